@@ -0,0 +1,388 @@
+#include "AssetLoader.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <Windows.h>
+#include <wincodec.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#pragma comment(lib, "windowscodecs.lib")
+
+using namespace Microsoft::WRL;
+
+static float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	return elapsed.count();
+}
+
+// "../../Assets/Textures/Albedo Maps/bronze.png" -> "Albedo Maps/bronze.png"
+static std::string GetReportName(const std::wstring& fileName)
+{
+	size_t slash = fileName.find_last_of(L"/\\");
+	if (slash != std::wstring::npos && slash > 0)
+		slash = fileName.find_last_of(L"/\\", slash - 1);
+	std::wstring shortName = slash == std::wstring::npos ? fileName : fileName.substr(slash + 1);
+
+	int length = WideCharToMultiByte(CP_UTF8, 0, shortName.c_str(), (int)shortName.size(), 0, 0, 0, 0);
+	std::string name(length, '\0');
+	if (length > 0)
+		WideCharToMultiByte(CP_UTF8, 0, shortName.c_str(), (int)shortName.size(), &name[0], length, 0, 0);
+	return name;
+}
+
+bool ReadWholeFile(const std::wstring& fileName, std::vector<char>& buffer)
+{
+	HANDLE file = CreateFileW(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size = {};
+	bool read = GetFileSizeEx(file, &size) && size.QuadPart > 0 && size.QuadPart < MAXDWORD;
+	if (read)
+	{
+		DWORD bytesRead = 0;
+		buffer.resize((size_t)size.QuadPart);
+		read = ReadFile(file, &buffer[0], (DWORD)size.QuadPart, &bytesRead, 0) && bytesRead == (DWORD)size.QuadPart;
+	}
+
+	CloseHandle(file);
+	return read;
+}
+
+bool DecodeImage(const std::vector<char>& file, DecodedImage& image)
+{
+	if (file.empty())
+		return false;
+
+	ComPtr<IWICImagingFactory> factory;
+	ComPtr<IWICStream> stream;
+	ComPtr<IWICBitmapDecoder> decoder;
+	ComPtr<IWICBitmapFrameDecode> frame;
+	if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, 0, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(factory.GetAddressOf()))) ||
+		FAILED(factory->CreateStream(stream.GetAddressOf())) ||
+		FAILED(stream->InitializeFromMemory((BYTE*)file.data(), (DWORD)file.size())) ||
+		FAILED(factory->CreateDecoderFromStream(stream.Get(), 0, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf())) ||
+		FAILED(decoder->GetFrame(0, frame.GetAddressOf())))
+		return false;
+
+	UINT width = 0;
+	UINT height = 0;
+	WICPixelFormatGUID sourceFormat = {};
+	if (FAILED(frame->GetSize(&width, &height)) || FAILED(frame->GetPixelFormat(&sourceFormat)) || width == 0 || height == 0)
+		return false;
+
+	bool gray = IsEqualGUID(sourceFormat, GUID_WICPixelFormat8bppGray) != 0;
+	WICPixelFormatGUID targetFormat = gray ? GUID_WICPixelFormat8bppGray : GUID_WICPixelFormat32bppRGBA;
+
+	// sRGB metadata, looked up the same way WICTextureLoader does
+	bool sRGB = false;
+	ComPtr<IWICMetadataQueryReader> metadata;
+	if (!gray && SUCCEEDED(frame->GetMetadataQueryReader(metadata.GetAddressOf())))
+	{
+		GUID container = {};
+		PROPVARIANT value;
+		PropVariantInit(&value);
+		if (SUCCEEDED(decoder->GetContainerFormat(&container)) && IsEqualGUID(container, GUID_ContainerFormatPng))
+		{
+			// A PNG with an sRGB chunk
+			sRGB = SUCCEEDED(metadata->GetMetadataByName(L"/sRGB/RenderingIntent", &value)) && value.vt == VT_UI1;
+		}
+		else if (SUCCEEDED(metadata->GetMetadataByName(L"System.Image.ColorSpace", &value)) && value.vt == VT_UI2)
+		{
+			sRGB = value.uiVal == 1;
+		}
+		PropVariantClear(&value);
+	}
+
+	image.width = width;
+	image.height = height;
+	image.rowPitch = width * (gray ? 1 : 4);
+	image.format = gray ? DXGI_FORMAT_R8_UNORM : (sRGB ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM);
+	image.pixels.resize((size_t)image.rowPitch * height);
+
+	if (IsEqualGUID(sourceFormat, targetFormat))
+		return SUCCEEDED(frame->CopyPixels(0, image.rowPitch, (UINT)image.pixels.size(), &image.pixels[0]));
+
+	ComPtr<IWICFormatConverter> converter;
+	return SUCCEEDED(factory->CreateFormatConverter(converter.GetAddressOf())) &&
+		SUCCEEDED(converter->Initialize(frame.Get(), targetFormat, WICBitmapDitherTypeErrorDiffusion, 0, 0.0, WICBitmapPaletteTypeMedianCut)) &&
+		SUCCEEDED(converter->CopyPixels(0, image.rowPitch, (UINT)image.pixels.size(), &image.pixels[0]));
+}
+
+HRESULT CreateTextureFromImage(ID3D11Device* device, ID3D11DeviceContext* context,
+	const DecodedImage& image, ID3D11ShaderResourceView** srv)
+{
+	// Mips are rendered by the GPU, if the format allows it
+	UINT support = 0;
+	bool generateMips = SUCCEEDED(device->CheckFormatSupport(image.format, &support)) &&
+		(support & D3D11_FORMAT_SUPPORT_MIP_AUTOGEN) != 0;
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = image.width;
+	desc.Height = image.height;
+	desc.MipLevels = generateMips ? 0 : 1;	// 0 = the full chain
+	desc.ArraySize = 1;
+	desc.Format = image.format;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | (generateMips ? D3D11_BIND_RENDER_TARGET : 0);
+	desc.MiscFlags = generateMips ? D3D11_RESOURCE_MISC_GENERATE_MIPS : 0;
+
+	ComPtr<ID3D11Texture2D> texture;
+	HRESULT hr = device->CreateTexture2D(&desc, 0, texture.GetAddressOf());
+	if (FAILED(hr))
+		return hr;
+
+	hr = device->CreateShaderResourceView(texture.Get(), 0, srv);
+	if (FAILED(hr))
+		return hr;
+
+	context->UpdateSubresource(texture.Get(), 0, 0, image.pixels.data(), image.rowPitch, (UINT)image.pixels.size());
+	if (generateMips)
+		context->GenerateMips(*srv);
+
+	return S_OK;
+}
+
+HRESULT CreateCubemapFromImages(ID3D11Device* device, const DecodedImage faces[6], ID3D11ShaderResourceView** srv)
+{
+	D3D11_SUBRESOURCE_DATA faceData[6] = {};
+	for (int i = 0; i < 6; i++)
+	{
+		if (faces[i].pixels.empty() || faces[i].width != faces[0].width ||
+			faces[i].height != faces[0].height || faces[i].format != faces[0].format)
+			return E_INVALIDARG;
+
+		faceData[i].pSysMem = faces[i].pixels.data();
+		faceData[i].SysMemPitch = faces[i].rowPitch;
+	}
+
+	// Faces go straight into the array slices, no copies between textures
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = faces[0].width;
+	desc.Height = faces[0].height;
+	desc.MipLevels = 1;
+	desc.ArraySize = 6;
+	desc.Format = faces[0].format;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+
+	ComPtr<ID3D11Texture2D> texture;
+	HRESULT hr = device->CreateTexture2D(&desc, faceData, texture.GetAddressOf());
+	if (FAILED(hr))
+		return hr;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = desc.Format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+	srvDesc.TextureCube.MipLevels = 1;
+	srvDesc.TextureCube.MostDetailedMip = 0;
+	return device->CreateShaderResourceView(texture.Get(), &srvDesc, srv);
+}
+
+AssetLoader::AssetLoader(ComPtr<ID3D11Device> device, ComPtr<ID3D11DeviceContext> context) :
+	device(device),
+	context(context)
+{
+}
+
+void AssetLoader::AddTexture(const std::wstring& fileName, ComPtr<ID3D11ShaderResourceView>* srv)
+{
+	std::unique_ptr<Asset> asset(new Asset());
+	asset->type = AssetTexture;
+	asset->timing.name = GetReportName(fileName);
+	asset->imageFiles.push_back(fileName);
+	asset->srv = srv;
+	assets.push_back(std::move(asset));
+}
+
+void AssetLoader::AddCubemap(const std::wstring faceFileNames[6], ComPtr<ID3D11ShaderResourceView>* srv)
+{
+	std::unique_ptr<Asset> asset(new Asset());
+	asset->type = AssetCubemap;
+	asset->timing.name = GetReportName(faceFileNames[0]) + " (cube)";
+	asset->imageFiles.assign(faceFileNames, faceFileNames + 6);
+	asset->srv = srv;
+	assets.push_back(std::move(asset));
+}
+
+void AssetLoader::AddMesh(const std::string& fileName, std::shared_ptr<Mesh>* mesh, bool optimize)
+{
+	std::unique_ptr<Asset> asset(new Asset());
+	asset->type = AssetMesh;
+	asset->timing.name = fileName.substr(fileName.find_last_of("/\\") + 1);
+	asset->meshFile = fileName;
+	asset->optimize = optimize;
+	asset->mesh = mesh;
+	assets.push_back(std::move(asset));
+}
+
+void AssetLoader::Load()
+{
+	PROFILE_SCOPE("Load Assets");
+	auto start = std::chrono::high_resolution_clock::now();
+	JobSystem& jobs = JobSystem::GetInstance();
+	report = AssetLoadReport();
+	report.threads = jobs.GetThreadCount();
+
+	// Job counts are set before anything is queued, so no asset can look finished early
+	for (auto& asset : assets)
+	{
+		unsigned int imageCount = (unsigned int)asset->imageFiles.size();
+		asset->jobsLeft = asset->type == AssetMesh ? 1 : imageCount;
+		asset->images.resize(imageCount);
+		asset->jobMilliseconds.assign(imageCount * 2, 0.0f);
+	}
+
+	for (auto& asset : assets)
+	{
+		Asset* a = asset.get();
+		if (a->type == AssetMesh)
+			jobs.Run([this, a]() { ImportMesh(a); });
+
+		for (unsigned int i = 0; i < a->images.size(); i++)
+			jobs.Run([this, a, i]() { LoadImageFile(a, i); });
+	}
+
+	// Upload whatever is ready, otherwise help with the decoding
+	size_t uploaded = 0;
+	std::vector<Asset*> ready;
+	while (uploaded < assets.size())
+	{
+		{
+			std::lock_guard<std::mutex> lock(readyLock);
+			ready.swap(readyAssets);
+		}
+
+		if (ready.empty())
+		{
+			if (!jobs.RunNextJob())
+				std::this_thread::yield();
+			continue;
+		}
+
+		for (Asset* asset : ready)
+		{
+			Upload(asset);
+			asset->timing.finishMilliseconds = MillisecondsSince(start);
+			uploaded++;
+		}
+		ready.clear();
+	}
+
+	report.totalMilliseconds = MillisecondsSince(start);
+	for (auto& asset : assets)
+	{
+		const AssetLoadTiming& t = asset->timing;
+		report.serialMilliseconds += t.readMilliseconds + t.decodeMilliseconds + t.uploadMilliseconds;
+		report.uploadMilliseconds += t.uploadMilliseconds;
+		report.criticalPathMilliseconds = (std::max)(report.criticalPathMilliseconds, t.longestJobMilliseconds + t.uploadMilliseconds);
+		report.assets.push_back(t);
+	}
+	report.criticalPathMilliseconds = (std::max)(report.criticalPathMilliseconds, report.uploadMilliseconds);
+
+	assets.clear();
+}
+
+const AssetLoadReport& AssetLoader::GetReport() const
+{
+	return report;
+}
+
+void AssetLoader::PrintReport() const
+{
+	printf("Loaded %d assets on %u threads in %.1f ms\n", (int)report.assets.size(), report.threads, report.totalMilliseconds);
+	printf("  One after another: %.1f ms, critical path: %.1f ms, uploads (main thread): %.1f ms\n",
+		report.serialMilliseconds, report.criticalPathMilliseconds, report.uploadMilliseconds);
+	printf("  %9s %9s %9s %9s  %s\n", "read", "decode", "upload", "done at", "asset");
+	for (const AssetLoadTiming& t : report.assets)
+	{
+		printf("  %9.2f %9.2f %9.2f %9.2f  %s%s%s\n",
+			t.readMilliseconds, t.decodeMilliseconds, t.uploadMilliseconds, t.finishMilliseconds,
+			t.name.c_str(), t.fromCache ? " [cached]" : "", t.failed ? " [FAILED]" : "");
+	}
+}
+
+// One job per image file: read, then decode
+void AssetLoader::LoadImageFile(Asset* asset, unsigned int image)
+{
+	PROFILE_SCOPE("Load Image");
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Pool threads run jobs from anywhere, so each job brings its own COM
+	HRESULT com = CoInitializeEx(0, COINIT_MULTITHREADED);
+
+	std::vector<char> file;
+	bool read = ReadWholeFile(asset->imageFiles[image], file);
+	asset->jobMilliseconds[image * 2] = MillisecondsSince(start);
+
+	auto decodeStart = std::chrono::high_resolution_clock::now();
+	if (!read || !DecodeImage(file, asset->images[image]))
+		asset->images[image] = DecodedImage();
+	asset->jobMilliseconds[image * 2 + 1] = MillisecondsSince(decodeStart);
+
+	if (SUCCEEDED(com))
+		CoUninitialize();
+
+	FinishJob(asset);
+}
+
+void AssetLoader::ImportMesh(Asset* asset)
+{
+	PROFILE_SCOPE("Import Mesh");
+	auto start = std::chrono::high_resolution_clock::now();
+	asset->timing.failed = !Mesh::Import(asset->meshFile.c_str(), asset->optimize, asset->meshData);
+	asset->timing.readMilliseconds = asset->meshData.readMilliseconds;
+	asset->timing.decodeMilliseconds = asset->meshData.parseMilliseconds;
+	asset->timing.longestJobMilliseconds = MillisecondsSince(start);
+	asset->timing.fromCache = asset->meshData.fromCache;
+
+	FinishJob(asset);
+}
+
+void AssetLoader::FinishJob(Asset* asset)
+{
+	std::lock_guard<std::mutex> lock(readyLock);
+	if (--asset->jobsLeft == 0)
+		readyAssets.push_back(asset);
+}
+
+// Main thread only, after every job of the asset is done
+void AssetLoader::Upload(Asset* asset)
+{
+	AssetLoadTiming& timing = asset->timing;
+	for (unsigned int i = 0; i < asset->images.size(); i++)
+	{
+		timing.readMilliseconds += asset->jobMilliseconds[i * 2];
+		timing.decodeMilliseconds += asset->jobMilliseconds[i * 2 + 1];
+		timing.longestJobMilliseconds = (std::max)(timing.longestJobMilliseconds, asset->jobMilliseconds[i * 2] + asset->jobMilliseconds[i * 2 + 1]);
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	switch (asset->type)
+	{
+	case AssetTexture:
+		timing.failed = asset->images[0].pixels.empty() ||
+			FAILED(CreateTextureFromImage(device.Get(), context.Get(), asset->images[0], asset->srv->ReleaseAndGetAddressOf()));
+		break;
+
+	case AssetCubemap:
+		timing.failed = FAILED(CreateCubemapFromImages(device.Get(), &asset->images[0], asset->srv->ReleaseAndGetAddressOf()));
+		break;
+
+	case AssetMesh:
+		// Even a failed import gets an (empty) mesh, like the file constructor
+		*asset->mesh = std::make_shared<Mesh>(device, context, asset->meshData);
+		break;
+	}
+	timing.uploadMilliseconds = MillisecondsSince(start);
+
+	// The CPU copies (or the mapped cache file) aren't needed anymore
+	asset->images.clear();
+	asset->meshData = MeshImportData();
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Mesh.h"
+
+// --------------------------------------------------------
+// Pixels of one decoded image, before it becomes a texture
+// --------------------------------------------------------
+struct DecodedImage
+{
+	std::vector<unsigned char> pixels;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	unsigned int rowPitch = 0;
+	DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+};
+
+// Whole file into buffer, false if it's missing, empty or can't be read
+bool ReadWholeFile(const std::wstring& fileName, std::vector<char>& buffer);
+
+// Decodes an image file held in memory with WIC.  Grayscale stays
+// one channel, everything else becomes 32-bit RGBA, and sRGB metadata
+// picks the _SRGB format (the same choices WICTextureLoader makes).
+// No Direct3D, so any thread can call it.
+bool DecodeImage(const std::vector<char>& file, DecodedImage& image);
+
+// Texture with a full mip chain generated on the GPU, so it needs
+// the immediate context (main thread only)
+HRESULT CreateTextureFromImage(ID3D11Device* device, ID3D11DeviceContext* context,
+	const DecodedImage& image, ID3D11ShaderResourceView** srv);
+
+// Cube map from six same-sized faces (+X, -X, +Y, -Y, +Z, -Z), one mip
+HRESULT CreateCubemapFromImages(ID3D11Device* device, const DecodedImage faces[6], ID3D11ShaderResourceView** srv);
+
+// Times of one asset, in milliseconds
+struct AssetLoadTiming
+{
+	std::string name;
+	float readMilliseconds = 0.0f;		// File reads
+	float decodeMilliseconds = 0.0f;	// Image decoding or OBJ parsing (summed over cube faces)
+	float uploadMilliseconds = 0.0f;	// Creating the Direct3D objects on the main thread
+	float longestJobMilliseconds = 0.0f;	// Slowest read + decode job (cube faces are separate jobs)
+	float finishMilliseconds = 0.0f;	// When its upload finished, from the start of Load()
+	bool fromCache = false;				// Mesh came from its binary cache
+	bool failed = false;
+};
+
+struct AssetLoadReport
+{
+	std::vector<AssetLoadTiming> assets;
+	unsigned int threads = 0;
+	float totalMilliseconds = 0.0f;			// Wall clock time of Load()
+	float serialMilliseconds = 0.0f;		// Every read, decode and upload one after another
+	float uploadMilliseconds = 0.0f;		// The part that always runs on the main thread
+	float criticalPathMilliseconds = 0.0f;	// Longest job chain: slowest job + its upload,
+											// or all uploads back to back if that's longer
+};
+
+// --------------------------------------------------------
+// Loads a batch of textures, cube maps and meshes together.
+//
+// Reading files, decoding images and parsing meshes are
+// JobSystem jobs (one per file, so a cube map's six faces
+// decode in parallel).  The main thread creates each
+// asset's Direct3D objects as soon as its jobs are done,
+// while the rest are still decoding, and runs queued jobs
+// itself when nothing is ready yet.
+//
+// Results are written through the pointers given to Add*()
+// when Load() returns, and stay null for anything that
+// failed to load.
+// --------------------------------------------------------
+class AssetLoader
+{
+public:
+	AssetLoader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	void AddTexture(const std::wstring& fileName, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>* srv);
+	void AddCubemap(const std::wstring faceFileNames[6], Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>* srv);
+	void AddMesh(const std::string& fileName, std::shared_ptr<Mesh>* mesh, bool optimize = true);
+
+	// Loads everything added since the last Load()
+	void Load();
+
+	const AssetLoadReport& GetReport() const;
+	void PrintReport() const;	// To the console
+
+private:
+	enum AssetType
+	{
+		AssetTexture,
+		AssetCubemap,
+		AssetMesh
+	};
+
+	struct Asset
+	{
+		AssetType type;
+		AssetLoadTiming timing;
+		std::vector<std::wstring> imageFiles;	// One, or six cube faces
+		std::vector<DecodedImage> images;
+		std::vector<float> jobMilliseconds;		// Read + decode per image
+		std::string meshFile;
+		bool optimize = true;
+		MeshImportData meshData;
+		unsigned int jobsLeft = 0;	// Only changed under readyLock
+
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>* srv = 0;
+		std::shared_ptr<Mesh>* mesh = 0;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+	std::vector<std::unique_ptr<Asset>> assets;
+	std::mutex readyLock;
+	std::vector<Asset*> readyAssets;	// Every job done, waiting for the main thread
+	AssetLoadReport report;
+
+	void LoadImageFile(Asset* asset, unsigned int image);
+	void ImportMesh(Asset* asset);
+	void FinishJob(Asset* asset);
+	void Upload(Asset* asset);
+};
@@ -0,0 +1,334 @@
+#include "AssetStreamer.h"
+#include "Profiler.h"
+#include <Windows.h>
+#include <chrono>
+#include <thread>
+
+using namespace Microsoft::WRL;
+
+static float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	return elapsed.count();
+}
+
+// 1x1 texture of one color, for shaders sampling something that hasn't loaded
+static HRESULT CreateSolidTexture(ID3D11Device* device, unsigned int rgba, ID3D11ShaderResourceView** srv)
+{
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = 1;
+	desc.Height = 1;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	D3D11_SUBRESOURCE_DATA data = {};
+	data.pSysMem = &rgba;
+	data.SysMemPitch = sizeof(rgba);
+
+	ComPtr<ID3D11Texture2D> texture;
+	HRESULT hr = device->CreateTexture2D(&desc, &data, texture.GetAddressOf());
+	if (FAILED(hr))
+		return hr;
+
+	return device->CreateShaderResourceView(texture.Get(), 0, srv);
+}
+
+AssetStreamer::AssetStreamer(ComPtr<ID3D11Device> device, ComPtr<ID3D11DeviceContext> context) :
+	device(device),
+	context(context),
+	inFlight(0),
+	stopping(false),
+	decodeMilliseconds(0.0f),
+	uploadsPerFrame(2)
+{
+	// In TexturePlaceholder order, as 0xAABBGGRR
+	const unsigned int colors[4] = { 0xFF808080, 0xFFFF8080, 0xFF000000, 0xFFFFFFFF };
+	for (int i = 0; i < 4; i++)
+		CreateSolidTexture(device.Get(), colors[i], placeholderTextures[i].GetAddressOf());
+}
+
+AssetStreamer::~AssetStreamer()
+{
+	// Jobs still queued only lower the count now, but they
+	// all have to be gone before this object is
+	stopping = true;
+	JobSystem& jobs = JobSystem::GetInstance();
+	while (!decodeJobs.IsDone())
+	{
+		if (!jobs.RunBackgroundJob())
+			std::this_thread::yield();
+	}
+	jobs.Wait(&decodeJobs);
+}
+
+std::shared_ptr<StreamedTexture> AssetStreamer::RequestTexture(const std::wstring& fileName, TexturePlaceholder placeholder, AssetLoader* loader)
+{
+	auto found = textures.find(fileName);
+	if (found != textures.end())
+		return found->second;
+
+	auto texture = std::make_shared<StreamedTexture>();
+	texture->fileName = fileName;
+	texture->placeholder = placeholderTextures[placeholder];
+	texture->srv = texture->placeholder;
+	textures[fileName] = texture;
+	stats.requested++;
+
+	if (loader)
+	{
+		// The loader writes straight into the handle
+		loader->AddTexture(fileName, &texture->srv);
+		loaderTextures.push_back(texture);
+	}
+	else
+		Enqueue({ texture, nullptr });
+
+	return texture;
+}
+
+std::shared_ptr<StreamedMesh> AssetStreamer::RequestMesh(const std::string& fileName, bool optimize)
+{
+	auto found = meshes.find(fileName);
+	if (found != meshes.end())
+		return found->second;
+
+	auto mesh = std::make_shared<StreamedMesh>();
+	mesh->fileName = fileName;
+	mesh->optimize = optimize;
+	mesh->mesh = placeholderMesh;
+	meshes[fileName] = mesh;
+	stats.requested++;
+
+	Enqueue({ nullptr, mesh });
+	return mesh;
+}
+
+void AssetStreamer::BindTexture(std::shared_ptr<StreamedTexture> texture, std::shared_ptr<Material> material, const std::string& name)
+{
+	material->SetTextureSRV(name, texture->srv);
+
+	// Nothing left to swap in once it's resident (or failed)
+	if (texture->state == StreamLoading)
+		texture->bindings.push_back({ material, name });
+}
+
+void AssetStreamer::BindMesh(std::shared_ptr<StreamedMesh> mesh, std::shared_ptr<Entity> entity)
+{
+	if (mesh->mesh)
+		entity->SetMesh(mesh->mesh);
+
+	if (mesh->state == StreamLoading)
+		mesh->bindings.push_back(entity);
+}
+
+void AssetStreamer::SetPlaceholderMesh(std::shared_ptr<Mesh> mesh)
+{
+	placeholderMesh = mesh;
+}
+
+void AssetStreamer::Update()
+{
+	PROFILE_SCOPE("Commit Streamed Assets");
+	stats.texturesCommittedLastUpdate = 0;
+	stats.meshesCommittedLastUpdate = 0;
+
+	// Without workers nobody else would ever run the decodes
+	JobSystem& jobs = JobSystem::GetInstance();
+	if (jobs.GetThreadCount() == 1 && GetStats().queued > 0)
+		jobs.RunBackgroundJob();
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (unsigned int i = 0; i < uploadsPerFrame; i++)
+	{
+		Request request;
+		{
+			std::lock_guard<std::mutex> lock(queueLock);
+			if (finished.empty())
+				break;
+
+			request = std::move(finished.front());
+			finished.pop_front();
+		}
+
+		Commit(request);
+	}
+
+	stats.uploadMillisecondsLastUpdate = MillisecondsSince(start);
+}
+
+void AssetStreamer::Flush()
+{
+	JobSystem& jobs = JobSystem::GetInstance();
+	while (true)
+	{
+		Request request;
+		bool done = false;
+		{
+			std::lock_guard<std::mutex> lock(queueLock);
+			if (!finished.empty())
+			{
+				request = std::move(finished.front());
+				finished.pop_front();
+			}
+			else
+				done = inFlight == 0;
+		}
+
+		if (request.texture || request.mesh)
+			Commit(request);
+		else if (done)
+			break;
+		else if (!jobs.RunBackgroundJob())
+			std::this_thread::yield();	// The last ones are on workers
+	}
+}
+
+void AssetStreamer::CommitLoaded()
+{
+	for (auto& texture : loaderTextures)
+	{
+		// Left alone if the file didn't decode, released if the upload failed
+		if (texture->srv && texture->srv != texture->placeholder)
+		{
+			texture->state = StreamResident;
+			SwapIn(*texture);
+			stats.resident++;
+		}
+		else
+		{
+			texture->srv = texture->placeholder;
+			texture->state = StreamFailed;
+			stats.failed++;
+		}
+		texture->bindings.clear();
+	}
+	loaderTextures.clear();
+}
+
+void AssetStreamer::SetUploadsPerFrame(unsigned int uploads)
+{
+	uploadsPerFrame = uploads;
+}
+
+AssetStreamerStats AssetStreamer::GetStats() const
+{
+	AssetStreamerStats current = stats;
+
+	std::lock_guard<std::mutex> lock(queueLock);
+	current.queued = inFlight;
+	current.readyToUpload = (unsigned int)finished.size();
+	current.decodeMilliseconds = decodeMilliseconds;
+	return current;
+}
+
+// The only one touching the handle's image or data until it's in finished
+void AssetStreamer::Decode(Request& request)
+{
+	float milliseconds = 0.0f;
+	if (!stopping)
+	{
+		// Pool threads run jobs from anywhere, so each job brings its own COM
+		HRESULT com = CoInitializeEx(0, COINIT_MULTITHREADED);
+		auto start = std::chrono::high_resolution_clock::now();
+		if (request.texture)
+		{
+			PROFILE_SCOPE("Decode Texture");
+			std::vector<char> file;
+			StreamedTexture& texture = *request.texture;
+			texture.decoded = ReadWholeFile(texture.fileName, file) && DecodeImage(file, texture.image);
+		}
+		else
+		{
+			PROFILE_SCOPE("Import Mesh");
+			StreamedMesh& mesh = *request.mesh;
+			mesh.imported = Mesh::Import(mesh.fileName.c_str(), mesh.optimize, mesh.data);
+		}
+		milliseconds = MillisecondsSince(start);
+
+		if (SUCCEEDED(com))
+			CoUninitialize();
+	}
+
+	std::lock_guard<std::mutex> lock(queueLock);
+	if (!stopping)
+		finished.push_back(std::move(request));
+	inFlight--;
+	decodeMilliseconds += milliseconds;
+}
+
+// Main thread: creates the Direct3D objects and swaps them in everywhere they're bound
+void AssetStreamer::Commit(Request& request)
+{
+	if (request.texture)
+	{
+		StreamedTexture& texture = *request.texture;
+
+		ComPtr<ID3D11ShaderResourceView> srv;
+		if (texture.decoded && SUCCEEDED(CreateTextureFromImage(device.Get(), context.Get(), texture.image, srv.GetAddressOf())))
+		{
+			texture.srv = srv;
+			texture.state = StreamResident;
+			SwapIn(texture);
+			stats.resident++;
+		}
+		else
+		{
+			texture.state = StreamFailed;
+			stats.failed++;
+		}
+
+		texture.image = DecodedImage();
+		texture.bindings.clear();
+		stats.texturesCommittedLastUpdate++;
+	}
+	else
+	{
+		StreamedMesh& mesh = *request.mesh;
+
+		if (mesh.imported && mesh.data.GetIndexCount() > 0)
+		{
+			mesh.mesh = std::make_shared<Mesh>(device, context, mesh.data);
+			mesh.state = StreamResident;
+			for (auto& binding : mesh.bindings)
+			{
+				if (auto entity = binding.lock())
+					entity->SetMesh(mesh.mesh);
+			}
+			stats.resident++;
+		}
+		else
+		{
+			mesh.state = StreamFailed;
+			stats.failed++;
+		}
+
+		mesh.data = MeshImportData();
+		mesh.bindings.clear();
+		stats.meshesCommittedLastUpdate++;
+	}
+}
+
+void AssetStreamer::Enqueue(Request request)
+{
+	{
+		std::lock_guard<std::mutex> lock(queueLock);
+		inFlight++;
+	}
+
+	JobSystem::GetInstance().RunBackground([this, request]() mutable { Decode(request); }, &decodeJobs);
+}
+
+// Every material bound to the texture gets its current SRV
+void AssetStreamer::SwapIn(StreamedTexture& texture)
+{
+	for (auto& binding : texture.bindings)
+	{
+		if (auto material = binding.material.lock())
+			material->SetTextureSRV(binding.name, texture.srv);
+	}
+}
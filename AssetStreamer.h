@@ -0,0 +1,189 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "AssetLoader.h"
+#include "Entity.h"
+#include "JobSystem.h"
+#include "Material.h"
+#include "Mesh.h"
+
+enum StreamState
+{
+	StreamLoading,	// Placeholder bound, file still being read or decoded, or waiting to upload
+	StreamResident,	// Real resource bound
+	StreamFailed	// Placeholder stays
+};
+
+// What a texture shows until its file has streamed in
+enum TexturePlaceholder
+{
+	PlaceholderGrey,		// Albedo, roughness
+	PlaceholderFlatNormal,	// Normal maps: (0.5, 0.5, 1) is straight out of the surface
+	PlaceholderBlack,		// Metalness
+	PlaceholderWhite
+};
+
+// --------------------------------------------------------
+// Handle to a streamed texture.  GetSRV() is the placeholder
+// until the streamer commits the real texture, then that.
+// --------------------------------------------------------
+class StreamedTexture
+{
+public:
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetSRV() const { return srv; }
+	StreamState GetState() const { return state; }
+	const std::wstring& GetFileName() const { return fileName; }
+
+private:
+	friend class AssetStreamer;
+
+	struct Binding
+	{
+		std::weak_ptr<Material> material;
+		std::string name;
+	};
+
+	std::wstring fileName;
+	StreamState state = StreamLoading;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> placeholder;
+	std::vector<Binding> bindings;	// Main thread only
+	DecodedImage image;				// Its decode job's, until it's handed back
+	bool decoded = false;
+};
+
+// --------------------------------------------------------
+// Handle to a streamed mesh, the proxy cube until it's
+// committed
+// --------------------------------------------------------
+class StreamedMesh
+{
+public:
+	std::shared_ptr<Mesh> GetMesh() const { return mesh; }
+	StreamState GetState() const { return state; }
+	const std::string& GetFileName() const { return fileName; }
+
+private:
+	friend class AssetStreamer;
+
+	std::string fileName;
+	bool optimize = true;
+	StreamState state = StreamLoading;
+	std::shared_ptr<Mesh> mesh;
+	std::vector<std::weak_ptr<Entity>> bindings;	// Main thread only
+	MeshImportData data;	// Its import job's, until it's handed back
+	bool imported = false;
+};
+
+struct AssetStreamerStats
+{
+	unsigned int requested = 0;		// Different files asked for
+	unsigned int resident = 0;
+	unsigned int failed = 0;
+	unsigned int queued = 0;		// Waiting for or running as a background job
+	unsigned int readyToUpload = 0;	// Decoded, held back by the upload budget
+	unsigned int texturesCommittedLastUpdate = 0;
+	unsigned int meshesCommittedLastUpdate = 0;
+	float uploadMillisecondsLastUpdate = 0.0f;
+	float decodeMilliseconds = 0.0f;	// Reads and decodes in background jobs, in total
+};
+
+// --------------------------------------------------------
+// Loads textures and meshes while the game keeps running.
+//
+// Request*() returns a handle at once, with a placeholder
+// (1x1 grey, flat normal, black or white texture, or the
+// proxy cube) that can be bound and drawn right away.  Each
+// file is read and decoded by a JobSystem background job,
+// reusing DecodeImage() and Mesh::Import(), and Update()
+// commits at most uploadsPerFrame of the finished ones each
+// frame (creating Direct3D objects and generating mips are
+// main thread work that shows up in the frame time).
+//
+// Background jobs, since a decode can take tens of
+// milliseconds: only workers run them, so a frame that
+// Wait()s on a ParallelFor never ends up running one.
+//
+// Committing swaps the real resource into the handle and
+// into everything bound to it with Bind*().
+//
+// Textures needed before the first frame can go through an
+// AssetLoader instead, with everything else loaded up front.
+// --------------------------------------------------------
+class AssetStreamer
+{
+public:
+	AssetStreamer(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	~AssetStreamer();	// Drops whatever hasn't loaded yet
+
+	AssetStreamer(AssetStreamer const&) = delete;
+	void operator=(AssetStreamer const&) = delete;
+
+	// The same file asked for twice gets the same handle.  With a loader the
+	// file is added to it instead of streamed, see CommitLoaded().
+	std::shared_ptr<StreamedTexture> RequestTexture(const std::wstring& fileName, TexturePlaceholder placeholder, AssetLoader* loader = 0);
+	std::shared_ptr<StreamedMesh> RequestMesh(const std::string& fileName, bool optimize = true);
+
+	// Sets the texture on the material now (placeholder or not),
+	// and again when the real one is committed
+	void BindTexture(std::shared_ptr<StreamedTexture> texture, std::shared_ptr<Material> material, const std::string& name);
+	void BindMesh(std::shared_ptr<StreamedMesh> mesh, std::shared_ptr<Entity> entity);
+
+	// Stands in for meshes that haven't loaded, must be set before RequestMesh()
+	void SetPlaceholderMesh(std::shared_ptr<Mesh> mesh);
+
+	// Main thread, once a frame: commits up to uploadsPerFrame finished assets
+	void Update();
+
+	// After the loader given to RequestTexture() has Load()ed: makes its
+	// textures resident (or failed), and swaps them in where they're bound
+	void CommitLoaded();
+
+	// Waits for and commits everything requested so far, ignoring the budget
+	void Flush();
+
+	unsigned int GetUploadsPerFrame() const { return uploadsPerFrame; }
+	void SetUploadsPerFrame(unsigned int uploads);
+	AssetStreamerStats GetStats() const;
+
+private:
+	struct Request
+	{
+		std::shared_ptr<StreamedTexture> texture;
+		std::shared_ptr<StreamedMesh> mesh;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> placeholderTextures[4];
+	std::shared_ptr<Mesh> placeholderMesh;
+
+	std::unordered_map<std::wstring, std::shared_ptr<StreamedTexture>> textures;
+	std::unordered_map<std::string, std::shared_ptr<StreamedMesh>> meshes;
+
+	std::vector<std::shared_ptr<StreamedTexture>> loaderTextures;	// Waiting for CommitLoaded()
+
+	JobCounter decodeJobs;
+	mutable std::mutex queueLock;
+	std::deque<Request> finished;	// Decoded, waiting for Update()
+	unsigned int inFlight;			// Queued or running, not yet in finished
+	std::atomic<bool> stopping;		// Jobs that haven't started skip their file
+	float decodeMilliseconds;
+
+	unsigned int uploadsPerFrame;
+	AssetStreamerStats stats;
+
+	void Decode(Request& request);	// In a background job
+	void Commit(Request& request);
+	void Enqueue(Request request);
+	void SwapIn(StreamedTexture& texture);
+};
@@ -118,6 +118,16 @@ float Camera::GetFieldOfView()
 	return fieldOfViewAngle;
 }
 
+float Camera::GetNearClipPlaneDistance()
+{
+	return nearClipPlaneDistance;
+}
+
+float Camera::GetFarClipPlaneDistance()
+{
+	return farPlaneDistance;
+}
+
 bool Camera::UsingPerspectiveProjection()
 {
 	return perspectiveProjection;
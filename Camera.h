@@ -34,6 +34,8 @@ public:
 	void ResetPosition();
 	void SetFieldOfView(float fov, float aspectRation);
 	float GetFieldOfView();
+	float GetNearClipPlaneDistance();
+	float GetFarClipPlaneDistance();
 	bool UsingPerspectiveProjection();
 	std::shared_ptr<Transform> GetTransform();
 };
@@ -1,5 +1,9 @@
 #include "DXCore.h"
 #include "Input.h"
+#include "TransformSystem.h"
+#include "RenderStateCache.h"
+#include "JobSystem.h"
+#include "Profiler.h"
 #include <dxgi1_5.h>
 #include <WindowsX.h>
 #include <sstream>
@@ -51,6 +55,11 @@ DXCore::DXCore(
 	dxFeatureLevel(D3D_FEATURE_LEVEL_11_0),
 	fpsTimeElapsed(0),
 	fpsFrameCount(0),
+	frameStatsCSVOnExit(false),
+	previousPresentTime(0),
+	presentInterval(0),
+	presentBlockedTime(0),
+	presented(false),
 	previousTime(0),
 	currentTime(0),
 	hasFocus(true),
@@ -83,6 +92,19 @@ DXCore::~DXCore()
 
 	// Delete input manager singleton
 	delete& Input::GetInstance();
+
+	// Delete transform system singleton (every Transform is gone by now)
+	delete& TransformSystem::GetInstance();
+
+	// Delete render state cache singleton
+	delete& RenderStateCache::GetInstance();
+
+	// Delete job system singleton (stops its worker threads)
+	// - Jobs still queued run first, and they have profiler scopes
+	delete& JobSystem::GetInstance();
+
+	// Delete profiler singleton last, nothing can open a scope now
+	delete& Profiler::GetInstance();
 }
 
 // --------------------------------------------------------
@@ -410,6 +432,10 @@ HRESULT DXCore::Run()
 	currentTime = now;
 	previousTime = now;
 
+	// Created before Init() starts any jobs that could time themselves
+	Profiler::NameCurrentThread("Main");
+	Profiler::GetInstance();
+
 	// Give subclass a chance to initialize
 	Init();
 
@@ -436,8 +462,19 @@ HRESULT DXCore::Run()
 			Input::GetInstance().Update();
 
 			// The game loop
-			Update(deltaTime, totalTime);
-			Draw(deltaTime, totalTime);
+			__int64 frameStart = 0;
+			QueryPerformanceCounter((LARGE_INTEGER*)&frameStart);
+			presented = false;
+			presentBlockedTime = 0;
+
+			Profiler::GetInstance().BeginFrame();
+			{
+				PROFILE_SCOPE("Frame");
+				Update(deltaTime, totalTime);
+				Draw(deltaTime, totalTime);
+			}
+			Profiler::GetInstance().EndFrame();
+			RecordFrameStats(frameStart);
 
 			// Frame is over, notify the input manager
 			Input::GetInstance().EndOfFrame();
@@ -446,6 +483,9 @@ HRESULT DXCore::Run()
 
 	// We'll end up here once we get a WM_QUIT message,
 	// which usually comes from the user closing the window
+	if (frameStatsCSVOnExit)
+		frameStats.WriteCSV("frame_stats.csv");
+
 	return (HRESULT)msg.wParam;
 }
 
@@ -484,6 +524,48 @@ void DXCore::UpdateTimer()
 }
 
 
+// --------------------------------------------------------
+// Presents the frame, timing the call (it blocks while the
+// GPU is behind, or until vsync) and the time since the last
+// --------------------------------------------------------
+HRESULT DXCore::Present(UINT syncInterval, UINT flags)
+{
+	__int64 start = 0;
+	QueryPerformanceCounter((LARGE_INTEGER*)&start);
+
+	HRESULT hr = swapChain->Present(syncInterval, flags);
+
+	__int64 end = 0;
+	QueryPerformanceCounter((LARGE_INTEGER*)&end);
+	presentBlockedTime += end - start;
+	presentInterval = previousPresentTime ? start - previousPresentTime : 0;
+	previousPresentTime = start;
+	presented = true;
+	return hr;
+}
+
+
+// --------------------------------------------------------
+// Adds this frame to frameStats: the CPU time is the whole
+// of Update() and Draw() minus what Present() spent blocked
+// --------------------------------------------------------
+void DXCore::RecordFrameStats(__int64 frameStart)
+{
+	// The first present has no interval yet
+	if (!presented || presentInterval == 0)
+		return;
+
+	__int64 frameEnd = 0;
+	QueryPerformanceCounter((LARGE_INTEGER*)&frameEnd);
+
+	double toMilliseconds = perfCounterSeconds * 1000.0;
+	frameStats.Record(
+		(float)((frameEnd - frameStart - presentBlockedTime) * toMilliseconds),
+		(float)(presentInterval * toMilliseconds),
+		(float)(presentBlockedTime * toMilliseconds));
+}
+
+
 // --------------------------------------------------------
 // Updates the window's title bar with several stats once
 // per second, including:
@@ -4,6 +4,7 @@
 #include <d3d11.h>
 #include <string>
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
+#include "FrameStats.h"
 
 // We can include the correct library files here
 // instead of in Visual Studio settings if we want
@@ -75,6 +76,14 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> backBufferRTV;
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> depthBufferDSV;
 
+	// Per-frame CPU and present times, kept since the title bar only shows an average
+	FrameStats frameStats;
+	bool frameStatsCSVOnExit; // Writes frame_stats.csv when the game loop ends
+
+	// Presents the back buffer and times how long the call blocks,
+	// use this instead of swapChain->Present() so frameStats sees it
+	HRESULT Present(UINT syncInterval, UINT flags);
+
 	// Helper function for allocating a console window
 	void CreateConsoleWindow(int bufferLines, int bufferColumns, int windowLines, int windowColumns);
 
@@ -91,7 +100,14 @@ private:
 	int fpsFrameCount;
 	float fpsTimeElapsed;
 
+	// Present() timing for the current frame
+	__int64 previousPresentTime;
+	__int64 presentInterval;
+	__int64 presentBlockedTime;
+	bool presented;
+
 	void UpdateTimer();			// Updates the timer for this frame
+	void RecordFrameStats(__int64 frameStart);	// After Update() and Draw()
 	void UpdateTitleBarStats();	// Puts debug info in the title bar
 };
 
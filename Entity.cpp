@@ -7,10 +7,13 @@
 Entity::Entity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material)
 {
 	object = std::make_shared<Transform>();
-	colorTint = DirectX::XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+	colorTint = DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f); //multiplied with the material's tint
 	this->mesh = mesh;
 	this->material = material;
 	moveForward = true;
+	useGammaCorrection = false;
+	isStatic = false;
+	lightCount = -1;
 }
 std::shared_ptr<Mesh> Entity::GetMesh()
 {
@@ -22,34 +25,79 @@ bool Entity::GetMoveForward()
 	return moveForward;
 }
 
+bool Entity::GetUseGammaCorrection()
+{
+	return useGammaCorrection;
+}
+
+bool Entity::GetIsStatic()
+{
+	return isStatic;
+}
+
 std::shared_ptr<Transform> Entity::GetTransform()
 {
 	return object;
 }
 
-void Entity::Draw(std::shared_ptr<Camera> camera)
+void Entity::Draw()
 {
 	std::shared_ptr<SimpleVertexShader> vs = material->GetVertexShader();
 	std::shared_ptr<SimplePixelShader> ps = material->GetPixelShader();
 
-	vs->SetMatrix4x4("worldMatrix", object->GetWorldMatrix());
-	vs->SetMatrix4x4("worldInvTranspose", object->GetWorldInverseTransposeMatrix());
-	vs->SetMatrix4x4("projectionMatrix", camera->GetProjectionMatrix());
-	vs->SetMatrix4x4("viewMatrix", camera->GetViewMatrix());
+	// Only the per-object (and per-material) buffers change between
+	// entities, the per-frame ones are skipped as they're still clean
+	material->SetObjectData(object->GetWorldMatrix(), object->GetWorldInverseTransposeMatrix(), colorTint, useGammaCorrection);
+	material->SetObjectLights(lightIndices, lightCount);
+	material->SetMaterialData();
 	vs->CopyAllBufferData();
-
-	ps->SetFloat4("colorTint", material->GetColorTint());
-	ps->SetFloat3("cameraPosition", camera->GetTransform()->GetPosition());
 	ps->CopyAllBufferData();
 
-	
-	material->GetVertexShader()->SetShader();
-	material->GetPixelShader()->SetShader();
-
+	vs->SetShader();
+	ps->SetShader();
 
 	mesh->Draw();
 }
 
+// Transforms the local box's center, and finds the world space half size by
+// running the extents through the absolute value of the rotation/scale part
+void Entity::GetWorldBounds(DirectX::XMFLOAT3& center, DirectX::XMFLOAT3& extents)
+{
+	DirectX::XMFLOAT3 boundsMin = mesh->GetBoundsMin();
+	DirectX::XMFLOAT3 boundsMax = mesh->GetBoundsMax();
+	DirectX::XMVECTOR localMin = DirectX::XMLoadFloat3(&boundsMin);
+	DirectX::XMVECTOR localMax = DirectX::XMLoadFloat3(&boundsMax);
+	DirectX::XMVECTOR localCenter = DirectX::XMVectorScale(DirectX::XMVectorAdd(localMin, localMax), 0.5f);
+	DirectX::XMVECTOR localExtents = DirectX::XMVectorScale(DirectX::XMVectorSubtract(localMax, localMin), 0.5f);
+
+	DirectX::XMFLOAT4X4 worldMatrix = object->GetWorldMatrix();
+	DirectX::XMMATRIX world = DirectX::XMLoadFloat4x4(&worldMatrix);
+
+	DirectX::XMVECTOR worldExtents = DirectX::XMVectorMultiply(DirectX::XMVectorAbs(world.r[0]), DirectX::XMVectorSplatX(localExtents));
+	worldExtents = DirectX::XMVectorMultiplyAdd(DirectX::XMVectorAbs(world.r[1]), DirectX::XMVectorSplatY(localExtents), worldExtents);
+	worldExtents = DirectX::XMVectorMultiplyAdd(DirectX::XMVectorAbs(world.r[2]), DirectX::XMVectorSplatZ(localExtents), worldExtents);
+
+	DirectX::XMStoreFloat3(&center, DirectX::XMVector3TransformCoord(localCenter, world));
+	DirectX::XMStoreFloat3(&extents, worldExtents);
+}
+
+void Entity::GetWorldBoundingSphere(DirectX::XMFLOAT3& center, float& radius)
+{
+	DirectX::XMFLOAT3 localCenter = mesh->GetBoundingSphereCenter();
+	DirectX::XMFLOAT4X4 worldMatrix = object->GetWorldMatrix();
+	DirectX::XMMATRIX world = DirectX::XMLoadFloat4x4(&worldMatrix);
+
+	// Non-uniform scale stretches the sphere, so use the largest axis
+	float scaleX = DirectX::XMVectorGetX(DirectX::XMVector3Length(world.r[0]));
+	float scaleY = DirectX::XMVectorGetX(DirectX::XMVector3Length(world.r[1]));
+	float scaleZ = DirectX::XMVectorGetX(DirectX::XMVector3Length(world.r[2]));
+	float maxScale = scaleX > scaleY ? scaleX : scaleY;
+	maxScale = scaleZ > maxScale ? scaleZ : maxScale;
+
+	DirectX::XMStoreFloat3(&center, DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&localCenter), world));
+	radius = mesh->GetBoundingSphereRadius() * maxScale;
+}
+
 DirectX::XMFLOAT4 Entity::GetColorTint()
 {
 	return colorTint;
@@ -60,6 +108,11 @@ std::shared_ptr<Material> Entity::GetMaterial()
 	return material;
 }
 
+void Entity::SetMesh(std::shared_ptr<Mesh> mesh)
+{
+	this->mesh = mesh;
+}
+
 void Entity::SetMaterial(std::shared_ptr<Material> material)
 {
 	this->material = material;
@@ -74,3 +127,20 @@ void Entity::SetColorTint(DirectX::XMFLOAT4 colorTint)
 {
 	this->colorTint = colorTint;
 }
+
+void Entity::SetUseGammaCorrection(bool useGammaCorrection)
+{
+	this->useGammaCorrection = useGammaCorrection;
+}
+
+void Entity::SetIsStatic(bool isStatic)
+{
+	this->isStatic = isStatic;
+}
+
+void Entity::SetLightList(const unsigned int* indices, int count)
+{
+	lightCount = count < MAX_OBJECT_LIGHTS ? count : MAX_OBJECT_LIGHTS;
+	for (int i = 0; i < lightCount; i++)
+		lightIndices[i] = indices[i];
+}
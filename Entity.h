@@ -5,6 +5,7 @@
 #include <DirectXMath.h>
 #include "Camera.h"
 #include "Material.h"
+#include "LightSelector.h"
 
 class Entity
 {
@@ -14,17 +15,29 @@ private:
 	std::shared_ptr<Material> material;
 	DirectX::XMFLOAT4 colorTint;
 	bool moveForward;
+	bool useGammaCorrection;
+	bool isStatic; //never moves, so its shadow can be cached
+	unsigned int lightIndices[MAX_OBJECT_LIGHTS];
+	int lightCount; //negative: the pixel shader uses its light cluster instead
 
 public:
 	Entity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material);
 	std::shared_ptr<Mesh> GetMesh();
 	bool GetMoveForward();
+	bool GetUseGammaCorrection();
+	bool GetIsStatic();
 	std::shared_ptr<Transform> GetTransform();
 	DirectX::XMFLOAT4 GetColorTint();
 	std::shared_ptr<Material> GetMaterial();
 	void SetColorTint(DirectX::XMFLOAT4 colorTint);
+	void SetMesh(std::shared_ptr<Mesh> mesh);
 	void SetMaterial(std::shared_ptr<Material> material);
 	void SetMoveForward(bool moveForward);
-	void Draw(std::shared_ptr<Camera> camera);
+	void SetUseGammaCorrection(bool useGammaCorrection);
+	void SetIsStatic(bool isStatic);
+	void SetLightList(const unsigned int* indices, int count); //indices into the light buffer, count < 0 for clustered lighting
+	void GetWorldBounds(DirectX::XMFLOAT3& center, DirectX::XMFLOAT3& extents); //mesh bounding box moved into world space (still axis aligned)
+	void GetWorldBoundingSphere(DirectX::XMFLOAT3& center, float& radius);
+	void Draw(); //per-frame camera and light data must already be set on the shaders
 };
 
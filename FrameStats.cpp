@@ -0,0 +1,156 @@
+#include "FrameStats.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+// A frame counts as CPU-bound when its CPU work took at
+// least this much of the time between presents
+#define FRAME_STATS_CPU_BOUND_SHARE 0.9f
+
+FrameStats::FrameStats() :
+	frames(FRAME_STATS_HISTORY),
+	totalFrames(0),
+	totalHitches(0),
+	targetMilliseconds(1000.0f / 60.0f),
+	hitchFactor(1.5f)
+{
+}
+
+void FrameStats::Record(float cpuMilliseconds, float presentIntervalMilliseconds, float presentBlockedMilliseconds)
+{
+	FrameTiming& timing = frames[totalFrames % FRAME_STATS_HISTORY];
+	timing.frame = totalFrames;
+	timing.cpuMilliseconds = cpuMilliseconds;
+	timing.presentIntervalMilliseconds = presentIntervalMilliseconds;
+	timing.presentBlockedMilliseconds = presentBlockedMilliseconds;
+	timing.hitch = presentIntervalMilliseconds > targetMilliseconds * hitchFactor;
+	timing.cpuBound = cpuMilliseconds >= presentIntervalMilliseconds * FRAME_STATS_CPU_BOUND_SHARE;
+
+	totalFrames++;
+	if (timing.hitch)
+		totalHitches++;
+}
+
+void FrameStats::Reset()
+{
+	totalFrames = 0;
+	totalHitches = 0;
+}
+
+void FrameStats::SetTargetMilliseconds(float milliseconds)
+{
+	targetMilliseconds = milliseconds;
+}
+
+void FrameStats::SetHitchFactor(float factor)
+{
+	hitchFactor = factor;
+}
+
+unsigned int FrameStats::GetFrameCount() const
+{
+	return (unsigned int)std::min(totalFrames, (unsigned long long)FRAME_STATS_HISTORY);
+}
+
+const FrameTiming& FrameStats::GetFrame(unsigned int framesAgo) const
+{
+	return frames[(totalFrames - 1 - framesAgo) % FRAME_STATS_HISTORY];
+}
+
+// Nearest rank, on already sorted times
+static float Percentile(const std::vector<float>& sorted, float percent)
+{
+	size_t rank = (size_t)ceilf(percent / 100.0f * sorted.size());
+	return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static FrameTimeSummary Summarize(std::vector<float>& times)
+{
+	FrameTimeSummary summary;
+	if (times.empty())
+		return summary;
+
+	std::sort(times.begin(), times.end());
+	double total = 0.0;
+	for (float t : times)
+		total += t;
+
+	summary.min = times.front();
+	summary.average = (float)(total / times.size());
+	summary.p50 = Percentile(times, 50.0f);
+	summary.p95 = Percentile(times, 95.0f);
+	summary.p99 = Percentile(times, 99.0f);
+	summary.max = times.back();
+	return summary;
+}
+
+FrameStatsSummary FrameStats::GetSummary() const
+{
+	FrameStatsSummary summary;
+	summary.frames = GetFrameCount();
+
+	std::vector<float> cpu;
+	std::vector<float> present;
+	cpu.reserve(summary.frames);
+	present.reserve(summary.frames);
+	for (unsigned int i = 0; i < summary.frames; i++)
+	{
+		const FrameTiming& timing = GetFrame(i);
+		cpu.push_back(timing.cpuMilliseconds);
+		present.push_back(timing.presentIntervalMilliseconds);
+
+		// Against the current budget, so changing it recounts the window
+		if (timing.presentIntervalMilliseconds > targetMilliseconds * hitchFactor)
+			summary.hitches++;
+		if (timing.cpuBound)
+			summary.cpuBoundFrames++;
+		else
+			summary.gpuBoundFrames++;
+	}
+
+	summary.cpu = Summarize(cpu);
+	summary.presentInterval = Summarize(present);
+	return summary;
+}
+
+void FrameStats::GetHistogram(float* counts, unsigned int bucketCount, float maxMilliseconds) const
+{
+	for (unsigned int b = 0; b < bucketCount; b++)
+		counts[b] = 0.0f;
+
+	if (bucketCount == 0 || maxMilliseconds <= 0.0f)
+		return;
+
+	for (unsigned int i = 0; i < GetFrameCount(); i++)
+	{
+		float t = GetFrame(i).presentIntervalMilliseconds;
+		unsigned int bucket = t <= 0.0f ? 0 : (unsigned int)(t / maxMilliseconds * bucketCount);
+		counts[std::min(bucket, bucketCount - 1)] += 1.0f;
+	}
+}
+
+bool FrameStats::WriteCSV(const std::string& fileName) const
+{
+	std::ofstream file(fileName, std::ios::trunc);
+	if (!file)
+		return false;
+
+	file << "frame,cpu_ms,present_interval_ms,present_blocked_ms,hitch,bound\n";
+
+	char line[128];
+	for (unsigned int i = GetFrameCount(); i > 0; i--)
+	{
+		const FrameTiming& timing = GetFrame(i - 1);
+		snprintf(line, sizeof(line), "%llu,%.4f,%.4f,%.4f,%d,%s\n",
+			timing.frame,
+			timing.cpuMilliseconds,
+			timing.presentIntervalMilliseconds,
+			timing.presentBlockedMilliseconds,
+			timing.hitch ? 1 : 0,
+			timing.cpuBound ? "cpu" : "gpu");
+		file << line;
+	}
+
+	return (bool)file;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#define FRAME_STATS_HISTORY 1024	// Frames in the rolling window
+
+// One frame's times, in milliseconds
+struct FrameTiming
+{
+	unsigned long long frame;			// Counted from the first recorded frame
+	float cpuMilliseconds;				// Update + Draw, minus time blocked inside Present()
+	float presentIntervalMilliseconds;	// Since the previous Present() call (what the display sees)
+	float presentBlockedMilliseconds;	// Inside Present(), waiting on the GPU or vsync
+	bool hitch;		// Present interval over the budget by more than the hitch factor, as it was when recorded
+	bool cpuBound;	// The CPU work filled (nearly) the whole interval
+};
+
+struct FrameTimeSummary
+{
+	float min = 0.0f;
+	float average = 0.0f;
+	float p50 = 0.0f;
+	float p95 = 0.0f;
+	float p99 = 0.0f;
+	float max = 0.0f;
+};
+
+struct FrameStatsSummary
+{
+	unsigned int frames = 0;
+	FrameTimeSummary cpu;
+	FrameTimeSummary presentInterval;
+	unsigned int hitches = 0;
+	unsigned int cpuBoundFrames = 0;
+	unsigned int gpuBoundFrames = 0;	// Waiting on the GPU or vsync for part of the frame
+};
+
+// --------------------------------------------------------
+// Rolling record of the last FRAME_STATS_HISTORY frames.
+//
+// An FPS average over a second hides the one slow frame in
+// sixty, so this keeps every frame: percentiles and a
+// histogram show the spread, and frames over the budget are
+// flagged as hitches.
+//
+// CPU time and the time between presents are kept apart.
+// When the interval is much longer than the CPU time, the
+// rest was spent waiting in Present() (GPU-bound, or vsync).
+// --------------------------------------------------------
+class FrameStats
+{
+public:
+	FrameStats();
+
+	void Record(float cpuMilliseconds, float presentIntervalMilliseconds, float presentBlockedMilliseconds);
+	void Reset();
+
+	// The budget a frame should fit in, and how far over it counts as a hitch
+	float GetTargetMilliseconds() const { return targetMilliseconds; }
+	void SetTargetMilliseconds(float milliseconds);
+	float GetHitchFactor() const { return hitchFactor; }
+	void SetHitchFactor(float factor);
+
+	unsigned int GetFrameCount() const;	// In the window, up to FRAME_STATS_HISTORY
+	const FrameTiming& GetFrame(unsigned int framesAgo) const;	// 0 is the newest
+	unsigned long long GetTotalFrames() const { return totalFrames; }
+	unsigned long long GetTotalHitches() const { return totalHitches; }	// Since the last Reset(), not just the window
+
+	// Sorts a copy of the window, so only call it when it's shown
+	FrameStatsSummary GetSummary() const;
+
+	// Present intervals in the window binned over [0, maxMilliseconds),
+	// anything slower lands in the last bucket
+	void GetHistogram(float* counts, unsigned int bucketCount, float maxMilliseconds) const;
+
+	// Every frame in the window, oldest first
+	bool WriteCSV(const std::string& fileName) const;
+
+private:
+	std::vector<FrameTiming> frames;	// Ring, the newest at (totalFrames - 1) % FRAME_STATS_HISTORY
+	unsigned long long totalFrames;
+	unsigned long long totalHitches;
+	float targetMilliseconds;
+	float hitchFactor;
+};
@@ -0,0 +1,116 @@
+#include "Frustum.h"
+
+using namespace DirectX;
+
+Frustum::Frustum()
+{
+	// Until Update() is called nothing gets culled
+	for (int i = 0; i < 6; i++)
+		planes[i] = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+
+	for (int i = 0; i < 2; i++)
+	{
+		planeNormalX[i] = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+		planeNormalY[i] = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+		planeNormalZ[i] = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+		planeDistance[i] = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+	}
+}
+
+void Frustum::Update(XMFLOAT4X4 view, XMFLOAT4X4 projection)
+{
+	Update(XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection)));
+}
+
+void Frustum::Update(FXMMATRIX viewProjection)
+{
+	// With row vectors, clip = p * M, so each clip coordinate
+	// is p dotted with one *column* of the matrix
+	XMMATRIX columns = XMMatrixTranspose(viewProjection);
+	XMVECTOR x = columns.r[0];
+	XMVECTOR y = columns.r[1];
+	XMVECTOR z = columns.r[2];
+	XMVECTOR w = columns.r[3];
+
+	XMVECTOR extracted[6] =
+	{
+		XMVectorAdd(w, x),		// Left:   -w <= x
+		XMVectorSubtract(w, x),	// Right:   x <= w
+		XMVectorAdd(w, y),		// Bottom: -w <= y
+		XMVectorSubtract(w, y),	// Top:     y <= w
+		z,						// Near:    0 <= z
+		XMVectorSubtract(w, z)	// Far:     z <= w
+	};
+
+	for (int i = 0; i < 6; i++)
+		XMStoreFloat4(&planes[i], XMPlaneNormalize(extracted[i]));
+
+	// Transpose into SoA for the SIMD tests
+	static const int groups[2][4] = { { 0, 1, 2, 3 }, { 4, 5, 4, 5 } };
+	for (int g = 0; g < 2; g++)
+	{
+		const XMFLOAT4& a = planes[groups[g][0]];
+		const XMFLOAT4& b = planes[groups[g][1]];
+		const XMFLOAT4& c = planes[groups[g][2]];
+		const XMFLOAT4& d = planes[groups[g][3]];
+		planeNormalX[g] = XMFLOAT4(a.x, b.x, c.x, d.x);
+		planeNormalY[g] = XMFLOAT4(a.y, b.y, c.y, d.y);
+		planeNormalZ[g] = XMFLOAT4(a.z, b.z, c.z, d.z);
+		planeDistance[g] = XMFLOAT4(a.w, b.w, c.w, d.w);
+	}
+}
+
+bool Frustum::IntersectsAABB(const XMFLOAT3& center, const XMFLOAT3& extents) const
+{
+	XMVECTOR cx = XMVectorReplicate(center.x);
+	XMVECTOR cy = XMVectorReplicate(center.y);
+	XMVECTOR cz = XMVectorReplicate(center.z);
+	XMVECTOR ex = XMVectorReplicate(extents.x);
+	XMVECTOR ey = XMVectorReplicate(extents.y);
+	XMVECTOR ez = XMVectorReplicate(extents.z);
+	XMVECTOR zero = XMVectorZero();
+
+	for (int g = 0; g < 2; g++)
+	{
+		XMVECTOR nx = XMLoadFloat4(&planeNormalX[g]);
+		XMVECTOR ny = XMLoadFloat4(&planeNormalY[g]);
+		XMVECTOR nz = XMLoadFloat4(&planeNormalZ[g]);
+
+		// Signed distance of the center from each plane...
+		XMVECTOR distance = XMVectorMultiplyAdd(nz, cz, XMVectorMultiplyAdd(ny, cy, XMVectorMultiplyAdd(nx, cx, XMLoadFloat4(&planeDistance[g]))));
+
+		// ...and how far the box reaches towards each plane's normal
+		XMVECTOR radius = XMVectorMultiplyAdd(XMVectorAbs(nz), ez, XMVectorMultiplyAdd(XMVectorAbs(ny), ey, XMVectorMultiply(XMVectorAbs(nx), ex)));
+
+		// Completely behind any one plane = outside
+		if (XMComparisonAnyTrue(XMVector4GreaterR(zero, XMVectorAdd(distance, radius))))
+			return false;
+	}
+
+	return true;
+}
+
+bool Frustum::IntersectsSphere(const XMFLOAT3& center, float radius) const
+{
+	XMVECTOR cx = XMVectorReplicate(center.x);
+	XMVECTOR cy = XMVectorReplicate(center.y);
+	XMVECTOR cz = XMVectorReplicate(center.z);
+	XMVECTOR negativeRadius = XMVectorReplicate(-radius);
+
+	for (int g = 0; g < 2; g++)
+	{
+		XMVECTOR distance = XMVectorMultiplyAdd(XMLoadFloat4(&planeNormalZ[g]), cz,
+			XMVectorMultiplyAdd(XMLoadFloat4(&planeNormalY[g]), cy,
+			XMVectorMultiplyAdd(XMLoadFloat4(&planeNormalX[g]), cx, XMLoadFloat4(&planeDistance[g]))));
+
+		if (XMComparisonAnyTrue(XMVector4GreaterR(negativeRadius, distance)))
+			return false;
+	}
+
+	return true;
+}
+
+XMFLOAT4 Frustum::GetPlane(int index) const
+{
+	return planes[index];
+}
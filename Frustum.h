@@ -0,0 +1,38 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// Six planes pulled out of a view * projection matrix, used
+// to skip anything that can't end up on screen
+//
+// - Plane normals point inwards, so a point is inside when
+//   dot(normal, point) + d >= 0 for every plane
+// - Works for both perspective and orthographic projections
+// --------------------------------------------------------
+class Frustum
+{
+public:
+	Frustum();
+
+	// Extracts the planes (Gribb & Hartmann) from a row-major
+	// view * projection matrix using D3D's 0..1 clip depth
+	void Update(DirectX::XMFLOAT4X4 view, DirectX::XMFLOAT4X4 projection);
+	void Update(DirectX::FXMMATRIX viewProjection);
+
+	// Box is given as center/half size, as returned by Entity::GetWorldBounds()
+	bool IntersectsAABB(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents) const;
+	bool IntersectsSphere(const DirectX::XMFLOAT3& center, float radius) const;
+
+	DirectX::XMFLOAT4 GetPlane(int index) const; // 0-5: left, right, bottom, top, near, far
+
+private:
+	DirectX::XMFLOAT4 planes[6];
+
+	// The same planes transposed into two groups of four (the second
+	// group repeats near/far), so all six are tested with two SIMD passes
+	DirectX::XMFLOAT4 planeNormalX[2];
+	DirectX::XMFLOAT4 planeNormalY[2];
+	DirectX::XMFLOAT4 planeNormalZ[2];
+	DirectX::XMFLOAT4 planeDistance[2];
+};
@@ -3,6 +3,9 @@
 // Needed for a helper function to load pre-compiled shader files
 #pragma comment(lib, "d3dcompiler.lib")
 #include <d3dcompiler.h>
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
 
 // For the DirectX Math library
 using namespace DirectX;
@@ -31,9 +34,6 @@ Game::Game(HINSTANCE hInstance)
 	printf("Console window created successfully.  Feel free to printf() here.\n");
 #endif
 
-	shadowViewMatrix = XMFLOAT4X4();
-	shadowProjectionMatrix = XMFLOAT4X4();
-
 }
 
 // --------------------------------------------------------
@@ -108,6 +108,9 @@ void Game::Init()
 	ImGui_ImplWin32_Init(hWnd);
 	ImGui_ImplDX11_Init(device.Get(), context.Get());
 
+	shaderCache = std::make_shared<ShaderCache>(device, context);
+	assetStreamer = std::make_shared<AssetStreamer>(device, context);
+
 	// Helper methods for loading shaders, creating some basic
 	// geometry to draw and some simple camera matrices.
 	//  - You'll be expanding and/or replacing these later
@@ -135,85 +138,107 @@ void Game::LoadAssets()
 	samplerData.MaxAnisotropy = 16;
 	samplerData.MaxLOD = D3D11_FLOAT32_MAX;
 
-	// Quick pre-processor macro for simplifying texture loading calls below
-	#define LoadTexture(path, srv) CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(path).c_str(), 0, srv.GetAddressOf());
+	// The sky and meshes are read and decoded/parsed in parallel before the
+	// first frame, only the Direct3D objects are created here on the main
+	// thread (see AssetLoader.h).  Textures go with them, or with
+	// streamTextures stream in while the game runs, drawn with placeholders
+	// until they're ready (see AssetStreamer.h).
+	AssetLoader loader(device, context);
+	auto requestTexture = [&](const wchar_t* path, TexturePlaceholder placeholder)
+	{
+		return assetStreamer->RequestTexture(FixPath(path), placeholder, streamTextures ? 0 : &loader);
+	};
 
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState;
 	HRESULT a1 = device->CreateSamplerState(&samplerData, samplerState.GetAddressOf());
 
-	//create skybox
-	
-	std::shared_ptr<Mesh> skybBoxMesh = std::make_shared<Mesh>(device, context, FixPath("../../Assets/Models/cube.obj").c_str());
-	std::shared_ptr<SimpleVertexShader> skyBoxVertexShaders = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"SkyboxVertexShader.cso").c_str());
-	std::shared_ptr<SimplePixelShader> skyBoxPixelShaders = std::make_shared<SimplePixelShader>(device, context, FixPath(L"SkyboxPixelShader.cso").c_str());
-
-	skyBox = std::make_shared<Sky>(
-		FixPath(L"../../Assets/SkyBoxes/Clouds Pink/right.png").c_str(),
-		FixPath(L"../../Assets/SkyBoxes/Clouds Pink/left.png").c_str(),
-		FixPath(L"../../Assets/SkyBoxes/Clouds Pink/up.png").c_str(),
-		FixPath(L"../../Assets/SkyBoxes/Clouds Pink/down.png").c_str(),
-		FixPath(L"../../Assets/SkyBoxes/Clouds Pink/front.png").c_str(),
-		FixPath(L"../../Assets/SkyBoxes/Clouds Pink/back.png").c_str(),
-		skybBoxMesh,
-		skyBoxVertexShaders,
-		skyBoxPixelShaders,
-		samplerState,
-		device,
-		context);
+	//Load the sky faces
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> skyBoxSRV;
+	std::wstring skyBoxFaces[6] =
+	{
+		FixPath(L"../../Assets/SkyBoxes/Clouds Pink/right.png"),
+		FixPath(L"../../Assets/SkyBoxes/Clouds Pink/left.png"),
+		FixPath(L"../../Assets/SkyBoxes/Clouds Pink/up.png"),
+		FixPath(L"../../Assets/SkyBoxes/Clouds Pink/down.png"),
+		FixPath(L"../../Assets/SkyBoxes/Clouds Pink/front.png"),
+		FixPath(L"../../Assets/SkyBoxes/Clouds Pink/back.png")
+	};
+	loader.AddCubemap(skyBoxFaces, &skyBoxSRV);
 
 	//Load the meshes
-	meshes.push_back(std::make_shared<Mesh>(device, context, FixPath("../../Assets/Models/cube.obj").c_str()));
-	meshes.push_back(std::make_shared<Mesh>(device, context, FixPath("../../Assets/Models/cylinder.obj").c_str()));
-	meshes.push_back(std::make_shared<Mesh>(device, context, FixPath("../../Assets/Models/sphere.obj").c_str()));
+	meshes.resize(3);
+	loader.AddMesh(FixPath("../../Assets/Models/cube.obj"), &meshes[0]);
+	loader.AddMesh(FixPath("../../Assets/Models/cylinder.obj"), &meshes[1]);
+	loader.AddMesh(FixPath("../../Assets/Models/sphere.obj"), &meshes[2]);
 
-	//Load the textures
+	//Load or stream the textures
 
-	std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> srvAlbedoMapVector, srvNormalMapVector, srvRoughnessMapVector, srvMetalMapVector;
+	std::vector<std::shared_ptr<StreamedTexture>> albedoMapVector, normalMapVector, roughnessMapVector, metalMapVector;
 
-	//Shader Resource View
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeAlbedoSRV, cobblestoneAlbedoSRV, scratchedAlbedoSRV, woodAlbedoSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeNormalSRV, cobblestoneNormalSRV, scratchedNormalSRV, flatNormalSRV, woodNormalSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeRoughnessSRV, cobblestoneRoughnessSRV, scratchedRoughnessSRV, woodRoughnessSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeMetalSRV, cobblestoneMetalSRV, scratchedMetalSRV, woodMetalSRV;
+	std::shared_ptr<StreamedTexture> bronzeAlbedo, cobblestoneAlbedo, scratchedAlbedo, woodAlbedo;
+	std::shared_ptr<StreamedTexture> bronzeNormal, cobblestoneNormal, scratchedNormal, flatNormal, woodNormal;
+	std::shared_ptr<StreamedTexture> bronzeRoughness, cobblestoneRoughness, scratchedRoughness, woodRoughness;
+	std::shared_ptr<StreamedTexture> bronzeMetal, cobblestoneMetal, scratchedMetal, woodMetal;
 
 	//================================================================================
 
-	LoadTexture(L"../../Assets/Textures/Albedo Maps/bronze.png", bronzeAlbedoSRV);
-	LoadTexture(L"../../Assets/Textures/Albedo Maps/cobblestone.png", cobblestoneAlbedoSRV);
-	LoadTexture(L"../../Assets/Textures/Albedo Maps/scratched.png", scratchedAlbedoSRV);
-	LoadTexture(L"../../Assets/Textures/Albedo Maps/wood.png", woodAlbedoSRV);
+	bronzeAlbedo = requestTexture(L"../../Assets/Textures/Albedo Maps/bronze.png", PlaceholderGrey);
+	cobblestoneAlbedo = requestTexture(L"../../Assets/Textures/Albedo Maps/cobblestone.png", PlaceholderGrey);
+	scratchedAlbedo = requestTexture(L"../../Assets/Textures/Albedo Maps/scratched.png", PlaceholderGrey);
+	woodAlbedo = requestTexture(L"../../Assets/Textures/Albedo Maps/wood.png", PlaceholderGrey);
+
+	bronzeNormal = requestTexture(L"../../Assets/Textures/Normal Maps/bronze.png", PlaceholderFlatNormal);
+	cobblestoneNormal = requestTexture(L"../../Assets/Textures/Normal Maps/cobblestone.png", PlaceholderFlatNormal);
+	scratchedNormal = requestTexture(L"../../Assets/Textures/Normal Maps/scratched.png", PlaceholderFlatNormal);
+	flatNormal = requestTexture(L"../../Assets/Textures/Normal Maps/flat.png", PlaceholderFlatNormal);
+	woodNormal = requestTexture(L"../../Assets/Textures/Normal Maps/wood.png", PlaceholderFlatNormal);
+
+	bronzeRoughness = requestTexture(L"../../Assets/Textures/Roughness Maps/bronze.png", PlaceholderGrey);
+	cobblestoneRoughness = requestTexture(L"../../Assets/Textures/Roughness Maps/cobblestone.png", PlaceholderGrey);
+	scratchedRoughness = requestTexture(L"../../Assets/Textures/Roughness Maps/scratched.png", PlaceholderGrey);
+	woodRoughness = requestTexture(L"../../Assets/Textures/Roughness Maps/wood.png", PlaceholderGrey);
+
+	bronzeMetal = requestTexture(L"../../Assets/Textures/Metal Maps/bronze.png", PlaceholderBlack);
+	cobblestoneMetal = requestTexture(L"../../Assets/Textures/Metal Maps/cobblestone.png", PlaceholderBlack);
+	scratchedMetal = requestTexture(L"../../Assets/Textures/Metal Maps/scratched.png", PlaceholderBlack);
+	woodMetal = requestTexture(L"../../Assets/Textures/Metal Maps/wood.png", PlaceholderBlack);
 
-	LoadTexture(L"../../Assets/Textures/Normal Maps/bronze.png", bronzeNormalSRV);
-	LoadTexture(L"../../Assets/Textures/Normal Maps/cobblestone.png", cobblestoneNormalSRV);
-	LoadTexture(L"../../Assets/Textures/Normal Maps/scratched.png", scratchedNormalSRV);
-	LoadTexture(L"../../Assets/Textures/Normal Maps/flat.png", flatNormalSRV);
-	LoadTexture(L"../../Assets/Textures/Normal Maps/wood.png", woodNormalSRV);
+	loader.Load();
+	assetStreamer->CommitLoaded();
+	assetLoadReport = loader.GetReport();
+	loader.PrintReport();
 
-	LoadTexture(L"../../Assets/Textures/Roughness Maps/bronze.png", bronzeRoughnessSRV);
-	LoadTexture(L"../../Assets/Textures/Roughness Maps/cobblestone.png", cobblestoneRoughnessSRV);
-	LoadTexture(L"../../Assets/Textures/Roughness Maps/scratched.png", scratchedRoughnessSRV);
-	LoadTexture(L"../../Assets/Textures/Roughness Maps/wood.png", woodRoughnessSRV);
+	//streamed meshes stand in as cubes until they've loaded
+	assetStreamer->SetPlaceholderMesh(meshes[0]);
 
-	LoadTexture(L"../../Assets/Textures/Metal Maps/bronze.png", bronzeMetalSRV);
-	LoadTexture(L"../../Assets/Textures/Metal Maps/cobblestone.png", cobblestoneMetalSRV);
-	LoadTexture(L"../../Assets/Textures/Metal Maps/scratched.png", scratchedMetalSRV);
-	LoadTexture(L"../../Assets/Textures/Metal Maps/wood.png", woodMetalSRV);
+	//create skybox (sharing the cube mesh)
+	std::shared_ptr<SimpleVertexShader> skyBoxVertexShaders = shaderCache->GetVertexShader(FixPath(L"SkyboxVertexShader.cso"));
+	std::shared_ptr<SimplePixelShader> skyBoxPixelShaders = shaderCache->GetPixelShader(FixPath(L"SkyboxPixelShader.cso"));
+
+	skyBox = std::make_shared<Sky>(
+		skyBoxSRV,
+		meshes[0],
+		skyBoxVertexShaders,
+		skyBoxPixelShaders,
+		samplerState,
+		device,
+		context);
 
-	srvAlbedoMapVector.push_back(bronzeAlbedoSRV);
-	srvAlbedoMapVector.push_back(cobblestoneAlbedoSRV);
-	srvAlbedoMapVector.push_back(scratchedAlbedoSRV);
+	albedoMapVector.push_back(bronzeAlbedo);
+	albedoMapVector.push_back(cobblestoneAlbedo);
+	albedoMapVector.push_back(scratchedAlbedo);
 
-	srvNormalMapVector.push_back(bronzeNormalSRV);
-	srvNormalMapVector.push_back(cobblestoneNormalSRV);
-	srvNormalMapVector.push_back(scratchedNormalSRV);
+	normalMapVector.push_back(bronzeNormal);
+	normalMapVector.push_back(cobblestoneNormal);
+	normalMapVector.push_back(scratchedNormal);
 
-	srvRoughnessMapVector.push_back(bronzeRoughnessSRV);
-	srvRoughnessMapVector.push_back(cobblestoneRoughnessSRV);
-	srvRoughnessMapVector.push_back(scratchedRoughnessSRV);
+	roughnessMapVector.push_back(bronzeRoughness);
+	roughnessMapVector.push_back(cobblestoneRoughness);
+	roughnessMapVector.push_back(scratchedRoughness);
 
-	srvMetalMapVector.push_back(bronzeMetalSRV);
-	srvMetalMapVector.push_back(cobblestoneMetalSRV);
-	srvMetalMapVector.push_back(scratchedMetalSRV);
+	metalMapVector.push_back(bronzeMetal);
+	metalMapVector.push_back(cobblestoneMetal);
+	metalMapVector.push_back(scratchedMetal);
 
 	//Create Materials
 	CreateMaterials();
@@ -224,26 +249,25 @@ void Game::LoadAssets()
 		std::shared_ptr<Material> mat = materials[i];
 
 		mat->AddSampler("BasicSampler", samplerState);
-		mat->AddTextureSRV("AlbedoMap", srvAlbedoMapVector[i % srvAlbedoMapVector.size()]);
-		mat->AddTextureSRV("MetalnessMap", srvMetalMapVector[i % srvMetalMapVector.size()]);
-		mat->AddTextureSRV("RoughnessMap", srvRoughnessMapVector[i % srvRoughnessMapVector.size()]);
+		assetStreamer->BindTexture(albedoMapVector[i % albedoMapVector.size()], mat, "AlbedoMap");
+		assetStreamer->BindTexture(metalMapVector[i % metalMapVector.size()], mat, "MetalnessMap");
+		assetStreamer->BindTexture(roughnessMapVector[i % roughnessMapVector.size()], mat, "RoughnessMap");
 
 
 		//top row uses flat normals
 		if (i < 3)
-			mat->AddTextureSRV("NormalMap", flatNormalSRV);
+			assetStreamer->BindTexture(flatNormal, mat, "NormalMap");
 
 		//every other row uses their normals
 		else
-			mat->AddTextureSRV("NormalMap", srvNormalMapVector[i % srvNormalMapVector.size()]);
+			assetStreamer->BindTexture(normalMapVector[i % normalMapVector.size()], mat, "NormalMap");
 	}
 
 	floorMaterial->AddSampler("BasicSampler", samplerState);
-	floorMaterial->AddTextureSRV("AlbedoMap", woodAlbedoSRV);
-	floorMaterial->AddTextureSRV("NormalMap", woodNormalSRV);
-	floorMaterial->AddTextureSRV("MetalnessMap", woodMetalSRV);
-	floorMaterial->AddTextureSRV("RoughnessMap", woodRoughnessSRV);
-
+	assetStreamer->BindTexture(woodAlbedo, floorMaterial, "AlbedoMap");
+	assetStreamer->BindTexture(woodNormal, floorMaterial, "NormalMap");
+	assetStreamer->BindTexture(woodMetal, floorMaterial, "MetalnessMap");
+	assetStreamer->BindTexture(woodRoughness, floorMaterial, "RoughnessMap");
 
 	CreateEntites();
 
@@ -264,11 +288,11 @@ void Game::CreateLights()
 
 void Game::CreateShadowMapResources()
 {
-	// Create the actual texture that will be the shadow map
+	// Create the actual texture that will be the shadow map (one slice per cascade)
 	D3D11_TEXTURE2D_DESC shadowDesc = {};
 	shadowDesc.Width = shadowMapResolution; 
 	shadowDesc.Height = shadowMapResolution;
-	shadowDesc.ArraySize = 1;
+	shadowDesc.ArraySize = MAX_SHADOW_CASCADES;
 	shadowDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
 	shadowDesc.CPUAccessFlags = 0;
 	shadowDesc.Format = DXGI_FORMAT_R32_TYPELESS; //reserve all 32 bits for a single value
@@ -277,54 +301,60 @@ void Game::CreateShadowMapResources()
 	shadowDesc.SampleDesc.Count = 1;
 	shadowDesc.SampleDesc.Quality = 0;
 	shadowDesc.Usage = D3D11_USAGE_DEFAULT;
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowTexture; //not needed after this method
 	device->CreateTexture2D(&shadowDesc, 0, shadowTexture.GetAddressOf());
 
-	//views to bind texture resources in the pipeline (shadowDSV and shadowSRV)
-	//ViewDimension describes the dimensionality of the resource. In this case its just a 2D texture.
-    //MipSlice tells the depth view which mip map to render into. We only have 1, so its index 0.
+	//views to bind texture resources in the pipeline (shadowDSVs and shadowSRV)
+	//ViewDimension describes the dimensionality of the resource. In this case it's an array of 2D textures.
+	//Each depth view renders into one slice (one cascade), the SRV reads all of them.
+    //MipSlice tells the depth view which mip map to render into. We only have 1, so it's index 0.
 	//MipLevels and MostDetailedMip tell the SRV which mips it can read. Again, we only have 1.
-	//Format is slightly different for each view (D32_FLOAT vs. R32_FLOAT). These both mean treat all 32 bits as a single value, but D32_FLOAT is specific to depth views.
-
-	// Create the depth/stencil view
-	D3D11_DEPTH_STENCIL_VIEW_DESC shadowDSDesc = {};
-	shadowDSDesc.Format = DXGI_FORMAT_D32_FLOAT;
-	shadowDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
-	shadowDSDesc.Texture2D.MipSlice = 0;
-	device->CreateDepthStencilView( shadowTexture.Get(), &shadowDSDesc, shadowDSV.GetAddressOf());
+	//Format is slightly different for each view (D32_FLOAT vs. R32_FLOAT). These both mean "treat all 32 bits as a single value", but D32_FLOAT is specific to depth views.
+
+	// Create the depth/stencil views
+	for (unsigned int i = 0; i < MAX_SHADOW_CASCADES; i++)
+	{
+		D3D11_DEPTH_STENCIL_VIEW_DESC shadowDSDesc = {};
+		shadowDSDesc.Format = DXGI_FORMAT_D32_FLOAT;
+		shadowDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+		shadowDSDesc.Texture2DArray.MipSlice = 0;
+		shadowDSDesc.Texture2DArray.FirstArraySlice = i;
+		shadowDSDesc.Texture2DArray.ArraySize = 1;
+		device->CreateDepthStencilView(shadowTexture.Get(), &shadowDSDesc, shadowDSVs[i].GetAddressOf());
+	}
 	
 	// Create the SRV for the shadow map
 	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MipLevels = 1;
-	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+	srvDesc.Texture2DArray.MipLevels = 1;
+	srvDesc.Texture2DArray.MostDetailedMip = 0;
+	srvDesc.Texture2DArray.FirstArraySlice = 0;
+	srvDesc.Texture2DArray.ArraySize = MAX_SHADOW_CASCADES;
 	device->CreateShaderResourceView(shadowTexture.Get(), &srvDesc, shadowSRV.GetAddressOf());
 
-	//To render from the lights point of view, well need view and projection matrices that match the light
-
-	//View matrix creation requires three things: a position, a direction and an up vector.
-	//up vector is world's up
-	//direction should match whichever directional light is casting shadows in your scene
-	//Position is the trickiest as directional lights dont inherently have a position. As discussed above, picking a 
-	//point close to the center of your game world(perhaps the origin) and backing up along the negative light direction 
-	//works well for a simple scene
-
-	XMMATRIX lightView = XMMatrixLookToLH(
-		XMVectorSet(0, 20, 0, 0), // Position: "Backing up" 20 units from origin
-		XMVectorSet(lights[0].Direction.x, lights[0].Direction.y, lights[0].Direction.z, 0), // Direction: light's direction
-		XMVectorSet(1, 0, 0, 0));
-
+	// Same again for the static casters, copied into shadowTexture at the start of each frame
+	device->CreateTexture2D(&shadowDesc, 0, staticShadowTexture.GetAddressOf());
+	for (unsigned int i = 0; i < MAX_SHADOW_CASCADES; i++)
+	{
+		D3D11_DEPTH_STENCIL_VIEW_DESC shadowDSDesc = {};
+		shadowDSDesc.Format = DXGI_FORMAT_D32_FLOAT;
+		shadowDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+		shadowDSDesc.Texture2DArray.MipSlice = 0;
+		shadowDSDesc.Texture2DArray.FirstArraySlice = i;
+		shadowDSDesc.Texture2DArray.ArraySize = 1;
+		device->CreateDepthStencilView(staticShadowTexture.Get(), &shadowDSDesc, staticShadowDSVs[i].GetAddressOf());
+	}
 
-	float lightProjectionSize = 25.0f; // how much of the world is included within the shadow map
-	XMMATRIX lightProjection = XMMatrixOrthographicLH(
-		lightProjectionSize,
-		lightProjectionSize,
-		1.0f,
-		100.0f);
+	// ImGui can only show a plain 2D texture, so one cascade at a time is copied here
+	shadowDesc.ArraySize = 1;
+	shadowDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	device->CreateTexture2D(&shadowDesc, 0, shadowPreviewTexture.GetAddressOf());
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MipLevels = 1;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	device->CreateShaderResourceView(shadowPreviewTexture.Get(), &srvDesc, shadowPreviewSRV.GetAddressOf());
 
-	XMStoreFloat4x4(&shadowViewMatrix, lightView);
-	XMStoreFloat4x4(&shadowProjectionMatrix, lightProjection);
+	// The light's view and projection matrices are fitted to the camera every frame (see UpdateShadowCascades())
 
 	//fix shadow achne
 	D3D11_RASTERIZER_DESC shadowRastDesc = {};
@@ -347,19 +377,35 @@ void Game::CreateShadowMapResources()
 	device->CreateSamplerState(&shadowSampDesc, &shadowSampler);
 }
 
-void Game::RenderShadowMap()
+// Fits each cascade to its slice of the active camera's frustum.  Both the
+// camera and the light (through ImGui) can move, so this runs every frame.
+void Game::UpdateShadowCascades()
 {
-	context->RSSetState(shadowRasterizer.Get());
+	std::shared_ptr<Camera> camera = cameras[activeCameraIndex];
+	shadowCascadeSettings.resolution = shadowMapResolution;
+	ComputeShadowCascades(camera->GetViewMatrix(), camera->GetProjectionMatrix(),
+		camera->GetNearClipPlaneDistance(), camera->GetFarClipPlaneDistance(),
+		lights[0].Direction, shadowCascadeSettings, shadowCascades);
+
+	// Casters are culled against the same box each cascade covers
+	for (unsigned int i = 0; i < shadowCascadeSettings.cascadeCount; i++)
+	{
+		XMMATRIX viewProjection = XMMatrixMultiply(XMLoadFloat4x4(&shadowCascades[i].view), XMLoadFloat4x4(&shadowCascades[i].projection));
+		XMStoreFloat4x4(&shadowViewProjections[i], viewProjection);
+		shadowFrustums[i].Update(viewProjection);
+	}
+}
 
-	//clear the shadow map
-	context->ClearDepthStencilView(shadowDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+void Game::RenderShadowMap()
+{
+	PROFILE_SCOPE("RenderShadowMap");
 
-	//Set up the output merger stage
-	ID3D11RenderTargetView* nullRTV{};
-	context->OMSetRenderTargets(1, &nullRTV, shadowDSV.Get());
+	if (RenderStateCache::GetInstance().UpdateRasterizerState(shadowRasterizer.Get()))
+		context->RSSetState(shadowRasterizer.Get());
 
 	//Deactivate pixel shader
-	context->PSSetShader(0, 0, 0);
+	if (RenderStateCache::GetInstance().UpdateShader(RenderStagePixel, 0))
+		context->PSSetShader(0, 0, 0);
 
 	//Change viewport
 	D3D11_VIEWPORT viewport = {};
@@ -369,18 +415,70 @@ void Game::RenderShadowMap()
 	context->RSSetViewports(1, &viewport);
 
 	//Entity render loop
-	std::shared_ptr<SimpleVertexShader> shadowVS = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"ShadowVertexShader.cso").c_str());
-	shadowVS->SetShader();
-	shadowVS->SetMatrix4x4("view", shadowViewMatrix);
-	shadowVS->SetMatrix4x4("projection", shadowProjectionMatrix);
-	// Loop and draw all entities
-	for (auto& e : entities)
+	shadowVertexShader->SetShader();
+	shadowCastersDrawn = 0;
+	shadowCastersSkipped = 0;
+
+	bool staticCastersChanged = StaticShadowCastersChanged();
+	for (unsigned int c = 0; c < shadowCascadeSettings.cascadeCount; c++)
 	{
-		shadowVS->SetMatrix4x4("world", e->GetTransform()->GetWorldMatrix());
-		shadowVS->CopyAllBufferData();
-		// Draw the mesh directly to avoid the entity's material
-		// Note: Your code may differ significantly here!
-		e->GetMesh()->Draw();
+		ID3D11RenderTargetView* nullRTV{};
+		shadowVertexShader->SetMatrix4x4(shadowViewHandle, shadowCascades[c].view);
+		shadowVertexShader->SetMatrix4x4(shadowProjectionHandle, shadowCascades[c].projection);
+
+		if (shadowCaching)
+		{
+			bool cacheValid = staticShadowCacheFilled[c] && !staticCastersChanged &&
+				memcmp(&staticShadowCascades[c].view, &shadowCascades[c].view, sizeof(DirectX::XMFLOAT4X4)) == 0 &&
+				memcmp(&staticShadowCascades[c].projection, &shadowCascades[c].projection, sizeof(DirectX::XMFLOAT4X4)) == 0;
+
+			if (cacheValid)
+			{
+				staticShadowCacheFrames[c]++;
+			}
+			else
+			{
+				// Every static caster in the light's box, as the camera can
+				// turn towards any of them while the cache is still valid
+				context->ClearDepthStencilView(staticShadowDSVs[c].Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+				context->OMSetRenderTargets(1, &nullRTV, staticShadowDSVs[c].Get());
+				for (auto& e : entities)
+				{
+					DirectX::XMFLOAT3 center;
+					DirectX::XMFLOAT3 extents;
+					e->GetWorldBounds(center, extents);
+					if (e->GetIsStatic() && shadowFrustums[c].IntersectsAABB(center, extents))
+						DrawShadowCaster(e);
+				}
+
+				staticShadowCascades[c] = shadowCascades[c];
+				staticShadowCacheFilled[c] = true;
+				staticShadowCacheFrames[c] = 0;
+				staticShadowCacheRebuilds++;
+			}
+
+			// Start from the static casters (the copy needs the slice unbound)
+			context->OMSetRenderTargets(1, &nullRTV, 0);
+			context->CopySubresourceRegion(shadowTexture.Get(), D3D11CalcSubresource(0, c, 1), 0, 0, 0,
+				staticShadowTexture.Get(), D3D11CalcSubresource(0, c, 1), 0);
+		}
+		else
+		{
+			context->ClearDepthStencilView(shadowDSVs[c].Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+		}
+
+		//render into this cascade's slice
+		context->OMSetRenderTargets(1, &nullRTV, shadowDSVs[c].Get());
+
+		// Loop and draw all entities that can put a shadow on screen through this cascade
+		for (auto& e : entities)
+		{
+			if (shadowCaching && e->GetIsStatic())
+				continue;
+
+			if (CastsVisibleShadow(e, c))
+				DrawShadowCaster(e);
+		}
 	}
 
 	//Reset the pipeline
@@ -388,9 +486,321 @@ void Game::RenderShadowMap()
 	viewport.Width = (float)this->windowWidth;
 	viewport.Height = (float)this->windowHeight;
 	context->RSSetViewports(1, &viewport);
-	context->RSSetState(0);
+	if (RenderStateCache::GetInstance().UpdateRasterizerState(0))
+		context->RSSetState(0);
+
+	// Copy of one slice for ImGui (a whole subresource, as depth resources need)
+	unsigned int previewCascade = (unsigned int)shadowPreviewCascade < shadowCascadeSettings.cascadeCount ? shadowPreviewCascade : 0;
+	context->CopySubresourceRegion(shadowPreviewTexture.Get(), 0, 0, 0, 0,
+		shadowTexture.Get(), D3D11CalcSubresource(0, previewCascade, 1), 0);
+}
+
+
+bool Game::IsInCameraFrustum(std::shared_ptr<Entity> entity)
+{
+	if (!frustumCulling)
+		return true;
+
+	DirectX::XMFLOAT3 center;
+	DirectX::XMFLOAT3 extents;
+	entity->GetWorldBounds(center, extents);
+	return cameraFrustum.IntersectsAABB(center, extents);
+}
+
+// Everything entities can be drawn with, in the order they were created
+// - Streamed models are only known once they're resident, anything
+//   missing here is given an ID after the packet jobs instead
+void Game::RegisterRenderResources()
+{
+	for (auto& ps : pixelShaders)
+		renderQueue.GetResourceId(ps.get());
+	for (auto& material : materials)
+		renderQueue.GetResourceId(material.get());
+	renderQueue.GetResourceId(floorMaterial.get());
+	for (auto& mesh : meshes)
+		renderQueue.GetResourceId(mesh.get());
+	for (auto& model : streamedModels)
+	{
+		if (model->GetMesh())
+			renderQueue.GetResourceId(model->GetMesh().get());
+	}
 }
 
+// One range of entities per thread, unless that makes the jobs too small to pay off
+unsigned int Game::GetEntityGrainSize(unsigned int count)
+{
+	unsigned int threadCount = JobSystem::GetInstance().GetThreadCount();
+	return (std::max)(minEntitiesPerJob, (count + threadCount - 1) / threadCount);
+}
+
+// Every material shares the same few shaders, so the data that's the same for
+// every entity is set once on each shader and uploaded here.  Anything that
+// didn't change since last frame isn't uploaded at all.
+void Game::SetPerFrameShaderData()
+{
+	std::shared_ptr<Camera> camera = cameras[activeCameraIndex];
+
+	for (auto& vs : vertexShaders)
+	{
+		vs->SetMatrix4x4("viewMatrix", camera->GetViewMatrix());
+		vs->SetMatrix4x4("projectionMatrix", camera->GetProjectionMatrix());
+		vs->CopyBufferData("PerFrame");
+	}
+
+	for (auto& ps : pixelShaders)
+	{
+		ps->SetFloat3("cameraPosition", camera->GetTransform()->GetPosition());
+		ps->SetFloat3("ambient", DirectX::XMFLOAT3(0.59f, 0.42f, 0.52f));
+		ps->SetFloat3("cameraForward", camera->GetTransform()->GetForward());
+		ps->SetInt("directionalLightNum", (int)lightClusters.GetDirectionalLightCount());
+		ps->SetFloat("clusterSliceScale", lightClusters.GetSliceScale());
+		ps->SetFloat("clusterSliceBias", lightClusters.GetSliceBias());
+		ps->SetFloat2("clusterTileScale", DirectX::XMFLOAT2(
+			(float)LIGHT_CLUSTERS_X / this->windowWidth,
+			(float)LIGHT_CLUSTERS_Y / this->windowHeight));
+
+		// Cascades past the count never match, as their end is as far as it gets
+		float cascadeEnds[MAX_SHADOW_CASCADES];
+		for (unsigned int c = 0; c < MAX_SHADOW_CASCADES; c++)
+			cascadeEnds[c] = c < shadowCascadeSettings.cascadeCount ? shadowCascades[c].splitFar : FLT_MAX;
+		ps->SetInt("shadowCascadeNum", (int)shadowCascadeSettings.cascadeCount);
+		ps->SetFloat4("shadowCascadeEnds", cascadeEnds);
+		ps->SetData("shadowMatrices", shadowViewProjections, sizeof(DirectX::XMFLOAT4X4) * shadowCascadeSettings.cascadeCount);
+		ps->CopyBufferData("PerFrame");
+
+		// Same shadow map and light lists for everything, and nothing else uses these slots
+		ps->SetShaderResourceView("ShadowMap", shadowSRV);
+		ps->SetSamplerState("ShadowSampler", shadowSampler);
+		ps->SetShaderResourceView("Lights", lightSRV);
+		ps->SetShaderResourceView("LightClusters", lightClusterSRV);
+		ps->SetShaderResourceView("LightIndices", lightIndexSRV);
+	}
+}
+
+// Rebuilds the cluster lists for this frame's camera and
+// copies them into the shaders' structured buffers
+void Game::UpdateLightClusters()
+{
+	PROFILE_SCOPE("UpdateLightClusters");
+
+	std::shared_ptr<Camera> camera = cameras[activeCameraIndex];
+	lightClusters.Build(lights, camera->GetViewMatrix(), camera->GetProjectionMatrix(),
+		camera->GetNearClipPlaneDistance(), camera->GetFarClipPlaneDistance());
+
+	const std::vector<Light>& clusteredLights = lightClusters.GetLights();
+	const std::vector<LightCluster>& clusters = lightClusters.GetClusters();
+	const std::vector<unsigned int>& indices = lightClusters.GetLightIndices();
+	UploadStructuredBuffer(lightBuffer, lightSRV, lightBufferCapacity,
+		clusteredLights.data(), (unsigned int)clusteredLights.size(), sizeof(Light));
+	UploadStructuredBuffer(lightClusterBuffer, lightClusterSRV, lightClusterBufferCapacity,
+		clusters.data(), (unsigned int)clusters.size(), sizeof(LightCluster));
+	UploadStructuredBuffer(lightIndexBuffer, lightIndexSRV, lightIndexBufferCapacity,
+		indices.data(), (unsigned int)indices.size(), sizeof(unsigned int));
+
+	// Selections index the same light buffer
+	if (perObjectLights)
+		lightSelector.Build(clusteredLights, lightClusters.GetDirectionalLightCount());
+}
+
+// Same growth as the instance buffer, but read through an SRV.  The buffer
+// (and its view) is only recreated when the data outgrows it.
+void Game::UploadStructuredBuffer(Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv,
+	unsigned int& capacity, const void* data, unsigned int count, unsigned int stride)
+{
+	if (count > capacity || !buffer)
+	{
+		capacity = capacity == 0 ? 64 : capacity;
+		while (capacity < count)
+			capacity *= 2;
+
+		D3D11_BUFFER_DESC desc = {};
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.ByteWidth = stride * capacity;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		desc.StructureByteStride = stride;
+		buffer.Reset();
+		srv.Reset();
+		device->CreateBuffer(&desc, 0, buffer.GetAddressOf());
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements = capacity;
+		device->CreateShaderResourceView(buffer.Get(), &srvDesc, srv.GetAddressOf());
+	}
+
+	if (count == 0)
+		return;
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
+	memcpy(mapped.pData, data, stride * count);
+	context->Unmap(buffer.Get(), 0);
+}
+
+// Stress test for the clustering, scattered over the floor
+void Game::AddRandomPointLights(unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Light light = {};
+		light.Type = LIGHT_TYPE_POINT;
+		light.Position = DirectX::XMFLOAT3(
+			(rand() / (float)RAND_MAX) * 40.0f - 20.0f,
+			(rand() / (float)RAND_MAX) * 4.0f,
+			(rand() / (float)RAND_MAX) * 40.0f - 20.0f);
+		light.Color = DirectX::XMFLOAT3(rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX);
+		light.Range = 1.0f + (rand() / (float)RAND_MAX) * 3.0f;
+		light.Intensity = 0.5f;
+		lights.push_back(light);
+	}
+}
+
+// Packs the batched entities' matrices and tints into one dynamic vertex
+// buffer (grown when needed).  Each batch then reads its own range of it.
+void Game::UploadInstanceData()
+{
+	instanceBatcher.Build();
+	const std::vector<InstanceData>& instances = instanceBatcher.GetInstanceData();
+	if (instances.empty())
+		return;
+
+	if (instances.size() > instanceBufferCapacity)
+	{
+		instanceBufferCapacity = instanceBufferCapacity == 0 ? 64 : instanceBufferCapacity;
+		while (instanceBufferCapacity < instances.size())
+			instanceBufferCapacity *= 2;
+
+		D3D11_BUFFER_DESC desc = {};
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.ByteWidth = sizeof(InstanceData) * instanceBufferCapacity;
+		desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		instanceBuffer.Reset();
+		device->CreateBuffer(&desc, 0, instanceBuffer.GetAddressOf());
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(instanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
+	memcpy(mapped.pData, &instances[0], sizeof(InstanceData) * instances.size());
+	context->Unmap(instanceBuffer.Get(), 0);
+
+	UINT stride = sizeof(InstanceData);
+	UINT offset = 0;
+	if (RenderStateCache::GetInstance().UpdateVertexBuffer(1, instanceBuffer.Get(), stride, offset))
+		context->IASetVertexBuffers(1, 1, instanceBuffer.GetAddressOf(), &stride, &offset);
+}
+
+// One DrawIndexedInstanced() for the whole batch
+void Game::DrawInstanceBatch(const InstanceBatch& batch)
+{
+	std::shared_ptr<SimplePixelShader> ps = batch.material->GetPixelShader();
+	batch.material->SetMaterialData();
+	batch.material->SetGammaCorrection(batch.useGammaCorrection);
+	batch.material->SetObjectLights(0, -1);
+	instancedVertexShader->CopyAllBufferData();
+	ps->CopyAllBufferData();
+
+	instancedVertexShader->SetShader();
+	ps->SetShader();
+
+	batch.mesh->DrawInstanced(batch.instanceCount, batch.firstInstance);
+	entityDrawCalls++;
+}
+
+float Game::GetSortDepth(DirectX::XMFLOAT3 position)
+{
+	std::shared_ptr<Camera> camera = cameras[activeCameraIndex];
+	XMFLOAT3 cameraPosition = camera->GetTransform()->GetPosition();
+	float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&position), XMLoadFloat3(&cameraPosition))));
+	return distance / camera->GetFarClipPlaneDistance();
+}
+
+void Game::DrawShadowCaster(std::shared_ptr<Entity> entity)
+{
+	shadowVertexShader->SetMatrix4x4(shadowWorldHandle, entity->GetTransform()->GetWorldMatrix());
+	shadowVertexShader->CopyAllBufferData();
+	// Draw the mesh directly to avoid the entity's material
+	// Note: Your code may differ significantly here!
+	entity->GetMesh()->Draw();
+}
+
+// Compares the light and every static caster's matrix with the last frame's,
+// which catches anything that moved them (including ImGui edits)
+bool Game::StaticShadowCastersChanged()
+{
+	staticShadowCasterScratch.clear();
+	for (auto& e : entities)
+	{
+		if (e->GetIsStatic())
+			staticShadowCasterScratch.push_back({ e.get(), e->GetTransform()->GetWorldMatrix() });
+	}
+
+	bool changed =
+		memcmp(&staticShadowLightDirection, &lights[0].Direction, sizeof(DirectX::XMFLOAT3)) != 0 ||
+		staticShadowCasterScratch.size() != staticShadowCasters.size() ||
+		(!staticShadowCasters.empty() && memcmp(staticShadowCasterScratch.data(), staticShadowCasters.data(),
+			sizeof(StaticShadowCaster) * staticShadowCasters.size()) != 0);
+
+	staticShadowCasters.swap(staticShadowCasterScratch);
+	staticShadowLightDirection = lights[0].Direction;
+	return changed;
+}
+
+// A caster is skipped when it's outside the light's box (it isn't in the
+// shadow map at all), or when the volume its shadow can sweep through
+// (its bounds stretched along the light direction) misses the camera
+bool Game::CastsVisibleShadow(std::shared_ptr<Entity> entity, unsigned int cascade)
+{
+	if (!frustumCulling)
+	{
+		shadowCastersDrawn++;
+		return true;
+	}
+
+	DirectX::XMFLOAT3 center;
+	DirectX::XMFLOAT3 extents;
+	entity->GetWorldBounds(center, extents);
+
+	bool visible = shadowFrustums[cascade].IntersectsAABB(center, extents);
+	if (visible)
+	{
+		// The shadow can reach the far side of the cascade's box
+		const ShadowCascade& c = shadowCascades[cascade];
+		float reach = c.sphereRadius * 2.0f + shadowCascadeSettings.casterDistance;
+		XMVECTOR direction = XMVector3Normalize(XMLoadFloat3(&lights[0].Direction));
+		XMVECTOR halfSweep = XMVectorScale(direction, reach * 0.5f);
+
+		DirectX::XMFLOAT3 sweptCenter;
+		DirectX::XMFLOAT3 sweptExtents;
+		XMStoreFloat3(&sweptCenter, XMVectorAdd(XMLoadFloat3(&center), halfSweep));
+		XMStoreFloat3(&sweptExtents, XMVectorAdd(XMLoadFloat3(&extents), XMVectorAbs(halfSweep)));
+
+		// Has to land somewhere this cascade is used: inside its sphere, and on screen
+		XMVECTOR sweptCenterV = XMLoadFloat3(&sweptCenter);
+		XMVECTOR sweptExtentsV = XMLoadFloat3(&sweptExtents);
+		XMVECTOR closest = XMVectorClamp(XMLoadFloat3(&c.sphereCenter),
+			XMVectorSubtract(sweptCenterV, sweptExtentsV), XMVectorAdd(sweptCenterV, sweptExtentsV));
+		float distanceSq = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(closest, XMLoadFloat3(&c.sphereCenter))));
+
+		visible = distanceSq <= c.sphereRadius * c.sphereRadius &&
+			cameraFrustum.IntersectsAABB(sweptCenter, sweptExtents);
+	}
+
+	if (!visible)
+	{
+		shadowCastersSkipped++;
+		return false;
+	}
+
+	shadowCastersDrawn++;
+	return true;
+}
 
 // --------------------------------------------------------
 // Loads shaders from compiled shader object (.cso) files
@@ -402,12 +812,18 @@ void Game::RenderShadowMap()
 // --------------------------------------------------------
 void Game::LoadShaders()
 {
-	vertexShaders.push_back(std::make_shared<SimpleVertexShader>(device, context,
-		FixPath(L"VertexShader.cso").c_str()));
-	pixelShaders.push_back(std::make_shared<SimplePixelShader>(device, context,
-		FixPath(L"PixelShader.cso").c_str()));
-	pixelShaders.push_back(std::make_shared<SimplePixelShader>(device, context,
-		FixPath(L"CustomPixelShader.cso").c_str()));
+	vertexShaders.push_back(shaderCache->GetVertexShader(FixPath(L"VertexShader.cso")));
+	pixelShaders.push_back(shaderCache->GetPixelShader(FixPath(L"PixelShader.cso")));
+	pixelShaders.push_back(shaderCache->GetPixelShader(FixPath(L"CustomPixelShader.cso")));
+
+	instancedVertexShader = shaderCache->GetVertexShader(FixPath(L"InstancedVertexShader.cso"));
+	vertexShaders.push_back(instancedVertexShader);
+
+	//loaded once here instead of every time the shadow map is rendered
+	shadowVertexShader = shaderCache->GetVertexShader(FixPath(L"ShadowVertexShader.cso"));
+	shadowWorldHandle = shadowVertexShader->GetVariableHandle("world");
+	shadowViewHandle = shadowVertexShader->GetVariableHandle("view");
+	shadowProjectionHandle = shadowVertexShader->GetVariableHandle("projection");
 }
 
 void Game::CreateMaterials()
@@ -441,6 +857,12 @@ void Game::CreateEntites()
 
 		entities.push_back(make_shared<Entity>(meshes[i % meshes.size()], material));
 
+		//only the third row should have the gamma correct
+		entities[i]->SetUseGammaCorrection(i / columnNum == 2);
+
+		//the last entity is the only one Update() never moves
+		entities[i]->SetIsStatic(i == entityNum - 1);
+
 		//move back so not in the same space as camera
 		entities[i]->GetTransform()->MoveAbsolute(0.0f, 0.0f, 3.0f);
 
@@ -453,6 +875,7 @@ void Game::CreateEntites()
 
 	//create floor entity
 	floorEntity = std::make_shared<Entity>(meshes[0], floorMaterial);
+	floorEntity->SetUseGammaCorrection(true);
 	floorEntity->GetTransform()->MoveAbsolute(0.0, -8.0f, -3.0f);
 	floorEntity->GetTransform()->Scale(10.0f, 0.1f, 10.0f);
 
@@ -515,50 +938,73 @@ void Game::OnResize()
 // --------------------------------------------------------
 void Game::Update(float deltaTime, float totalTime)
 {
+	PROFILE_SCOPE("Update");
+
 	// Example input checking: Quit if the escape key is pressed
 	if (Input::GetInstance().KeyDown(VK_ESCAPE))
 		Quit();
 
 	ImGuiInitialization(deltaTime, this->windowHeight, this->windowWidth);
 
+	// Swap in whatever finished streaming, within the per-frame upload budget
+	assetStreamer->Update();
+
+	// A static caster's cached shadow still has its old mesh in it
+	if (assetStreamer->GetStats().meshesCommittedLastUpdate > 0)
+	{
+		for (int c = 0; c < MAX_SHADOW_CASCADES; c++)
+			staticShadowCacheFilled[c] = false;
+	}
+
 	float maxZ = 3.0f;
 	float minZ = -10.0f;
 	float moveAmount = 5.0f;
 
+	// Each entity only touches its own transform, so they're spread over the
+	// JobSystem (the last one never moves)
 	if (rotate)
 	{
-		for (int i = 0; i < entities.size(); i++)
+		unsigned int movingEntities = (unsigned int)entities.size() - 1;
+		JobSystem::GetInstance().ParallelFor(movingEntities, GetEntityGrainSize(movingEntities),
+			[this, deltaTime, maxZ, minZ, moveAmount](unsigned int first, unsigned int end)
 		{
-			if (i == entities.size() - 1)
-				break;
+			PROFILE_SCOPE("Move Entities");
+			for (unsigned int i = first; i < end; i++)
+			{
+				std::shared_ptr<Transform> transform = entities[i]->GetTransform();
+				transform->Rotate(0, -deltaTime * 0.25f, 0);
 
-			entities[i]->GetTransform()->Rotate(0, -deltaTime * 0.25f, 0);
-		}
+				//make it so only the first row moves back and forth
+				if (i >= 3)
+					continue;
 
-		for (int i = 0; i < 3; i++)
-		{
-			//make it so only the first row moves back and forth
-			if (entities[i]->GetMoveForward())
-			{
-				entities[i]->GetTransform()->MoveAbsolute(0, 0, moveAmount * deltaTime);
-				if (entities[i]->GetTransform()->GetPosition().z >= maxZ)
-					entities[i]->SetMoveForward(false);
-			}
+				if (entities[i]->GetMoveForward())
+				{
+					transform->MoveAbsolute(0, 0, moveAmount * deltaTime);
+					if (transform->GetPosition().z >= maxZ)
+						entities[i]->SetMoveForward(false);
+				}
 
-			else
-			{
-				entities[i]->GetTransform()->MoveAbsolute(0, 0, -moveAmount * deltaTime);
-				if (entities[i]->GetTransform()->GetPosition().z <= minZ)
-					entities[i]->SetMoveForward(true);
+				else
+				{
+					transform->MoveAbsolute(0, 0, -moveAmount * deltaTime);
+					if (transform->GetPosition().z <= minZ)
+						entities[i]->SetMoveForward(true);
+				}
 			}
-		}
+		});
 	}
 
 	CameraInput(deltaTime);
+
+	// Rebuild every matrix that changed this frame in one batch,
+	// before anything asks for them in Draw()
+	TransformSystem::GetInstance().UpdateDirtyMatrices();
 }
 
 void Game::ImGuiInitialization(float deltaTime, unsigned int windowHeight, unsigned int windowWidth)
 {
+	PROFILE_SCOPE("Build ImGui");
 
 	// Feed fresh input data to ImGui
 	ImGuiIO& io = ImGui::GetIO();
@@ -573,7 +1019,7 @@ void Game::ImGuiInitialization(float deltaTime, unsigned int windowHeight, unsig
 	Input& input = Input::GetInstance();
 	input.SetKeyboardCapture(io.WantCaptureKeyboard);
 	input.SetMouseCapture(io.WantCaptureMouse);
-	ImGui::Image(shadowSRV.Get(), ImVec2(512, 512));
+	ImGui::Image(shadowPreviewSRV.Get(), ImVec2(512, 512));
 	if (ImGui::TreeNode("Controls"))
 	{
 		ImGui::Text("Q/E: Up/Down");
@@ -634,6 +1080,10 @@ void Game::ImGuiInitialization(float deltaTime, unsigned int windowHeight, unsig
 				if (ImGui::ColorEdit4("Color Tint", &colorTint.x))
 					entities[index]->SetColorTint(colorTint);
 
+				bool isStatic = entities[index]->GetIsStatic();
+				if (ImGui::Checkbox("Static (Cached Shadow)", &isStatic))
+					entities[index]->SetIsStatic(isStatic);
+
 				ImGui::TreePop();
 			}
 		}
@@ -673,17 +1123,367 @@ void Game::ImGuiInitialization(float deltaTime, unsigned int windowHeight, unsig
 		ImGui::TreePop();
 
 	}
+
+	if (ImGui::TreeNode("Meshes"))
+	{
+		for (int i = 0; i < meshes.size(); i++)
+		{
+			if (ImGui::TreeNode((void*)(intptr_t)i, "Mesh %d", i + 1))
+			{
+				ObjImportStats stats = meshes[i]->GetImportStats();
+				ImGui::Text("Vertices: %d", meshes[i]->GetVertexCount());
+				ImGui::Text("Indices: %d", meshes[i]->GetIndexCount());
+				ImGui::Text("Input Corners: %u", stats.inputCorners);
+				ImGui::Text("Unique Vertices: %u", stats.uniqueVertices);
+				ImGui::Text("Bytes Saved: %u", stats.bytesSaved);
+
+				VertexCacheStats cache = meshes[i]->GetVertexCacheStats();
+				ImGui::Text("ACMR: %.3f -> %.3f", cache.acmrBefore, cache.acmrAfter);
+				ImGui::Text("ATVR: %.3f -> %.3f", cache.atvrBefore, cache.atvrAfter);
+				ImGui::TreePop();
+			}
+		}
+		ImGui::TreePop();
+	}
+
+	if (ImGui::TreeNode("Shadow Cascades"))
+	{
+		int cascadeCount = (int)shadowCascadeSettings.cascadeCount;
+		if (ImGui::SliderInt("Cascades", &cascadeCount, 1, MAX_SHADOW_CASCADES))
+			shadowCascadeSettings.cascadeCount = (unsigned int)cascadeCount;
+		ImGui::SliderFloat("Split Lambda", &shadowCascadeSettings.splitLambda, 0.0f, 1.0f);
+		ImGui::DragFloat("Shadow Distance", &shadowCascadeSettings.maxDistance, 0.5f, 1.0f, 500.0f);
+		ImGui::SliderInt("Preview Cascade", &shadowPreviewCascade, 0, (int)shadowCascadeSettings.cascadeCount - 1);
+		for (unsigned int c = 0; c < shadowCascadeSettings.cascadeCount; c++)
+			ImGui::Text("Cascade %u: %.2f - %.2f (radius %.2f)", c, shadowCascades[c].splitNear, shadowCascades[c].splitFar, shadowCascades[c].sphereRadius);
+
+		ImGui::Checkbox("Cache Static Casters", &shadowCaching);
+		if (shadowCaching)
+		{
+			for (unsigned int c = 0; c < shadowCascadeSettings.cascadeCount; c++)
+				ImGui::Text("Cascade %u Cache Valid For: %u frames", c, staticShadowCacheFrames[c]);
+			ImGui::Text("Cache Rebuilds: %u", staticShadowCacheRebuilds);
+		}
+		ImGui::TreePop();
+	}
+
+	if (ImGui::TreeNode("Culling"))
+	{
+		ImGui::Checkbox("Frustum Culling", &frustumCulling);
+		ImGui::Text("Tested: %u", entitiesTested);
+		ImGui::Text("Culled: %u", entitiesCulled);
+		ImGui::Text("Drawn: %u", entitiesDrawn);
+		ImGui::Text("Shadow Casters Drawn: %u", shadowCastersDrawn);
+		ImGui::Text("Shadow Casters Skipped: %u", shadowCastersSkipped);
+		ImGui::TreePop();
+	}
+
+	if (ImGui::TreeNode("Instancing"))
+	{
+		ImGui::Checkbox("Instancing", &instancing);
+		ImGui::Text("Instanced Entities: %u", instanceBatcher.GetDrawCount());
+		ImGui::Text("Instance Batches: %d", (int)instanceBatcher.GetBatches().size());
+		ImGui::Text("Entity Draw Calls: %u", entityDrawCalls);
+		ImGui::TreePop();
+	}
+
+	if (ImGui::TreeNode("Render Queue"))
+	{
+		RenderQueueStats queueStats = renderQueue.GetStats();
+		ImGui::Text("Draws Sorted: %u", queueStats.draws);
+		ImGui::Text("State Changes Unsorted: %u", queueStats.stateChangesSubmitted);
+		ImGui::Text("State Changes Sorted: %u", queueStats.stateChangesSorted);
+		ImGui::Text("State Changes Avoided: %d", (int)queueStats.stateChangesSubmitted - (int)queueStats.stateChangesSorted);
+		ImGui::TreePop();
+	}
+
+	if (ImGui::TreeNode("Clustered Lighting"))
+	{
+		LightClusterStats clusterStats = lightClusters.GetStats();
+		ImGui::Text("Grid: %d x %d x %d", LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y, LIGHT_CLUSTERS_Z);
+		ImGui::Text("Directional Lights: %u", clusterStats.directionalLights);
+		ImGui::Text("Clustered Lights: %u", clusterStats.clusteredLights);
+		ImGui::Text("Lights Outside Frustum: %u", clusterStats.culledLights);
+		ImGui::Text("Light Indices: %u", clusterStats.indices);
+		ImGui::Text("Most Lights In A Cluster: %u", clusterStats.maxLightsPerCluster);
+		ImGui::Text("Build Time: %.3f ms (%u threads)", clusterStats.buildMilliseconds, JobSystem::GetInstance().GetThreadCount());
+
+		if (ImGui::Button("Add 1000 Point Lights"))
+			AddRandomPointLights(1000);
+		ImGui::SameLine();
+		if (ImGui::Button("Remove Point Lights"))
+			lights.erase(std::remove_if(lights.begin(), lights.end(),
+				[](const Light& l) { return l.Type == LIGHT_TYPE_POINT; }), lights.end());
+
+		ImGui::Checkbox("Per-Object Lights Instead", &perObjectLights);
+		if (perObjectLights)
+		{
+			ImGui::Text("Max Lights Per Object: %d", MAX_OBJECT_LIGHTS);
+			ImGui::Text("Objects: %u", lightSelector.GetSelectionCount());
+			ImGui::Text("Lights Tested: %u", lightSelector.GetLightsTested());
+		}
+		ImGui::TreePop();
+	}
+
+	if (ImGui::TreeNode("State Changes"))
+	{
+		ImGui::Text("Binds Filtered: %u", lastFrameBindsFiltered);
+		ImGui::Text("Binds Made: %u", lastFrameBindsForwarded);
+		ImGui::TreePop();
+	}
+
+	if (ImGui::TreeNode("Constant Buffers"))
+	{
+		ImGui::Text("Buffers Uploaded: %u", lastFrameUploadStats.BuffersUploaded);
+		ImGui::Text("Unchanged Buffers Skipped: %u", lastFrameUploadStats.BuffersSkipped);
+		ImGui::Text("Partial Uploads: %u", lastFrameUploadStats.PartialUploads);
+		ImGui::Text("Bytes Uploaded: %llu", lastFrameUploadStats.BytesUploaded);
+		ImGui::Text("Bytes Skipped: %llu", lastFrameUploadStats.BytesSkipped);
+		ImGui::Text("Dynamic Buffers: %s", ISimpleShader::UseDynamicConstantBuffers ? "On" : "Off (start with -dynamiccb)");
+		ImGui::TreePop();
+	}
+
+	if (ImGui::TreeNode("Transforms"))
+	{
+		ImGui::Text("Transforms: %u", TransformSystem::GetInstance().GetTransformCount());
+		ImGui::Text("Matrices Rebuilt Last Frame: %u", TransformSystem::GetInstance().GetLastUpdateCount());
+		ImGui::Text("Parented Matrices Composed: %u", TransformSystem::GetInstance().GetLastHierarchyCount());
+		ImGui::TreePop();
+	}
+
+	if (ImGui::TreeNode("Asset Loading"))
+	{
+		ImGui::Text("Loaded In: %.1f ms (%u threads)", assetLoadReport.totalMilliseconds, assetLoadReport.threads);
+		ImGui::Text("One After Another: %.1f ms", assetLoadReport.serialMilliseconds);
+		ImGui::Text("Critical Path: %.1f ms", assetLoadReport.criticalPathMilliseconds);
+		ImGui::Text("Uploads (Main Thread): %.1f ms", assetLoadReport.uploadMilliseconds);
+		for (const AssetLoadTiming& t : assetLoadReport.assets)
+		{
+			ImGui::Text("%s%s: read %.1f, decode %.1f, upload %.1f ms", t.name.c_str(), t.failed ? " (failed)" : "",
+				t.readMilliseconds, t.decodeMilliseconds, t.uploadMilliseconds);
+		}
+		ImGui::TreePop();
+	}
+
+	if (ImGui::TreeNode("Streaming"))
+	{
+		AssetStreamerStats streaming = assetStreamer->GetStats();
+		ImGui::Text("Resident: %u / %u (%u failed)", streaming.resident, streaming.requested, streaming.failed);
+		ImGui::Text("Queued: %u", streaming.queued);
+		ImGui::Text("Decoded, Waiting To Upload: %u", streaming.readyToUpload);
+		ImGui::Text("Decoding (Background Jobs): %.1f ms total", streaming.decodeMilliseconds);
+		ImGui::Text("Committed This Frame: %u textures, %u meshes (%.2f ms)",
+			streaming.texturesCommittedLastUpdate, streaming.meshesCommittedLastUpdate, streaming.uploadMillisecondsLastUpdate);
+
+		int uploadsPerFrame = (int)assetStreamer->GetUploadsPerFrame();
+		if (ImGui::SliderInt("Uploads Per Frame", &uploadsPerFrame, 1, 16))
+			assetStreamer->SetUploadsPerFrame((unsigned int)uploadsPerFrame);
+
+		// Middle row, cubes until the models have loaded
+		if (ImGui::Button("Stream In Models"))
+		{
+			const char* models[3] = { "../../Assets/Models/helix.obj", "../../Assets/Models/torus.obj", "../../Assets/Models/quad_double_sided.obj" };
+			streamedModels.clear();
+			for (int i = 0; i < 3; i++)
+			{
+				streamedModels.push_back(assetStreamer->RequestMesh(FixPath(models[i])));
+				assetStreamer->BindMesh(streamedModels[i], entities[3 + i]);
+			}
+		}
+
+		const char* stateNames[3] = { "loading", "resident", "failed" };
+		for (auto& model : streamedModels)
+			ImGui::Text("%s: %s", model->GetFileName().c_str(), stateNames[model->GetState()]);
+		ImGui::TreePop();
+	}
+
+	if (ImGui::TreeNode("Job System"))
+	{
+		ImGui::Text("Threads: %u", JobSystem::GetInstance().GetThreadCount());
+		ImGui::Text("Jobs Run: %u", lastFrameJobStats.jobsRun);
+		ImGui::Text("Jobs Stolen: %u", lastFrameJobStats.jobsStolen);
+		ImGui::Text("Parallel Loops: %u (%u too small to split)", lastFrameJobStats.parallelFors, lastFrameJobStats.inlineParallelFors);
+		ImGui::TreePop();
+	}
+
+	if (ImGui::TreeNode("Frame Stats"))
+	{
+		FrameStatsSummary summary = frameStats.GetSummary();
+		ImGui::Text("Last %u frames (ms)", summary.frames);
+		ImGui::Text("%-10s %7s %7s %7s %7s %7s %7s", "", "min", "avg", "p50", "p95", "p99", "max");
+		ImGui::Text("%-10s %7.2f %7.2f %7.2f %7.2f %7.2f %7.2f", "CPU", summary.cpu.min, summary.cpu.average,
+			summary.cpu.p50, summary.cpu.p95, summary.cpu.p99, summary.cpu.max);
+		ImGui::Text("%-10s %7.2f %7.2f %7.2f %7.2f %7.2f %7.2f", "Present", summary.presentInterval.min, summary.presentInterval.average,
+			summary.presentInterval.p50, summary.presentInterval.p95, summary.presentInterval.p99, summary.presentInterval.max);
+		ImGui::Text("CPU-Bound Frames: %u, Waiting On GPU/VSync: %u", summary.cpuBoundFrames, summary.gpuBoundFrames);
+
+		float target = frameStats.GetTargetMilliseconds();
+		if (ImGui::SliderFloat("Budget (ms)", &target, 4.0f, 50.0f))
+			frameStats.SetTargetMilliseconds(target);
+		float hitchFactor = frameStats.GetHitchFactor();
+		if (ImGui::SliderFloat("Hitch Over Budget (x)", &hitchFactor, 1.0f, 4.0f))
+			frameStats.SetHitchFactor(hitchFactor);
+		ImGui::Text("Hitches: %u in the window, %llu since reset", summary.hitches, frameStats.GetTotalHitches());
+
+		// Time between presents, up to three budgets (the last bucket is everything slower)
+		float histogram[48];
+		frameStats.GetHistogram(histogram, 48, target * 3.0f);
+		ImGui::PlotHistogram("##FrameHistogram", histogram, 48, 0, "Present Interval Histogram", 0.0f, FLT_MAX, ImVec2(0, 80));
+		ImGui::Text("%.2f ms buckets, the last is %.1f ms and up", target * 3.0f / 48, target * 3.0f);
+
+		// Most recent frames, oldest on the left
+		float recent[240];
+		unsigned int recentCount = frameStats.GetFrameCount() < 240 ? frameStats.GetFrameCount() : 240;
+		for (unsigned int i = 0; i < recentCount; i++)
+			recent[i] = frameStats.GetFrame(recentCount - 1 - i).presentIntervalMilliseconds;
+		if (recentCount > 0)
+			ImGui::PlotLines("##RecentFrames", recent, (int)recentCount, 0, "Present Interval (Recent)", 0.0f, target * 3.0f, ImVec2(0, 80));
+
+		if (ImGui::Button("Write CSV"))
+			frameStats.WriteCSV("frame_stats.csv");
+		ImGui::SameLine();
+		if (ImGui::Button("Reset"))
+			frameStats.Reset();
+		ImGui::SameLine();
+		ImGui::Checkbox("Write CSV On Exit", &frameStatsCSVOnExit);
+		ImGui::TreePop();
+	}
+
+	if (ImGui::TreeNode("Profiler"))
+	{
+		ImGuiProfiler();
+		ImGui::TreePop();
+	}
+
+	if (ImGui::TreeNode("Shader Cache"))
+	{
+		ImGui::Text("Shaders Loaded: %d", (int)shaderCache->GetShaderCount());
+		ImGui::Text("Hits: %u", shaderCache->GetHitCount());
+		ImGui::Text("Misses: %u", shaderCache->GetMissCount());
+		ImGui::TreePop();
+	}
 	
 	// Show the demo window
 	//ImGui::ShowDemoWindow();
 }
 
 
+// Each thread gets a lane with a row per nesting depth, scopes are
+// placed by when they ran in the frame (hover one for its time)
+void Game::ImGuiProfiler()
+{
+	Profiler& profiler = Profiler::GetInstance();
+
+	bool capturing = Profiler::IsCapturing();
+	if (ImGui::Checkbox("Capture", &capturing))
+		profiler.SetCapturing(capturing);
+
+	ImGui::SameLine();
+	if (ImGui::Button("Export Chrome Trace"))
+	{
+		profilerExportMessage = profiler.ExportChromeTrace("profile_trace.json") ?
+			"Wrote profile_trace.json" : "Couldn't write profile_trace.json";
+	}
+	if (!profilerExportMessage.empty())
+		ImGui::Text("%s (open in chrome://tracing or ui.perfetto.dev)", profilerExportMessage.c_str());
+
+	unsigned int frameCount = profiler.GetFrameCount();
+	if (frameCount == 0)
+	{
+		ImGui::Text("No frames recorded yet");
+		return;
+	}
+
+	if (profilerFramesAgo > (int)frameCount - 1)
+		profilerFramesAgo = (int)frameCount - 1;
+	ImGui::SliderInt("Frames Ago", &profilerFramesAgo, 0, (int)frameCount - 1);
+
+	const ProfileFrame& frame = profiler.GetFrame((unsigned int)profilerFramesAgo);
+	float frameNanoseconds = (float)(frame.end - frame.start);
+	ImGui::Text("Frame: %.3f ms, %d scopes (%u dropped)", frameNanoseconds / 1000000.0f, (int)frame.events.size(), profiler.GetDroppedCount());
+	if (frameNanoseconds <= 0.0f)
+		return;
+
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	ImVec2 origin = ImGui::GetCursorScreenPos();
+	float labelWidth = 120.0f;
+	float timelineWidth = ImGui::GetContentRegionAvail().x - labelWidth;
+	float rowHeight = ImGui::GetTextLineHeight() + 2.0f;
+	float y = origin.y;
+
+	// Events are sorted by thread, so each lane is one run of them
+	size_t laneStart = 0;
+	while (laneStart < frame.events.size())
+	{
+		unsigned int thread = frame.events[laneStart].thread;
+		size_t laneEnd = laneStart;
+		unsigned int maxDepth = 0;
+		while (laneEnd < frame.events.size() && frame.events[laneEnd].thread == thread)
+		{
+			if (frame.events[laneEnd].depth > maxDepth)
+				maxDepth = frame.events[laneEnd].depth;
+			laneEnd++;
+		}
+
+		drawList->AddText(ImVec2(origin.x, y), IM_COL32(220, 220, 220, 255), profiler.GetThreadName(thread).c_str());
+
+		for (size_t i = laneStart; i < laneEnd; i++)
+		{
+			const ProfileEvent& e = frame.events[i];
+
+			// Clamped to the frame (the streaming thread isn't in step with it)
+			float startX = (e.start - frame.start) / frameNanoseconds;
+			float endX = (e.end - frame.start) / frameNanoseconds;
+			startX = origin.x + labelWidth + timelineWidth * (startX < 0.0f ? 0.0f : (startX > 1.0f ? 1.0f : startX));
+			endX = origin.x + labelWidth + timelineWidth * (endX < 0.0f ? 0.0f : (endX > 1.0f ? 1.0f : endX));
+			if (endX - startX < 1.0f)
+				endX = startX + 1.0f;
+
+			ImVec2 topLeft(startX, y + e.depth * rowHeight);
+			ImVec2 bottomRight(endX, topLeft.y + rowHeight - 1.0f);
+
+			// Same name, same color, every frame
+			unsigned int hash = 2166136261u;
+			for (const char* c = e.name; *c; c++)
+				hash = (hash ^ (unsigned char)*c) * 16777619u;
+			float r, g, b;
+			ImGui::ColorConvertHSVtoRGB((hash % 360) / 360.0f, 0.5f, 0.75f, r, g, b);
+			drawList->AddRectFilled(topLeft, bottomRight, IM_COL32((int)(r * 255), (int)(g * 255), (int)(b * 255), 255));
+
+			if (ImGui::CalcTextSize(e.name).x < bottomRight.x - topLeft.x - 4.0f)
+				drawList->AddText(ImVec2(topLeft.x + 2.0f, topLeft.y + 1.0f), IM_COL32(0, 0, 0, 255), e.name);
+
+			if (ImGui::IsMouseHoveringRect(topLeft, bottomRight))
+				ImGui::SetTooltip("%s\n%.3f ms", e.name, (e.end - e.start) / 1000000.0f);
+		}
+
+		y += (maxDepth + 1) * rowHeight + 4.0f;
+		laneStart = laneEnd;
+	}
+	ImGui::Dummy(ImVec2(labelWidth + timelineWidth, y - origin.y));
+
+	// The same scopes as an indented list, per thread
+	if (ImGui::TreeNode("Scope List"))
+	{
+		for (size_t i = 0; i < frame.events.size(); i++)
+		{
+			const ProfileEvent& e = frame.events[i];
+			if (i == 0 || frame.events[i - 1].thread != e.thread)
+				ImGui::Text("%s", profiler.GetThreadName(e.thread).c_str());
+			ImGui::Text("%*s%s: %.3f ms", (int)(e.depth + 1) * 2, "", e.name, (e.end - e.start) / 1000000.0f);
+		}
+		ImGui::TreePop();
+	}
+}
+
+
 // --------------------------------------------------------
 // Clear the screen, redraw everything, present to the user
 // --------------------------------------------------------
 void Game::Draw(float deltaTime, float totalTime)
 {
+	PROFILE_SCOPE("Draw");
+
 	// Frame START
 	// - These things should happen ONCE PER FRAME
 	// - At the beginning of Game::Draw() before drawing *anything*
@@ -698,58 +1498,185 @@ void Game::Draw(float deltaTime, float totalTime)
 
 	//start drawing
 
-	size_t columnNum = meshes.size();
-
-	
+	// Planes for this frame's camera, so entities that can't be seen
+	// are skipped before any of their shader data is set up
+	// - The shadow pass uses them too, so update them first
+	cameraFrustum.Update(cameras[activeCameraIndex]->GetViewMatrix(), cameras[activeCameraIndex]->GetProjectionMatrix());
+	{
+		PROFILE_SCOPE("UpdateShadowCascades");
+		UpdateShadowCascades();
+	}
 
 	//Shadow map
 	RenderShadowMap();
 
-	for (int i = 0; i < entityNum; i++)
+	entitiesTested = 0;
+	entitiesCulled = 0;
+	entitiesDrawn = 0;
+
+	// Lights, camera and shadow matrices only go to the GPU once per frame,
+	// each entity after this just fills in its own (much smaller) buffers
+	UpdateLightClusters();
+	SetPerFrameShaderData();
+
+	entityDrawCalls = 0;
+	bool drawInstanced = instancing && !perObjectLights && instancedVertexShader->GetPerInstanceCompatible();
+	instanceBatcher.Clear();
+	renderQueue.Clear();
+
+	// Culling, light selection and sort keys only read shared data (or write
+	// their own entity's light list), so each job fills its own range of
+	// packets, then the queue and batcher are filled from them in entity order
+	RegisterRenderResources();
+	unsigned int drawableCount = entityNum + 1;
+	unsigned int grainSize = GetEntityGrainSize(drawableCount);
+	entityPackets.resize(drawableCount);
+	lightSelectorScratch.resize((drawableCount + grainSize - 1) / grainSize);
+	JobSystem::GetInstance().ParallelFor(drawableCount, grainSize, [this, grainSize, drawInstanced](unsigned int first, unsigned int end)
+	{
+		PROFILE_SCOPE("Build Draw Packets");
+		LightSelectorScratch& scratch = lightSelectorScratch[first / grainSize];
+		for (unsigned int i = first; i < end; i++)
+		{
+			// Floor goes last
+			shared_ptr<Entity> entity = i < (unsigned int)entityNum ? entities[i] : floorEntity;
+			EntityDrawPacket& packet = entityPackets[i];
+			packet.visible = IsInCameraFrustum(entity);
+			if (!packet.visible)
+				continue;
+
+			if (perObjectLights)
+			{
+				DirectX::XMFLOAT3 center;
+				DirectX::XMFLOAT3 extents;
+				entity->GetWorldBounds(center, extents);
+				unsigned int selected[MAX_OBJECT_LIGHTS];
+				unsigned int count = lightSelector.Select(center, extents, selected, MAX_OBJECT_LIGHTS, scratch);
+				entity->SetLightList(selected, (int)count);
+			}
+			else
+			{
+				entity->SetLightList(0, -1);
+			}
+
+			// The instanced shader stands in for the regular one, so
+			// anything using a different vertex shader is drawn on its own
+			std::shared_ptr<Material> material = entity->GetMaterial();
+			packet.instanced = drawInstanced && material->GetVertexShader() == vertexShaders[0];
+			if (packet.instanced)
+				continue;
+
+			packet.sortDepth = GetSortDepth(entity->GetTransform()->GetPosition());
+			unsigned int shaderId = renderQueue.FindResourceId(material->GetPixelShader().get());
+			unsigned int materialId = renderQueue.FindResourceId(material.get());
+			unsigned int meshId = renderQueue.FindResourceId(entity->GetMesh().get());
+			packet.keyResolved = shaderId != RENDER_QUEUE_UNKNOWN_ID && materialId != RENDER_QUEUE_UNKNOWN_ID && meshId != RENDER_QUEUE_UNKNOWN_ID;
+			if (packet.keyResolved)
+				packet.sortKey = RenderQueue::MakeSortKey(RENDER_PASS_OPAQUE, shaderId, materialId, meshId, packet.sortDepth);
+		}
+	});
+
+	for (auto& scratch : lightSelectorScratch)
+		lightSelector.MergeStats(scratch);
+
+	for (int i = 0; i <= entityNum; i++)
 	{
-		shared_ptr<Entity> entity = entities[i];
-		entity->GetMaterial()->SetLights("lights", &lights[0], sizeof(Light) * (int)lights.size());
+		const EntityDrawPacket& packet = entityPackets[i];
+		entitiesTested++;
+		if (!packet.visible)
+		{
+			entitiesCulled++;
+			continue;
+		}
+		entitiesDrawn++;
 
-		entity->GetMaterial()->GetVertexShader()->SetMatrix4x4("shadowView", shadowViewMatrix);
-		entity->GetMaterial()->GetVertexShader()->SetMatrix4x4("shadowProjection", shadowProjectionMatrix);
-		
-		entity->GetMaterial()->SetTextureData();
-		entity->GetMaterial()->GetPixelShader()->SetFloat3("ambient", DirectX::XMFLOAT3(0.59f, 0.42f, 0.52f));
-		entity->GetMaterial()->GetPixelShader()->SetInt("lightNum", (int)lights.size());
+		shared_ptr<Entity> entity = i < entityNum ? entities[i] : floorEntity;
+		if (packet.instanced)
+		{
+			std::shared_ptr<Transform> transform = entity->GetTransform();
+			instanceBatcher.Add(entity->GetMesh().get(), entity->GetMaterial().get(), entity->GetUseGammaCorrection(),
+				transform->GetWorldMatrix(), transform->GetWorldInverseTransposeMatrix(), entity->GetColorTint());
+			continue;
+		}
 
-		//only the third row should have the gamma correct
-		int gammaNum = i / columnNum == 2;
-
-		entity->GetMaterial()->GetPixelShader()->SetInt("useGammaCorrection", gammaNum);
-		entity->GetMaterial()->GetPixelShader()->SetShaderResourceView("ShadowMap", shadowSRV);
-		entity->GetMaterial()->GetPixelShader()->SetSamplerState("ShadowSampler", shadowSampler);
-		entity->GetMaterial()->GetPixelShader()->CopyAllBufferData();
-		entity->Draw(cameras[activeCameraIndex]);
-	}
-
-	floorEntity->GetMaterial()->SetLights("lights", &lights[0], sizeof(Light) * (int)lights.size());
-	floorEntity->GetMaterial()->GetVertexShader()->SetMatrix4x4("shadowView", shadowViewMatrix);
-	floorEntity->GetMaterial()->GetVertexShader()->SetMatrix4x4("shadowProjection", shadowProjectionMatrix);
-	floorEntity->GetMaterial()->SetTextureData();
-	floorEntity->GetMaterial()->GetPixelShader()->SetFloat3("ambient", DirectX::XMFLOAT3(0.59f, 0.42f, 0.52f));
-	floorEntity->GetMaterial()->GetPixelShader()->SetInt("lightNum", (int)lights.size());
-	floorEntity->GetMaterial()->GetPixelShader()->SetInt("useGammaCorrection", 1);
-	floorEntity->GetMaterial()->GetPixelShader()->SetShaderResourceView("ShadowMap", shadowSRV);
-	floorEntity->GetMaterial()->GetPixelShader()->SetSamplerState("ShadowSampler", shadowSampler);
-	floorEntity->GetMaterial()->GetPixelShader()->CopyAllBufferData();
-	floorEntity->Draw(cameras[activeCameraIndex]);
-
-	//draw skybox last
-	skyBox->Draw(cameras[activeCameraIndex]);
+		// Resources RegisterRenderResources() didn't know about get their IDs here
+		unsigned long long key = packet.sortKey;
+		if (!packet.keyResolved)
+		{
+			std::shared_ptr<Material> material = entity->GetMaterial();
+			key = RenderQueue::MakeSortKey(RENDER_PASS_OPAQUE,
+				renderQueue.GetResourceId(material->GetPixelShader().get()),
+				renderQueue.GetResourceId(material.get()),
+				renderQueue.GetResourceId(entity->GetMesh().get()),
+				packet.sortDepth);
+		}
+		renderQueue.Submit(key, { RenderCommandEntity, (unsigned int)i });
+	}
+
+	// Batches are sorted like single draws, using their first instance's position
+	UploadInstanceData();
+	const std::vector<InstanceBatch>& batches = instanceBatcher.GetBatches();
+	for (unsigned int b = 0; b < batches.size(); b++)
+	{
+		const InstanceData& first = instanceBatcher.GetInstanceData()[batches[b].firstInstance];
+		unsigned long long key = RenderQueue::MakeSortKey(RENDER_PASS_OPAQUE,
+			renderQueue.GetResourceId(batches[b].material->GetPixelShader().get()),
+			renderQueue.GetResourceId(batches[b].material),
+			renderQueue.GetResourceId(batches[b].mesh),
+			GetSortDepth(XMFLOAT3(first.world._41, first.world._42, first.world._43)));
+		renderQueue.Submit(key, { RenderCommandInstanceBatch, b });
+	}
+
+	//skybox last (ImGui is drawn after the queue)
+	renderQueue.Submit(RenderQueue::MakeSortKey(RENDER_PASS_SKY, 0, 0, 0, 0.0f), { RenderCommandSky, 0 });
+
+	// Same shader/material/mesh end up next to each other, nearest first
+	renderQueue.Sort();
+	{
+		PROFILE_SCOPE("Draw Queue");
+		for (unsigned int i = 0; i < renderQueue.GetCount(); i++)
+		{
+			const RenderPacket& packet = renderQueue.GetPacket(i);
+			switch (packet.command)
+			{
+			case RenderCommandEntity:
+				(packet.index < (unsigned int)entityNum ? entities[packet.index] : floorEntity)->Draw();
+				entityDrawCalls++;
+				break;
+
+			case RenderCommandInstanceBatch:
+				DrawInstanceBatch(batches[packet.index]);
+				break;
+
+			case RenderCommandSky:
+				skyBox->Draw(cameras[activeCameraIndex]);
+				break;
+			}
+		}
+	}
+
+	lastFrameUploadStats = ISimpleShader::UploadStats;
+	ISimpleShader::ResetUploadStats();
+	lastFrameBindsFiltered = RenderStateCache::GetInstance().GetFilteredCount();
+	lastFrameBindsForwarded = RenderStateCache::GetInstance().GetForwardedCount();
+	RenderStateCache::GetInstance().ResetStats();
+	lastFrameJobStats = JobSystem::GetInstance().GetStats();
+	JobSystem::GetInstance().ResetStats();
 
 	// Draw ImGui
-	ImGui::Render();
-	ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+	{
+		PROFILE_SCOPE("ImGui Render");
+		ImGui::Render();
+		ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+	}
 
 	//unbind the srv
 	ID3D11ShaderResourceView* nullSRVs[128] = {};
 	context->PSSetShaderResources(0, 128, nullSRVs);
 
+	// ImGui and the unbind above went straight to the context
+	RenderStateCache::GetInstance().Invalidate();
+
 	// Frame END
 	// - These should happen exactly ONCE PER FRAME
 	// - At the very end of the frame (after drawing *everything*)
@@ -757,8 +1684,9 @@ void Game::Draw(float deltaTime, float totalTime)
 		// Present the back buffer to the user
 		//  - Puts the results of what we've drawn onto the window
 		//  - Without this, the user never sees anything
+		PROFILE_SCOPE("Present");
 		bool vsyncNecessary = vsync || !deviceSupportsTearing || isFullscreen;
-		swapChain->Present(
+		Present(
 			vsyncNecessary ? 1 : 0,
 			vsyncNecessary ? 0 : DXGI_PRESENT_ALLOW_TEARING);
 
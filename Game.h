@@ -17,6 +17,19 @@
 #include "ImGui/imgui_impl_dx11.h"
 #include "ImGui/imgui_impl_win32.h"
 #include "Sky.h"
+#include "ShaderCache.h"
+#include "TransformSystem.h"
+#include "Frustum.h"
+#include "InstanceBatcher.h"
+#include "RenderQueue.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "AssetLoader.h"
+#include "AssetStreamer.h"
+#include "RenderStateCache.h"
+#include "LightClusterBuilder.h"
+#include "LightSelector.h"
+#include "ShadowCascades.h"
 #include <vector>
 #include <memory>
 
@@ -39,6 +52,7 @@ public:
 private:
 	//helper method for igmu
 	void ImGuiInitialization(float deltaTime, unsigned int windowHeight, unsigned int windowWidth);
+	void ImGuiProfiler(); //timeline of one recorded frame, one lane per thread
 	void CreateMaterials();
 	// Initialization helper methods - feel free to customize, combine, remove, etc.
 	void LoadShaders(); 
@@ -47,7 +61,16 @@ private:
 	void LoadAssets();
 	void CreateLights();
 	void CreateShadowMapResources();
+	void UpdateShadowCascades(); //fits the cascades to the active camera
 	void RenderShadowMap();
+	void SetPerFrameShaderData(); //camera, light and shadow data shared by every entity
+	void UploadInstanceData(); //builds instanceBatcher's batches and binds their data to input slot 1
+	void DrawInstanceBatch(const InstanceBatch& batch);
+	float GetSortDepth(DirectX::XMFLOAT3 position); //distance from the camera, 0-1 over the far plane distance
+	void UpdateLightClusters(); //bins the lights for the active camera and uploads the lists
+	void UploadStructuredBuffer(Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv,
+		unsigned int& capacity, const void* data, unsigned int count, unsigned int stride);
+	void AddRandomPointLights(unsigned int count);
 
 	// Note the usage of ComPtr below
 	//  - This is a smart pointer for objects that abide by the
@@ -63,6 +86,12 @@ private:
 	std::vector<std::shared_ptr<SimplePixelShader>> pixelShaders;
 	std::vector<std::shared_ptr<SimpleVertexShader>> skyBoxVertexShaders;
 	std::vector<std::shared_ptr<SimplePixelShader>> skyBoxPixelShaders;
+	std::shared_ptr<SimpleVertexShader> shadowVertexShader;
+	std::shared_ptr<SimpleVertexShader> instancedVertexShader; //also in vertexShaders, so it gets per-frame data
+	SimpleVariableHandle shadowWorldHandle;
+	SimpleVariableHandle shadowViewHandle; //set once per cascade
+	SimpleVariableHandle shadowProjectionHandle;
+	std::shared_ptr<ShaderCache> shaderCache;
 
 
 	std::vector<std::shared_ptr<Mesh>> meshes;
@@ -84,14 +113,127 @@ private:
 	std::shared_ptr<Entity> floorEntity;
 
 
-	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSV;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowTexture; //one array slice per cascade
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSVs[MAX_SHADOW_CASCADES];
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowPreviewTexture; //copy of one cascade for ImGui
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowPreviewSRV;
+	int shadowPreviewCascade = 0;
 	Microsoft::WRL::ComPtr<ID3D11RasterizerState> shadowRasterizer;
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> shadowSampler;
-	DirectX::XMFLOAT4X4 shadowViewMatrix;
-	DirectX::XMFLOAT4X4 shadowProjectionMatrix;
-	int shadowMapResolution = 1024; // Ideally a power of 2 (like 1024)
-
+	int shadowMapResolution = 1024; // Per cascade, ideally a power of 2 (like 1024)
+	ShadowCascadeSettings shadowCascadeSettings;
+	ShadowCascade shadowCascades[MAX_SHADOW_CASCADES];
+	DirectX::XMFLOAT4X4 shadowViewProjections[MAX_SHADOW_CASCADES];
+
+	// View frustum culling
+	Frustum cameraFrustum;
+	bool frustumCulling = true;
+	unsigned int entitiesTested = 0;
+	unsigned int entitiesCulled = 0;
+	unsigned int entitiesDrawn = 0;
+	bool IsInCameraFrustum(std::shared_ptr<Entity> entity); //safe to call from jobs
+
+	// Per entity results of the parallel packet pass in Draw() (floor last)
+	// - Each job fills its own range, the queue and batcher are filled from them afterwards
+	struct EntityDrawPacket
+	{
+		unsigned long long sortKey;
+		float sortDepth;
+		bool visible;
+		bool instanced; //goes to instanceBatcher instead of the queue
+		bool keyResolved; //false if a resource had no queue ID yet, the key is made afterwards
+	};
+	const unsigned int minEntitiesPerJob = 2;
+	unsigned int GetEntityGrainSize(unsigned int count);
+	std::vector<EntityDrawPacket> entityPackets;
+	std::vector<LightSelectorScratch> lightSelectorScratch; //one per job range, kept between frames
+	void RegisterRenderResources(); //hands out queue IDs up front, so the packet jobs only look them up
+
+	// Shadow caster culling
+	Frustum shadowFrustums[MAX_SHADOW_CASCADES];
+	unsigned int shadowCastersDrawn = 0;
+	unsigned int shadowCastersSkipped = 0;
+	bool CastsVisibleShadow(std::shared_ptr<Entity> entity, unsigned int cascade); //also updates the counters above
+
+	// Static shadow caster cache
+	// - Static casters are drawn into their own copy of the shadow map, which
+	//   each frame starts from before the dynamic casters are drawn on top
+	// - A cascade's copy is redrawn when its light box moves (the camera moved
+	//   at least a texel), or when the light or any static caster changes
+	struct StaticShadowCaster
+	{
+		Entity* entity;
+		DirectX::XMFLOAT4X4 world;
+	};
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> staticShadowTexture;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> staticShadowDSVs[MAX_SHADOW_CASCADES];
+	bool shadowCaching = true;
+	bool staticShadowCacheFilled[MAX_SHADOW_CASCADES] = {};
+	ShadowCascade staticShadowCascades[MAX_SHADOW_CASCADES]; //what each cached slice was drawn with
+	std::vector<StaticShadowCaster> staticShadowCasters; //as of the last check
+	std::vector<StaticShadowCaster> staticShadowCasterScratch;
+	DirectX::XMFLOAT3 staticShadowLightDirection = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+	unsigned int staticShadowCacheFrames[MAX_SHADOW_CASCADES] = {}; //frames each slice has stayed valid
+	unsigned int staticShadowCacheRebuilds = 0;
+	bool StaticShadowCastersChanged(); //also records the current ones
+	void DrawShadowCaster(std::shared_ptr<Entity> entity);
+
+	// Instancing
+	// - Entities sharing a mesh and material are drawn with one instanced draw call
+	InstanceBatcher instanceBatcher;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> instanceBuffer;
+	unsigned int instanceBufferCapacity = 0; //in instances
+	bool instancing = true;
+	unsigned int entityDrawCalls = 0;
+
+	// Draw ordering
+	// - Packet commands: index is an entity (entityNum for the floor) or an instance batch
+	enum RenderCommand { RenderCommandEntity, RenderCommandInstanceBatch, RenderCommandSky };
+	RenderQueue renderQueue;
+
+	// Constant buffer uploads during the last full frame
+	SimpleShaderUploadStats lastFrameUploadStats;
+
+	// Binds dropped/made by the state cache during the last full frame
+	unsigned int lastFrameBindsFiltered = 0;
+	unsigned int lastFrameBindsForwarded = 0;
+
+	// Jobs run during the last full frame
+	JobSystemStats lastFrameJobStats;
+
+	// Per asset times from LoadAssets()
+	AssetLoadReport assetLoadReport;
+
+	// Runtime streaming
+	// - Models picked in the UI, and textures when streamTextures is set, load behind placeholders
+	std::shared_ptr<AssetStreamer> assetStreamer;
+	bool streamTextures = false; //true streams material textures in behind placeholders, false loads them with everything else before the first frame (listed in the load report)
+	std::vector<std::shared_ptr<StreamedMesh>> streamedModels; //swapped onto the middle row from the UI
+
+	// Profiler panel
+	int profilerFramesAgo = 0; //0 = the last finished frame
+	std::string profilerExportMessage;
+
+	// Clustered lighting
+	// - Point and spot lights are binned into froxels of the camera frustum
+	//   on the CPU, so each pixel only evaluates the lights of its cluster
+	LightClusterBuilder lightClusters;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> lightBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> lightSRV;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> lightClusterBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> lightClusterSRV;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> lightIndexBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> lightIndexSRV;
+	unsigned int lightBufferCapacity = 0; //in elements, like the two below
+	unsigned int lightClusterBufferCapacity = 0;
+	unsigned int lightIndexBufferCapacity = 0;
+
+	// Per-object lights
+	// - Instead of clusters, each entity gets its few most relevant
+	//   lights (instancing is off, as every draw has its own list)
+	LightSelector lightSelector;
+	bool perObjectLights = false;
 
 };
 
@@ -0,0 +1,96 @@
+#include "InstanceBatcher.h"
+#include <unordered_map>
+
+using namespace DirectX;
+
+// Mesh, material and flag packed into one hashable key
+struct BatchKey
+{
+	Mesh* mesh;
+	Material* material;
+	bool useGammaCorrection;
+
+	bool operator==(const BatchKey& other) const
+	{
+		return mesh == other.mesh && material == other.material && useGammaCorrection == other.useGammaCorrection;
+	}
+};
+
+struct BatchKeyHash
+{
+	size_t operator()(const BatchKey& key) const
+	{
+		size_t hash = std::hash<Mesh*>()(key.mesh);
+		hash ^= std::hash<Material*>()(key.material) + 0x9E3779B9 + (hash << 6) + (hash >> 2);
+		return hash ^ (size_t)key.useGammaCorrection;
+	}
+};
+
+void InstanceBatcher::Clear()
+{
+	draws.clear();
+	unsortedInstances.clear();
+	batches.clear();
+	instances.clear();
+}
+
+void InstanceBatcher::Add(Mesh* mesh, Material* material, bool useGammaCorrection,
+	const XMFLOAT4X4& world, const XMFLOAT4X4& worldInvTranspose, const XMFLOAT4& tint)
+{
+	draws.push_back({ mesh, material, useGammaCorrection, 0 });
+	unsortedInstances.push_back({ world, worldInvTranspose, tint });
+}
+
+void InstanceBatcher::Build()
+{
+	batches.clear();
+	instances.resize(unsortedInstances.size());
+
+	// Assign every draw to a batch, counting instances as we go
+	std::unordered_map<BatchKey, unsigned int, BatchKeyHash> batchIndices;
+	for (auto& d : draws)
+	{
+		BatchKey key = { d.mesh, d.material, d.useGammaCorrection };
+		auto found = batchIndices.find(key);
+		if (found == batchIndices.end())
+		{
+			found = batchIndices.insert({ key, (unsigned int)batches.size() }).first;
+			batches.push_back({ d.mesh, d.material, d.useGammaCorrection, 0, 0 });
+		}
+
+		d.batch = found->second;
+		batches[d.batch].instanceCount++;
+	}
+
+	// Each batch's range starts where the previous one ended
+	unsigned int offset = 0;
+	for (auto& b : batches)
+	{
+		b.firstInstance = offset;
+		offset += b.instanceCount;
+		b.instanceCount = 0;
+	}
+
+	// Scatter instances into their batch's range, keeping the order they were added in
+	for (size_t i = 0; i < draws.size(); i++)
+	{
+		InstanceBatch& b = batches[draws[i].batch];
+		instances[b.firstInstance + b.instanceCount] = unsortedInstances[i];
+		b.instanceCount++;
+	}
+}
+
+const std::vector<InstanceBatch>& InstanceBatcher::GetBatches() const
+{
+	return batches;
+}
+
+const std::vector<InstanceData>& InstanceBatcher::GetInstanceData() const
+{
+	return instances;
+}
+
+unsigned int InstanceBatcher::GetDrawCount() const
+{
+	return (unsigned int)draws.size();
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+class Mesh;
+class Material;
+
+// --------------------------------------------------------
+// One instance's worth of data in the per-instance vertex
+// buffer, matching the "_PER_INSTANCE" inputs of
+// InstancedVertexShader.hlsl
+// --------------------------------------------------------
+struct InstanceData
+{
+	DirectX::XMFLOAT4X4 world;
+	DirectX::XMFLOAT4X4 worldInvTranspose;
+	DirectX::XMFLOAT4 tint;
+};
+
+// --------------------------------------------------------
+// A run of instances that can go out as one instanced draw
+// --------------------------------------------------------
+struct InstanceBatch
+{
+	Mesh* mesh;
+	Material* material;
+	bool useGammaCorrection;	// Lives in a per-object cbuffer, so it has to match too
+	unsigned int firstInstance;	// Into GetInstanceData()
+	unsigned int instanceCount;
+};
+
+// --------------------------------------------------------
+// Groups draws that share a mesh, material and per-object
+// shader state, and packs their instance data so each group
+// is contiguous.
+//
+// Only the CPU side lives here (meshes and materials are
+// never dereferenced), the caller uploads the packed data
+// and issues one DrawIndexedInstanced() per batch.
+// --------------------------------------------------------
+class InstanceBatcher
+{
+public:
+	void Clear();
+	void Add(Mesh* mesh, Material* material, bool useGammaCorrection,
+		const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInvTranspose, const DirectX::XMFLOAT4& tint);
+
+	// Groups everything added since Clear().  Batches keep the order
+	// their first draw was added in, as do instances within a batch.
+	void Build();
+
+	const std::vector<InstanceBatch>& GetBatches() const;
+	const std::vector<InstanceData>& GetInstanceData() const;
+	unsigned int GetDrawCount() const;	// Draws added, for comparing against the batch count
+
+private:
+	struct PendingDraw
+	{
+		Mesh* mesh;
+		Material* material;
+		bool useGammaCorrection;
+		unsigned int batch;
+	};
+
+	std::vector<PendingDraw> draws;
+	std::vector<InstanceData> unsortedInstances;
+	std::vector<InstanceBatch> batches;
+	std::vector<InstanceData> instances;
+};
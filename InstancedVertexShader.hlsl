@@ -0,0 +1,50 @@
+#include "ShaderIncludes.hlsli"
+
+cbuffer PerFrame : register(b0)
+{
+    matrix projectionMatrix, viewMatrix;
+}
+
+// The regular vertex inputs, plus the per-object data that
+// would otherwise come from a cbuffer.  Anything ending in
+// "_PER_INSTANCE" is read from input slot 1, once per instance.
+// - Must match InstanceData in InstanceBatcher.h
+struct InstancedVertexShaderInput
+{
+    float3 localPosition : POSITION;
+    float3 normal : NORMAL;
+    float2 uv : TEXCOORD;
+    float3 tangent : TANGENT;
+    float4 world0 : WORLD_PER_INSTANCE0; // Matrix rows, as stored on the C++ side
+    float4 world1 : WORLD_PER_INSTANCE1;
+    float4 world2 : WORLD_PER_INSTANCE2;
+    float4 world3 : WORLD_PER_INSTANCE3;
+    float4 worldInvTranspose0 : WORLD_INV_TRANSPOSE_PER_INSTANCE0;
+    float4 worldInvTranspose1 : WORLD_INV_TRANSPOSE_PER_INSTANCE1;
+    float4 worldInvTranspose2 : WORLD_INV_TRANSPOSE_PER_INSTANCE2;
+    float4 worldInvTranspose3 : WORLD_INV_TRANSPOSE_PER_INSTANCE3;
+    float4 tint : TINT_PER_INSTANCE;
+};
+
+// --------------------------------------------------------
+// Same as VertexShader.hlsl, with the world matrices
+// coming from the instance buffer
+// --------------------------------------------------------
+VertexToPixel main(InstancedVertexShaderInput input)
+{
+    VertexToPixel output;
+
+    // Cbuffer matrices arrive transposed, so do the same here
+    // to keep the math identical to the non-instanced shader
+    matrix worldMatrix = transpose(float4x4(input.world0, input.world1, input.world2, input.world3));
+    matrix worldInvTranspose = transpose(float4x4(input.worldInvTranspose0, input.worldInvTranspose1, input.worldInvTranspose2, input.worldInvTranspose3));
+
+    matrix wvp = mul(projectionMatrix, mul(viewMatrix, worldMatrix));
+    output.screenPosition = mul(wvp, float4(input.localPosition, 1.0f));
+    output.uv = input.uv;
+    output.normal = mul((float3x3) worldInvTranspose, input.normal);
+    output.worldPosition = mul(worldMatrix, float4(input.localPosition, 1.0f)).xyz;
+    output.tangent = mul((float3x3) worldMatrix, input.tangent);
+    output.tint = input.tint;
+    return output;
+}
@@ -0,0 +1,327 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <string>
+
+// Singleton requirement
+JobSystem* JobSystem::instance;
+
+unsigned int JobSystem::RequestedThreadCount = 0;
+
+// Which deque the current thread pushes to and pops from
+static thread_local unsigned int currentQueue = 0;
+
+JobCounter::JobCounter() :
+	pending(0)
+{
+}
+
+bool JobCounter::IsDone() const
+{
+	return pending.load() == 0;
+}
+
+// One worker per hardware thread (unless told otherwise), minus the
+// main thread that queues the jobs (and runs them too while it waits)
+JobSystem::JobSystem() :
+	queuedJobs(0),
+	stopping(false),
+	queuedBackgroundJobs(0),
+	runningBackgroundJobs(0),
+	jobsRun(0),
+	jobsStolen(0),
+	parallelFors(0),
+	inlineParallelFors(0)
+{
+	unsigned int threadCount = RequestedThreadCount ? RequestedThreadCount : std::thread::hardware_concurrency();
+	unsigned int workerCount = std::max(1u, threadCount) - 1;
+
+	// One worker is always left for frame work (unless it's the only one)
+	maxBackgroundWorkers = workerCount > 1 ? workerCount - 1 : 1;
+
+	for (unsigned int i = 0; i <= workerCount; i++)
+		queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+
+	for (unsigned int i = 1; i <= workerCount; i++)
+		workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+	stopping = true;
+	WakeWorkers((unsigned int)workers.size());
+
+	for (std::thread& t : workers)
+		t.join();
+
+	// Anything the workers didn't get to (only when there are none)
+	while (RunNextJob() || RunBackgroundJob());
+}
+
+unsigned int JobSystem::GetThreadCount() const
+{
+	return (unsigned int)queues.size();
+}
+
+void JobSystem::Run(std::function<void()> function, JobCounter* counter, JobCounter* dependency)
+{
+	if (counter)
+		counter->pending++;
+
+	Job job = { std::move(function), counter };
+
+	if (dependency)
+	{
+		// Checked under the lock, so it can't reach zero in between
+		// and leave the job waiting for a release that already happened
+		std::lock_guard<std::mutex> lock(dependency->dependentLock);
+		if (dependency->pending.load() != 0)
+		{
+			dependency->dependents.push_back(std::move(job));
+			return;
+		}
+	}
+
+	Push(std::move(job));
+	WakeWorkers(1);
+}
+
+void JobSystem::Wait(JobCounter* counter)
+{
+	while (!counter->IsDone())
+	{
+		if (!RunNextJob())
+			std::this_thread::yield();
+	}
+
+	// The job that finished the count may still hold this
+	std::lock_guard<std::mutex> lock(counter->dependentLock);
+}
+
+void JobSystem::RunBackground(std::function<void()> function, JobCounter* counter)
+{
+	if (counter)
+		counter->pending++;
+
+	{
+		std::lock_guard<std::mutex> lock(backgroundLock);
+		backgroundJobs.push_back({ std::move(function), counter });
+	}
+	queuedBackgroundJobs++;
+	WakeWorkers(1);
+}
+
+bool JobSystem::RunBackgroundJob()
+{
+	Job job;
+	if (!PopBackgroundJob(job))
+		return false;
+
+	job.function();
+	jobsRun++;
+	Finish(job.counter);
+	return true;
+}
+
+void JobSystem::ParallelFor(unsigned int count, unsigned int grainSize,
+	const std::function<void(unsigned int first, unsigned int end)>& body)
+{
+	parallelFors++;
+	if (count == 0)
+		return;
+
+	grainSize = std::max(1u, grainSize);
+	if (count <= grainSize || workers.empty())
+	{
+		inlineParallelFors++;
+		body(0, count);
+		return;
+	}
+
+	// Last range pushed first, so this thread pops them in order from
+	// the back while thieves take the far end from the front
+	JobCounter counter;
+	unsigned int rangeCount = (count + grainSize - 1) / grainSize;
+	counter.pending += rangeCount - 1;
+	for (unsigned int r = rangeCount - 1; r > 0; r--)
+	{
+		unsigned int first = r * grainSize;
+		unsigned int end = std::min(count, first + grainSize);
+		Push({ [&body, first, end]() { body(first, end); }, &counter });
+	}
+	WakeWorkers(rangeCount - 1);
+
+	body(0, grainSize);
+	Wait(&counter);
+}
+
+JobSystemStats JobSystem::GetStats() const
+{
+	JobSystemStats stats;
+	stats.jobsRun = jobsRun.load();
+	stats.jobsStolen = jobsStolen.load();
+	stats.parallelFors = parallelFors.load();
+	stats.inlineParallelFors = inlineParallelFors.load();
+	return stats;
+}
+
+void JobSystem::ResetStats()
+{
+	jobsRun = 0;
+	jobsStolen = 0;
+	parallelFors = 0;
+	inlineParallelFors = 0;
+}
+
+void JobSystem::WorkerLoop(unsigned int queueIndex)
+{
+	currentQueue = queueIndex;
+	Profiler::NameCurrentThread("Job Worker " + std::to_string(queueIndex));
+
+	while (true)
+	{
+		if (RunNextJob())
+			continue;
+
+		// Frame work always goes first, background jobs only fill the gaps
+		if (ReserveBackgroundWorker())
+		{
+			bool ran = RunBackgroundJob();
+			runningBackgroundJobs--;
+			if (ran)
+				continue;
+		}
+
+		if (stopping)
+			break;
+
+		std::unique_lock<std::mutex> lock(sleepLock);
+		sleepCondition.wait(lock, [this]() { return queuedJobs.load() > 0 || HasBackgroundWork() || stopping; });
+	}
+}
+
+bool JobSystem::HasBackgroundWork() const
+{
+	return queuedBackgroundJobs.load() > 0 && runningBackgroundJobs.load() < maxBackgroundWorkers;
+}
+
+bool JobSystem::ReserveBackgroundWorker()
+{
+	unsigned int running = runningBackgroundJobs.load();
+	while (queuedBackgroundJobs.load() > 0 && running < maxBackgroundWorkers)
+	{
+		if (runningBackgroundJobs.compare_exchange_weak(running, running + 1))
+			return true;
+	}
+	return false;
+}
+
+bool JobSystem::PopBackgroundJob(Job& job)
+{
+	std::lock_guard<std::mutex> lock(backgroundLock);
+	if (backgroundJobs.empty())
+		return false;
+
+	job = std::move(backgroundJobs.front());
+	backgroundJobs.pop_front();
+	queuedBackgroundJobs--;
+	return true;
+}
+
+void JobSystem::Push(Job job)
+{
+	WorkQueue& queue = *queues[currentQueue];
+	{
+		std::lock_guard<std::mutex> lock(queue.lock);
+		queue.jobs.push_back(std::move(job));
+	}
+	queuedJobs++;
+}
+
+void JobSystem::WakeWorkers(unsigned int count)
+{
+	if (workers.empty() || count == 0)
+		return;
+
+	// A worker that just found nothing to do holds sleepLock until it's
+	// actually waiting, so taking it here means the notify can't be missed
+	{
+		std::lock_guard<std::mutex> lock(sleepLock);
+	}
+
+	if (count >= workers.size())
+		sleepCondition.notify_all();
+	else
+	{
+		for (unsigned int i = 0; i < count; i++)
+			sleepCondition.notify_one();
+	}
+}
+
+bool JobSystem::RunNextJob()
+{
+	Job job;
+	bool found = false;
+	bool stolen = false;
+
+	// Newest job of this thread's own deque
+	{
+		WorkQueue& own = *queues[currentQueue];
+		std::lock_guard<std::mutex> lock(own.lock);
+		if (!own.jobs.empty())
+		{
+			job = std::move(own.jobs.back());
+			own.jobs.pop_back();
+			found = true;
+		}
+	}
+
+	// Otherwise the oldest job of the next deque that has one
+	for (unsigned int i = 1; !found && i < queues.size(); i++)
+	{
+		WorkQueue& other = *queues[(currentQueue + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(other.lock);
+		if (!other.jobs.empty())
+		{
+			job = std::move(other.jobs.front());
+			other.jobs.pop_front();
+			found = true;
+			stolen = true;
+		}
+	}
+
+	if (!found)
+		return false;
+
+	queuedJobs--;
+	job.function();
+
+	jobsRun++;
+	if (stolen)
+		jobsStolen++;
+
+	Finish(job.counter);
+	return true;
+}
+
+void JobSystem::Finish(JobCounter* counter)
+{
+	if (!counter)
+		return;
+
+	// Lowered under the lock, which Wait() takes before returning, so
+	// the counter can't be destroyed while this is still using it
+	std::vector<Job> ready;
+	{
+		std::lock_guard<std::mutex> lock(counter->dependentLock);
+		if (--counter->pending != 0)
+			return;
+
+		// Last job of the group, so whatever depended on it can go
+		ready.swap(counter->dependents);
+	}
+
+	for (Job& job : ready)
+		Push(std::move(job));
+	WakeWorkers((unsigned int)ready.size());
+}
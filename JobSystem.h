@@ -0,0 +1,170 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobCounter;
+
+// One unit of work, and the counter it lowers when it's done
+struct Job
+{
+	std::function<void()> function;
+	JobCounter* counter;
+};
+
+// --------------------------------------------------------
+// Counts a group of unfinished jobs.  Run() raises it before
+// queueing a job and the job lowers it when it's done, so
+// zero means everything given this counter has finished.
+//
+// Jobs can also depend on a counter: they're held here and
+// only queued once it reaches zero.  A counter has to outlive
+// every job using it (usually a local, then Wait() on it).
+// --------------------------------------------------------
+class JobCounter
+{
+public:
+	JobCounter();
+
+	JobCounter(JobCounter const&) = delete;
+	void operator=(JobCounter const&) = delete;
+
+	bool IsDone() const;
+
+private:
+	friend class JobSystem;
+
+	std::atomic<unsigned int> pending;
+	std::mutex dependentLock;
+	std::vector<Job> dependents;	// Queued when pending reaches zero
+};
+
+struct JobSystemStats
+{
+	unsigned int jobsRun = 0;
+	unsigned int jobsStolen = 0;	// Run by a thread other than the one that queued them
+	unsigned int parallelFors = 0;
+	unsigned int inlineParallelFors = 0;	// Too small to split, run on the caller
+};
+
+// --------------------------------------------------------
+// Runs small jobs on a pool of worker threads, started once
+// instead of every time something wants to go wide.
+//
+// Every thread has its own job deque.  A thread pushes and
+// pops at the back of its own (newest first, while the data
+// is still in cache) and, when it's empty, steals from the
+// front of another thread's (oldest first, usually the
+// biggest piece of what's left).  Threads outside the pool
+// share queue 0, and help run jobs while they Wait().
+//
+// Workers sleep when every deque is empty.
+//
+// Background jobs (long, not needed this frame, like asset
+// decoding) wait in their own queue.  Only workers take them,
+// once every deque is empty, and never more than all but one
+// worker at a time, so a thread that Wait()s on frame work
+// never ends up running one.
+// --------------------------------------------------------
+class JobSystem
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static JobSystem& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new JobSystem();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	JobSystem(JobSystem const&) = delete;
+	void operator=(JobSystem const&) = delete;
+
+private:
+	static JobSystem* instance;
+	JobSystem();
+#pragma endregion
+
+public:
+	~JobSystem();	// Finishes queued jobs, then stops the workers
+
+	// Threads to start with (workers plus the calling thread), 0 for one
+	// per hardware thread.  Only read when the instance is first created.
+	static unsigned int RequestedThreadCount;
+
+	// Workers plus the thread(s) that queue jobs from outside
+	unsigned int GetThreadCount() const;
+
+	// Queues a job, which lowers counter (if any) when it's done.  With a
+	// dependency, the job is held until that counter reaches zero.
+	void Run(std::function<void()> function, JobCounter* counter = 0, JobCounter* dependency = 0);
+
+	// Runs other jobs until the counter reaches zero
+	void Wait(JobCounter* counter);
+
+	// Runs one queued job on the calling thread, for threads waiting on
+	// something other than a counter.  False if every queue was empty.
+	bool RunNextJob();
+
+	// Queues a background job, which lowers counter (if any) when it's done
+	void RunBackground(std::function<void()> function, JobCounter* counter = 0);
+
+	// Runs one background job on the calling thread, for whoever is waiting
+	// on them (or when there are no workers).  False if there were none.
+	bool RunBackgroundJob();
+
+	// Calls body(first, end) over [0, count) in ranges of grainSize,
+	// spread over every thread, and returns when all of them are done.
+	// A count of grainSize or less just runs on the calling thread.
+	void ParallelFor(unsigned int count, unsigned int grainSize,
+		const std::function<void(unsigned int first, unsigned int end)>& body);
+
+	// Since the last ResetStats()
+	JobSystemStats GetStats() const;
+	void ResetStats();
+
+private:
+	struct WorkQueue
+	{
+		std::mutex lock;
+		std::deque<Job> jobs;
+	};
+
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<WorkQueue>> queues;	// Queue 0 is for threads outside the pool
+
+	std::mutex sleepLock;
+	std::condition_variable sleepCondition;
+	std::atomic<unsigned int> queuedJobs;
+	std::atomic<bool> stopping;
+
+	std::mutex backgroundLock;
+	std::deque<Job> backgroundJobs;
+	std::atomic<unsigned int> queuedBackgroundJobs;
+	std::atomic<unsigned int> runningBackgroundJobs;	// On workers
+	unsigned int maxBackgroundWorkers;
+
+	std::atomic<unsigned int> jobsRun;
+	std::atomic<unsigned int> jobsStolen;
+	std::atomic<unsigned int> parallelFors;
+	std::atomic<unsigned int> inlineParallelFors;
+
+	void WorkerLoop(unsigned int queueIndex);
+	bool HasBackgroundWork() const;	// For a worker: something queued, and room to run it
+	bool ReserveBackgroundWorker();	// Counts the caller as running one, if there's room
+	bool PopBackgroundJob(Job& job);
+	void Push(Job job);
+	void WakeWorkers(unsigned int count);
+	void Finish(JobCounter* counter);
+};
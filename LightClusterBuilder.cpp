@@ -0,0 +1,255 @@
+#include "LightClusterBuilder.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace DirectX;
+
+LightClusterBuilder::LightClusterBuilder() :
+	directionalCount(0),
+	sliceScale(0.0f),
+	sliceBias(0.0f)
+{
+	clusters.resize(LIGHT_CLUSTER_COUNT);
+	sliceIndices.resize(LIGHT_CLUSTERS_Z);
+}
+
+void LightClusterBuilder::Build(const std::vector<Light>& sceneLights,
+	const XMFLOAT4X4& view, const XMFLOAT4X4& projection,
+	float nearClip, float farClip)
+{
+	PROFILE_SCOPE("Build Light Clusters");
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Directional lights first, so the shader can loop over them
+	// without any indices, then everything that gets binned
+	lights.clear();
+	for (const Light& l : sceneLights)
+	{
+		if (l.Type == LIGHT_TYPE_DIRECTIONAL)
+			lights.push_back(l);
+	}
+	directionalCount = (unsigned int)lights.size();
+	for (const Light& l : sceneLights)
+	{
+		if (l.Type != LIGHT_TYPE_DIRECTIONAL)
+			lights.push_back(l);
+	}
+
+	// slice = Z * log(depth / near) / log(far / near)
+	float logDepthRange = logf(farClip / nearClip);
+	sliceScale = LIGHT_CLUSTERS_Z / logDepthRange;
+	sliceBias = -LIGHT_CLUSTERS_Z * logf(nearClip) / logDepthRange;
+
+	unsigned int binned = (unsigned int)lights.size() - directionalCount;
+	bounds.resize(binned);
+
+	// Bounds in runs of lights, then one job per depth slice (binning
+	// walks every light's bounds, so with few lights it stays on one thread)
+	JobSystem& jobs = JobSystem::GetInstance();
+	jobs.ParallelFor(binned, 256, [&](unsigned int first, unsigned int end)
+	{
+		PROFILE_SCOPE("Light Bounds");
+		ComputeBounds(first, end, view, projection, nearClip, farClip);
+	});
+	jobs.ParallelFor(LIGHT_CLUSTERS_Z, binned < 256 ? LIGHT_CLUSTERS_Z : 1, [this](unsigned int first, unsigned int end)
+	{
+		PROFILE_SCOPE("Bin Light Slices");
+		for (unsigned int s = first; s < end; s++)
+			BinSlice(s);
+	});
+
+	// Join the slices' lists, moving each cluster's offset along with them
+	indices.clear();
+	stats.maxLightsPerCluster = 0;
+	for (unsigned int s = 0; s < LIGHT_CLUSTERS_Z; s++)
+	{
+		unsigned int base = (unsigned int)indices.size();
+		for (unsigned int c = s * LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y; c < (s + 1) * LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y; c++)
+		{
+			clusters[c].offset += base;
+			stats.maxLightsPerCluster = std::max(stats.maxLightsPerCluster, clusters[c].count);
+		}
+		indices.insert(indices.end(), sliceIndices[s].begin(), sliceIndices[s].end());
+	}
+
+	stats.directionalLights = directionalCount;
+	stats.clusteredLights = 0;
+	for (const LightBounds& b : bounds)
+	{
+		if (b.minZ <= b.maxZ)
+			stats.clusteredLights++;
+	}
+	stats.culledLights = binned - stats.clusteredLights;
+	stats.indices = (unsigned int)indices.size();
+
+	std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	stats.buildMilliseconds = elapsed.count();
+}
+
+// Finds the clusters covered by each light's sphere: depth slices from its
+// view-space depth range, tiles from the screen rectangle its view-space
+// box projects to (for perspective, the box corners bound the projection
+// when they're all in front of the near plane)
+void LightClusterBuilder::ComputeBounds(unsigned int first, unsigned int end,
+	const XMFLOAT4X4& view, const XMFLOAT4X4& projection,
+	float nearClip, float farClip)
+{
+	XMMATRIX viewMatrix = XMLoadFloat4x4(&view);
+	XMVECTOR scaleX = XMVectorReplicate(projection._11);
+	XMVECTOR scaleY = XMVectorReplicate(projection._22);
+	bool orthographic = projection._34 == 0.0f;	// No perspective divide
+
+	for (unsigned int i = first; i < end; i++)
+	{
+		const Light& light = lights[directionalCount + i];
+		LightBounds& b = bounds[i];
+
+		XMFLOAT3 center;
+		XMStoreFloat3(&center, XMVector3Transform(XMLoadFloat3(&light.Position), viewMatrix));
+		float r = light.Range;
+
+		float nearZ = center.z - r;
+		float farZ = center.z + r;
+		if (farZ < nearClip || nearZ > farClip)
+		{
+			b = { 0, -1, 0, -1, 0, -1 };
+			continue;
+		}
+
+		b.minZ = GetSlice(std::max(nearZ, nearClip));
+		b.maxZ = GetSlice(std::min(farZ, farClip));
+
+		float minX, maxX, minY, maxY;
+		if (orthographic)
+		{
+			minX = (center.x - r) * projection._11 + projection._41;
+			maxX = (center.x + r) * projection._11 + projection._41;
+			minY = (center.y - r) * projection._22 + projection._42;
+			maxY = (center.y + r) * projection._22 + projection._42;
+		}
+		else if (nearZ <= nearClip)
+		{
+			// Crossing the near plane can cover any part of the screen
+			b.minX = 0;
+			b.maxX = LIGHT_CLUSTERS_X - 1;
+			b.minY = 0;
+			b.maxY = LIGHT_CLUSTERS_Y - 1;
+			continue;
+		}
+		else
+		{
+			// All four (x, z) and (y, z) corner combinations at once
+			XMVECTOR depths = XMVectorSet(nearZ, nearZ, farZ, farZ);
+			XMVECTOR ndcX = XMVectorMultiply(XMVectorDivide(XMVectorSet(center.x - r, center.x + r, center.x - r, center.x + r), depths), scaleX);
+			XMVECTOR ndcY = XMVectorMultiply(XMVectorDivide(XMVectorSet(center.y - r, center.y + r, center.y - r, center.y + r), depths), scaleY);
+			XMFLOAT4 x, y;
+			XMStoreFloat4(&x, ndcX);
+			XMStoreFloat4(&y, ndcY);
+			minX = std::min(std::min(x.x, x.y), std::min(x.z, x.w));
+			maxX = std::max(std::max(x.x, x.y), std::max(x.z, x.w));
+			minY = std::min(std::min(y.x, y.y), std::min(y.z, y.w));
+			maxY = std::max(std::max(y.x, y.y), std::max(y.z, y.w));
+		}
+
+		if (minX > 1.0f || maxX < -1.0f || minY > 1.0f || maxY < -1.0f)
+		{
+			b = { 0, -1, 0, -1, 0, -1 };
+			continue;
+		}
+
+		// NDC to tiles (screen y points down)
+		b.minX = std::max(0, (int)floorf((minX * 0.5f + 0.5f) * LIGHT_CLUSTERS_X));
+		b.maxX = std::min(LIGHT_CLUSTERS_X - 1, (int)floorf((maxX * 0.5f + 0.5f) * LIGHT_CLUSTERS_X));
+		b.minY = std::max(0, (int)floorf((0.5f - maxY * 0.5f) * LIGHT_CLUSTERS_Y));
+		b.maxY = std::min(LIGHT_CLUSTERS_Y - 1, (int)floorf((0.5f - minY * 0.5f) * LIGHT_CLUSTERS_Y));
+	}
+}
+
+// Counts, then fills, the light lists of one depth slice.  Offsets are
+// relative to the slice until Build() joins them.
+void LightClusterBuilder::BinSlice(unsigned int slice)
+{
+	LightCluster* sliceClusters = &clusters[slice * LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y];
+	for (unsigned int c = 0; c < LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y; c++)
+		sliceClusters[c] = { 0, 0 };
+
+	int s = (int)slice;
+	for (const LightBounds& b : bounds)
+	{
+		if (s < b.minZ || s > b.maxZ)
+			continue;
+
+		for (int y = b.minY; y <= b.maxY; y++)
+			for (int x = b.minX; x <= b.maxX; x++)
+				sliceClusters[y * LIGHT_CLUSTERS_X + x].count++;
+	}
+
+	unsigned int total = 0;
+	for (unsigned int c = 0; c < LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y; c++)
+	{
+		sliceClusters[c].offset = total;
+		total += sliceClusters[c].count;
+		sliceClusters[c].count = 0;
+	}
+
+	std::vector<unsigned int>& list = sliceIndices[slice];
+	list.resize(total);
+	for (unsigned int i = 0; i < bounds.size(); i++)
+	{
+		const LightBounds& b = bounds[i];
+		if (s < b.minZ || s > b.maxZ)
+			continue;
+
+		for (int y = b.minY; y <= b.maxY; y++)
+			for (int x = b.minX; x <= b.maxX; x++)
+			{
+				LightCluster& c = sliceClusters[y * LIGHT_CLUSTERS_X + x];
+				list[c.offset + c.count] = directionalCount + i;
+				c.count++;
+			}
+	}
+}
+
+int LightClusterBuilder::GetSlice(float depth) const
+{
+	int slice = (int)floorf(logf(depth) * sliceScale + sliceBias);
+	return std::max(0, std::min(LIGHT_CLUSTERS_Z - 1, slice));
+}
+
+const std::vector<Light>& LightClusterBuilder::GetLights() const
+{
+	return lights;
+}
+
+unsigned int LightClusterBuilder::GetDirectionalLightCount() const
+{
+	return directionalCount;
+}
+
+const std::vector<LightCluster>& LightClusterBuilder::GetClusters() const
+{
+	return clusters;
+}
+
+const std::vector<unsigned int>& LightClusterBuilder::GetLightIndices() const
+{
+	return indices;
+}
+
+LightClusterStats LightClusterBuilder::GetStats() const
+{
+	return stats;
+}
+
+float LightClusterBuilder::GetSliceScale() const
+{
+	return sliceScale;
+}
+
+float LightClusterBuilder::GetSliceBias() const
+{
+	return sliceBias;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Lights.h"
+
+// Cluster grid: tiles across the screen and exponential depth slices
+// from the near to the far plane (must match PixelShader.hlsl)
+#define LIGHT_CLUSTERS_X 16
+#define LIGHT_CLUSTERS_Y 9
+#define LIGHT_CLUSTERS_Z 24
+#define LIGHT_CLUSTER_COUNT (LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z)
+
+// Where one cluster's lights are in the index list (a uint2 in the shader)
+struct LightCluster
+{
+	unsigned int offset;
+	unsigned int count;
+};
+
+struct LightClusterStats
+{
+	unsigned int directionalLights = 0;
+	unsigned int clusteredLights = 0;	// Point/spot lights in at least one cluster
+	unsigned int culledLights = 0;		// Point/spot lights outside the frustum
+	unsigned int indices = 0;
+	unsigned int maxLightsPerCluster = 0;
+	float buildMilliseconds = 0.0f;
+};
+
+// --------------------------------------------------------
+// Bins point and spot lights into a froxel grid of the
+// camera frustum on the CPU.
+//
+// The output is three arrays for the GPU:
+//  - lights: directional lights first (always evaluated),
+//    then every point/spot light
+//  - clusters: an (offset, count) range per cluster
+//  - indices: the light list of each cluster, back to back
+//
+// A pixel finds its cluster from its screen position and
+// view depth, and only evaluates the lights in that range.
+// Lights are bounded by their Range sphere (conservative
+// for spot lights).  Depth slices are split between the
+// JobSystem's threads, so each job writes only its own clusters.
+// --------------------------------------------------------
+class LightClusterBuilder
+{
+public:
+	LightClusterBuilder();
+
+	// Projection can be perspective or orthographic, from nearClip to farClip
+	void Build(const std::vector<Light>& sceneLights,
+		const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection,
+		float nearClip, float farClip);
+
+	const std::vector<Light>& GetLights() const;
+	unsigned int GetDirectionalLightCount() const;
+	const std::vector<LightCluster>& GetClusters() const;
+	const std::vector<unsigned int>& GetLightIndices() const;
+	LightClusterStats GetStats() const;
+
+	// Slice of a view depth in the shader: log(depth) * scale + bias
+	float GetSliceScale() const;
+	float GetSliceBias() const;
+
+private:
+	// Inclusive cluster ranges a light touches (empty if minZ > maxZ)
+	struct LightBounds
+	{
+		int minX, maxX;
+		int minY, maxY;
+		int minZ, maxZ;
+	};
+
+	unsigned int directionalCount;
+	float sliceScale;
+	float sliceBias;
+
+	std::vector<Light> lights;
+	std::vector<LightBounds> bounds;	// One per light after the directional ones
+	std::vector<LightCluster> clusters;
+	std::vector<unsigned int> indices;
+	std::vector<std::vector<unsigned int>> sliceIndices;	// Per depth slice, before they're joined
+	LightClusterStats stats;
+
+	void ComputeBounds(unsigned int first, unsigned int end,
+		const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection,
+		float nearClip, float farClip);
+	void BinSlice(unsigned int slice);
+	int GetSlice(float depth) const;
+};
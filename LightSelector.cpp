@@ -0,0 +1,197 @@
+#include "LightSelector.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+LightSelector::LightSelector() :
+	minCellSize(4.0f),
+	cellSize(4.0f),
+	gridMin(0.0f, 0.0f, 0.0f),
+	lights(0),
+	selections(0),
+	lightsTested(0)
+{
+	cellCounts[0] = cellCounts[1] = cellCounts[2] = 0;
+}
+
+void LightSelector::SetCellSize(float size)
+{
+	minCellSize = size > 0.0f ? size : minCellSize;
+}
+
+void LightSelector::Build(const std::vector<Light>& lights, unsigned int firstLight)
+{
+	this->lights = &lights;
+	selections = 0;
+	lightsTested = 0;
+	cellStarts.clear();
+	cellLights.clear();
+	cellCounts[0] = cellCounts[1] = cellCounts[2] = 0;
+
+	if (firstLight >= lights.size())
+		return;
+
+	// Grid covers every light's sphere
+	XMFLOAT3 boundsMin = lights[firstLight].Position;
+	XMFLOAT3 boundsMax = lights[firstLight].Position;
+	for (unsigned int i = firstLight; i < lights.size(); i++)
+	{
+		const Light& l = lights[i];
+		boundsMin = XMFLOAT3(std::min(boundsMin.x, l.Position.x - l.Range), std::min(boundsMin.y, l.Position.y - l.Range), std::min(boundsMin.z, l.Position.z - l.Range));
+		boundsMax = XMFLOAT3(std::max(boundsMax.x, l.Position.x + l.Range), std::max(boundsMax.y, l.Position.y + l.Range), std::max(boundsMax.z, l.Position.z + l.Range));
+	}
+
+	float size[3] = { boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z };
+	float largest = std::max(size[0], std::max(size[1], size[2]));
+	cellSize = std::max(minCellSize, largest / LIGHT_SELECTOR_MAX_CELLS);
+	gridMin = boundsMin;
+	for (int a = 0; a < 3; a++)
+		cellCounts[a] = std::max(1, std::min(LIGHT_SELECTOR_MAX_CELLS, (int)ceilf(size[a] / cellSize)));
+
+	// Count, then place, each light in the cells its sphere's box overlaps
+	cellStarts.assign(cellCounts[0] * cellCounts[1] * cellCounts[2] + 1, 0);
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (unsigned int i = firstLight; i < lights.size(); i++)
+		{
+			const Light& l = lights[i];
+			int cellMin[3], cellMax[3];
+			GetCellRange(
+				XMFLOAT3(l.Position.x - l.Range, l.Position.y - l.Range, l.Position.z - l.Range),
+				XMFLOAT3(l.Position.x + l.Range, l.Position.y + l.Range, l.Position.z + l.Range),
+				cellMin, cellMax);
+
+			for (int z = cellMin[2]; z <= cellMax[2]; z++)
+				for (int y = cellMin[1]; y <= cellMax[1]; y++)
+					for (int x = cellMin[0]; x <= cellMax[0]; x++)
+					{
+						unsigned int cell = (z * cellCounts[1] + y) * cellCounts[0] + x;
+						if (pass == 0)
+							cellStarts[cell + 1]++;
+						else
+							cellLights[cellStarts[cell]++] = i;
+					}
+		}
+
+		if (pass == 0)
+		{
+			for (unsigned int c = 1; c < cellStarts.size(); c++)
+				cellStarts[c] += cellStarts[c - 1];
+			cellLights.resize(cellStarts.back());
+		}
+	}
+
+	// Filling moved every start up to the next cell's, so shift them back
+	for (unsigned int c = (unsigned int)cellStarts.size() - 1; c > 0; c--)
+		cellStarts[c] = cellStarts[c - 1];
+	cellStarts[0] = 0;
+}
+
+unsigned int LightSelector::Select(const XMFLOAT3& center, const XMFLOAT3& extents,
+	unsigned int* indices, unsigned int maxLights)
+{
+	unsigned int count = Select(center, extents, indices, maxLights, mainScratch);
+	MergeStats(mainScratch);
+	return count;
+}
+
+unsigned int LightSelector::Select(const XMFLOAT3& center, const XMFLOAT3& extents,
+	unsigned int* indices, unsigned int maxLights, LightSelectorScratch& scratch) const
+{
+	if (cellLights.empty() || maxLights == 0)
+		return 0;
+
+	scratch.selections++;
+	if (scratch.visitedStamps.size() < lights->size())
+		scratch.visitedStamps.resize(lights->size(), scratch.stamp);
+
+	XMFLOAT3 boxMin(center.x - extents.x, center.y - extents.y, center.z - extents.z);
+	XMFLOAT3 boxMax(center.x + extents.x, center.y + extents.y, center.z + extents.z);
+	int cellMin[3], cellMax[3];
+	GetCellRange(boxMin, boxMax, cellMin, cellMax);
+
+	// New stamp marks every light as unvisited for this query
+	if (++scratch.stamp == 0)
+	{
+		std::fill(scratch.visitedStamps.begin(), scratch.visitedStamps.end(), 0);
+		scratch.stamp = 1;
+	}
+
+	float scores[MAX_OBJECT_LIGHTS];
+	unsigned int count = 0;
+	maxLights = std::min(maxLights, (unsigned int)MAX_OBJECT_LIGHTS);
+
+	for (int z = cellMin[2]; z <= cellMax[2]; z++)
+		for (int y = cellMin[1]; y <= cellMax[1]; y++)
+			for (int x = cellMin[0]; x <= cellMax[0]; x++)
+			{
+				unsigned int cell = (z * cellCounts[1] + y) * cellCounts[0] + x;
+				for (unsigned int e = cellStarts[cell]; e < cellStarts[cell + 1]; e++)
+				{
+					unsigned int i = cellLights[e];
+					if (scratch.visitedStamps[i] == scratch.stamp)
+						continue;
+					scratch.visitedStamps[i] = scratch.stamp;
+					scratch.lightsTested++;
+
+					// Squared distance from the light to the closest point of the box
+					const Light& l = (*lights)[i];
+					float dx = std::max(0.0f, std::max(boxMin.x - l.Position.x, l.Position.x - boxMax.x));
+					float dy = std::max(0.0f, std::max(boxMin.y - l.Position.y, l.Position.y - boxMax.y));
+					float dz = std::max(0.0f, std::max(boxMin.z - l.Position.z, l.Position.z - boxMax.z));
+					float distSq = dx * dx + dy * dy + dz * dz;
+					float rangeSq = l.Range * l.Range;
+					if (distSq >= rangeSq)
+						continue;
+
+					// Same falloff as Attenuate() in ShaderIncludes.hlsli
+					float att = 1.0f - distSq / rangeSq;
+					float score = att * att * l.Intensity * std::max(l.Color.x, std::max(l.Color.y, l.Color.z));
+					if (count == maxLights && score <= scores[count - 1])
+						continue;
+
+					// Insert into the sorted list, dropping the weakest if it's full
+					unsigned int slot = count < maxLights ? count++ : count - 1;
+					while (slot > 0 && scores[slot - 1] < score)
+					{
+						scores[slot] = scores[slot - 1];
+						indices[slot] = indices[slot - 1];
+						slot--;
+					}
+					scores[slot] = score;
+					indices[slot] = i;
+				}
+			}
+
+	return count;
+}
+
+void LightSelector::MergeStats(LightSelectorScratch& scratch)
+{
+	selections += scratch.selections;
+	lightsTested += scratch.lightsTested;
+	scratch.selections = 0;
+	scratch.lightsTested = 0;
+}
+
+unsigned int LightSelector::GetSelectionCount() const
+{
+	return selections;
+}
+
+unsigned int LightSelector::GetLightsTested() const
+{
+	return lightsTested;
+}
+
+void LightSelector::GetCellRange(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax, int cellMin[3], int cellMax[3]) const
+{
+	float low[3] = { boxMin.x - gridMin.x, boxMin.y - gridMin.y, boxMin.z - gridMin.z };
+	float high[3] = { boxMax.x - gridMin.x, boxMax.y - gridMin.y, boxMax.z - gridMin.z };
+	for (int a = 0; a < 3; a++)
+	{
+		cellMin[a] = std::max(0, std::min(cellCounts[a] - 1, (int)floorf(low[a] / cellSize)));
+		cellMax[a] = std::max(0, std::min(cellCounts[a] - 1, (int)floorf(high[a] / cellSize)));
+	}
+}
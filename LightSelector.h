@@ -0,0 +1,85 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Lights.h"
+
+// Most point/spot lights one object is lit by (must match PixelShader.hlsl)
+#define MAX_OBJECT_LIGHTS 8
+
+// Cells per axis, the cell size grows when the lights spread further
+#define LIGHT_SELECTOR_MAX_CELLS 32
+
+// --------------------------------------------------------
+// Per-thread state for Select(), so several jobs can query
+// one LightSelector at once without sharing visited marks.
+// Its counts are added to the selector's by MergeStats().
+// --------------------------------------------------------
+struct LightSelectorScratch
+{
+	std::vector<unsigned int> visitedStamps;	// Per light, so one in several cells is only scored once
+	unsigned int stamp = 0;
+	unsigned int selections = 0;
+	unsigned int lightsTested = 0;
+};
+
+// --------------------------------------------------------
+// Picks the few lights that matter most to an object, so a
+// forward-rendered draw has a bounded light count no matter
+// how many lights the level has.
+//
+// Point and spot lights go into a uniform grid of world
+// space cells, each light in every cell its Range sphere
+// touches.  A query only visits the cells under an object's
+// box, so its cost depends on the lights near the object
+// rather than on the total.  Candidates are ranked by
+// intensity, brightest color channel and the shader's
+// Attenuate() falloff at the closest point of the box.
+// Spot lights are treated like point lights of the same
+// range, which never drops a light that could reach.
+// --------------------------------------------------------
+class LightSelector
+{
+public:
+	LightSelector();
+
+	// Smallest cell edge length, in world units
+	void SetCellSize(float size);
+
+	// Grids every light from firstLight on (the ones before are
+	// usually directional and lit everything anyway)
+	void Build(const std::vector<Light>& lights, unsigned int firstLight);
+
+	// Writes the indices (into Build()'s vector) of up to maxLights
+	// lights reaching the box, most relevant first, and returns how many
+	unsigned int Select(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents,
+		unsigned int* indices, unsigned int maxLights);
+
+	// The same, but only touching scratch, so it's safe from any number
+	// of threads at once as long as each brings its own
+	unsigned int Select(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents,
+		unsigned int* indices, unsigned int maxLights, LightSelectorScratch& scratch) const;
+
+	// Adds (and clears) the counts of a scratch used since the last Build()
+	void MergeStats(LightSelectorScratch& scratch);
+
+	// Since the last Build()
+	unsigned int GetSelectionCount() const;
+	unsigned int GetLightsTested() const;	// Candidates scored over all selections
+
+private:
+	float minCellSize;
+	float cellSize;
+	DirectX::XMFLOAT3 gridMin;
+	int cellCounts[3];
+
+	const std::vector<Light>* lights;
+	std::vector<unsigned int> cellStarts;	// Each cell's first entry in cellLights (plus one past the end)
+	std::vector<unsigned int> cellLights;
+	LightSelectorScratch mainScratch;	// For the single-threaded Select()
+
+	unsigned int selections;
+	unsigned int lightsTested;
+
+	void GetCellRange(const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax, int cellMin[3], int cellMax[3]) const;
+};
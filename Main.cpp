@@ -1,6 +1,7 @@
 
 #include <Windows.h>
 #include "Game.h"
+#include <cstring>
 
 // --------------------------------------------------------
 // Entry point for a graphical (non-console) Windows application
@@ -18,6 +19,11 @@ int WINAPI WinMain(
 	_CrtSetDbgFlag( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
 #endif
 
+	// -dynamiccb creates every shader's constant buffers as DYNAMIC and
+	// uploads them with Map(WRITE_DISCARD), so it's set before anything loads
+	if (strstr(lpCmdLine, "-dynamiccb"))
+		ISimpleShader::UseDynamicConstantBuffers = true;
+
 	// Create the Game object using
 	// the app handle we got from WinMain
 	Game dxGame(hInstance);
@@ -7,7 +7,7 @@ Material::Material(DirectX::XMFLOAT4 colorTint, std::shared_ptr<SimplePixelShade
 	pixelShader(pixelShader),
 	vertexShader(vertexShader)
 {
-
+	ResolveHandles();
 }
 
 DirectX::XMFLOAT4 Material::GetColorTint()
@@ -33,21 +33,45 @@ void Material::SetColorTint(DirectX::XMFLOAT4 colorTint)
 void Material::SetPixelShader(std::shared_ptr<SimplePixelShader> pixelShader)
 {
 	this->pixelShader = pixelShader;
+	ResolveHandles();
 }
 
 void Material::SetVertexShader(std::shared_ptr<SimpleVertexShader> vertexShader)
 {
 	this->vertexShader = vertexShader;
+	ResolveHandles();
 }
 
 void Material::AddTextureSRV(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> textureSRV)
 {
-	textureSRVs.insert({ name, textureSRV });
+	for (auto& t : textureSRVs) { if (t.name == name) return; }
+	textureSRVs.push_back({ name, pixelShader->GetShaderResourceViewHandle(name), textureSRV });
+}
+
+void Material::SetTextureSRV(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> textureSRV)
+{
+	for (auto& t : textureSRVs) { if (t.name == name) { t.resource = textureSRV; return; } }
+	textureSRVs.push_back({ name, pixelShader->GetShaderResourceViewHandle(name), textureSRV });
 }
 
 void Material::AddSampler(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler)
 {
-	samplers.insert({ name, sampler });
+	for (auto& s : samplers) { if (s.name == name) return; }
+	samplers.push_back({ name, pixelShader->GetSamplerHandle(name), sampler });
+}
+
+void Material::ResolveHandles()
+{
+	colorTintHandle = pixelShader->GetVariableHandle("colorTint");
+	useGammaCorrectionHandle = pixelShader->GetVariableHandle("useGammaCorrection");
+	objectLightNumHandle = pixelShader->GetVariableHandle("objectLightNum");
+	objectLightsHandle = pixelShader->GetVariableHandle("objectLights");
+	worldMatrixHandle = vertexShader->GetVariableHandle("worldMatrix");
+	worldInvTransposeHandle = vertexShader->GetVariableHandle("worldInvTranspose");
+	objectTintHandle = vertexShader->GetVariableHandle("objectTint");
+
+	for (auto& t : textureSRVs) { t.handle = pixelShader->GetShaderResourceViewHandle(t.name); }
+	for (auto& s : samplers) { s.handle = pixelShader->GetSamplerHandle(s.name); }
 }
 
 float Material::Clamp(float val)
@@ -55,13 +79,35 @@ float Material::Clamp(float val)
 	return val < 0.0f ? 0.0f : val > 1.0f ? 1.0f : val;
 }
 
-void Material::SetLights(std::string name, const void* data, unsigned int size)
+void Material::SetTextureData()
 {
-	pixelShader->SetData(name, data, size);
+	for (auto& t : textureSRVs) { pixelShader->SetShaderResourceView(t.handle, t.resource.Get()); }
+	for (auto& s : samplers) { pixelShader->SetSamplerState(s.handle, s.resource.Get()); }
 }
 
-void Material::SetTextureData()
+void Material::SetMaterialData()
+{
+	pixelShader->SetFloat4(colorTintHandle, colorTint);
+	SetTextureData();
+}
+
+void Material::SetObjectData(const DirectX::XMFLOAT4X4& worldMatrix, const DirectX::XMFLOAT4X4& worldInvTranspose, const DirectX::XMFLOAT4& objectTint, bool useGammaCorrection)
+{
+	vertexShader->SetMatrix4x4(worldMatrixHandle, worldMatrix);
+	vertexShader->SetMatrix4x4(worldInvTransposeHandle, worldInvTranspose);
+	vertexShader->SetFloat4(objectTintHandle, objectTint);
+	SetGammaCorrection(useGammaCorrection);
+}
+
+void Material::SetGammaCorrection(bool useGammaCorrection)
+{
+	pixelShader->SetInt(useGammaCorrectionHandle, useGammaCorrection ? 1 : 0);
+}
+
+// The indices are packed four to a uint4 in the shader, so they're contiguous
+void Material::SetObjectLights(const unsigned int* indices, int count)
 {
-	for (auto& t : textureSRVs) { pixelShader->SetShaderResourceView(t.first.c_str(), t.second); }
-	for (auto& s : samplers) { pixelShader->SetSamplerState(s.first.c_str(), s.second.Get()); }
+	pixelShader->SetInt(objectLightNumHandle, count);
+	if (count > 0)
+		pixelShader->SetData(objectLightsHandle, indices, sizeof(unsigned int) * count);
 }
\ No newline at end of file
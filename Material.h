@@ -2,14 +2,35 @@
 #include <memory>
 #include "SimpleShader.h"
 #pragma once
+
+// A texture or sampler with its register in the pixel shader,
+// so binding it doesn't need a name lookup
+template <typename T>
+struct MaterialResource
+{
+	std::string name;
+	SimpleResourceHandle handle;
+	Microsoft::WRL::ComPtr<T> resource;
+};
+
 class Material
 {
 private:
 	DirectX::XMFLOAT4 colorTint;
 	std::shared_ptr<SimplePixelShader> pixelShader;
 	std::shared_ptr<SimpleVertexShader> vertexShader;
-	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textureSRVs;
-	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>> samplers;
+	std::vector<MaterialResource<ID3D11ShaderResourceView>> textureSRVs;
+	std::vector<MaterialResource<ID3D11SamplerState>> samplers;
+
+	// Looked up whenever a shader changes, used every draw
+	SimpleVariableHandle colorTintHandle;
+	SimpleVariableHandle worldMatrixHandle;
+	SimpleVariableHandle worldInvTransposeHandle;
+	SimpleVariableHandle objectTintHandle;
+	SimpleVariableHandle useGammaCorrectionHandle;
+	SimpleVariableHandle objectLightNumHandle;
+	SimpleVariableHandle objectLightsHandle;
+	void ResolveHandles();
 
 	float Clamp(float val);
 public:
@@ -26,8 +47,14 @@ public:
 	void SetVertexShader(std::shared_ptr<SimpleVertexShader> vertexShader);
 	
 	void AddTextureSRV(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> textureSRV);
+	void SetTextureSRV(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> textureSRV); // Replaces one added before, or adds it
 	void AddSampler(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler);
-	void SetLights(std::string name, const void* data, unsigned int size);
 	void SetTextureData();
+
+	// Per-draw data, set through handles (buffers still need copying after)
+	void SetMaterialData();	// Tint and textures
+	void SetObjectData(const DirectX::XMFLOAT4X4& worldMatrix, const DirectX::XMFLOAT4X4& worldInvTranspose, const DirectX::XMFLOAT4& objectTint, bool useGammaCorrection);
+	void SetGammaCorrection(bool useGammaCorrection); // The only per-object value instanced draws still need
+	void SetObjectLights(const unsigned int* indices, int count); // count < 0 lights by cluster instead
 };
 
@@ -3,7 +3,12 @@
 #include <wrl/client.h>
 #include "Mesh.h"
 #include "Vertex.h"
-#include <fstream>
+#include "ObjParser.h"
+#include "MeshOptimizer.h"
+#include "MeshCache.h"
+#include "MeshTangents.h"
+#include "RenderStateCache.h"
+#include <chrono>
 
 using namespace DirectX;
 
@@ -17,303 +22,177 @@ Mesh::Mesh(Vertex* vertexObjects,
 {
 	this->context = context;
 	this->indexCount = indexCount;
-
+	this->vertexCount = vertexCount;
+	this->importStats = {};
+	this->cacheStats = {};
+	this->boundsMin = XMFLOAT3(0, 0, 0);
+	this->boundsMax = XMFLOAT3(0, 0, 0);
+	this->boundsRadius = 0.0f;
+
+	CalculateMeshBounds(vertexObjects, vertexCount, boundsMin, boundsMax, boundsRadius);
 	CalculateTangents(vertexObjects, vertexCount, indices, indexCount);
 	CreateVertexAndIndexBuffer(device, vertexObjects, vertexCount, indices);
 }
 
-Mesh::Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const char* fileName)
+Mesh::Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const char* fileName, bool optimize)
 {
-	std::ifstream obj(fileName);
+	this->context = context;
+	this->indexCount = 0;
+	this->vertexCount = 0;
+	this->importStats = {};
+	this->cacheStats = {};
+	this->boundsMin = XMFLOAT3(0, 0, 0);
+	this->boundsMax = XMFLOAT3(0, 0, 0);
+	this->boundsRadius = 0.0f;
+
+	MeshImportData data;
+	if (Import(fileName, optimize, data))
+		SetImportData(device, data);
+}
 
+Mesh::Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const MeshImportData& data)
+{
 	this->context = context;
+	SetImportData(device, data);
+}
 
-	// Check for successful open
-	if (!obj.is_open())
-		return;
-
-	// Variables used while reading the file
-	std::vector<DirectX::XMFLOAT3> positions;	// Positions from the file
-	std::vector<DirectX::XMFLOAT3> normals;		// Normals from the file
-	std::vector<DirectX::XMFLOAT2> uvs;		// UVs from the file
-	std::vector<Vertex> verts;		// Verts we're assembling
-	std::vector<UINT> indices;		// Indices of these verts
-	int vertCounter = 0;			// Count of vertices
-	int indexCounter = 0;			// Count of indices
-	char chars[100];			// String for line reading
-
-	// Still have data left?
-	while (obj.good())
-	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
+void Mesh::SetImportData(Microsoft::WRL::ComPtr<ID3D11Device> device, const MeshImportData& data)
+{
+	this->vertexCount = data.GetVertexCount();
+	this->indexCount = data.GetIndexCount();
+	this->importStats = data.importStats;
+	this->cacheStats = data.cacheStats;
+	this->boundsMin = data.boundsMin;
+	this->boundsMax = data.boundsMax;
+	this->boundsRadius = data.boundsRadius;
+
+	if (vertexCount > 0 && indexCount > 0)
+		CreateVertexAndIndexBuffer(device, data.GetVertices(), vertexCount, data.GetIndices());
+}
 
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			DirectX::XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
-		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			DirectX::XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			DirectX::XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
-		}
-		else if (chars[0] == 'f')
+bool Mesh::Import(const char* fileName, bool optimize, MeshImportData& data)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	unsigned int cacheFlags = optimize ? MESH_CACHE_FLAG_OPTIMIZED : 0;
+	std::string cacheFileName = GetMeshCacheFileName(fileName);
+
+	unsigned long long sourceSize = 0;
+	unsigned long long sourceWriteTime = 0;
+	bool sourceExists = GetSourceFileInfo(fileName, sourceSize, sourceWriteTime);
+
+	// Use the binary cache if it was built from this exact OBJ
+	// - The mapping stays open in the import data and buffers are created
+	//   straight from it, so nothing is copied on the CPU
+	// - Without a source file (cache-only assets) the cache is trusted as is
+	std::vector<char> source;
+	{
+		std::shared_ptr<MeshCacheFile> cache = std::make_shared<MeshCacheFile>();
+		if (cache->Open(cacheFileName.c_str()) && cache->GetHeader()->flags == cacheFlags)
 		{
-			// Read the face indices into an array
-			// NOTE: This assumes the given obj file contains
-			//  vertex positions, uv coordinates AND normals.
-			unsigned int i[12];
-			int numbersRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// If we only got the first number, chances are the OBJ
-			// file has no UV coordinates.  This isn't great, but we
-			// still want to load the model without crashing, so we
-			// need to re-read a different pattern (in which we assume
-			// there are no UVs denoted for any of the vertices)
-			if (numbersRead == 1)
+			const MeshCacheHeader* header = cache->GetHeader();
+			bool current = !sourceExists || (header->sourceSize == sourceSize && header->sourceWriteTime == sourceWriteTime);
+			bool touched = false;
+
+			// Timestamps change on checkout or copy, so compare contents before re-importing
+			if (!current && ReadFileToBuffer(fileName, source))
 			{
-				// Re-read with a different pattern
-				numbersRead = sscanf_s(
-					chars,
-					"f %d//%d %d//%d %d//%d %d//%d",
-					&i[0], &i[2],
-					&i[3], &i[5],
-					&i[6], &i[8],
-					&i[9], &i[11]);
-
-				// The following indices are where the UVs should 
-				// have been, so give them a valid value
-				i[1] = 1;
-				i[4] = 1;
-				i[7] = 1;
-				i[10] = 1;
-
-				// If we have no UVs, create a single UV coordinate
-				// that will be used for all vertices
-				if (uvs.size() == 0)
-					uvs.push_back(DirectX::XMFLOAT2(0, 0));
+				current = HashMeshSource(source.data(), source.size()) == header->sourceHash;
+				touched = current;
 			}
 
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.uv = uvs[i[1] - 1];
-			v1.normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.uv = uvs[i[4] - 1];
-			v2.normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.uv = uvs[i[7] - 1];
-			v3.normal = normals[i[8] - 1];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.uv.y = 1.0f - v1.uv.y;
-			v2.uv.y = 1.0f - v2.uv.y;
-			v3.uv.y = 1.0f - v3.uv.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal's Z
-			v1.normal.z *= -1.0f;
-			v2.normal.z *= -1.0f;
-			v3.normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-			vertCounter += 3;
-
-			// Add three more indices
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-
-			// Was there a 4th face?
-			// - 12 numbers read means 4 faces WITH uv's
-			// - 8 numbers read means 4 faces WITHOUT uv's
-			if (numbersRead == 12 || numbersRead == 8)
+			// Skip the hash next time
+			// - The rewrite needs the file to itself, so the mapping is reopened around it
+			if (touched)
 			{
-				// Make the last vertex
-				Vertex v4;
-				v4.Position = positions[i[9] - 1];
-				v4.uv = uvs[i[10] - 1];
-				v4.normal = normals[i[11] - 1];
-
-				// Flip the UV, Z pos and normal's Z
-				v4.uv.y = 1.0f - v4.uv.y;
-				v4.Position.z *= -1.0f;
-				v4.normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-				vertCounter += 3;
-
-				// Add three more indices
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
+				cache->Close();
+				UpdateMeshCacheSourceInfo(cacheFileName.c_str(), sourceSize, sourceWriteTime);
+				current = cache->Open(cacheFileName.c_str()) && cache->GetHeader()->flags == cacheFlags;
+				header = cache->GetHeader();
 			}
-		}
-	}
-
-	this->indexCount = indexCounter;
-	// Close the file and create the actual buffers
-	obj.close();
-
-	CalculateTangents(&verts[0], vertCounter, &indices[0], indexCounter);
-	CreateVertexAndIndexBuffer(device, &verts[0], vertCounter, &indices[0]);
-}
 
-// --------------------------------------------------------
-// Author: Chris Cascioli
-// Purpose: Calculates the tangents of the vertices in a mesh
-// 
-// - You are allowed to directly copy/paste this into your code base
-//   for assignments, given that you clearly cite that this is not
-//   code of your own design.
-//
-// - Code originally adapted from: http://www.terathon.com/code/tangent.html
-//   - Updated version now found here: http://foundationsofgameenginedev.com/FGED2-sample.pdf
-//   - See listing 7.4 in section 7.5 (page 9 of the PDF)
-//
-// - Note: For this code to work, your Vertex format must
-//         contain an XMFLOAT3 called Tangent
-//
-// - Be sure to call this BEFORE creating your D3D vertex/index buffers
-// --------------------------------------------------------
-
-void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
-{
-	// Reset tangents
-	for (int i = 0; i < numVerts; i++)
-	{
-		verts[i].tangent = XMFLOAT3(0, 0, 0);
+			if (current)
+			{
+				data.cachedVertices = cache->GetVertices();
+				data.cachedIndices = cache->GetIndices();
+				data.cachedVertexCount = header->vertexCount;
+				data.cachedIndexCount = header->indexCount;
+				data.importStats = header->importStats;
+				data.cacheStats = header->cacheStats;
+				data.boundsMin = header->boundsMin;
+				data.boundsMax = header->boundsMax;
+				data.boundsRadius = header->boundsRadius;
+				data.fromCache = true;
+				data.cacheFile = cache;
+
+				std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+				data.readMilliseconds = elapsed.count();
+				return true;
+			}
+		}
 	}
 
-	// Calculate tangents one whole triangle at a time
-	for (int i = 0; i < numIndices;)
+	// Read and parse the whole file on the CPU first
+	// - Parsing doesn't touch Direct3D at all (see ObjParser.h)
+	// - Identical face corners are welded into a single vertex,
+	//   so the index buffer actually gets reused
+	if (source.empty() && !ReadFileToBuffer(fileName, source))
+		return false;
+
+	auto parseStart = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<float, std::milli> readTime = parseStart - start;
+	data.readMilliseconds = readTime.count();
+
+	ObjMeshData meshData;
+	if (source.empty() || !ParseObj(&source[0], source.size(), meshData) || meshData.indices.empty())
+		return false;
+
+	int vertexCount = (int)meshData.vertices.size();
+	int indexCount = (int)meshData.indices.size();
+	data.importStats = meshData.stats;
+
+	// Reorder for the post-transform cache, then for overdraw,
+	// then lay the vertices out in the order they get fetched
+	VertexCacheStats& cacheStats = data.cacheStats;
+	cacheStats.acmrBefore = CalculateACMR(&meshData.indices[0], indexCount, vertexCount);
+	cacheStats.atvrBefore = CalculateATVR(&meshData.indices[0], indexCount, vertexCount);
+	if (optimize)
 	{
-		// Grab indices and vertices of first triangle
-		unsigned int i1 = indices[i++];
-		unsigned int i2 = indices[i++];
-		unsigned int i3 = indices[i++];
-		Vertex* v1 = &verts[i1];
-		Vertex* v2 = &verts[i2];
-		Vertex* v3 = &verts[i3];
-
-		// Calculate vectors relative to triangle positions
-		float x1 = v2->Position.x - v1->Position.x;
-		float y1 = v2->Position.y - v1->Position.y;
-		float z1 = v2->Position.z - v1->Position.z;
-
-		float x2 = v3->Position.x - v1->Position.x;
-		float y2 = v3->Position.y - v1->Position.y;
-		float z2 = v3->Position.z - v1->Position.z;
-
-		// Do the same for vectors relative to triangle uv's
-		float s1 = v2->uv.x - v1->uv.x;
-		float t1 = v2->uv.y - v1->uv.y;
-
-		float s2 = v3->uv.x - v1->uv.x;
-		float t2 = v3->uv.y - v1->uv.y;
-
-		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
-
-		float tx = (t2 * x1 - t1 * x2) * r;
-		float ty = (t2 * y1 - t1 * y2) * r;
-		float tz = (t2 * z1 - t1 * z2) * r;
-
-		// Adjust tangents of each vert of the triangle
-		v1->tangent.x += tx;
-		v1->tangent.y += ty;
-		v1->tangent.z += tz;
-
-		v2->tangent.x += tx;
-		v2->tangent.y += ty;
-		v2->tangent.z += tz;
-
-		v3->tangent.x += tx;
-		v3->tangent.y += ty;
-		v3->tangent.z += tz;
-	}
-
-	// Ensure all of the tangents are orthogonal to the normals
-	for (int i = 0; i < numVerts; i++)
-	{
-		// Grab the two vectors
-		XMVECTOR normal = XMLoadFloat3(&verts[i].normal);
-		XMVECTOR tangent = XMLoadFloat3(&verts[i].tangent);
-
-		// Use Gram-Schmidt orthonormalize to ensure
-		// the normal and tangent are exactly 90 degrees apart
-		tangent = XMVector3Normalize(
-			tangent - normal * XMVector3Dot(normal, tangent));
-
-		// Store the tangent
-		XMStoreFloat3(&verts[i].tangent, tangent);
+		OptimizeVertexCache(&meshData.indices[0], indexCount, vertexCount);
+		OptimizeOverdraw(&meshData.indices[0], indexCount, &meshData.vertices[0], vertexCount);
+		vertexCount = OptimizeVertexFetch(&meshData.vertices[0], vertexCount, &meshData.indices[0], indexCount);
+		meshData.vertices.resize(vertexCount);
 	}
+	cacheStats.acmrAfter = CalculateACMR(&meshData.indices[0], indexCount, vertexCount);
+	cacheStats.atvrAfter = CalculateATVR(&meshData.indices[0], indexCount, vertexCount);
+
+	CalculateMeshBounds(&meshData.vertices[0], vertexCount, data.boundsMin, data.boundsMax, data.boundsRadius);
+	CalculateTangents(&meshData.vertices[0], vertexCount, &meshData.indices[0], indexCount);
+
+	// Save the finished data so the next launch can skip all of the above
+	MeshCacheHeader header = {};
+	header.flags = cacheFlags;
+	header.vertexCount = (unsigned int)vertexCount;
+	header.indexCount = (unsigned int)indexCount;
+	header.sourceHash = HashMeshSource(source.data(), source.size());
+	header.sourceSize = sourceSize;
+	header.sourceWriteTime = sourceWriteTime;
+	header.importStats = data.importStats;
+	header.cacheStats = data.cacheStats;
+	header.boundsMin = data.boundsMin;
+	header.boundsMax = data.boundsMax;
+	header.boundsRadius = data.boundsRadius;
+
+	WriteMeshCache(cacheFileName.c_str(), header, &meshData.vertices[0], &meshData.indices[0]);
+
+	data.vertices.swap(meshData.vertices);
+	data.indices.swap(meshData.indices);
+
+	std::chrono::duration<float, std::milli> parseTime = std::chrono::high_resolution_clock::now() - parseStart;
+	data.parseMilliseconds = parseTime.count();
+	return true;
 }
 
-
 Mesh::~Mesh()
 {
 
@@ -339,6 +218,44 @@ int Mesh::GetIndexCount()
 	return indexCount;
 }
 
+int Mesh::GetVertexCount()
+{
+	return vertexCount;
+}
+
+ObjImportStats Mesh::GetImportStats()
+{
+	return importStats;
+}
+
+VertexCacheStats Mesh::GetVertexCacheStats()
+{
+	return cacheStats;
+}
+
+XMFLOAT3 Mesh::GetBoundsMin()
+{
+	return boundsMin;
+}
+
+XMFLOAT3 Mesh::GetBoundsMax()
+{
+	return boundsMax;
+}
+
+XMFLOAT3 Mesh::GetBoundingSphereCenter()
+{
+	return XMFLOAT3(
+		(boundsMin.x + boundsMax.x) * 0.5f,
+		(boundsMin.y + boundsMax.y) * 0.5f,
+		(boundsMin.z + boundsMax.z) * 0.5f);
+}
+
+float Mesh::GetBoundingSphereRadius()
+{
+	return boundsRadius;
+}
+
 void Mesh::Draw()
 {
 	// DRAW geometry
@@ -352,12 +269,15 @@ void Mesh::Draw()
 		//  - For this demo, this step *could* simply be done once during Init()
 		//  - However, this needs to be done between EACH DrawIndexed() call
 		//     when drawing different geometry, so it's here as an example
-		context->IASetVertexBuffers(0, 
-			1, 
-			vertexBuffer.GetAddressOf(),
-			&stride, 
-			&offset);
-		context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+		//  - Skipped when the previous draw used the same mesh
+		if (RenderStateCache::GetInstance().UpdateVertexBuffer(0, vertexBuffer.Get(), stride, offset))
+			context->IASetVertexBuffers(0, 
+				1, 
+				vertexBuffer.GetAddressOf(),
+				&stride, 
+				&offset);
+		if (RenderStateCache::GetInstance().UpdateIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0))
+			context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
 
 		// Tell Direct3D to draw
 		//  - Begins the rendering pipeline on the GPU
@@ -372,7 +292,21 @@ void Mesh::Draw()
 	}
 }
 
-void Mesh::CreateVertexAndIndexBuffer(Microsoft::WRL::ComPtr<ID3D11Device> device, Vertex* vertexObjects, int vertexCount, unsigned int* indices)
+// Same as Draw(), but draws the mesh once per instance.  The caller
+// binds the per-instance data to input slot 1 beforehand.
+void Mesh::DrawInstanced(unsigned int instanceCount, unsigned int startInstance)
+{
+	UINT stride = sizeof(Vertex);
+	UINT offset = 0;
+	if (RenderStateCache::GetInstance().UpdateVertexBuffer(0, vertexBuffer.Get(), stride, offset))
+		context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
+	if (RenderStateCache::GetInstance().UpdateIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0))
+		context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+
+	context->DrawIndexedInstanced(indexCount, instanceCount, 0, 0, startInstance);
+}
+
+void Mesh::CreateVertexAndIndexBuffer(Microsoft::WRL::ComPtr<ID3D11Device> device, const Vertex* vertexObjects, int vertexCount, const unsigned int* indices)
 {
 		// Create a VERTEX BUFFER
 	// - This holds the vertex data of triangles for a single object
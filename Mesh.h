@@ -4,7 +4,48 @@
 #include <DirectXMath.h>
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
 #include "Vertex.h"
+#include "ObjParser.h"
+#include "MeshOptimizer.h"
 #include <vector>
+#include <memory>
+
+class MeshCacheFile;
+
+// --------------------------------------------------------
+// Everything importing a mesh file produces before its
+// buffers are created.  Mesh::Import() fills this without
+// touching Direct3D, so it can run on any thread.
+//
+// A cache hit keeps the mapped cache file open and points
+// into it instead of copying, so buffer creation reads the
+// file's pages directly.  Freshly parsed OBJs use the vectors.
+// --------------------------------------------------------
+struct MeshImportData
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+
+	std::shared_ptr<MeshCacheFile> cacheFile;	// Unmapped when the last copy goes away
+	const Vertex* cachedVertices = nullptr;
+	const unsigned int* cachedIndices = nullptr;
+	unsigned int cachedVertexCount = 0;
+	unsigned int cachedIndexCount = 0;
+
+	const Vertex* GetVertices() const { return cacheFile ? cachedVertices : vertices.data(); }
+	const unsigned int* GetIndices() const { return cacheFile ? cachedIndices : indices.data(); }
+	int GetVertexCount() const { return cacheFile ? (int)cachedVertexCount : (int)vertices.size(); }
+	int GetIndexCount() const { return cacheFile ? (int)cachedIndexCount : (int)indices.size(); }
+
+	ObjImportStats importStats = {};
+	VertexCacheStats cacheStats = {};
+	DirectX::XMFLOAT3 boundsMin = DirectX::XMFLOAT3(0, 0, 0);
+	DirectX::XMFLOAT3 boundsMax = DirectX::XMFLOAT3(0, 0, 0);
+	float boundsRadius = 0.0f;
+
+	bool fromCache = false;
+	float readMilliseconds = 0.0f;	// File reads, or mapping the cache
+	float parseMilliseconds = 0.0f;	// Parsing, optimizing and tangents (0 from the cache)
+};
 
 //hold geometry data (vertices & indices) in Direct3D buffers
 
@@ -12,6 +53,10 @@ class Mesh
 {
 
 public:
+	// CPU half of the file constructor below (cache lookup, parse, optimize,
+	// cache write), returns false if the file couldn't be read or parsed
+	static bool Import(const char* fileName, bool optimize, MeshImportData& data);
+
 	Mesh(Vertex* vertexObjects,
 		int vertexCount,
 		unsigned int* indices,
@@ -19,14 +64,25 @@ public:
 		Microsoft::WRL::ComPtr<ID3D11Device> device,
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
 
-	Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const char* fileName);
+	Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const char* fileName, bool optimize = true);
+
+	// Just the buffer creation, from an earlier Import()
+	Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const MeshImportData& data);
 
 	~Mesh();
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer(); //method to return the pointer to the vertex buffer object
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer(); //method, which does the same thing for the index buffer
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> GetContext();
 	int GetIndexCount(); //method, which returns the number of indices this mesh contains
+	int GetVertexCount();
+	ObjImportStats GetImportStats(); //how much vertex welding saved when this mesh was loaded
+	VertexCacheStats GetVertexCacheStats(); //ACMR/ATVR before and after index reordering
+	DirectX::XMFLOAT3 GetBoundsMin(); //local space bounding box
+	DirectX::XMFLOAT3 GetBoundsMax();
+	DirectX::XMFLOAT3 GetBoundingSphereCenter(); //local space bounding sphere (centered on the box)
+	float GetBoundingSphereRadius();
 	void Draw(); //method, which sets the buffers and tells DirectX to draw the correct number of indices
+	void DrawInstanced(unsigned int instanceCount, unsigned int startInstance); //per-instance data must already be bound to slot 1
 private:
 	// Note the usage of ComPtr below
 	//  - This is a smart pointer for objects that abide by the
@@ -40,7 +96,13 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
 
 	int indexCount;
-	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
-	void CreateVertexAndIndexBuffer(Microsoft::WRL::ComPtr<ID3D11Device> device, Vertex* vertexObjects, int vertexCount, unsigned int* indices);
+	int vertexCount;
+	ObjImportStats importStats;
+	VertexCacheStats cacheStats;
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+	float boundsRadius;
+	void SetImportData(Microsoft::WRL::ComPtr<ID3D11Device> device, const MeshImportData& data);
+	void CreateVertexAndIndexBuffer(Microsoft::WRL::ComPtr<ID3D11Device> device, const Vertex* vertexObjects, int vertexCount, const unsigned int* indices);
 };
 
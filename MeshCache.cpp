@@ -0,0 +1,241 @@
+#include "MeshCache.h"
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+// Vertex data starts on a 16 byte boundary after the header
+static unsigned int AlignUp(unsigned int value, unsigned int alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+MeshCacheFile::MeshCacheFile() :
+	file(INVALID_HANDLE_VALUE),
+	mapping(NULL),
+	view(nullptr),
+	size(0)
+{
+}
+
+MeshCacheFile::~MeshCacheFile()
+{
+	Close();
+}
+
+bool MeshCacheFile::Open(const char* cacheFileName)
+{
+	Close();
+
+	file = CreateFileA(cacheFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize) || (unsigned long long)fileSize.QuadPart < sizeof(MeshCacheHeader))
+	{
+		Close();
+		return false;
+	}
+	size = (unsigned long long)fileSize.QuadPart;
+
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+	{
+		Close();
+		return false;
+	}
+
+	view = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	// Anything written by a different build is treated as missing
+	const MeshCacheHeader* header = GetHeader();
+	unsigned long long vertexEnd = (unsigned long long)header->vertexOffset + (unsigned long long)header->vertexCount * sizeof(Vertex);
+	unsigned long long indexEnd = (unsigned long long)header->indexOffset + (unsigned long long)header->indexCount * sizeof(unsigned int);
+
+	if (header->magic != MESH_CACHE_MAGIC ||
+		header->version != MESH_CACHE_VERSION ||
+		header->vertexStride != sizeof(Vertex) ||
+		vertexEnd > size ||
+		indexEnd > size)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MeshCacheFile::Close()
+{
+	if (view)
+		UnmapViewOfFile(view);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+
+	view = nullptr;
+	mapping = NULL;
+	file = INVALID_HANDLE_VALUE;
+	size = 0;
+}
+
+const MeshCacheHeader* MeshCacheFile::GetHeader() const
+{
+	return (const MeshCacheHeader*)view;
+}
+
+const Vertex* MeshCacheFile::GetVertices() const
+{
+	return (const Vertex*)(view + GetHeader()->vertexOffset);
+}
+
+const unsigned int* MeshCacheFile::GetIndices() const
+{
+	return (const unsigned int*)(view + GetHeader()->indexOffset);
+}
+
+std::string GetMeshCacheFileName(const char* sourceFileName)
+{
+	return std::string(sourceFileName) + MESH_CACHE_EXTENSION;
+}
+
+bool GetSourceFileInfo(const char* fileName, unsigned long long& size, unsigned long long& writeTime)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes = {};
+	if (!GetFileAttributesExA(fileName, GetFileExInfoStandard, &attributes))
+		return false;
+
+	size = ((unsigned long long)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+	writeTime = ((unsigned long long)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+unsigned long long HashMeshSource(const char* data, size_t size)
+{
+	unsigned long long hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= (unsigned char)data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+void CalculateMeshBounds(const Vertex* vertices, int vertexCount, XMFLOAT3& boundsMin, XMFLOAT3& boundsMax, float& boundsRadius)
+{
+	if (vertexCount == 0)
+	{
+		boundsMin = XMFLOAT3(0, 0, 0);
+		boundsMax = XMFLOAT3(0, 0, 0);
+		boundsRadius = 0.0f;
+		return;
+	}
+
+	boundsMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	boundsMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	for (int i = 0; i < vertexCount; i++)
+	{
+		const XMFLOAT3& p = vertices[i].Position;
+		boundsMin.x = p.x < boundsMin.x ? p.x : boundsMin.x;
+		boundsMin.y = p.y < boundsMin.y ? p.y : boundsMin.y;
+		boundsMin.z = p.z < boundsMin.z ? p.z : boundsMin.z;
+		boundsMax.x = p.x > boundsMax.x ? p.x : boundsMax.x;
+		boundsMax.y = p.y > boundsMax.y ? p.y : boundsMax.y;
+		boundsMax.z = p.z > boundsMax.z ? p.z : boundsMax.z;
+	}
+
+	// Tighter than half the box diagonal for round meshes
+	XMFLOAT3 center(
+		(boundsMin.x + boundsMax.x) * 0.5f,
+		(boundsMin.y + boundsMax.y) * 0.5f,
+		(boundsMin.z + boundsMax.z) * 0.5f);
+
+	float radiusSquared = 0.0f;
+	for (int i = 0; i < vertexCount; i++)
+	{
+		const XMFLOAT3& p = vertices[i].Position;
+		float dx = p.x - center.x, dy = p.y - center.y, dz = p.z - center.z;
+		float distanceSquared = dx * dx + dy * dy + dz * dz;
+		radiusSquared = distanceSquared > radiusSquared ? distanceSquared : radiusSquared;
+	}
+	boundsRadius = sqrtf(radiusSquared);
+}
+
+static bool WriteAll(HANDLE file, const void* data, unsigned long long size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	while (size > 0)
+	{
+		DWORD chunk = size > 0x40000000ull ? 0x40000000u : (DWORD)size;
+		DWORD written = 0;
+		if (!WriteFile(file, bytes, chunk, &written, NULL) || written != chunk)
+			return false;
+
+		bytes += chunk;
+		size -= chunk;
+	}
+	return true;
+}
+
+bool WriteMeshCache(const char* cacheFileName, MeshCacheHeader header, const Vertex* vertices, const unsigned int* indices)
+{
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.vertexStride = sizeof(Vertex);
+	header.vertexOffset = AlignUp(sizeof(MeshCacheHeader), 16);
+	header.indexOffset = header.vertexOffset + header.vertexCount * sizeof(Vertex);
+
+	std::string tempFileName = std::string(cacheFileName) + ".tmp";
+	HANDLE file = CreateFileA(tempFileName.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	unsigned char padding[16] = {};
+	bool success =
+		WriteAll(file, &header, sizeof(MeshCacheHeader)) &&
+		WriteAll(file, padding, header.vertexOffset - sizeof(MeshCacheHeader)) &&
+		WriteAll(file, vertices, (unsigned long long)header.vertexCount * sizeof(Vertex)) &&
+		WriteAll(file, indices, (unsigned long long)header.indexCount * sizeof(unsigned int));
+
+	CloseHandle(file);
+
+	// Only swap the finished file in once everything was written
+	if (!success || !MoveFileExA(tempFileName.c_str(), cacheFileName, MOVEFILE_REPLACE_EXISTING))
+	{
+		DeleteFileA(tempFileName.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool UpdateMeshCacheSourceInfo(const char* cacheFileName, unsigned long long sourceSize, unsigned long long sourceWriteTime)
+{
+	HANDLE file = CreateFileA(cacheFileName, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	MeshCacheHeader header = {};
+	DWORD read = 0;
+	bool success = ReadFile(file, &header, sizeof(MeshCacheHeader), &read, NULL) && read == sizeof(MeshCacheHeader);
+
+	if (success)
+	{
+		header.sourceSize = sourceSize;
+		header.sourceWriteTime = sourceWriteTime;
+
+		LARGE_INTEGER start = {};
+		success = SetFilePointerEx(file, start, NULL, FILE_BEGIN) && WriteAll(file, &header, sizeof(MeshCacheHeader));
+	}
+
+	CloseHandle(file);
+	return success;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <Windows.h>
+#include <DirectXMath.h>
+#include <string>
+#include "Vertex.h"
+#include "ObjParser.h"
+#include "MeshOptimizer.h"
+
+// --------------------------------------------------------
+// Binary mesh cache
+//
+// The first time an OBJ is imported, the finished vertex and
+// index data (welded, reordered, tangents included) is written
+// next to it as "<file>.obj.mesh".  Later loads memory-map
+// that file and keep the mapping alive in MeshImportData, so
+// buffer creation reads the mapped view without a CPU copy.
+//
+// File layout:
+//   MeshCacheHeader
+//   Vertex       vertices[vertexCount]   (at vertexOffset)
+//   unsigned int indices[indexCount]     (at indexOffset)
+// --------------------------------------------------------
+
+#define MESH_CACHE_MAGIC 0x4853454D // "MESH"
+#define MESH_CACHE_VERSION 2
+#define MESH_CACHE_EXTENSION ".mesh"
+
+// Import options baked into the cached data
+#define MESH_CACHE_FLAG_OPTIMIZED 0x1
+
+struct MeshCacheHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned int vertexStride;		// sizeof(Vertex) when written, catches layout changes
+	unsigned int flags;
+
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	unsigned int vertexOffset;		// Byte offsets from the start of the file
+	unsigned int indexOffset;
+
+	// Used to tell if the source OBJ changed since the cache was written
+	unsigned long long sourceHash;	// FNV-1a of the whole OBJ file
+	unsigned long long sourceSize;
+	unsigned long long sourceWriteTime;
+
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+	float boundsRadius;				// Bounding sphere around the center of the box
+
+	ObjImportStats importStats;
+	VertexCacheStats cacheStats;
+};
+
+// --------------------------------------------------------
+// Read-only memory mapped view of a mesh cache file
+// --------------------------------------------------------
+class MeshCacheFile
+{
+public:
+	MeshCacheFile();
+	~MeshCacheFile();
+
+	// Maps the file and checks the header.  Returns false if the file
+	// is missing, truncated or from a different version/vertex layout
+	bool Open(const char* cacheFileName);
+	void Close();
+
+	const MeshCacheHeader* GetHeader() const;
+	const Vertex* GetVertices() const;
+	const unsigned int* GetIndices() const;
+
+private:
+	HANDLE file;
+	HANDLE mapping;
+	const unsigned char* view;
+	unsigned long long size;
+
+	// Mapped views can't be shared
+	MeshCacheFile(const MeshCacheFile&) = delete;
+	MeshCacheFile& operator=(const MeshCacheFile&) = delete;
+};
+
+// "Assets/Models/cube.obj" -> "Assets/Models/cube.obj.mesh"
+std::string GetMeshCacheFileName(const char* sourceFileName);
+
+// Size and last write time of a file, without opening it
+bool GetSourceFileInfo(const char* fileName, unsigned long long& size, unsigned long long& writeTime);
+
+// 64-bit FNV-1a hash of a block of memory
+unsigned long long HashMeshSource(const char* data, size_t size);
+
+// Axis aligned bounds of a vertex array, plus the radius of
+// the smallest sphere around the box's center holding every vertex
+void CalculateMeshBounds(const Vertex* vertices, int vertexCount, DirectX::XMFLOAT3& boundsMin, DirectX::XMFLOAT3& boundsMax, float& boundsRadius);
+
+// Writes a cache file (to a temp file first, so a crash never leaves a half written cache)
+// - Fills in magic, version, stride and offsets in the header
+bool WriteMeshCache(const char* cacheFileName, MeshCacheHeader header, const Vertex* vertices, const unsigned int* indices);
+
+// Rewrites the source size/time in an existing cache after its contents were
+// confirmed to match by hash (e.g. the OBJ was touched but not changed)
+bool UpdateMeshCacheSourceInfo(const char* cacheFileName, unsigned long long sourceSize, unsigned long long sourceWriteTime);
@@ -0,0 +1,474 @@
+#include "MeshOptimizer.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// FIFO post-transform cache simulation
+// --------------------------------------------------------
+
+// Pushes one vertex through a FIFO cache and returns true on a miss
+static bool TouchFifoCache(std::vector<int>& timestamps, unsigned int& time, unsigned int vertex, int cacheSize)
+{
+	// A vertex is still cached if it was added less than cacheSize misses ago
+	if (timestamps[vertex] >= 0 && time - (unsigned int)timestamps[vertex] < (unsigned int)cacheSize)
+		return false;
+
+	timestamps[vertex] = (int)time;
+	time++;
+	return true;
+}
+
+static unsigned int CountCacheMisses(const unsigned int* indices, int indexCount, int vertexCount, int cacheSize)
+{
+	std::vector<int> timestamps(vertexCount, -1);
+	unsigned int time = 0;
+	unsigned int misses = 0;
+
+	for (int i = 0; i < indexCount; i++)
+	{
+		if (TouchFifoCache(timestamps, time, indices[i], cacheSize))
+			misses++;
+	}
+
+	return misses;
+}
+
+float CalculateACMR(const unsigned int* indices, int indexCount, int vertexCount, int cacheSize)
+{
+	int triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return 0.0f;
+
+	return (float)CountCacheMisses(indices, indexCount, vertexCount, cacheSize) / triangleCount;
+}
+
+float CalculateATVR(const unsigned int* indices, int indexCount, int vertexCount, int cacheSize)
+{
+	// Only count the vertices the index list actually uses
+	std::vector<bool> used(vertexCount, false);
+	int usedCount = 0;
+	for (int i = 0; i < indexCount; i++)
+	{
+		if (!used[indices[i]])
+		{
+			used[indices[i]] = true;
+			usedCount++;
+		}
+	}
+
+	if (usedCount == 0)
+		return 0.0f;
+
+	return (float)CountCacheMisses(indices, indexCount, vertexCount, cacheSize) / usedCount;
+}
+
+// --------------------------------------------------------
+// Forsyth's "Linear-Speed Vertex Cache Optimisation"
+// https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+//
+// Every vertex gets a score based on where it sits in a
+// simulated LRU cache and how many triangles still need it.
+// Each step greedily adds the highest scoring triangle that
+// touches the cache.
+// --------------------------------------------------------
+
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_MAX_VALENCE 32
+
+static const float CacheDecayPower = 1.5f;
+static const float LastTriScore = 0.75f;
+static const float ValenceBoostScale = 2.0f;
+static const float ValenceBoostPower = 0.5f;
+
+// Scores are looked up from small tables instead of calling pow() every update
+struct ForsythScoreTables
+{
+	float cache[FORSYTH_CACHE_SIZE];
+	float valence[FORSYTH_MAX_VALENCE];
+
+	ForsythScoreTables()
+	{
+		for (int i = 0; i < FORSYTH_CACHE_SIZE; i++)
+		{
+			// The three vertices of the last triangle all get the same score,
+			// so it doesn't matter which order they were added in
+			if (i < 3)
+			{
+				cache[i] = LastTriScore;
+			}
+			else
+			{
+				float scaler = 1.0f - (float)(i - 3) / (FORSYTH_CACHE_SIZE - 3);
+				cache[i] = powf(scaler, CacheDecayPower);
+			}
+		}
+
+		// Boost vertices with few triangles left so they get finished off
+		valence[0] = 0.0f;
+		for (int i = 1; i < FORSYTH_MAX_VALENCE; i++)
+			valence[i] = ValenceBoostScale * powf((float)i, -ValenceBoostPower);
+	}
+};
+
+static float ForsythVertexScore(const ForsythScoreTables& tables, int cachePosition, int remainingValence)
+{
+	// No triangles left that need this vertex
+	if (remainingValence == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+		score = tables.cache[cachePosition];
+
+	score += tables.valence[std::min(remainingValence, FORSYTH_MAX_VALENCE - 1)];
+	return score;
+}
+
+void OptimizeVertexCache(unsigned int* indices, int indexCount, int vertexCount)
+{
+	int triangleCount = indexCount / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+		return;
+
+	static const ForsythScoreTables tables;
+
+	// Build vertex -> triangle adjacency in one flat array
+	std::vector<int> valence(vertexCount, 0);
+	for (int i = 0; i < triangleCount * 3; i++)
+		valence[indices[i]]++;
+
+	std::vector<int> adjacencyOffsets(vertexCount + 1, 0);
+	for (int v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + valence[v];
+
+	std::vector<int> adjacency(triangleCount * 3);
+	std::vector<int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (int t = 0; t < triangleCount; t++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = indices[t * 3 + c];
+			adjacency[fill[v]++] = t;
+		}
+	}
+
+	// Initial scores (nothing is cached yet)
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (int v = 0; v < vertexCount; v++)
+		vertexScore[v] = ForsythVertexScore(tables, -1, valence[v]);
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> triangleAdded(triangleCount, false);
+	int bestTriangle = 0;
+	for (int t = 0; t < triangleCount; t++)
+	{
+		triangleScore[t] =
+			vertexScore[indices[t * 3 + 0]] +
+			vertexScore[indices[t * 3 + 1]] +
+			vertexScore[indices[t * 3 + 2]];
+
+		if (triangleScore[t] > triangleScore[bestTriangle])
+			bestTriangle = t;
+	}
+
+	// The cache holds up to 3 extra entries while a triangle is being added
+	int cache[FORSYTH_CACHE_SIZE + 3];
+	int cacheCount = 0;
+	int newCache[FORSYTH_CACHE_SIZE + 3];
+
+	std::vector<unsigned int> output(triangleCount * 3);
+	int scanCursor = 0;
+
+	for (int outputTriangle = 0; outputTriangle < triangleCount; outputTriangle++)
+	{
+		// Nothing in the cache pointed anywhere useful, so pick
+		// the next triangle that hasn't been added yet
+		if (bestTriangle < 0)
+		{
+			while (triangleAdded[scanCursor])
+				scanCursor++;
+			bestTriangle = scanCursor;
+		}
+
+		const unsigned int* tri = &indices[bestTriangle * 3];
+		output[outputTriangle * 3 + 0] = tri[0];
+		output[outputTriangle * 3 + 1] = tri[1];
+		output[outputTriangle * 3 + 2] = tri[2];
+		triangleAdded[bestTriangle] = true;
+
+		// Remove this triangle from each of its vertices' lists
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = tri[c];
+			int begin = adjacencyOffsets[v];
+			int end = begin + valence[v];
+			for (int a = begin; a < end; a++)
+			{
+				if (adjacency[a] == bestTriangle)
+				{
+					adjacency[a] = adjacency[end - 1];
+					break;
+				}
+			}
+			valence[v]--;
+		}
+
+		// New triangle goes to the front of the LRU cache
+		int newCount = 0;
+		for (int c = 0; c < 3; c++)
+			newCache[newCount++] = (int)tri[c];
+
+		for (int i = 0; i < cacheCount; i++)
+		{
+			int v = cache[i];
+			if (v != (int)tri[0] && v != (int)tri[1] && v != (int)tri[2])
+				newCache[newCount++] = v;
+		}
+
+		// Vertices pushed past the end of the cache are no longer cached
+		for (int i = FORSYTH_CACHE_SIZE; i < newCount; i++)
+			cachePosition[newCache[i]] = -1;
+
+		cacheCount = std::min(newCount, FORSYTH_CACHE_SIZE);
+		for (int i = 0; i < cacheCount; i++)
+		{
+			cache[i] = newCache[i];
+			cachePosition[cache[i]] = i;
+		}
+
+		// Re-score everything affected and find the next best triangle
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+
+		for (int i = 0; i < newCount; i++)
+		{
+			int v = newCache[i];
+			float score = ForsythVertexScore(tables, cachePosition[v], valence[v]);
+			float delta = score - vertexScore[v];
+			vertexScore[v] = score;
+
+			int begin = adjacencyOffsets[v];
+			int end = begin + valence[v];
+			for (int a = begin; a < end; a++)
+			{
+				int t = adjacency[a];
+				triangleScore[t] += delta;
+
+				// Only triangles touching the cache are candidates
+				if (i < cacheCount && triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+// --------------------------------------------------------
+// Overdraw reordering, after Sander, Nehab & Barczak,
+// "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"
+//
+// The cache-optimized triangle list is cut into clusters at
+// points where the cache would have been cold anyway, and the
+// clusters are then sorted so the ones facing away from the
+// middle of the mesh (most likely to occlude others) go first.
+// --------------------------------------------------------
+
+struct TriangleCluster
+{
+	int firstTriangle;
+	int triangleCount;
+	float sortKey;
+};
+
+void OptimizeOverdraw(unsigned int* indices, int indexCount, const Vertex* vertices, int vertexCount, float threshold)
+{
+	int triangleCount = indexCount / 3;
+	if (triangleCount < 2 || vertexCount == 0)
+		return;
+
+	float acmrBefore = CalculateACMR(indices, indexCount, vertexCount);
+
+	// Hard boundaries: triangles where every vertex missed the cache
+	std::vector<int> hardBoundaries;
+	{
+		std::vector<int> timestamps(vertexCount, -1);
+		unsigned int time = 0;
+		for (int t = 0; t < triangleCount; t++)
+		{
+			int misses = 0;
+			for (int c = 0; c < 3; c++)
+				misses += TouchFifoCache(timestamps, time, indices[t * 3 + c], VERTEX_CACHE_MEASURE_SIZE) ? 1 : 0;
+
+			if (t == 0 || misses == 3)
+				hardBoundaries.push_back(t);
+		}
+		hardBoundaries.push_back(triangleCount);
+	}
+
+	// Soft boundaries: split hard clusters further wherever the running
+	// ACMR is already as good as the cluster's overall ACMR (plus threshold)
+	std::vector<TriangleCluster> clusters;
+	for (size_t h = 0; h + 1 < hardBoundaries.size(); h++)
+	{
+		int start = hardBoundaries[h];
+		int end = hardBoundaries[h + 1];
+
+		float clusterACMR = CalculateACMR(indices + start * 3, (end - start) * 3, vertexCount);
+		float target = clusterACMR * threshold;
+
+		std::vector<int> timestamps(vertexCount, -1);
+		unsigned int time = 0;
+		int misses = 0;
+		int clusterStart = start;
+
+		for (int t = start; t < end; t++)
+		{
+			for (int c = 0; c < 3; c++)
+				misses += TouchFifoCache(timestamps, time, indices[t * 3 + c], VERTEX_CACHE_MEASURE_SIZE) ? 1 : 0;
+
+			int count = t - clusterStart + 1;
+			if ((float)misses / count <= target || t == end - 1)
+			{
+				clusters.push_back({ clusterStart, count, 0.0f });
+
+				// Start the next cluster with a cold cache
+				std::fill(timestamps.begin(), timestamps.end(), -1);
+				time = 0;
+				misses = 0;
+				clusterStart = t + 1;
+			}
+		}
+	}
+
+	if (clusters.size() < 2)
+		return;
+
+	// Area weighted centroid of the whole mesh
+	XMFLOAT3 meshCentroid(0.0f, 0.0f, 0.0f);
+	float meshArea = 0.0f;
+	for (int t = 0; t < triangleCount; t++)
+	{
+		const XMFLOAT3& a = vertices[indices[t * 3 + 0]].Position;
+		const XMFLOAT3& b = vertices[indices[t * 3 + 1]].Position;
+		const XMFLOAT3& c = vertices[indices[t * 3 + 2]].Position;
+
+		float ex = b.x - a.x, ey = b.y - a.y, ez = b.z - a.z;
+		float fx = c.x - a.x, fy = c.y - a.y, fz = c.z - a.z;
+		float nx = ey * fz - ez * fy, ny = ez * fx - ex * fz, nz = ex * fy - ey * fx;
+		float area = sqrtf(nx * nx + ny * ny + nz * nz);
+
+		meshCentroid.x += (a.x + b.x + c.x) / 3.0f * area;
+		meshCentroid.y += (a.y + b.y + c.y) / 3.0f * area;
+		meshCentroid.z += (a.z + b.z + c.z) / 3.0f * area;
+		meshArea += area;
+	}
+
+	if (meshArea > 0.0f)
+	{
+		meshCentroid.x /= meshArea;
+		meshCentroid.y /= meshArea;
+		meshCentroid.z /= meshArea;
+	}
+
+	// Clusters whose average normal points away from the
+	// mesh centroid are drawn first
+	for (TriangleCluster& cluster : clusters)
+	{
+		XMFLOAT3 centroid(0.0f, 0.0f, 0.0f);
+		XMFLOAT3 normal(0.0f, 0.0f, 0.0f);
+		float clusterArea = 0.0f;
+
+		for (int t = cluster.firstTriangle; t < cluster.firstTriangle + cluster.triangleCount; t++)
+		{
+			const XMFLOAT3& a = vertices[indices[t * 3 + 0]].Position;
+			const XMFLOAT3& b = vertices[indices[t * 3 + 1]].Position;
+			const XMFLOAT3& c = vertices[indices[t * 3 + 2]].Position;
+
+			// Front faces are clockwise, which makes (b - a) x (c - a) point outwards
+			float ex = b.x - a.x, ey = b.y - a.y, ez = b.z - a.z;
+			float fx = c.x - a.x, fy = c.y - a.y, fz = c.z - a.z;
+			float nx = ey * fz - ez * fy, ny = ez * fx - ex * fz, nz = ex * fy - ey * fx;
+			float area = sqrtf(nx * nx + ny * ny + nz * nz);
+
+			centroid.x += (a.x + b.x + c.x) / 3.0f * area;
+			centroid.y += (a.y + b.y + c.y) / 3.0f * area;
+			centroid.z += (a.z + b.z + c.z) / 3.0f * area;
+			normal.x += nx;
+			normal.y += ny;
+			normal.z += nz;
+			clusterArea += area;
+		}
+
+		if (clusterArea > 0.0f)
+		{
+			centroid.x /= clusterArea;
+			centroid.y /= clusterArea;
+			centroid.z /= clusterArea;
+		}
+
+		float normalLength = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+		if (normalLength > 0.0f)
+		{
+			normal.x /= normalLength;
+			normal.y /= normalLength;
+			normal.z /= normalLength;
+		}
+
+		cluster.sortKey =
+			(centroid.x - meshCentroid.x) * normal.x +
+			(centroid.y - meshCentroid.y) * normal.y +
+			(centroid.z - meshCentroid.z) * normal.z;
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(),
+		[](const TriangleCluster& a, const TriangleCluster& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<unsigned int> output;
+	output.reserve(triangleCount * 3);
+	for (const TriangleCluster& cluster : clusters)
+	{
+		output.insert(output.end(),
+			indices + cluster.firstTriangle * 3,
+			indices + (cluster.firstTriangle + cluster.triangleCount) * 3);
+	}
+
+	// Don't accept the new order if it costs more cache misses than allowed
+	float acmrAfter = CalculateACMR(&output[0], triangleCount * 3, vertexCount);
+	if (acmrAfter > acmrBefore * threshold)
+		return;
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+int OptimizeVertexFetch(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount)
+{
+	// Hand out new vertex numbers in the order the index list first uses them
+	std::vector<int> remap(vertexCount, -1);
+	int nextVertex = 0;
+	for (int i = 0; i < indexCount; i++)
+	{
+		unsigned int v = indices[i];
+		if (remap[v] == -1)
+			remap[v] = nextVertex++;
+
+		indices[i] = (unsigned int)remap[v];
+	}
+
+	std::vector<Vertex> reordered(nextVertex);
+	for (int v = 0; v < vertexCount; v++)
+	{
+		if (remap[v] != -1)
+			reordered[remap[v]] = vertices[v];
+	}
+
+	std::copy(reordered.begin(), reordered.end(), vertices);
+	return nextVertex;
+}
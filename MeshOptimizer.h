@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// CPU-only helpers for reordering indexed triangle lists so
+// the GPU's post-transform vertex cache and vertex fetch
+// work better.  None of these touch Direct3D.
+// --------------------------------------------------------
+
+// Size of the FIFO cache used when measuring ACMR/ATVR
+#define VERTEX_CACHE_MEASURE_SIZE 16
+
+// Before/after numbers for a mesh that has been optimized
+struct VertexCacheStats
+{
+	float acmrBefore; // Average cache miss ratio (misses per triangle, 0.5 - 3.0)
+	float acmrAfter;
+	float atvrBefore; // Average transform to vertex ratio (misses per used vertex, 1.0 is ideal)
+	float atvrAfter;
+};
+
+// Simulates a FIFO post-transform cache and returns misses per triangle
+float CalculateACMR(const unsigned int* indices, int indexCount, int vertexCount, int cacheSize = VERTEX_CACHE_MEASURE_SIZE);
+
+// Simulates a FIFO post-transform cache and returns misses per referenced vertex
+float CalculateATVR(const unsigned int* indices, int indexCount, int vertexCount, int cacheSize = VERTEX_CACHE_MEASURE_SIZE);
+
+// Reorders triangles for vertex cache locality (Tom Forsyth's linear-speed algorithm)
+void OptimizeVertexCache(unsigned int* indices, int indexCount, int vertexCount);
+
+// Reorders clusters of an already cache-optimized index list so outward
+// facing clusters are drawn first, reducing overdraw (Tipsify-style).
+// threshold is how much ACMR is allowed to get worse, e.g. 1.05 = 5%
+void OptimizeOverdraw(unsigned int* indices, int indexCount, const Vertex* vertices, int vertexCount, float threshold = 1.05f);
+
+// Reorders vertices into the order the index list first uses them and
+// drops unreferenced vertices.  Returns the new vertex count.
+int OptimizeVertexFetch(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount);
@@ -0,0 +1,171 @@
+#include "MeshTangents.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <vector>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Pieces of the tangent calculation shared by the serial and
+// parallel paths.  Both paths must use these exact functions so
+// the floating point math (and therefore the output) is identical.
+// --------------------------------------------------------
+
+// Meshes with fewer triangles than this use the serial path
+#define PARALLEL_TANGENT_MIN_TRIANGLES 16384
+
+// Tangent of one triangle, before it is added to its vertices
+static inline XMFLOAT3 CalculateTriangleTangent(const Vertex* verts, const unsigned int* triangle)
+{
+	const Vertex* v1 = &verts[triangle[0]];
+	const Vertex* v2 = &verts[triangle[1]];
+	const Vertex* v3 = &verts[triangle[2]];
+
+	// Calculate vectors relative to triangle positions
+	float x1 = v2->Position.x - v1->Position.x;
+	float y1 = v2->Position.y - v1->Position.y;
+	float z1 = v2->Position.z - v1->Position.z;
+
+	float x2 = v3->Position.x - v1->Position.x;
+	float y2 = v3->Position.y - v1->Position.y;
+	float z2 = v3->Position.z - v1->Position.z;
+
+	// Do the same for vectors relative to triangle uv's
+	float s1 = v2->uv.x - v1->uv.x;
+	float t1 = v2->uv.y - v1->uv.y;
+
+	float s2 = v3->uv.x - v1->uv.x;
+	float t2 = v3->uv.y - v1->uv.y;
+
+	// Create vectors for tangent calculation
+	float r = 1.0f / (s1 * t2 - s2 * t1);
+
+	return XMFLOAT3(
+		(t2 * x1 - t1 * x2) * r,
+		(t2 * y1 - t1 * y2) * r,
+		(t2 * z1 - t1 * z2) * r);
+}
+
+// Use Gram-Schmidt orthonormalize to ensure
+// the normal and tangent are exactly 90 degrees apart
+static inline void OrthogonalizeTangent(Vertex& vertex)
+{
+	XMVECTOR normal = XMLoadFloat3(&vertex.normal);
+	XMVECTOR tangent = XMLoadFloat3(&vertex.tangent);
+
+	tangent = XMVector3Normalize(
+		tangent - normal * XMVector3Dot(normal, tangent));
+
+	XMStoreFloat3(&vertex.tangent, tangent);
+}
+
+// A few ranges per thread, so threads that finish early can steal the rest
+static unsigned int GetTangentGrainSize(int count, unsigned int threadCount)
+{
+	return std::max(1024u, (unsigned int)count / (threadCount * 4));
+}
+
+// --------------------------------------------------------
+// Author: Chris Cascioli
+// Purpose: Calculates the tangents of the vertices in a mesh
+// 
+// - You are allowed to directly copy/paste this into your code base
+//   for assignments, given that you clearly cite that this is not
+//   code of your own design.
+//
+// - Code originally adapted from: http://www.terathon.com/code/tangent.html
+//   - Updated version now found here: http://foundationsofgameenginedev.com/FGED2-sample.pdf
+//   - See listing 7.4 in section 7.5 (page 9 of the PDF)
+//
+// - Note: For this code to work, your Vertex format must
+//         contain an XMFLOAT3 called Tangent
+//
+// - Be sure to call this BEFORE creating your D3D vertex/index buffers
+// --------------------------------------------------------
+
+void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
+{
+	int numTriangles = numIndices / 3;
+
+	// Small meshes aren't worth splitting into jobs
+	JobSystem& jobs = JobSystem::GetInstance();
+	unsigned int threadCount = jobs.GetThreadCount();
+	if (numTriangles < PARALLEL_TANGENT_MIN_TRIANGLES || threadCount < 2)
+	{
+		CalculateTangentsSerial(verts, numVerts, indices, numIndices);
+		return;
+	}
+
+	// 1) Every triangle's tangent, independently
+	std::vector<XMFLOAT3> triangleTangents(numTriangles);
+	jobs.ParallelFor(numTriangles, GetTangentGrainSize(numTriangles, threadCount), [&](unsigned int first, unsigned int end)
+	{
+		for (unsigned int t = first; t < end; t++)
+			triangleTangents[t] = CalculateTriangleTangent(verts, &indices[t * 3]);
+	});
+
+	// 2) Bucket triangle corners by vertex (counting sort), so each
+	//    vertex lists its triangles in the same order the serial loop
+	//    visits them.  Summing in that order is what keeps the
+	//    floating point results bit-identical.
+	std::vector<int> cornerOffsets(numVerts + 1, 0);
+	for (int i = 0; i < numTriangles * 3; i++)
+		cornerOffsets[indices[i] + 1]++;
+	for (int v = 0; v < numVerts; v++)
+		cornerOffsets[v + 1] += cornerOffsets[v];
+
+	std::vector<int> cornerTriangles(numTriangles * 3);
+	std::vector<int> fill(cornerOffsets.begin(), cornerOffsets.end() - 1);
+	for (int i = 0; i < numTriangles * 3; i++)
+		cornerTriangles[fill[indices[i]]++] = i / 3;
+
+	// 3) Each job owns a range of vertices, so nothing is shared
+	jobs.ParallelFor(numVerts, GetTangentGrainSize(numVerts, threadCount), [&](unsigned int first, unsigned int end)
+	{
+		for (unsigned int v = first; v < end; v++)
+		{
+			XMFLOAT3 tangent(0, 0, 0);
+			for (int c = cornerOffsets[v]; c < cornerOffsets[v + 1]; c++)
+			{
+				const XMFLOAT3& t = triangleTangents[cornerTriangles[c]];
+				tangent.x += t.x;
+				tangent.y += t.y;
+				tangent.z += t.z;
+			}
+
+			verts[v].tangent = tangent;
+			OrthogonalizeTangent(verts[v]);
+		}
+	});
+}
+
+void CalculateTangentsSerial(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
+{
+	// Reset tangents
+	for (int i = 0; i < numVerts; i++)
+	{
+		verts[i].tangent = XMFLOAT3(0, 0, 0);
+	}
+
+	// Calculate tangents one whole triangle at a time
+	for (int i = 0; i + 2 < numIndices; i += 3)
+	{
+		XMFLOAT3 t = CalculateTriangleTangent(verts, &indices[i]);
+
+		// Adjust tangents of each vert of the triangle
+		for (int c = 0; c < 3; c++)
+		{
+			Vertex* v = &verts[indices[i + c]];
+			v->tangent.x += t.x;
+			v->tangent.y += t.y;
+			v->tangent.z += t.z;
+		}
+	}
+
+	// Ensure all of the tangents are orthogonal to the normals
+	for (int i = 0; i < numVerts; i++)
+	{
+		OrthogonalizeTangent(verts[i]);
+	}
+}
+
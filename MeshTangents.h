@@ -0,0 +1,15 @@
+#pragma once
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Per-vertex tangents for normal mapping, from positions,
+// uvs and normals.  CPU only, so they can be benchmarked
+// without a device.
+// --------------------------------------------------------
+
+// Splits big meshes over the JobSystem's threads, with output bit-identical to the serial version
+void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+
+// One triangle at a time on the calling thread
+void CalculateTangentsSerial(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
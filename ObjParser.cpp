@@ -0,0 +1,488 @@
+#include "ObjParser.h"
+#include <fstream>
+#include <cmath>
+#include <climits>
+#include <algorithm>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Small hand-written tokenizer helpers
+//
+// These work directly on the file buffer, so nothing is
+// copied into temporary strings and nothing is allocated
+// per line (unlike getline() + sscanf_s())
+// --------------------------------------------------------
+
+// One corner of a face - indices are already 0-based, or -1 if missing
+struct ObjCorner
+{
+	int position;
+	int uv;
+	int normal;
+};
+
+static bool IsDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static bool IsSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static void SkipSpaces(const char*& p, const char* end)
+{
+	while (p < end && IsSpace(*p))
+		p++;
+}
+
+static void SkipLine(const char*& p, const char* end)
+{
+	while (p < end && *p != '\n')
+		p++;
+
+	//step past the newline itself
+	if (p < end)
+		p++;
+}
+
+static double Pow10(int exponent)
+{
+	//every power of ten up to 1e22 is exactly representable as a double
+	static const double table[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	if (exponent >= 0 && exponent <= 22)
+		return table[exponent];
+
+	return std::pow(10.0, exponent);
+}
+
+// Numbers past INT_MAX skip the rest of their digits, come out
+// saturated and return false, so they can't wrap around
+static bool ParseInt(const char*& p, const char* end, int& out)
+{
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	if (p >= end || !IsDigit(*p))
+		return false;
+
+	int value = 0;
+	bool overflow = false;
+	while (p < end && IsDigit(*p))
+	{
+		int digit = *p - '0';
+		if (overflow || value > (INT_MAX - digit) / 10)
+			overflow = true;
+		else
+			value = value * 10 + digit;
+		p++;
+	}
+
+	if (overflow)
+		value = INT_MAX;
+
+	out = negative ? -value : value;
+	return !overflow;
+}
+
+static bool ParseFloat(const char*& p, const char* end, float& out)
+{
+	SkipSpaces(p, end);
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	//gather up to 19 significant digits into an integer, and keep
+	//track of where the decimal point goes with a power of ten
+	unsigned long long mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	bool anyDigits = false;
+
+	while (p < end && IsDigit(*p))
+	{
+		if (digits < 19)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa != 0)
+				digits++;
+		}
+		else
+		{
+			exponent++;
+		}
+
+		anyDigits = true;
+		p++;
+	}
+
+	if (p < end && *p == '.')
+	{
+		p++;
+		while (p < end && IsDigit(*p))
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0)
+					digits++;
+				exponent--;
+			}
+
+			anyDigits = true;
+			p++;
+		}
+	}
+
+	if (!anyDigits)
+		return false;
+
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		p++;
+		int e = 0;
+		ParseInt(p, end, e);	//saturated if it overflowed, which the clamp below handles too
+
+		//anything past this is 0 or infinity as a float anyway, and
+		//keeping both small stops the sum (and Pow10's table index) overflowing
+		e = std::max(-400, std::min(400, e));
+		exponent = std::max(-400, std::min(400, exponent + e));
+	}
+
+	double value = (double)mantissa;
+	if (exponent < 0)
+		value /= Pow10(-exponent);
+	else if (exponent > 0)
+		value *= Pow10(exponent);
+
+	out = (float)(negative ? -value : value);
+	return true;
+}
+
+// Converts a 1-based (or negative, relative) OBJ index to a 0-based one
+static int ResolveIndex(int index, size_t count)
+{
+	if (index > 0)
+		return index - 1;
+
+	if (index < 0)
+		return (int)count + index;
+
+	return -1;
+}
+
+// Reads a single "v", "v/vt", "v//vn" or "v/vt/vn" token
+static bool ParseCorner(const char*& p, const char* end, size_t positionCount, size_t uvCount, size_t normalCount, ObjCorner& corner)
+{
+	SkipSpaces(p, end);
+
+	int index = 0;
+	if (!ParseInt(p, end, index))
+		return false;
+
+	corner.position = ResolveIndex(index, positionCount);
+	corner.uv = -1;
+	corner.normal = -1;
+
+	if (p < end && *p == '/')
+	{
+		p++;
+
+		//uv index is optional ("v//vn")
+		if (ParseInt(p, end, index))
+			corner.uv = ResolveIndex(index, uvCount);
+
+		if (p < end && *p == '/')
+		{
+			p++;
+			if (ParseInt(p, end, index))
+				corner.normal = ResolveIndex(index, normalCount);
+		}
+	}
+
+	//skip anything left in this token that we don't understand
+	while (p < end && !IsSpace(*p) && *p != '\n')
+		p++;
+
+	return true;
+}
+
+// Counts the corners on a face line without resolving anything
+static int CountCorners(const char* p, const char* end)
+{
+	int count = 0;
+	while (true)
+	{
+		SkipSpaces(p, end);
+		if (p >= end || *p == '\n' || *p == '#')
+			return count;
+
+		count++;
+		while (p < end && !IsSpace(*p) && *p != '\n')
+			p++;
+	}
+}
+
+// Builds the final, left-handed vertex for one corner of a face
+static Vertex MakeVertex(const ObjCorner& corner,
+	const std::vector<XMFLOAT3>& positions,
+	const std::vector<XMFLOAT2>& uvs,
+	const std::vector<XMFLOAT3>& normals)
+{
+	Vertex v = {};
+
+	if (corner.position >= 0 && corner.position < (int)positions.size())
+		v.Position = positions[corner.position];
+
+	if (corner.uv >= 0 && corner.uv < (int)uvs.size())
+		v.uv = uvs[corner.uv];
+
+	if (corner.normal >= 0 && corner.normal < (int)normals.size())
+		v.normal = normals[corner.normal];
+
+	// The model is most likely in a right-handed space,
+	// especially if it came from Maya.  We want to convert
+	// to a left-handed space for DirectX.  This means we
+	// need to:
+	//  - Invert the Z position
+	//  - Invert the normal's Z
+	//  - Flip the winding order (done by the caller)
+	// We also need to flip the UV coordinate since DirectX
+	// defines (0,0) as the top left of the texture, and many
+	// 3D modeling packages use the bottom left as (0,0)
+	v.uv.y = 1.0f - v.uv.y;
+	v.Position.z *= -1.0f;
+	v.normal.z *= -1.0f;
+
+	return v;
+}
+
+// --------------------------------------------------------
+// Open-addressing hash table that maps a corner's
+// (position, uv, normal) index triple to the vertex that
+// was already created for it
+// --------------------------------------------------------
+class CornerWelder
+{
+public:
+	CornerWelder(size_t maxVertices)
+	{
+		// Keep the table at most half full so probes stay short
+		size_t capacity = 16;
+		while (capacity < maxVertices * 2)
+			capacity <<= 1;
+
+		slots.assign(capacity, -1);
+		mask = capacity - 1;
+		keys.reserve(maxVertices);
+	}
+
+	// Returns the existing vertex for this corner, or -1 after
+	// reserving the next vertex index for it
+	int FindOrAdd(const ObjCorner& corner, unsigned int newIndex)
+	{
+		size_t slot = Hash(corner) & mask;
+		while (slots[slot] != -1)
+		{
+			const ObjCorner& key = keys[slots[slot]];
+			if (key.position == corner.position && key.uv == corner.uv && key.normal == corner.normal)
+				return slots[slot];
+
+			slot = (slot + 1) & mask;
+		}
+
+		slots[slot] = (int)newIndex;
+		keys.push_back(corner);
+		return -1;
+	}
+
+private:
+	std::vector<int> slots;
+	std::vector<ObjCorner> keys;
+	size_t mask;
+
+	static size_t Hash(const ObjCorner& corner)
+	{
+		size_t h = (size_t)(unsigned int)corner.position * 73856093u;
+		h ^= (size_t)(unsigned int)corner.uv * 19349663u;
+		h ^= (size_t)(unsigned int)corner.normal * 83492791u;
+		return h ^ (h >> 16);
+	}
+};
+
+bool ReadFileToBuffer(const char* fileName, std::vector<char>& buffer)
+{
+	std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+		return false;
+
+	std::streamsize size = file.tellg();
+	if (size < 0)
+		return false;
+
+	file.seekg(0, std::ios::beg);
+	buffer.resize((size_t)size);
+
+	if (size > 0 && !file.read(&buffer[0], size))
+		return false;
+
+	return true;
+}
+
+bool ParseObj(const char* data, size_t size, ObjMeshData& meshData, bool weldVertices)
+{
+	const char* end = data + size;
+
+	// First pass - count everything so each vector
+	// is allocated exactly once
+	size_t positionCount = 0;
+	size_t uvCount = 0;
+	size_t normalCount = 0;
+	size_t triangleCount = 0;
+	int maxCorners = 0;
+
+	for (const char* p = data; p < end; SkipLine(p, end))
+	{
+		SkipSpaces(p, end);
+		if (end - p < 2)
+			continue;
+
+		if (p[0] == 'v' && IsSpace(p[1]))
+			positionCount++;
+		else if (p[0] == 'v' && p[1] == 't')
+			uvCount++;
+		else if (p[0] == 'v' && p[1] == 'n')
+			normalCount++;
+		else if (p[0] == 'f' && IsSpace(p[1]))
+		{
+			int corners = CountCorners(p + 1, end);
+			if (corners >= 3)
+				triangleCount += corners - 2;
+			if (corners > maxCorners)
+				maxCorners = corners;
+		}
+	}
+
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT2> uvs;
+	std::vector<XMFLOAT3> normals;
+	std::vector<ObjCorner> corners;
+	positions.reserve(positionCount);
+	uvs.reserve(uvCount);
+	normals.reserve(normalCount);
+	corners.resize(maxCorners);
+
+	meshData.vertices.clear();
+	meshData.indices.clear();
+	meshData.vertices.reserve(triangleCount * 3);
+	meshData.indices.reserve(triangleCount * 3);
+
+	// Worst case is still one vertex per corner
+	CornerWelder welder(weldVertices ? triangleCount * 3 : 0);
+
+	// Second pass - actually read the data
+	for (const char* p = data; p < end; SkipLine(p, end))
+	{
+		SkipSpaces(p, end);
+		if (end - p < 2)
+			continue;
+
+		if (p[0] == 'v' && IsSpace(p[1]))
+		{
+			p += 1;
+			XMFLOAT3 pos = {};
+			ParseFloat(p, end, pos.x);
+			ParseFloat(p, end, pos.y);
+			ParseFloat(p, end, pos.z);
+			positions.push_back(pos);
+		}
+		else if (p[0] == 'v' && p[1] == 't')
+		{
+			p += 2;
+			XMFLOAT2 uv = {};
+			ParseFloat(p, end, uv.x);
+			ParseFloat(p, end, uv.y);
+			uvs.push_back(uv);
+		}
+		else if (p[0] == 'v' && p[1] == 'n')
+		{
+			p += 2;
+			XMFLOAT3 norm = {};
+			ParseFloat(p, end, norm.x);
+			ParseFloat(p, end, norm.y);
+			ParseFloat(p, end, norm.z);
+			normals.push_back(norm);
+		}
+		else if (p[0] == 'f' && IsSpace(p[1]))
+		{
+			p += 1;
+
+			int cornerCount = 0;
+			while (cornerCount < maxCorners &&
+				ParseCorner(p, end, positions.size(), uvs.size(), normals.size(), corners[cornerCount]))
+			{
+				cornerCount++;
+			}
+
+			// Triangulate any polygon as a fan around the first corner,
+			// flipping the winding order of each triangle as we go
+			for (int i = 1; i + 1 < cornerCount; i++)
+			{
+				const ObjCorner* triangle[3] = { &corners[0], &corners[i + 1], &corners[i] };
+				for (int c = 0; c < 3; c++)
+				{
+					unsigned int index = (unsigned int)meshData.vertices.size();
+
+					if (weldVertices)
+					{
+						int existing = welder.FindOrAdd(*triangle[c], index);
+						if (existing != -1)
+						{
+							meshData.indices.push_back((unsigned int)existing);
+							continue;
+						}
+					}
+
+					meshData.vertices.push_back(MakeVertex(*triangle[c], positions, uvs, normals));
+					meshData.indices.push_back(index);
+				}
+			}
+		}
+	}
+
+	// Welding usually leaves a lot of the reserved space unused
+	meshData.vertices.shrink_to_fit();
+
+	meshData.stats.inputCorners = (unsigned int)meshData.indices.size();
+	meshData.stats.uniqueVertices = (unsigned int)meshData.vertices.size();
+	meshData.stats.bytesSaved = (meshData.stats.inputCorners - meshData.stats.uniqueVertices) * sizeof(Vertex);
+
+	return true;
+}
+
+bool LoadObjFile(const char* fileName, ObjMeshData& meshData, bool weldVertices)
+{
+	std::vector<char> buffer;
+	if (!ReadFileToBuffer(fileName, buffer))
+		return false;
+
+	if (buffer.empty())
+		return false;
+
+	return ParseObj(&buffer[0], buffer.size(), meshData, weldVertices);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Vertex.h"
+#include <vector>
+#include <cstddef>
+
+// --------------------------------------------------------
+// Numbers describing how much welding saved during import
+// --------------------------------------------------------
+struct ObjImportStats
+{
+	unsigned int inputCorners;		// Triangle corners read from the file (old vertex count)
+	unsigned int uniqueVertices;	// Vertices left after welding identical corners
+	unsigned int bytesSaved;		// Vertex buffer memory saved by welding
+};
+
+// --------------------------------------------------------
+// CPU-side geometry produced by the OBJ parser, ready to be
+// handed to a Mesh for buffer creation
+// --------------------------------------------------------
+struct ObjMeshData
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	ObjImportStats stats = {};
+};
+
+// Reads the whole file into memory in one call
+bool ReadFileToBuffer(const char* fileName, std::vector<char>& buffer);
+
+// Parses OBJ text that is already in memory (no Direct3D required)
+// - When weldVertices is true, face corners that share the same
+//   position/uv/normal indices become a single indexed vertex
+bool ParseObj(const char* data, size_t size, ObjMeshData& meshData, bool weldVertices = true);
+
+// Convenience wrapper for ReadFileToBuffer() + ParseObj()
+bool LoadObjFile(const char* fileName, ObjMeshData& meshData, bool weldVertices = true);
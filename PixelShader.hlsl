@@ -1,25 +1,50 @@
 #include "ShaderIncludes.hlsli"
 
-#define MAX_LIGHTS 128
+// Must match LightClusterBuilder.h
+#define LIGHT_CLUSTERS_X 16
+#define LIGHT_CLUSTERS_Y 9
+#define LIGHT_CLUSTERS_Z 24
+#define MAX_OBJECT_LIGHTS 8 // Must match LightSelector.h
+#define MAX_SHADOW_CASCADES 4 // Must match ShadowCascades.h
 static const float F0_NON_METAL = 0.04f;
 
-cbuffer ExternalData : register(b0)
+// Split by how often the data changes
+cbuffer PerFrame : register(b0)
 {
-    float4 colorTint;
-    float roughness;
     float3 cameraPosition;
+    int directionalLightNum; // the first lights in Lights, applied everywhere
     float3 ambient;
-    Light lights[MAX_LIGHTS];
-    int lightNum;
+    float clusterSliceScale; // depth slice = log(view depth) * scale + bias
+    float3 cameraForward;
+    float clusterSliceBias;
+    float2 clusterTileScale; // clusters per pixel across and down the screen
+    int shadowCascadeNum;
+    float4 shadowCascadeEnds; // view depth where each cascade stops
+    matrix shadowMatrices[MAX_SHADOW_CASCADES]; // light view * projection per cascade
+}
+
+cbuffer PerMaterial : register(b1)
+{
+    float4 colorTint;
+    float roughness;
     float2 uvOffset;
+}
+
+cbuffer PerObject : register(b2)
+{
     int useGammaCorrection;
+    int objectLightNum; // negative: use this pixel's light cluster instead
+    uint4 objectLights[MAX_OBJECT_LIGHTS / 4]; // indices into Lights, four per element
 }
 
 Texture2D AlbedoMap : register(t0); // "t" registers for textures
 Texture2D NormalMap : register(t1);
 Texture2D RoughnessMap : register(t2);
 Texture2D MetalnessMap : register(t3);
-Texture2D ShadowMap : register(t4);
+Texture2DArray ShadowMap : register(t4); // one slice per cascade
+StructuredBuffer<Light> Lights : register(t5);
+StructuredBuffer<uint2> LightClusters : register(t6); // offset and count in LightIndices
+StructuredBuffer<uint> LightIndices : register(t7);
 SamplerState BasicSampler : register(s0); // "s" registers for samplers
 SamplerComparisonState ShadowSampler : register(s1);
 
@@ -52,7 +77,7 @@ float4 main(VertexToPixel input) : SV_TARGET
     //uncorrect the gamma from the texture if using gammaCorrect
     surfaceColor = useGammaCorrection ? pow(surfaceColor, 2.2f) : surfaceColor;
     
-    surfaceColor *= colorTint.rgb;
+    surfaceColor *= colorTint.rgb * input.tint.rgb;
     
     float roughness = RoughnessMap.Sample(BasicSampler, input.uv).r;
     
@@ -64,27 +89,56 @@ float4 main(VertexToPixel input) : SV_TARGET
     float3 specularColor = lerp(F0_NON_METAL, surfaceColor.rgb, metalness);
     
     
-    // Perform the perspective divide (divide by W) ourselves
-    input.shadowMapPos /= input.shadowMapPos.w;
-    // Convert the normalized device coordinates to UVs for sampling
-    float2 shadowUV = input.shadowMapPos.xy * 0.5f + 0.5f;
-    shadowUV.y = 1 - shadowUV.y; // Flip the Y
-    // Grab the distances we need: light-to-pixel and closest-surface
-    float distToLight = input.shadowMapPos.z;
+    // Cascade whose depth range holds this pixel (the ones it's past are counted)
+    float viewDepth = dot(input.worldPosition - cameraPosition, cameraForward);
+    int cascade = (int)dot((float4)(viewDepth > shadowCascadeEnds), float4(1, 1, 1, 1));
+    float shadowAmount = 1.0f;
     
-    float shadowAmount = ShadowMap.SampleCmpLevelZero(ShadowSampler,shadowUV,distToLight).r;
+    if (cascade < shadowCascadeNum)
+    {
+        // Orthographic, so no divide by W is needed
+        float4 shadowMapPos = mul(shadowMatrices[cascade], float4(input.worldPosition, 1.0f));
+        // Convert the normalized device coordinates to UVs for sampling
+        float2 shadowUV = shadowMapPos.xy * 0.5f + 0.5f;
+        shadowUV.y = 1 - shadowUV.y; // Flip the Y
+        // Grab the distances we need: light-to-pixel and closest-surface
+        float distToLight = shadowMapPos.z;
+        
+        shadowAmount = ShadowMap.SampleCmpLevelZero(ShadowSampler, float3(shadowUV, cascade), distToLight).r;
+    }
     
     float3 lightSum = float3(0,0,0);
    
-    int lightUsed = lightNum > MAX_LIGHTS ? MAX_LIGHTS : lightNum;
-    
-    for (int i = 0; i < lightUsed; i++)
+    for (int i = 0; i < directionalLightNum; i++)
     {
-        float3 lightResult = GetLightColorCookTorrenceSpecular(lights[i], input.normal, cameraPosition, input.worldPosition, roughness, metalness, surfaceColor, specularColor);
+        float3 lightResult = GetLightColorCookTorrenceSpecular(Lights[i], input.normal, cameraPosition, input.worldPosition, roughness, metalness, surfaceColor, specularColor);
         
         lightSum += i == 0 ? (lightResult * shadowAmount) : lightResult;
     }
     
+    // Point and spot lights picked for the whole object on the CPU, or
+    // only those from this pixel's cluster
+    if (objectLightNum >= 0)
+    {
+        for (int j = 0; j < objectLightNum; j++)
+        {
+            lightSum += GetLightColorCookTorrenceSpecular(Lights[objectLights[j / 4][j % 4]], input.normal, cameraPosition, input.worldPosition, roughness, metalness, surfaceColor, specularColor);
+        }
+    }
+    else
+    {
+        uint3 cluster = uint3(
+            input.screenPosition.xy * clusterTileScale,
+            max(log(max(viewDepth, 0.0001f)) * clusterSliceScale + clusterSliceBias, 0.0f));
+        cluster = min(cluster, uint3(LIGHT_CLUSTERS_X - 1, LIGHT_CLUSTERS_Y - 1, LIGHT_CLUSTERS_Z - 1));
+        uint2 range = LightClusters[(cluster.z * LIGHT_CLUSTERS_Y + cluster.y) * LIGHT_CLUSTERS_X + cluster.x];
+    
+        for (uint k = 0; k < range.y; k++)
+        {
+            lightSum += GetLightColorCookTorrenceSpecular(Lights[LightIndices[range.x + k]], input.normal, cameraPosition, input.worldPosition, roughness, metalness, surfaceColor, specularColor);
+        }
+    }
+    
     //aply gamma correction
     lightSum = useGammaCorrection ? pow(lightSum, 1.0f / 2.2f) : lightSum;
     
@@ -0,0 +1,208 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+// Singleton requirement
+Profiler* Profiler::instance;
+std::atomic<bool> Profiler::capturing(true);
+thread_local Profiler::ThreadBuffer* Profiler::currentBuffer = 0;
+
+// Scopes open on this thread, and the name its ring gets
+static thread_local unsigned int currentDepth = 0;
+static thread_local std::string currentThreadName;
+
+Profiler::Profiler() :
+	origin(std::chrono::steady_clock::now()),
+	dropped(0),
+	frameCount(0),
+	frameStart(0)
+{
+}
+
+Profiler::~Profiler()
+{
+}
+
+void Profiler::SetCapturing(bool capture)
+{
+	capturing = capture;
+}
+
+void Profiler::NameCurrentThread(const std::string& name)
+{
+	currentThreadName = name;
+}
+
+long long Profiler::Now() const
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+long long Profiler::BeginScope()
+{
+	currentDepth++;
+	return Now();
+}
+
+void Profiler::EndScope(const char* name, long long start)
+{
+	long long end = Now();
+	currentDepth--;
+
+	ThreadBuffer* buffer = GetThreadBuffer();
+	unsigned int written = buffer->written.load(std::memory_order_relaxed);
+	if (written - buffer->read.load(std::memory_order_acquire) >= PROFILER_THREAD_EVENTS)
+	{
+		dropped++;
+		return;
+	}
+
+	ProfileEvent& e = buffer->events[written % PROFILER_THREAD_EVENTS];
+	e.name = name;
+	e.start = start;
+	e.end = end;
+	e.thread = buffer->index;
+	e.depth = currentDepth;
+
+	// Published after the event itself, for EndFrame() on the main thread
+	buffer->written.store(written + 1, std::memory_order_release);
+}
+
+void Profiler::BeginFrame()
+{
+	frameStart = Now();
+}
+
+void Profiler::EndFrame()
+{
+	bool keep = IsCapturing();
+	ProfileFrame& frame = frames[frameCount % PROFILER_FRAME_HISTORY];
+	if (keep)
+	{
+		frame.start = frameStart;
+		frame.end = Now();
+		frame.events.clear();
+	}
+
+	// Every ring is emptied, even when paused, so none of them fill up
+	std::lock_guard<std::mutex> lock(threadLock);
+	for (auto& buffer : threads)
+	{
+		unsigned int written = buffer->written.load(std::memory_order_acquire);
+		unsigned int read = buffer->read.load(std::memory_order_relaxed);
+		if (keep)
+		{
+			for (; read != written; read++)
+				frame.events.push_back(buffer->events[read % PROFILER_THREAD_EVENTS]);
+		}
+		buffer->read.store(written, std::memory_order_release);
+	}
+
+	if (!keep)
+		return;
+
+	std::sort(frame.events.begin(), frame.events.end(), [](const ProfileEvent& a, const ProfileEvent& b)
+	{
+		if (a.thread != b.thread)
+			return a.thread < b.thread;
+		if (a.start != b.start)
+			return a.start < b.start;
+		return a.depth < b.depth;
+	});
+
+	frameCount++;
+}
+
+unsigned int Profiler::GetFrameCount() const
+{
+	return std::min(frameCount, (unsigned int)PROFILER_FRAME_HISTORY);
+}
+
+const ProfileFrame& Profiler::GetFrame(unsigned int framesAgo) const
+{
+	return frames[(frameCount - 1 - framesAgo) % PROFILER_FRAME_HISTORY];
+}
+
+unsigned int Profiler::GetThreadCount()
+{
+	std::lock_guard<std::mutex> lock(threadLock);
+	return (unsigned int)threads.size();
+}
+
+std::string Profiler::GetThreadName(unsigned int thread)
+{
+	std::lock_guard<std::mutex> lock(threadLock);
+	return thread < threads.size() ? threads[thread]->name : std::string();
+}
+
+// Names come from code (string literals), but quotes or
+// backslashes in one would still break the whole file
+static void WriteJsonString(std::ofstream& file, const char* text)
+{
+	file << '"';
+	for (const char* c = text; *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+			file << '\\';
+		file << *c;
+	}
+	file << '"';
+}
+
+bool Profiler::ExportChromeTrace(const std::string& fileName)
+{
+	std::ofstream file(fileName, std::ios::trunc);
+	if (!file)
+		return false;
+
+	file << "{\"traceEvents\":[\n";
+
+	// Lane names first
+	bool first = true;
+	{
+		std::lock_guard<std::mutex> lock(threadLock);
+		for (auto& buffer : threads)
+		{
+			file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->index << ",\"args\":{\"name\":";
+			WriteJsonString(file, buffer->name.c_str());
+			file << "}}";
+			first = false;
+		}
+	}
+
+	// Complete events, oldest frame first, times in microseconds
+	char times[64];
+	for (unsigned int f = GetFrameCount(); f > 0; f--)
+	{
+		for (const ProfileEvent& e : GetFrame(f - 1).events)
+		{
+			snprintf(times, sizeof(times), "\"ts\":%.3f,\"dur\":%.3f", e.start / 1000.0, (e.end - e.start) / 1000.0);
+			file << (first ? "" : ",\n") << "{\"name\":";
+			WriteJsonString(file, e.name);
+			file << ",\"cat\":\"cpu\",\"ph\":\"X\"," << times << ",\"pid\":1,\"tid\":" << e.thread << "}";
+			first = false;
+		}
+	}
+
+	file << "\n]}\n";
+	return (bool)file;
+}
+
+// First scope a thread ends gives it a ring and a lane
+Profiler::ThreadBuffer* Profiler::GetThreadBuffer()
+{
+	if (currentBuffer)
+		return currentBuffer;
+
+	std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+	buffer->written = 0;
+	buffer->read = 0;
+
+	std::lock_guard<std::mutex> lock(threadLock);
+	buffer->index = (unsigned int)threads.size();
+	buffer->name = currentThreadName.empty() ? "Thread " + std::to_string(buffer->index) : currentThreadName;
+	currentBuffer = buffer.get();
+	threads.push_back(std::move(buffer));
+	return currentBuffer;
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 0 compiles every PROFILE_SCOPE away
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+#define PROFILER_FRAME_HISTORY 120	// Frames kept for the UI and trace export
+#define PROFILER_THREAD_EVENTS 4096	// Scopes a thread can end between two EndFrame()s
+
+// One finished scope
+struct ProfileEvent
+{
+	const char* name;	// Has to outlive the profiler (a string literal)
+	long long start;	// Nanoseconds since the profiler was created
+	long long end;
+	unsigned int thread;	// Index into GetThreadName()
+	unsigned int depth;		// Scopes open around it on the same thread
+};
+
+// Every scope that ended between one EndFrame() and the next,
+// sorted by thread then start time
+struct ProfileFrame
+{
+	long long start = 0;
+	long long end = 0;
+	std::vector<ProfileEvent> events;
+};
+
+// --------------------------------------------------------
+// Scoped CPU timing, nested and per thread.
+//
+// PROFILE_SCOPE("Name") times the rest of the block it's in.
+// Ending a scope writes one event into a ring that belongs
+// to the thread (no locks, nothing shared with the others),
+// and EndFrame() moves every thread's events into a history
+// of the last PROFILER_FRAME_HISTORY frames.
+//
+// With capture off a scope costs one relaxed atomic load,
+// and with PROFILER_ENABLED 0 it compiles to nothing.
+//
+// Created on the main thread before any job could use it.
+// --------------------------------------------------------
+class Profiler
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static Profiler& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new Profiler();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	Profiler(Profiler const&) = delete;
+	void operator=(Profiler const&) = delete;
+
+private:
+	static Profiler* instance;
+	Profiler();
+#pragma endregion
+
+public:
+	~Profiler();
+
+	static bool IsCapturing() { return capturing.load(std::memory_order_relaxed); }
+	void SetCapturing(bool capture);
+
+	// Name for the calling thread's lane, used when it first records a scope
+	static void NameCurrentThread(const std::string& name);
+
+	long long Now() const;
+
+	// Used by ProfileScope
+	long long BeginScope();
+	void EndScope(const char* name, long long start);
+
+	// Main thread, around everything a frame does
+	void BeginFrame();
+	void EndFrame();
+
+	// 0 is the last finished frame, up to GetFrameCount() - 1
+	unsigned int GetFrameCount() const;
+	const ProfileFrame& GetFrame(unsigned int framesAgo) const;
+
+	unsigned int GetThreadCount();
+	std::string GetThreadName(unsigned int thread);
+	unsigned int GetDroppedCount() const { return dropped.load(); }	// Scopes lost to a full ring
+
+	// Every frame in the history as Chrome trace JSON (chrome://tracing, Perfetto)
+	bool ExportChromeTrace(const std::string& fileName);
+
+private:
+	// Written only by its thread, read only by EndFrame()
+	struct ThreadBuffer
+	{
+		unsigned int index;
+		std::string name;
+		ProfileEvent events[PROFILER_THREAD_EVENTS];
+		std::atomic<unsigned int> written;
+		std::atomic<unsigned int> read;
+	};
+
+	static std::atomic<bool> capturing;
+	static thread_local ThreadBuffer* currentBuffer;
+
+	std::chrono::steady_clock::time_point origin;
+
+	std::mutex threadLock;	// Guards the list, not the buffers in it
+	std::vector<std::unique_ptr<ThreadBuffer>> threads;
+	std::atomic<unsigned int> dropped;
+
+	ProfileFrame frames[PROFILER_FRAME_HISTORY];
+	unsigned int frameCount;	// Frames finished, the newest at (frameCount - 1) % PROFILER_FRAME_HISTORY
+	long long frameStart;
+
+	ThreadBuffer* GetThreadBuffer();
+};
+
+// Times its own lifetime
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name) :
+		name(name),
+		start(-1)
+	{
+		if (Profiler::IsCapturing())
+			start = Profiler::GetInstance().BeginScope();
+	}
+
+	~ProfileScope()
+	{
+		if (start >= 0)
+			Profiler::GetInstance().EndScope(name, start);
+	}
+
+	ProfileScope(ProfileScope const&) = delete;
+	void operator=(ProfileScope const&) = delete;
+
+private:
+	const char* name;
+	long long start;
+};
+
+#if PROFILER_ENABLED
+#define PROFILE_SCOPE_JOIN(a, b) a##b
+#define PROFILE_SCOPE_NAME(id) PROFILE_SCOPE_JOIN(profileScope, id)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_SCOPE_NAME(__COUNTER__)(name)
+#else
+#define PROFILE_SCOPE(name)
+#endif
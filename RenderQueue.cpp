@@ -0,0 +1,130 @@
+#include "RenderQueue.h"
+
+// Field widths and positions within the sort key
+#define KEY_DEPTH_BITS 24
+#define KEY_MESH_BITS 14
+#define KEY_MATERIAL_BITS 14
+#define KEY_SHADER_BITS 10
+#define KEY_MESH_SHIFT KEY_DEPTH_BITS
+#define KEY_MATERIAL_SHIFT (KEY_MESH_SHIFT + KEY_MESH_BITS)
+#define KEY_SHADER_SHIFT (KEY_MATERIAL_SHIFT + KEY_MATERIAL_BITS)
+#define KEY_PASS_SHIFT (KEY_SHADER_SHIFT + KEY_SHADER_BITS)
+
+// Everything but depth - draws with the same state bits need no binds in between
+#define KEY_STATE_MASK (~((1ull << KEY_DEPTH_BITS) - 1))
+
+unsigned long long RenderQueue::MakeSortKey(unsigned int pass, unsigned int shaderId, unsigned int materialId, unsigned int meshId, float depth01)
+{
+	depth01 = depth01 < 0.0f ? 0.0f : depth01 > 1.0f ? 1.0f : depth01;
+	unsigned long long depth = (unsigned long long)(depth01 * (float)((1u << KEY_DEPTH_BITS) - 1));
+
+	return
+		((unsigned long long)(pass & 0x3) << KEY_PASS_SHIFT) |
+		((unsigned long long)(shaderId & ((1u << KEY_SHADER_BITS) - 1)) << KEY_SHADER_SHIFT) |
+		((unsigned long long)(materialId & ((1u << KEY_MATERIAL_BITS) - 1)) << KEY_MATERIAL_SHIFT) |
+		((unsigned long long)(meshId & ((1u << KEY_MESH_BITS) - 1)) << KEY_MESH_SHIFT) |
+		depth;
+}
+
+unsigned int RenderQueue::GetResourceId(const void* resource)
+{
+	auto found = resourceIds.find(resource);
+	if (found != resourceIds.end())
+		return found->second;
+
+	unsigned int id = (unsigned int)resourceIds.size();
+	resourceIds.insert({ resource, id });
+	return id;
+}
+
+unsigned int RenderQueue::FindResourceId(const void* resource) const
+{
+	auto found = resourceIds.find(resource);
+	return found != resourceIds.end() ? found->second : RENDER_QUEUE_UNKNOWN_ID;
+}
+
+void RenderQueue::Clear()
+{
+	items.clear();
+	packets.clear();
+	resourceIds.clear();
+}
+
+void RenderQueue::Submit(unsigned long long sortKey, RenderPacket packet)
+{
+	items.push_back({ sortKey, (unsigned int)packets.size() });
+	packets.push_back(packet);
+}
+
+// LSD radix sort, one byte per pass.  It's stable, so draws with equal keys
+// stay in submission order, and passes where every key has the same byte
+// (common for the pass and shader bits) are skipped.
+void RenderQueue::Sort()
+{
+	stats.draws = (unsigned int)items.size();
+	stats.stateChangesSubmitted = CountStateChanges(items);
+
+	scratch.resize(items.size());
+	for (unsigned int shift = 0; shift < 64; shift += 8)
+	{
+		unsigned int offsets[256] = {};
+		for (const Item& item : items)
+			offsets[(item.key >> shift) & 0xFF]++;
+
+		// Nothing moves if everything landed in one bucket
+		if (offsets[(items.empty() ? 0 : items[0].key >> shift) & 0xFF] == items.size())
+			continue;
+
+		unsigned int total = 0;
+		for (unsigned int b = 0; b < 256; b++)
+		{
+			unsigned int count = offsets[b];
+			offsets[b] = total;
+			total += count;
+		}
+
+		for (const Item& item : items)
+			scratch[offsets[(item.key >> shift) & 0xFF]++] = item;
+
+		items.swap(scratch);
+	}
+
+	stats.stateChangesSorted = CountStateChanges(items);
+}
+
+unsigned int RenderQueue::GetCount() const
+{
+	return (unsigned int)items.size();
+}
+
+const RenderPacket& RenderQueue::GetPacket(unsigned int sortedIndex) const
+{
+	return packets[items[sortedIndex].packet];
+}
+
+unsigned long long RenderQueue::GetSortKey(unsigned int sortedIndex) const
+{
+	return items[sortedIndex].key;
+}
+
+RenderQueueStats RenderQueue::GetStats() const
+{
+	return stats;
+}
+
+// Counts each shader, material and mesh field that differs from the previous draw
+unsigned int RenderQueue::CountStateChanges(const std::vector<Item>& list)
+{
+	unsigned int changes = 0;
+	for (unsigned int i = 1; i < list.size(); i++)
+	{
+		unsigned long long difference = (list[i].key ^ list[i - 1].key) & KEY_STATE_MASK;
+		if (difference == 0)
+			continue;
+
+		changes += (difference >> KEY_SHADER_SHIFT) & ((1ull << (KEY_SHADER_BITS + 2)) - 1) ? 1 : 0;
+		changes += (difference >> KEY_MATERIAL_SHIFT) & ((1ull << KEY_MATERIAL_BITS) - 1) ? 1 : 0;
+		changes += (difference >> KEY_MESH_SHIFT) & ((1ull << KEY_MESH_BITS) - 1) ? 1 : 0;
+	}
+	return changes;
+}
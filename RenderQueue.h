@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+
+// Passes, in the order they're drawn (top 2 bits of the sort key)
+#define RENDER_PASS_OPAQUE 0
+#define RENDER_PASS_SKY 2
+
+// FindResourceId() result for something that hasn't been given an ID
+#define RENDER_QUEUE_UNKNOWN_ID 0xFFFFFFFF
+
+// --------------------------------------------------------
+// What to draw, interpreted by whoever submitted it
+// (e.g. "entity 3" or "instance batch 1")
+// --------------------------------------------------------
+struct RenderPacket
+{
+	unsigned int command;
+	unsigned int index;
+};
+
+struct RenderQueueStats
+{
+	unsigned int draws = 0;
+	unsigned int stateChangesSubmitted = 0;	// Shader/material/mesh changes if drawn in submission order
+	unsigned int stateChangesSorted = 0;	// The same, after sorting
+};
+
+// --------------------------------------------------------
+// Collects a frame's draws as (sort key, packet) pairs and
+// orders them with a radix sort on the key.
+//
+// Key layout, most significant bits first:
+//   pass      2 bits
+//   shader   10 bits
+//   material 14 bits
+//   mesh     14 bits
+//   depth    24 bits  (0 = near plane, so opaque draws go front to back)
+//
+// Sorting by the key keeps draws that share a shader, then a
+// material, then a mesh next to each other, so fewer binds
+// change between neighbouring draws.  IDs wider than their
+// field are masked, which only costs some extra state changes.
+// --------------------------------------------------------
+class RenderQueue
+{
+public:
+	static unsigned long long MakeSortKey(unsigned int pass, unsigned int shaderId, unsigned int materialId, unsigned int meshId, float depth01);
+
+	// Small IDs for packing shaders/materials/meshes into keys, handed
+	// out in first-seen order.  They only last until Clear(), so the
+	// fields never fill up with resources that are gone, and an address
+	// reused by a new resource never sorts under an old one's ID.
+	unsigned int GetResourceId(const void* resource);
+
+	// Lookup only, so any number of threads can call it while nothing
+	// calls GetResourceId() or Clear().  RENDER_QUEUE_UNKNOWN_ID if the
+	// resource has no ID yet.
+	unsigned int FindResourceId(const void* resource) const;
+
+	// Forgets the submitted draws and the resource IDs
+	void Clear();
+	void Submit(unsigned long long sortKey, RenderPacket packet);
+
+	// Orders everything submitted since Clear() and updates the stats
+	void Sort();
+
+	unsigned int GetCount() const;
+	const RenderPacket& GetPacket(unsigned int sortedIndex) const;	// Valid after Sort()
+	unsigned long long GetSortKey(unsigned int sortedIndex) const;
+	RenderQueueStats GetStats() const;
+
+private:
+	struct Item
+	{
+		unsigned long long key;
+		unsigned int packet;
+	};
+
+	std::vector<Item> items;
+	std::vector<Item> scratch;
+	std::vector<RenderPacket> packets;
+	std::unordered_map<const void*, unsigned int> resourceIds;
+	RenderQueueStats stats;
+
+	static unsigned int CountStateChanges(const std::vector<Item>& list);
+};
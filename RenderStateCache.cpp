@@ -0,0 +1,157 @@
+#include "RenderStateCache.h"
+
+// Singleton requirement
+RenderStateCache* RenderStateCache::instance;
+
+// Stands in for "whatever the context has", so the first bind of
+// anything (even null) always goes through after an Invalidate()
+static const void* const UnknownBinding = (const void*)~(unsigned long long)0;
+
+RenderStateCache::RenderStateCache() :
+	filteredCount(0),
+	forwardedCount(0)
+{
+	Invalidate();
+}
+
+bool RenderStateCache::Update(const void*& bound, const void* value)
+{
+	if (bound == value)
+	{
+		filteredCount++;
+		return false;
+	}
+
+	bound = value;
+	forwardedCount++;
+	return true;
+}
+
+bool RenderStateCache::UpdateShader(RenderStage stage, const void* shader)
+{
+	return Update(stages[stage].shader, shader);
+}
+
+bool RenderStateCache::UpdateConstantBuffer(RenderStage stage, unsigned int slot, const void* buffer)
+{
+	if (slot >= RENDER_STATE_CONSTANT_BUFFER_SLOTS)
+		return true;
+
+	return Update(stages[stage].constantBuffers[slot], buffer);
+}
+
+bool RenderStateCache::UpdateShaderResource(RenderStage stage, unsigned int slot, const void* srv)
+{
+	if (slot >= RENDER_STATE_SHADER_RESOURCE_SLOTS)
+		return true;
+
+	return Update(stages[stage].shaderResources[slot], srv);
+}
+
+bool RenderStateCache::UpdateSampler(RenderStage stage, unsigned int slot, const void* sampler)
+{
+	if (slot >= RENDER_STATE_SAMPLER_SLOTS)
+		return true;
+
+	return Update(stages[stage].samplers[slot], sampler);
+}
+
+bool RenderStateCache::UpdateInputLayout(const void* inputLayout)
+{
+	return Update(this->inputLayout, inputLayout);
+}
+
+bool RenderStateCache::UpdateVertexBuffer(unsigned int slot, const void* buffer, unsigned int stride, unsigned int offset)
+{
+	if (slot >= RENDER_STATE_VERTEX_BUFFER_SLOTS)
+		return true;
+
+	VertexBufferBinding& bound = vertexBuffers[slot];
+	if (bound.buffer == buffer && bound.stride == stride && bound.offset == offset)
+	{
+		filteredCount++;
+		return false;
+	}
+
+	bound.buffer = buffer;
+	bound.stride = stride;
+	bound.offset = offset;
+	forwardedCount++;
+	return true;
+}
+
+bool RenderStateCache::UpdateIndexBuffer(const void* buffer, unsigned int format, unsigned int offset)
+{
+	if (indexBuffer == buffer && indexFormat == format && indexOffset == offset)
+	{
+		filteredCount++;
+		return false;
+	}
+
+	indexBuffer = buffer;
+	indexFormat = format;
+	indexOffset = offset;
+	forwardedCount++;
+	return true;
+}
+
+bool RenderStateCache::UpdateRasterizerState(const void* state)
+{
+	return Update(rasterizerState, state);
+}
+
+bool RenderStateCache::UpdateDepthStencilState(const void* state, unsigned int stencilRef)
+{
+	if (depthStencilState == state && this->stencilRef == stencilRef)
+	{
+		filteredCount++;
+		return false;
+	}
+
+	depthStencilState = state;
+	this->stencilRef = stencilRef;
+	forwardedCount++;
+	return true;
+}
+
+void RenderStateCache::Invalidate()
+{
+	for (StageBindings& s : stages)
+	{
+		s.shader = UnknownBinding;
+		for (const void*& b : s.constantBuffers) b = UnknownBinding;
+		for (const void*& b : s.shaderResources) b = UnknownBinding;
+		for (const void*& b : s.samplers) b = UnknownBinding;
+	}
+
+	for (VertexBufferBinding& v : vertexBuffers)
+	{
+		v.buffer = UnknownBinding;
+		v.stride = 0;
+		v.offset = 0;
+	}
+
+	inputLayout = UnknownBinding;
+	indexBuffer = UnknownBinding;
+	indexFormat = 0;
+	indexOffset = 0;
+	rasterizerState = UnknownBinding;
+	depthStencilState = UnknownBinding;
+	stencilRef = 0;
+}
+
+void RenderStateCache::ResetStats()
+{
+	filteredCount = 0;
+	forwardedCount = 0;
+}
+
+unsigned int RenderStateCache::GetFilteredCount()
+{
+	return filteredCount;
+}
+
+unsigned int RenderStateCache::GetForwardedCount()
+{
+	return forwardedCount;
+}
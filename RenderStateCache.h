@@ -0,0 +1,113 @@
+#pragma once
+
+// Shader stages with their own shader/cbuffer/SRV/sampler bindings
+enum RenderStage
+{
+	RenderStageVertex,
+	RenderStagePixel,
+	RenderStageDomain,
+	RenderStageHull,
+	RenderStageGeometry,
+	RenderStageCompute,
+	RenderStageCount
+};
+
+// Slots tracked per stage (matching the D3D11 limits),
+// binds to slots past these are never filtered
+#define RENDER_STATE_CONSTANT_BUFFER_SLOTS 14
+#define RENDER_STATE_SHADER_RESOURCE_SLOTS 128
+#define RENDER_STATE_SAMPLER_SLOTS 16
+#define RENDER_STATE_VERTEX_BUFFER_SLOTS 32
+
+// --------------------------------------------------------
+// Remembers what's currently bound to the device context so
+// redundant binds can be dropped.
+//
+// Each Update function records the new binding and returns
+// true only if it differs from the current one - the caller
+// makes the actual context call only in that case:
+//
+//   if (RenderStateCache::GetInstance().UpdateShader(RenderStageVertex, shader))
+//       context->VSSetShader(shader, 0, 0);
+//
+// Nothing here touches Direct3D (objects are only compared
+// by address), so the filtering can be checked without a
+// device.  Anything that binds directly on the context has
+// to call Invalidate() afterwards.
+// --------------------------------------------------------
+class RenderStateCache
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static RenderStateCache& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new RenderStateCache();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	RenderStateCache(RenderStateCache const&) = delete;
+	void operator=(RenderStateCache const&) = delete;
+
+private:
+	static RenderStateCache* instance;
+	RenderStateCache();
+#pragma endregion
+
+public:
+	bool UpdateShader(RenderStage stage, const void* shader);
+	bool UpdateConstantBuffer(RenderStage stage, unsigned int slot, const void* buffer);
+	bool UpdateShaderResource(RenderStage stage, unsigned int slot, const void* srv);
+	bool UpdateSampler(RenderStage stage, unsigned int slot, const void* sampler);
+
+	bool UpdateInputLayout(const void* inputLayout);
+	bool UpdateVertexBuffer(unsigned int slot, const void* buffer, unsigned int stride, unsigned int offset);
+	bool UpdateIndexBuffer(const void* buffer, unsigned int format, unsigned int offset);
+	bool UpdateRasterizerState(const void* state);
+	bool UpdateDepthStencilState(const void* state, unsigned int stencilRef);
+
+	// Forgets all bindings, so the next Update of each one goes through
+	void Invalidate();
+
+	// Counters since the last ResetStats()
+	void ResetStats();
+	unsigned int GetFilteredCount();	// Redundant binds dropped
+	unsigned int GetForwardedCount();	// Binds that changed something
+
+private:
+	struct StageBindings
+	{
+		const void* shader;
+		const void* constantBuffers[RENDER_STATE_CONSTANT_BUFFER_SLOTS];
+		const void* shaderResources[RENDER_STATE_SHADER_RESOURCE_SLOTS];
+		const void* samplers[RENDER_STATE_SAMPLER_SLOTS];
+	};
+
+	struct VertexBufferBinding
+	{
+		const void* buffer;
+		unsigned int stride;
+		unsigned int offset;
+	};
+
+	StageBindings stages[RenderStageCount];
+	VertexBufferBinding vertexBuffers[RENDER_STATE_VERTEX_BUFFER_SLOTS];
+	const void* inputLayout;
+	const void* indexBuffer;
+	unsigned int indexFormat;
+	unsigned int indexOffset;
+	const void* rasterizerState;
+	const void* depthStencilState;
+	unsigned int stencilRef;
+
+	unsigned int filteredCount;
+	unsigned int forwardedCount;
+
+	// Compares, records and counts a single binding
+	bool Update(const void*& bound, const void* value);
+};
@@ -0,0 +1,76 @@
+#include "ShaderCache.h"
+#include <cassert>
+
+ShaderCache::ShaderCache(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context) :
+	device(device),
+	context(context),
+	hits(0),
+	misses(0)
+{
+}
+
+ShaderCache::~ShaderCache()
+{
+}
+
+std::shared_ptr<SimpleVertexShader> ShaderCache::GetVertexShader(const std::wstring& shaderFile)
+{
+	std::shared_ptr<ISimpleShader> cached = Find(shaderFile);
+	if (cached)
+	{
+		std::shared_ptr<SimpleVertexShader> shader = std::dynamic_pointer_cast<SimpleVertexShader>(cached);
+		if (shader)
+			hits++;
+		else
+			LogTypeMismatch(cached, shaderFile, "vertex");
+		return shader;
+	}
+
+	//first request for this file, so load it from disk once
+	misses++;
+	std::shared_ptr<SimpleVertexShader> shader = std::make_shared<SimpleVertexShader>(device, context, shaderFile.c_str());
+	shaders.insert({ shaderFile, shader });
+	return shader;
+}
+
+std::shared_ptr<SimplePixelShader> ShaderCache::GetPixelShader(const std::wstring& shaderFile)
+{
+	std::shared_ptr<ISimpleShader> cached = Find(shaderFile);
+	if (cached)
+	{
+		std::shared_ptr<SimplePixelShader> shader = std::dynamic_pointer_cast<SimplePixelShader>(cached);
+		if (shader)
+			hits++;
+		else
+			LogTypeMismatch(cached, shaderFile, "pixel");
+		return shader;
+	}
+
+	misses++;
+	std::shared_ptr<SimplePixelShader> shader = std::make_shared<SimplePixelShader>(device, context, shaderFile.c_str());
+	shaders.insert({ shaderFile, shader });
+	return shader;
+}
+
+void ShaderCache::Clear()
+{
+	shaders.clear();
+	hits = 0;
+	misses = 0;
+}
+
+std::shared_ptr<ISimpleShader> ShaderCache::Find(const std::wstring& shaderFile)
+{
+	auto result = shaders.find(shaderFile);
+	return result != shaders.end() ? result->second : nullptr;
+}
+
+// Printed like SimpleShader's load errors, but always, as the caller
+// is about to get a null shader back (and debug builds stop here)
+void ShaderCache::LogTypeMismatch(std::shared_ptr<ISimpleShader> cached, const std::wstring& shaderFile, const char* requestedType)
+{
+	cached->LogError("ShaderCache - '");
+	cached->LogW(shaderFile);
+	cached->LogError(std::string("' was already loaded as a different type of shader, not as a ") + requestedType + " shader.\n");
+	assert(!"Shader file requested as a different shader type than it was cached as");
+}
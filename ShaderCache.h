@@ -0,0 +1,46 @@
+#pragma once
+
+#include "SimpleShader.h"
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// --------------------------------------------------------
+// Owns every compiled shader for the life of the device.
+//
+// Shaders are keyed by the path of their .cso file, so asking
+// for the same file twice hands back the same object instead
+// of re-reading, re-reflecting and re-creating it.  Asking
+// for a file as a different shader type than it was loaded
+// as logs an error and returns null.
+// --------------------------------------------------------
+class ShaderCache
+{
+public:
+	ShaderCache(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	~ShaderCache();
+
+	std::shared_ptr<SimpleVertexShader> GetVertexShader(const std::wstring& shaderFile);
+	std::shared_ptr<SimplePixelShader> GetPixelShader(const std::wstring& shaderFile);
+
+	void Clear();
+
+	unsigned int GetHitCount() { return hits; }
+	unsigned int GetMissCount() { return misses; }
+	size_t GetShaderCount() { return shaders.size(); }
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+	std::unordered_map<std::wstring, std::shared_ptr<ISimpleShader>> shaders;
+
+	unsigned int hits;
+	unsigned int misses;
+
+	// Untyped lookup, the Get functions count hits once the type matches
+	std::shared_ptr<ISimpleShader> Find(const std::wstring& shaderFile);
+	void LogTypeMismatch(std::shared_ptr<ISimpleShader> cached, const std::wstring& shaderFile, const char* requestedType);
+};
@@ -36,7 +36,7 @@ struct VertexToPixel
     float2 uv : TEXCOORD;
     float3 worldPosition : POSITION;
     float3 tangent : TANGENT;
-    float4 shadowMapPos : SHADOW_POSITION;
+    float4 tint : COLOR; // Per object (or per instance) tint, on top of the material's
 };
 
 #define LIGHT_TYPE_DIRECTIONAL 0
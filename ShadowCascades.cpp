@@ -0,0 +1,95 @@
+#include "ShadowCascades.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+void ComputeShadowCascadeSplits(float nearClip, float farClip, unsigned int count, float lambda, float* splits)
+{
+	for (unsigned int i = 0; i <= count; i++)
+	{
+		float t = (float)i / count;
+		float logSplit = nearClip * powf(farClip / nearClip, t);
+		float evenSplit = nearClip + (farClip - nearClip) * t;
+		splits[i] = lambda * logSplit + (1.0f - lambda) * evenSplit;
+	}
+
+	// Exact ends, whatever the rounding above did
+	splits[0] = nearClip;
+	splits[count] = farClip;
+}
+
+void ComputeShadowCascades(
+	const XMFLOAT4X4& cameraView,
+	const XMFLOAT4X4& cameraProjection,
+	float nearClip,
+	float farClip,
+	const XMFLOAT3& lightDirection,
+	const ShadowCascadeSettings& settings,
+	ShadowCascade* cascades)
+{
+	unsigned int count = std::max(1u, std::min(settings.cascadeCount, (unsigned int)MAX_SHADOW_CASCADES));
+	float shadowFar = std::min(farClip, settings.maxDistance);
+	float splits[MAX_SHADOW_CASCADES + 1];
+	ComputeShadowCascadeSplits(nearClip, std::max(shadowFar, nearClip), count, settings.splitLambda, splits);
+
+	// Camera position and forward direction from the inverse view
+	XMMATRIX cameraWorld = XMMatrixInverse(0, XMLoadFloat4x4(&cameraView));
+	XMVECTOR cameraPosition = cameraWorld.r[3];
+	XMVECTOR cameraForward = XMVector3Normalize(cameraWorld.r[2]);
+
+	// Half size of the view at one unit of depth (perspective), or at any depth (orthographic)
+	bool orthographic = cameraProjection._34 == 0.0f;
+	float halfWidth = 1.0f / cameraProjection._11;
+	float halfHeight = 1.0f / cameraProjection._22;
+	float cornerSq = halfWidth * halfWidth + halfHeight * halfHeight;
+
+	// Light space rotation, with an up vector that isn't parallel to the light
+	XMVECTOR direction = XMVector3Normalize(XMLoadFloat3(&lightDirection));
+	XMVECTOR up = fabsf(XMVectorGetY(direction)) > 0.99f ? XMVectorSet(1, 0, 0, 0) : XMVectorSet(0, 1, 0, 0);
+	XMMATRIX lightRotation = XMMatrixLookToLH(XMVectorZero(), direction, up);
+	XMMATRIX inverseLightRotation = XMMatrixTranspose(lightRotation);
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		ShadowCascade& cascade = cascades[i];
+		float n = splits[i];
+		float f = splits[i + 1];
+		cascade.splitNear = n;
+		cascade.splitFar = f;
+
+		// Smallest sphere around the slice with its center on the view axis:
+		// equally far from the near and far corners, unless that's past the far plane
+		float centerDepth;
+		float radius;
+		if (orthographic)
+		{
+			centerDepth = (n + f) * 0.5f;
+			radius = sqrtf((f - n) * (f - n) * 0.25f + cornerSq);
+		}
+		else
+		{
+			centerDepth = std::min(f, (n + f) * (1.0f + cornerSq) * 0.5f);
+			radius = sqrtf((f - centerDepth) * (f - centerDepth) + f * f * cornerSq);
+		}
+
+		// Snap the center to the texel grid in light space, with a texel
+		// of padding around the sphere so the snapping can't cut it off
+		float halfSize = radius * settings.resolution / (settings.resolution - 2.0f);
+		float texelSize = halfSize * 2.0f / settings.resolution;
+		XMVECTOR center = XMVectorMultiplyAdd(cameraForward, XMVectorReplicate(centerDepth), cameraPosition);
+		XMFLOAT3 lightSpaceCenter;
+		XMStoreFloat3(&lightSpaceCenter, XMVector3TransformNormal(center, lightRotation));
+		lightSpaceCenter.x = floorf(lightSpaceCenter.x / texelSize) * texelSize;
+		lightSpaceCenter.y = floorf(lightSpaceCenter.y / texelSize) * texelSize;
+		center = XMVector3TransformNormal(XMLoadFloat3(&lightSpaceCenter), inverseLightRotation);
+
+		// Box starts casterDistance before the sphere (towards the light) and ends behind it
+		float depth = radius * 2.0f + settings.casterDistance;
+		XMVECTOR eye = XMVectorSubtract(center, XMVectorScale(direction, radius + settings.casterDistance));
+		XMStoreFloat4x4(&cascade.view, XMMatrixLookToLH(eye, direction, up));
+		XMStoreFloat4x4(&cascade.projection, XMMatrixOrthographicLH(halfSize * 2.0f, halfSize * 2.0f, 0.0f, depth));
+		XMStoreFloat3(&cascade.sphereCenter, center);
+		cascade.sphereRadius = radius;
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+// Slices in the shadow map array (must match PixelShader.hlsl)
+#define MAX_SHADOW_CASCADES 4
+
+struct ShadowCascadeSettings
+{
+	unsigned int cascadeCount = 4;	// 1 to MAX_SHADOW_CASCADES
+	unsigned int resolution = 1024;	// Texels along each side of one cascade
+	float splitLambda = 0.75f;		// 0 = evenly spaced splits, 1 = logarithmic
+	float maxDistance = 60.0f;		// Shadows end here when the far plane is further away
+	float casterDistance = 50.0f;	// How far towards the light a caster is still rendered
+};
+
+struct ShadowCascade
+{
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 projection;
+	float splitNear;	// Camera view depths this cascade is used for
+	float splitFar;
+	DirectX::XMFLOAT3 sphereCenter;	// Bounds of that slice of the camera frustum (after snapping)
+	float sphereRadius;
+};
+
+// --------------------------------------------------------
+// Fits one orthographic light projection to each depth
+// slice of the camera frustum.
+//
+// - Splits blend evenly spaced and logarithmic distances
+//   between the camera's near plane and its far plane (or
+//   maxDistance, whichever is closer)
+// - Each slice is bounded by a sphere, whose size doesn't
+//   change as the camera turns, so the light's box doesn't
+//   either
+// - The sphere's center is snapped to whole shadow map
+//   texels in light space, so moving the camera doesn't
+//   make shadow edges shimmer
+//
+// Only math, no Direct3D, so the results can be checked
+// without a device.  Camera matrices are the row-major ones
+// from Camera (perspective or orthographic).
+// --------------------------------------------------------
+void ComputeShadowCascades(
+	const DirectX::XMFLOAT4X4& cameraView,
+	const DirectX::XMFLOAT4X4& cameraProjection,
+	float nearClip,
+	float farClip,
+	const DirectX::XMFLOAT3& lightDirection,
+	const ShadowCascadeSettings& settings,
+	ShadowCascade* cascades);	// Room for settings.cascadeCount
+
+// Split distances only: splits[0] = near, splits[count] = far
+void ComputeShadowCascadeSplits(float nearClip, float farClip, unsigned int count, float lambda, float* splits);
@@ -1,7 +1,12 @@
 #include "ShaderIncludes.hlsli"
-cbuffer externalData : register(b0)
+cbuffer perFrame : register(b0)
 {
-    matrix world, view, projection;
+    matrix view, projection;
+};
+
+cbuffer perObject : register(b1)
+{
+    matrix world;
 };
 // --------------------------------------------------------
 // A simplified vertex shader for rendering to a shadow map
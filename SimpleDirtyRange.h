@@ -0,0 +1,50 @@
+#pragma once
+
+// --------------------------------------------------------
+// Tracks which bytes of a constant buffer's local data
+// changed since it was last uploaded, as one [Start, End)
+// range that grows to cover every write.
+//
+// Has no Direct3D dependencies, so it can be checked on
+// its own without a device.
+// --------------------------------------------------------
+struct SimpleDirtyRange
+{
+	unsigned int Start = 0;
+	unsigned int End = 0;	// One past the last dirty byte
+
+	bool IsDirty() const { return End > Start; }
+
+	void Mark(unsigned int offset, unsigned int size)
+	{
+		if (size == 0)
+			return;
+
+		if (!IsDirty())
+		{
+			Start = offset;
+			End = offset + size;
+			return;
+		}
+
+		Start = offset < Start ? offset : Start;
+		End = offset + size > End ? offset + size : End;
+	}
+
+	void MarkAll(unsigned int bufferSize) { Start = 0; End = bufferSize; }
+	void Clear() { Start = 0; End = 0; }
+
+	// The dirty range grown out to whole 16 byte constants (the
+	// granularity of partial constant buffer updates), clamped
+	// to the buffer.  Returns false if nothing is dirty.
+	bool GetAlignedRange(unsigned int bufferSize, unsigned int& alignedStart, unsigned int& alignedEnd) const
+	{
+		if (!IsDirty())
+			return false;
+
+		alignedStart = Start & ~15u;
+		alignedEnd = (End + 15u) & ~15u;
+		alignedEnd = alignedEnd > bufferSize ? bufferSize : alignedEnd;
+		return alignedEnd > alignedStart;
+	}
+};
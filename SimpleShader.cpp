@@ -1,9 +1,14 @@
 #include "SimpleShader.h"
+#include "RenderStateCache.h"
 
 // Default error reporting state
 bool ISimpleShader::ReportErrors = false;
 bool ISimpleShader::ReportWarnings = false;
 
+// Constant buffer upload options and counters, shared by all shaders
+bool ISimpleShader::UseDynamicConstantBuffers = false;
+SimpleShaderUploadStats ISimpleShader::UploadStats;
+
 // To enable error reporting, use either or both 
 // of the following lines somewhere in your program, 
 // preferably before loading/using any shaders.
@@ -28,6 +33,14 @@ ISimpleShader::ISimpleShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Micros
 	this->constantBufferCount = 0;
 	this->constantBuffers = 0;
 	this->shaderValid = false;
+
+	// Partial constant buffer updates need a D3D 11.1 context and driver support
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	if (SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) &&
+		options.ConstantBufferPartialUpdate)
+	{
+		context.As(&deviceContext1);
+	}
 }
 
 // --------------------------------------------------------
@@ -189,10 +202,10 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 
 		// Create this constant buffer
 		D3D11_BUFFER_DESC newBuffDesc = {};
-		newBuffDesc.Usage = D3D11_USAGE_DEFAULT;
+		newBuffDesc.Usage = UseDynamicConstantBuffers ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT;
 		newBuffDesc.ByteWidth = ((bufferDesc.Size + 15) / 16) * 16; // Quick and dirty 16-byte alignment using integer division
 		newBuffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-		newBuffDesc.CPUAccessFlags = 0;
+		newBuffDesc.CPUAccessFlags = UseDynamicConstantBuffers ? D3D11_CPU_ACCESS_WRITE : 0;
 		newBuffDesc.MiscFlags = 0;
 		newBuffDesc.StructureByteStride = 0;
 		device->CreateBuffer(&newBuffDesc, 0, constantBuffers[b].ConstantBuffer.GetAddressOf());
@@ -201,6 +214,8 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		constantBuffers[b].Size = bufferDesc.Size;
 		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
 		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
+		constantBuffers[b].DirtyRange.MarkAll(bufferDesc.Size);
+		constantBuffers[b].Dynamic = UseDynamicConstantBuffers;
 
 		// Loop through all variables in this buffer
 		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
@@ -344,13 +359,10 @@ void ISimpleShader::CopyAllBufferData()
 	// Ensure the shader is valid
 	if (!shaderValid) return;
 
-	// Loop through the constant buffers and copy all data
+	// Loop through the constant buffers and copy any that changed
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer.Get(), 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
+		UploadBuffer(&constantBuffers[i]);
 	}
 }
 
@@ -378,10 +390,8 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	SimpleConstantBuffer* cb = &this->constantBuffers[index];
 	if (!cb) return;
 
-	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	// Copy the data (if it changed) and get out
+	UploadBuffer(cb);
 }
 
 // --------------------------------------------------------
@@ -400,12 +410,71 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
 	if (!cb) return;
 
-	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	// Copy the data (if it changed) and get out
+	UploadBuffer(cb);
 }
 
+// --------------------------------------------------------
+// Copies a buffer's local data to the GPU, unless it hasn't
+// changed since the last upload.  The GPU buffer belongs to
+// this shader, so whatever was uploaded last is still there.
+//
+// - Dynamic buffers are mapped with WRITE_DISCARD and
+//   always get the whole buffer
+// - Otherwise, if the driver supports it, only the dirty
+//   range (in whole 16 byte constants) is sent
+// --------------------------------------------------------
+void ISimpleShader::UploadBuffer(SimpleConstantBuffer* cb)
+{
+	unsigned int start = 0;
+	unsigned int end = 0;
+	if (!cb->DirtyRange.GetAlignedRange(cb->Size, start, end))
+	{
+		UploadStats.BuffersSkipped++;
+		UploadStats.BytesSkipped += cb->Size;
+		return;
+	}
+
+	if (cb->Dynamic)
+	{
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		if (FAILED(deviceContext->Map(cb->ConstantBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+			return; // Still dirty, so the next copy tries again
+
+		memcpy(mapped.pData, cb->LocalDataBuffer, cb->Size);
+		deviceContext->Unmap(cb->ConstantBuffer.Get(), 0);
+		start = 0;
+		end = cb->Size;
+	}
+	else if (deviceContext1 && (end - start) < cb->Size)
+	{
+		// The source pointer is the start of the box's data
+		D3D11_BOX box = {};
+		box.left = start;
+		box.right = end;
+		box.bottom = 1;
+		box.back = 1;
+		deviceContext1->UpdateSubresource1(
+			cb->ConstantBuffer.Get(), 0, &box,
+			cb->LocalDataBuffer + start, 0, 0, 0);
+		UploadStats.PartialUploads++;
+	}
+	else
+	{
+		// Copy the entire local data buffer
+		deviceContext->UpdateSubresource(
+			cb->ConstantBuffer.Get(), 0, 0,
+			cb->LocalDataBuffer, 0, 0);
+		start = 0;
+		end = cb->Size;
+	}
+
+	cb->DirtyRange.Clear();
+
+	UploadStats.BuffersUploaded++;
+	UploadStats.BytesUploaded += end - start;
+	UploadStats.BytesSkipped += cb->Size - (end - start);
+}
 
 // --------------------------------------------------------
 // Sets a variable by name with arbitrary data of the specified size
@@ -444,16 +513,89 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 		return false;
 	}
 
+	SimpleVariableHandle handle;
+	handle.ConstantBufferIndex = var->ConstantBufferIndex;
+	handle.ByteOffset = var->ByteOffset;
+	handle.Size = var->Size;
+	return SetData(handle, data, size);
+}
+
+// --------------------------------------------------------
+// Looks up a variable once, so it can be set repeatedly
+// without hashing its name.  Check IsValid() on the result.
+// --------------------------------------------------------
+SimpleVariableHandle ISimpleShader::GetVariableHandle(const std::string& name)
+{
+	SimpleVariableHandle handle;
+	SimpleShaderVariable* var = FindVariable(name, -1);
+	if (var == 0)
+		return handle;
+
+	handle.ConstantBufferIndex = var->ConstantBufferIndex;
+	handle.ByteOffset = var->ByteOffset;
+	handle.Size = var->Size;
+	return handle;
+}
+
+// --------------------------------------------------------
+// Sets a variable by handle with arbitrary data of the specified size
+//
+// Returns true if data is copied, false if the handle is invalid
+// or the data is larger than the variable
+// --------------------------------------------------------
+bool ISimpleShader::SetData(SimpleVariableHandle var, const void* data, unsigned int size)
+{
+	// Also catches handles from a different shader
+	if (!var.IsValid() || size > var.Size || var.ConstantBufferIndex >= constantBufferCount)
+		return false;
+
+	SimpleConstantBuffer* cb = &constantBuffers[var.ConstantBufferIndex];
+	if (var.ByteOffset + size > cb->Size)
+		return false;
+
+	// Setting the same value again doesn't need a new upload
+	unsigned char* destination = cb->LocalDataBuffer + var.ByteOffset;
+	if (memcmp(destination, data, size) == 0)
+		return true;
+
 	// Set the data in the local data buffer
-	memcpy(
-		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
-		data,
-		size);
+	memcpy(destination, data, size);
+	cb->DirtyRange.Mark(var.ByteOffset, size);
 
 	// Success
 	return true;
 }
 
+bool ISimpleShader::SetInt(SimpleVariableHandle var, int data)
+{
+	return this->SetData(var, &data, sizeof(int));
+}
+
+bool ISimpleShader::SetFloat(SimpleVariableHandle var, float data)
+{
+	return this->SetData(var, &data, sizeof(float));
+}
+
+bool ISimpleShader::SetFloat2(SimpleVariableHandle var, const DirectX::XMFLOAT2& data)
+{
+	return this->SetData(var, &data, sizeof(float) * 2);
+}
+
+bool ISimpleShader::SetFloat3(SimpleVariableHandle var, const DirectX::XMFLOAT3& data)
+{
+	return this->SetData(var, &data, sizeof(float) * 3);
+}
+
+bool ISimpleShader::SetFloat4(SimpleVariableHandle var, const DirectX::XMFLOAT4& data)
+{
+	return this->SetData(var, &data, sizeof(float) * 4);
+}
+
+bool ISimpleShader::SetMatrix4x4(SimpleVariableHandle var, const DirectX::XMFLOAT4X4& data)
+{
+	return this->SetData(var, &data, sizeof(float) * 16);
+}
+
 // --------------------------------------------------------
 // Sets INTEGER data
 // --------------------------------------------------------
@@ -534,6 +676,30 @@ bool ISimpleShader::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 dat
 	return this->SetData(name, &data, sizeof(float) * 16);
 }
 
+// --------------------------------------------------------
+// Looks up an SRV's register once.  Check IsValid() on the result.
+// --------------------------------------------------------
+SimpleResourceHandle ISimpleShader::GetShaderResourceViewHandle(const std::string& name)
+{
+	SimpleResourceHandle handle;
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
+	if (srvInfo)
+		handle.BindIndex = srvInfo->BindIndex;
+	return handle;
+}
+
+// --------------------------------------------------------
+// Looks up a sampler's register once.  Check IsValid() on the result.
+// --------------------------------------------------------
+SimpleResourceHandle ISimpleShader::GetSamplerHandle(const std::string& name)
+{
+	SimpleResourceHandle handle;
+	const SimpleSampler* sampInfo = GetSamplerInfo(name);
+	if (sampInfo)
+		handle.BindIndex = sampInfo->BindIndex;
+	return handle;
+}
+
 // --------------------------------------------------------
 // Determines if the shader contains the specified
 // variable within one of its constant buffers
@@ -868,8 +1034,10 @@ void SimpleVertexShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader and input layout
-	deviceContext->IASetInputLayout(inputLayout.Get());
-	deviceContext->VSSetShader(shader.Get(), 0, 0);
+	if (RenderStateCache::GetInstance().UpdateInputLayout(inputLayout.Get()))
+		deviceContext->IASetInputLayout(inputLayout.Get());
+	if (RenderStateCache::GetInstance().UpdateShader(RenderStageVertex, shader.Get()))
+		deviceContext->VSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -879,10 +1047,11 @@ void SimpleVertexShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->VSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+		if (RenderStateCache::GetInstance().UpdateConstantBuffer(RenderStageVertex, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer.Get()))
+			deviceContext->VSSetConstantBuffers(
+				constantBuffers[i].BindIndex,
+				1,
+				constantBuffers[i].ConstantBuffer.GetAddressOf());
 	}
 }
 
@@ -910,7 +1079,8 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 	}
 
 	// Set the shader resource view
-	deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (RenderStateCache::GetInstance().UpdateShaderResource(RenderStageVertex, srvInfo->BindIndex, srv.Get()))
+		deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -940,12 +1110,41 @@ bool SimpleVertexShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 	}
 
 	// Set the shader resource view
-	deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (RenderStateCache::GetInstance().UpdateSampler(RenderStageVertex, sampInfo->BindIndex, samplerState.Get()))
+		deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a shader resource view in the vertex shader stage
+// using a handle from GetShaderResourceViewHandle()
+// --------------------------------------------------------
+bool SimpleVertexShader::SetShaderResourceView(SimpleResourceHandle handle, ID3D11ShaderResourceView* srv)
+{
+	if (!handle.IsValid() || handle.BindIndex >= D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT)
+		return false;
+
+	if (RenderStateCache::GetInstance().UpdateShaderResource(RenderStageVertex, handle.BindIndex, srv))
+		deviceContext->VSSetShaderResources(handle.BindIndex, 1, &srv);
+	return true;
+}
+
+// --------------------------------------------------------
+// Sets a sampler state in the vertex shader stage
+// using a handle from GetSamplerHandle()
+// --------------------------------------------------------
+bool SimpleVertexShader::SetSamplerState(SimpleResourceHandle handle, ID3D11SamplerState* samplerState)
+{
+	if (!handle.IsValid() || handle.BindIndex >= D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT)
+		return false;
+
+	if (RenderStateCache::GetInstance().UpdateSampler(RenderStageVertex, handle.BindIndex, samplerState))
+		deviceContext->VSSetSamplers(handle.BindIndex, 1, &samplerState);
+	return true;
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // ------ SIMPLE PIXEL SHADER -------------------------------------------------
@@ -1011,7 +1210,8 @@ void SimplePixelShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 	
 	// Set the shader
-	deviceContext->PSSetShader(shader.Get(), 0, 0);
+	if (RenderStateCache::GetInstance().UpdateShader(RenderStagePixel, shader.Get()))
+		deviceContext->PSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1021,10 +1221,11 @@ void SimplePixelShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->PSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+		if (RenderStateCache::GetInstance().UpdateConstantBuffer(RenderStagePixel, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer.Get()))
+			deviceContext->PSSetConstantBuffers(
+				constantBuffers[i].BindIndex,
+				1,
+				constantBuffers[i].ConstantBuffer.GetAddressOf());
 	}
 }
 
@@ -1052,7 +1253,8 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, Microsoft::WRL::
 	}
 
 	// Set the shader resource view
-	deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (RenderStateCache::GetInstance().UpdateShaderResource(RenderStagePixel, srvInfo->BindIndex, srv.Get()))
+		deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1082,12 +1284,41 @@ bool SimplePixelShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr
 	}
 
 	// Set the shader resource view
-	deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (RenderStateCache::GetInstance().UpdateSampler(RenderStagePixel, sampInfo->BindIndex, samplerState.Get()))
+		deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a shader resource view in the pixel shader stage
+// using a handle from GetShaderResourceViewHandle()
+// --------------------------------------------------------
+bool SimplePixelShader::SetShaderResourceView(SimpleResourceHandle handle, ID3D11ShaderResourceView* srv)
+{
+	if (!handle.IsValid() || handle.BindIndex >= D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT)
+		return false;
+
+	if (RenderStateCache::GetInstance().UpdateShaderResource(RenderStagePixel, handle.BindIndex, srv))
+		deviceContext->PSSetShaderResources(handle.BindIndex, 1, &srv);
+	return true;
+}
+
+// --------------------------------------------------------
+// Sets a sampler state in the pixel shader stage
+// using a handle from GetSamplerHandle()
+// --------------------------------------------------------
+bool SimplePixelShader::SetSamplerState(SimpleResourceHandle handle, ID3D11SamplerState* samplerState)
+{
+	if (!handle.IsValid() || handle.BindIndex >= D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT)
+		return false;
+
+	if (RenderStateCache::GetInstance().UpdateSampler(RenderStagePixel, handle.BindIndex, samplerState))
+		deviceContext->PSSetSamplers(handle.BindIndex, 1, &samplerState);
+	return true;
+}
+
 
 
 
@@ -1155,7 +1386,8 @@ void SimpleDomainShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->DSSetShader(shader.Get(), 0, 0);
+	if (RenderStateCache::GetInstance().UpdateShader(RenderStageDomain, shader.Get()))
+		deviceContext->DSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1165,10 +1397,11 @@ void SimpleDomainShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->DSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+		if (RenderStateCache::GetInstance().UpdateConstantBuffer(RenderStageDomain, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer.Get()))
+			deviceContext->DSSetConstantBuffers(
+				constantBuffers[i].BindIndex,
+				1,
+				constantBuffers[i].ConstantBuffer.GetAddressOf());
 	}
 }
 
@@ -1196,7 +1429,8 @@ bool SimpleDomainShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 	}
 
 	// Set the shader resource view
-	deviceContext->DSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (RenderStateCache::GetInstance().UpdateShaderResource(RenderStageDomain, srvInfo->BindIndex, srv.Get()))
+		deviceContext->DSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1226,12 +1460,41 @@ bool SimpleDomainShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 	}
 
 	// Set the shader resource view
-	deviceContext->DSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (RenderStateCache::GetInstance().UpdateSampler(RenderStageDomain, sampInfo->BindIndex, samplerState.Get()))
+		deviceContext->DSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a shader resource view in the domain shader stage
+// using a handle from GetShaderResourceViewHandle()
+// --------------------------------------------------------
+bool SimpleDomainShader::SetShaderResourceView(SimpleResourceHandle handle, ID3D11ShaderResourceView* srv)
+{
+	if (!handle.IsValid() || handle.BindIndex >= D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT)
+		return false;
+
+	if (RenderStateCache::GetInstance().UpdateShaderResource(RenderStageDomain, handle.BindIndex, srv))
+		deviceContext->DSSetShaderResources(handle.BindIndex, 1, &srv);
+	return true;
+}
+
+// --------------------------------------------------------
+// Sets a sampler state in the domain shader stage
+// using a handle from GetSamplerHandle()
+// --------------------------------------------------------
+bool SimpleDomainShader::SetSamplerState(SimpleResourceHandle handle, ID3D11SamplerState* samplerState)
+{
+	if (!handle.IsValid() || handle.BindIndex >= D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT)
+		return false;
+
+	if (RenderStateCache::GetInstance().UpdateSampler(RenderStageDomain, handle.BindIndex, samplerState))
+		deviceContext->DSSetSamplers(handle.BindIndex, 1, &samplerState);
+	return true;
+}
+
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1298,7 +1561,8 @@ void SimpleHullShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->HSSetShader(shader.Get(), 0, 0);
+	if (RenderStateCache::GetInstance().UpdateShader(RenderStageHull, shader.Get()))
+		deviceContext->HSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1308,10 +1572,11 @@ void SimpleHullShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->HSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+		if (RenderStateCache::GetInstance().UpdateConstantBuffer(RenderStageHull, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer.Get()))
+			deviceContext->HSSetConstantBuffers(
+				constantBuffers[i].BindIndex,
+				1,
+				constantBuffers[i].ConstantBuffer.GetAddressOf());
 	}
 }
 
@@ -1339,7 +1604,8 @@ bool SimpleHullShader::SetShaderResourceView(std::string name, Microsoft::WRL::C
 	}
 
 	// Set the shader resource view
-	deviceContext->HSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (RenderStateCache::GetInstance().UpdateShaderResource(RenderStageHull, srvInfo->BindIndex, srv.Get()))
+		deviceContext->HSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1369,12 +1635,41 @@ bool SimpleHullShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<
 	}
 
 	// Set the shader resource view
-	deviceContext->HSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (RenderStateCache::GetInstance().UpdateSampler(RenderStageHull, sampInfo->BindIndex, samplerState.Get()))
+		deviceContext->HSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a shader resource view in the hull shader stage
+// using a handle from GetShaderResourceViewHandle()
+// --------------------------------------------------------
+bool SimpleHullShader::SetShaderResourceView(SimpleResourceHandle handle, ID3D11ShaderResourceView* srv)
+{
+	if (!handle.IsValid() || handle.BindIndex >= D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT)
+		return false;
+
+	if (RenderStateCache::GetInstance().UpdateShaderResource(RenderStageHull, handle.BindIndex, srv))
+		deviceContext->HSSetShaderResources(handle.BindIndex, 1, &srv);
+	return true;
+}
+
+// --------------------------------------------------------
+// Sets a sampler state in the hull shader stage
+// using a handle from GetSamplerHandle()
+// --------------------------------------------------------
+bool SimpleHullShader::SetSamplerState(SimpleResourceHandle handle, ID3D11SamplerState* samplerState)
+{
+	if (!handle.IsValid() || handle.BindIndex >= D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT)
+		return false;
+
+	if (RenderStateCache::GetInstance().UpdateSampler(RenderStageHull, handle.BindIndex, samplerState))
+		deviceContext->HSSetSamplers(handle.BindIndex, 1, &samplerState);
+	return true;
+}
+
 
 
 
@@ -1572,7 +1867,8 @@ void SimpleGeometryShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->GSSetShader(shader.Get(), 0, 0);
+	if (RenderStateCache::GetInstance().UpdateShader(RenderStageGeometry, shader.Get()))
+		deviceContext->GSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1582,10 +1878,11 @@ void SimpleGeometryShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->GSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+		if (RenderStateCache::GetInstance().UpdateConstantBuffer(RenderStageGeometry, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer.Get()))
+			deviceContext->GSSetConstantBuffers(
+				constantBuffers[i].BindIndex,
+				1,
+				constantBuffers[i].ConstantBuffer.GetAddressOf());
 	}
 }
 
@@ -1613,7 +1910,8 @@ bool SimpleGeometryShader::SetShaderResourceView(std::string name, Microsoft::WR
 	}
 
 	// Set the shader resource view
-	deviceContext->GSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (RenderStateCache::GetInstance().UpdateShaderResource(RenderStageGeometry, srvInfo->BindIndex, srv.Get()))
+		deviceContext->GSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1643,12 +1941,41 @@ bool SimpleGeometryShader::SetSamplerState(std::string name, Microsoft::WRL::Com
 	}
 
 	// Set the shader resource view
-	deviceContext->GSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (RenderStateCache::GetInstance().UpdateSampler(RenderStageGeometry, sampInfo->BindIndex, samplerState.Get()))
+		deviceContext->GSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a shader resource view in the geometry shader stage
+// using a handle from GetShaderResourceViewHandle()
+// --------------------------------------------------------
+bool SimpleGeometryShader::SetShaderResourceView(SimpleResourceHandle handle, ID3D11ShaderResourceView* srv)
+{
+	if (!handle.IsValid() || handle.BindIndex >= D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT)
+		return false;
+
+	if (RenderStateCache::GetInstance().UpdateShaderResource(RenderStageGeometry, handle.BindIndex, srv))
+		deviceContext->GSSetShaderResources(handle.BindIndex, 1, &srv);
+	return true;
+}
+
+// --------------------------------------------------------
+// Sets a sampler state in the geometry shader stage
+// using a handle from GetSamplerHandle()
+// --------------------------------------------------------
+bool SimpleGeometryShader::SetSamplerState(SimpleResourceHandle handle, ID3D11SamplerState* samplerState)
+{
+	if (!handle.IsValid() || handle.BindIndex >= D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT)
+		return false;
+
+	if (RenderStateCache::GetInstance().UpdateSampler(RenderStageGeometry, handle.BindIndex, samplerState))
+		deviceContext->GSSetSamplers(handle.BindIndex, 1, &samplerState);
+	return true;
+}
+
 // --------------------------------------------------------
 // Calculates the number of components specified by a parameter description mask
 //
@@ -1782,7 +2109,8 @@ void SimpleComputeShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->CSSetShader(shader.Get(), 0, 0);
+	if (RenderStateCache::GetInstance().UpdateShader(RenderStageCompute, shader.Get()))
+		deviceContext->CSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1792,10 +2120,11 @@ void SimpleComputeShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->CSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+		if (RenderStateCache::GetInstance().UpdateConstantBuffer(RenderStageCompute, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer.Get()))
+			deviceContext->CSSetConstantBuffers(
+				constantBuffers[i].BindIndex,
+				1,
+				constantBuffers[i].ConstantBuffer.GetAddressOf());
 	}
 }
 
@@ -1884,7 +2213,8 @@ bool SimpleComputeShader::SetShaderResourceView(std::string name, Microsoft::WRL
 	}
 
 	// Set the shader resource view
-	deviceContext->CSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (RenderStateCache::GetInstance().UpdateShaderResource(RenderStageCompute, srvInfo->BindIndex, srv.Get()))
+		deviceContext->CSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1914,12 +2244,41 @@ bool SimpleComputeShader::SetSamplerState(std::string name, Microsoft::WRL::ComP
 	}
 
 	// Set the shader resource view
-	deviceContext->CSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (RenderStateCache::GetInstance().UpdateSampler(RenderStageCompute, sampInfo->BindIndex, samplerState.Get()))
+		deviceContext->CSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a shader resource view in the compute shader stage
+// using a handle from GetShaderResourceViewHandle()
+// --------------------------------------------------------
+bool SimpleComputeShader::SetShaderResourceView(SimpleResourceHandle handle, ID3D11ShaderResourceView* srv)
+{
+	if (!handle.IsValid() || handle.BindIndex >= D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT)
+		return false;
+
+	if (RenderStateCache::GetInstance().UpdateShaderResource(RenderStageCompute, handle.BindIndex, srv))
+		deviceContext->CSSetShaderResources(handle.BindIndex, 1, &srv);
+	return true;
+}
+
+// --------------------------------------------------------
+// Sets a sampler state in the compute shader stage
+// using a handle from GetSamplerHandle()
+// --------------------------------------------------------
+bool SimpleComputeShader::SetSamplerState(SimpleResourceHandle handle, ID3D11SamplerState* samplerState)
+{
+	if (!handle.IsValid() || handle.BindIndex >= D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT)
+		return false;
+
+	if (RenderStateCache::GetInstance().UpdateSampler(RenderStageCompute, handle.BindIndex, samplerState))
+		deviceContext->CSSetSamplers(handle.BindIndex, 1, &samplerState);
+	return true;
+}
+
 // --------------------------------------------------------
 // Sets an unordered access view in the Compute shader stage
 //
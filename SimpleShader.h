@@ -3,6 +3,7 @@
 #pragma comment(lib, "d3dcompiler.lib")
 
 #include <d3d11.h>
+#include <d3d11_1.h>
 #include <d3dcompiler.h>
 #include <DirectXMath.h>
 #include <wrl/client.h>
@@ -11,6 +12,8 @@
 #include <vector>
 #include <string>
 
+#include "SimpleDirtyRange.h"
+
 
 // --------------------------------------------------------
 // Used by simple shaders to store information about
@@ -37,6 +40,45 @@ struct SimpleConstantBuffer
 	Microsoft::WRL::ComPtr<ID3D11Buffer> ConstantBuffer = 0;
 	unsigned char* LocalDataBuffer = 0;
 	std::vector<SimpleShaderVariable> Variables;
+	SimpleDirtyRange DirtyRange;	// Bytes that differ from what was last uploaded
+	bool Dynamic = false;			// Created for Map(WRITE_DISCARD) uploads
+};
+
+// --------------------------------------------------------
+// Counts constant buffer uploads across every shader,
+// reset by the caller (usually once per frame)
+// --------------------------------------------------------
+struct SimpleShaderUploadStats
+{
+	unsigned int BuffersUploaded = 0;
+	unsigned int BuffersSkipped = 0;	// Copy requested but nothing had changed
+	unsigned int PartialUploads = 0;	// Only the dirty range was sent
+	unsigned long long BytesUploaded = 0;
+	unsigned long long BytesSkipped = 0;	// Clean buffers plus the clean parts of partial uploads
+};
+
+// --------------------------------------------------------
+// A shader variable's location, looked up once by name with
+// GetVariableHandle() so the setters that take it can skip
+// the string hashing.  Only valid for the shader it came from.
+// --------------------------------------------------------
+struct SimpleVariableHandle
+{
+	unsigned int ConstantBufferIndex = 0;
+	unsigned int ByteOffset = 0;
+	unsigned int Size = 0;	// Zero if the variable wasn't found
+
+	bool IsValid() const { return Size > 0; }
+};
+
+// --------------------------------------------------------
+// The register of an SRV or sampler, looked up once by name
+// --------------------------------------------------------
+struct SimpleResourceHandle
+{
+	unsigned int BindIndex = 0xFFFFFFFF;	// Not found
+
+	bool IsValid() const { return BindIndex != 0xFFFFFFFF; }
 };
 
 // --------------------------------------------------------
@@ -70,6 +112,7 @@ public:
 	bool IsShaderValid() { return shaderValid; }
 
 	// Activating the shader and copying data
+	// - Buffers are only uploaded if something in them changed since the last copy
 	void SetShader();
 	void CopyAllBufferData();
 	void CopyBufferData(unsigned int index);
@@ -89,10 +132,26 @@ public:
 	bool SetMatrix4x4(std::string name, const float data[16]);
 	bool SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data);
 
+	// Handle versions of the above, for setting data every draw
+	SimpleVariableHandle GetVariableHandle(const std::string& name);
+	bool SetData(SimpleVariableHandle var, const void* data, unsigned int size);
+	bool SetInt(SimpleVariableHandle var, int data);
+	bool SetFloat(SimpleVariableHandle var, float data);
+	bool SetFloat2(SimpleVariableHandle var, const DirectX::XMFLOAT2& data);
+	bool SetFloat3(SimpleVariableHandle var, const DirectX::XMFLOAT3& data);
+	bool SetFloat4(SimpleVariableHandle var, const DirectX::XMFLOAT4& data);
+	bool SetMatrix4x4(SimpleVariableHandle var, const DirectX::XMFLOAT4X4& data);
+
 	// Setting shader resources
 	virtual bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv) = 0;
 	virtual bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState) = 0;
 
+	// Handle versions, which also skip the ComPtr reference counting
+	SimpleResourceHandle GetShaderResourceViewHandle(const std::string& name);
+	SimpleResourceHandle GetSamplerHandle(const std::string& name);
+	virtual bool SetShaderResourceView(SimpleResourceHandle handle, ID3D11ShaderResourceView* srv) = 0;
+	virtual bool SetSamplerState(SimpleResourceHandle handle, ID3D11SamplerState* samplerState) = 0;
+
 	// Simple resource checking
 	bool HasVariable(std::string name);
 	bool HasShaderResourceView(std::string name);
@@ -122,6 +181,16 @@ public:
 	static bool ReportErrors;
 	static bool ReportWarnings;
 
+	// Create constant buffers as DYNAMIC and upload them with
+	// Map(WRITE_DISCARD) instead of UpdateSubresource
+	// - Only affects shaders loaded after it's set
+	// - Always uploads the whole buffer, as discarding loses the old contents
+	static bool UseDynamicConstantBuffers;
+
+	// Upload counters
+	static SimpleShaderUploadStats UploadStats;
+	static void ResetUploadStats() { UploadStats = SimpleShaderUploadStats(); }
+
 protected:
 	
 	bool shaderValid;
@@ -129,6 +198,9 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D11Device> device;
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext;
 
+	// Set if the driver can update part of a constant buffer (D3D 11.1)
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> deviceContext1;
+
 	// Resource counts
 	unsigned int constantBufferCount;
 	
@@ -154,7 +226,12 @@ protected:
 	SimpleShaderVariable* FindVariable(std::string name, int size);
 	SimpleConstantBuffer* FindConstantBuffer(std::string name);
 
+	// Uploads a buffer if it's dirty (just the dirty range, when supported)
+	void UploadBuffer(SimpleConstantBuffer* cb);
+
 	// Error logging
+	// - The shader cache reports its errors the same way
+	friend class ShaderCache;
 	void Log(std::string message, WORD color);
 	void LogW(std::wstring message, WORD color);
 	void Log(std::string message);
@@ -180,6 +257,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleResourceHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleResourceHandle handle, ID3D11SamplerState* samplerState);
 
 protected:
 	bool perInstanceCompatible;
@@ -203,6 +282,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleResourceHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleResourceHandle handle, ID3D11SamplerState* samplerState);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> shader;
@@ -223,6 +304,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleResourceHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleResourceHandle handle, ID3D11SamplerState* samplerState);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11DomainShader> shader;
@@ -243,6 +326,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleResourceHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleResourceHandle handle, ID3D11SamplerState* samplerState);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11HullShader> shader;
@@ -263,6 +348,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleResourceHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleResourceHandle handle, ID3D11SamplerState* samplerState);
 
 	bool CreateCompatibleStreamOutBuffer(Microsoft::WRL::ComPtr<ID3D11Buffer> buffer, int vertexCount);
 
@@ -304,6 +391,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleResourceHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleResourceHandle handle, ID3D11SamplerState* samplerState);
 	bool SetUnorderedAccessView(std::string name, Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> uav, unsigned int appendConsumeOffset = -1);
 
 	int GetUnorderedAccessViewIndex(std::string name);
@@ -1,4 +1,6 @@
 #include "Sky.h"
+#include "RenderStateCache.h"
+#include "Profiler.h"
 
 using namespace DirectX;
 
@@ -20,6 +22,34 @@ Sky::Sky(const wchar_t* right,
 	device(device),
 	context(context),
 	mesh(mesh)
+{
+	CreateRenderStates();
+	cubeSRV = CreateCubemap(right, left, up, down, front, back);
+}
+
+Sky::Sky(ComPtr<ID3D11ShaderResourceView> cubeSRV,
+	shared_ptr<Mesh> mesh,
+	shared_ptr<SimpleVertexShader> vertexShader,
+	shared_ptr<SimplePixelShader> pixelShader,
+	ComPtr<ID3D11SamplerState> samplerState,
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context) :
+	cubeSRV(cubeSRV),
+	vertexShader(vertexShader),
+	pixelShader(pixelShader),
+	samplerState(samplerState),
+	device(device),
+	context(context),
+	mesh(mesh)
+{
+	CreateRenderStates();
+}
+
+Sky::~Sky()
+{
+}
+
+void Sky::CreateRenderStates()
 {
 	//Set the rastizer state
 	D3D11_RASTERIZER_DESC ras = {};
@@ -39,19 +69,17 @@ Sky::Sky(const wchar_t* right,
 	dep.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
 
 	device->CreateDepthStencilState(&dep, depthState.GetAddressOf());
-
-	cubeSRV = CreateCubemap(right, left, up, down, front, back);
-}
-
-Sky::~Sky()
-{
 }
 
 void Sky::Draw(std::shared_ptr<Camera> camera)
 {
+	PROFILE_SCOPE("Sky::Draw");
+
 	//Change the necessary render states
-	context->RSSetState(rasterizerState.Get());
-	context->OMSetDepthStencilState(depthState.Get(), 0);
+	if (RenderStateCache::GetInstance().UpdateRasterizerState(rasterizerState.Get()))
+		context->RSSetState(rasterizerState.Get());
+	if (RenderStateCache::GetInstance().UpdateDepthStencilState(depthState.Get(), 0))
+		context->OMSetDepthStencilState(depthState.Get(), 0);
 
 	//Prepare the sky-specific shaders for drawing
 	pixelShader->SetShader();
@@ -69,8 +97,10 @@ void Sky::Draw(std::shared_ptr<Camera> camera)
 	mesh->Draw();
 
 	//Reset any render states you changed above
-	context->RSSetState(0);
-	context->OMSetDepthStencilState(0, 0);
+	if (RenderStateCache::GetInstance().UpdateRasterizerState(0))
+		context->RSSetState(0);
+	if (RenderStateCache::GetInstance().UpdateDepthStencilState(0, 0))
+		context->OMSetDepthStencilState(0, 0);
 }
 
 Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(
@@ -26,6 +26,15 @@ public:
 		ComPtr<ID3D11SamplerState> samplerState,
 		Microsoft::WRL::ComPtr<ID3D11Device> device,
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	// With a cube map that's already loaded (e.g. by AssetLoader)
+	Sky(ComPtr<ID3D11ShaderResourceView> cubeSRV,
+		shared_ptr<Mesh> mesh,
+		shared_ptr<SimpleVertexShader> vertexShader,
+		shared_ptr<SimplePixelShader> pixelShader,
+		ComPtr<ID3D11SamplerState> samplerState,
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
 	~Sky();
 
 	void Draw(std::shared_ptr<Camera> camera);
@@ -48,5 +57,6 @@ private:
 		const wchar_t* down,
 		const wchar_t* front,
 		const wchar_t* back);
+	void CreateRenderStates();
 };
 
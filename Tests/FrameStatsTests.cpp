@@ -0,0 +1,51 @@
+#include "FrameStats.h"
+#include "TestHelpers.h"
+
+// One 40 ms frame in every ten, the rest on a 60 Hz budget
+static void Record(FrameStats& stats, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float interval = i % 10 == 0 ? 40.0f : 16.7f;
+		stats.Record(5.0f, interval, interval - 5.0f);
+	}
+}
+
+static void CountsHitches()
+{
+	FrameStats stats;
+	Record(stats, 100);
+
+	FrameStatsSummary summary = stats.GetSummary();
+	CHECK_EQUAL(100, summary.frames);
+	CHECK_EQUAL(10, summary.hitches);
+	CHECK_EQUAL(10, stats.GetTotalHitches());
+	CHECK(stats.GetFrame(0).frame == 99);
+}
+
+// The window is recounted against the budget as it is now, the
+// per-frame flag and the running total keep the one they were recorded with
+static void ChangingTheBudgetRecountsTheWindow()
+{
+	FrameStats stats;
+	Record(stats, 100);
+
+	stats.SetTargetMilliseconds(1000.0f / 30.0f);
+	CHECK_EQUAL(0, stats.GetSummary().hitches);
+	CHECK_EQUAL(10, stats.GetTotalHitches());
+	CHECK(stats.GetFrame(0).hitch == false && stats.GetFrame(9).hitch == true);
+
+	stats.SetTargetMilliseconds(1000.0f / 60.0f);
+	stats.SetHitchFactor(0.5f);
+	CHECK_EQUAL(100, stats.GetSummary().hitches);
+
+	stats.SetHitchFactor(1.5f);
+	CHECK_EQUAL(10, stats.GetSummary().hitches);
+}
+
+int main()
+{
+	CountsHitches();
+	ChangingTheBudgetRecountsTheWindow();
+	return TEST_RESULT();
+}
@@ -0,0 +1,119 @@
+#include "InstanceBatcher.h"
+#include "TestHelpers.h"
+#include <vector>
+
+using namespace DirectX;
+
+// Meshes and materials are only compared by address, never touched
+static Mesh* const MeshA = (Mesh*)0x1000;
+static Mesh* const MeshB = (Mesh*)0x2000;
+static Material* const MaterialA = (Material*)0x3000;
+static Material* const MaterialB = (Material*)0x4000;
+
+// Each instance is recognisable by the id in its tint
+static void Add(InstanceBatcher& batcher, Mesh* mesh, Material* material, bool gamma, float id)
+{
+	XMFLOAT4X4 world;
+	XMStoreFloat4x4(&world, XMMatrixTranslation(id, 0.0f, 0.0f));
+	XMFLOAT4X4 worldInvTranspose;
+	XMStoreFloat4x4(&worldInvTranspose, XMMatrixTranslation(0.0f, id, 0.0f));
+	batcher.Add(mesh, material, gamma, world, worldInvTranspose, XMFLOAT4(id, 0.0f, 0.0f, 1.0f));
+}
+
+static void CheckBatch(const InstanceBatcher& batcher, unsigned int index, Mesh* mesh, Material* material, bool gamma, const std::vector<float>& ids)
+{
+	CHECK(index < batcher.GetBatches().size());
+	if (index >= batcher.GetBatches().size())
+		return;
+
+	const InstanceBatch& batch = batcher.GetBatches()[index];
+	CHECK(batch.mesh == mesh);
+	CHECK(batch.material == material);
+	CHECK(batch.useGammaCorrection == gamma);
+	CHECK_EQUAL(ids.size(), batch.instanceCount);
+
+	for (size_t i = 0; i < ids.size() && i < batch.instanceCount; i++)
+	{
+		const InstanceData& data = batcher.GetInstanceData()[batch.firstInstance + i];
+		CHECK_NEAR(ids[i], data.tint.x, 0.0);
+		CHECK_NEAR(ids[i], data.world._41, 0.0);
+		CHECK_NEAR(ids[i], data.worldInvTranspose._42, 0.0);
+	}
+}
+
+static void GroupsBySharedState()
+{
+	InstanceBatcher batcher;
+	Add(batcher, MeshA, MaterialA, true, 0.0f);
+	Add(batcher, MeshB, MaterialA, true, 1.0f);
+	Add(batcher, MeshA, MaterialA, true, 2.0f);
+	Add(batcher, MeshA, MaterialB, true, 3.0f);
+	Add(batcher, MeshA, MaterialA, false, 4.0f);	// Same mesh and material, other gamma flag
+	Add(batcher, MeshB, MaterialA, true, 5.0f);
+	Add(batcher, MeshA, MaterialA, true, 6.0f);
+	batcher.Build();
+
+	CHECK_EQUAL(7, batcher.GetDrawCount());
+	CHECK_EQUAL(4, batcher.GetBatches().size());
+	CHECK_EQUAL(7, batcher.GetInstanceData().size());
+
+	// In order of each batch's first draw, instances in the order they were added
+	CheckBatch(batcher, 0, MeshA, MaterialA, true, { 0.0f, 2.0f, 6.0f });
+	CheckBatch(batcher, 1, MeshB, MaterialA, true, { 1.0f, 5.0f });
+	CheckBatch(batcher, 2, MeshA, MaterialB, true, { 3.0f });
+	CheckBatch(batcher, 3, MeshA, MaterialA, false, { 4.0f });
+}
+
+// Batch ranges are back to back and cover every instance once
+static void RangesArePacked()
+{
+	InstanceBatcher batcher;
+	Mesh* meshes[3] = { MeshA, MeshB, (Mesh*)0x5000 };
+	for (int i = 0; i < 300; i++)
+		Add(batcher, meshes[(i * 7) % 3], i % 2 ? MaterialA : MaterialB, i % 5 == 0, (float)i);
+	batcher.Build();
+
+	unsigned int next = 0;
+	for (const InstanceBatch& batch : batcher.GetBatches())
+	{
+		CHECK_EQUAL(next, batch.firstInstance);
+		CHECK(batch.instanceCount > 0);
+		next += batch.instanceCount;
+	}
+	CHECK_EQUAL(300, next);
+
+	std::vector<int> seen(300, 0);
+	for (const InstanceData& data : batcher.GetInstanceData())
+		seen[(int)data.tint.x]++;
+	bool once = true;
+	for (int count : seen)
+		once = once && count == 1;
+	CHECK(once);
+}
+
+static void ClearStartsOver()
+{
+	InstanceBatcher batcher;
+	Add(batcher, MeshA, MaterialA, true, 0.0f);
+	Add(batcher, MeshA, MaterialA, true, 1.0f);
+	batcher.Build();
+	CHECK_EQUAL(1, batcher.GetBatches().size());
+
+	batcher.Clear();
+	CHECK_EQUAL(0, batcher.GetDrawCount());
+	batcher.Build();
+	CHECK_EQUAL(0, batcher.GetBatches().size());
+	CHECK_EQUAL(0, batcher.GetInstanceData().size());
+
+	Add(batcher, MeshB, MaterialB, false, 9.0f);
+	batcher.Build();
+	CheckBatch(batcher, 0, MeshB, MaterialB, false, { 9.0f });
+}
+
+int main()
+{
+	GroupsBySharedState();
+	RangesArePacked();
+	ClearStartsOver();
+	return TEST_RESULT();
+}
@@ -0,0 +1,117 @@
+#include "JobSystem.h"
+#include "TestHelpers.h"
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+// --------------------------------------------------------
+// What scheduling costs: queueing and waiting on empty jobs,
+// ParallelFor at different grain sizes over the same loop,
+// and an uneven loop where stealing has to balance the work.
+//
+// Takes --threads N to pick the pool size (default one per
+// hardware thread).
+// --------------------------------------------------------
+
+static unsigned int GetRequestedThreads(int argc, char* argv[])
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--threads") == 0)
+			return (unsigned int)atoi(argv[i + 1]);
+	}
+	return 0;
+}
+
+// Some arithmetic that can't be optimized away, cost grows with work
+static float Spin(float value, unsigned int work)
+{
+	for (unsigned int i = 0; i < work; i++)
+		value = value * 1.0001f + 0.5f;
+	return value;
+}
+
+int main(int argc, char* argv[])
+{
+	bool quick = IsQuickRun(argc, argv);
+	int runs = quick ? 1 : 10;
+
+	JobSystem::RequestedThreadCount = GetRequestedThreads(argc, argv);
+	JobSystem& jobs = JobSystem::GetInstance();
+	printf("%u job threads\n", jobs.GetThreadCount());
+
+	// Empty jobs, so this is all queue, wake and counter overhead
+	unsigned int jobCount = quick ? 1000 : 100000;
+	double emptyJobs = BestOf(runs, [&]()
+	{
+		JobCounter counter;
+		for (unsigned int i = 0; i < jobCount; i++)
+			jobs.Run([]() {}, &counter);
+		jobs.Wait(&counter);
+	});
+	printf("  Run + Wait         %8.1f ns/job (%u empty jobs)\n", emptyJobs * 1000000.0 / jobCount, jobCount);
+
+	// The same cheap loop split finer and finer.  The serial run calls the
+	// same body once, so only the scheduling differs.
+	unsigned int count = quick ? 1 << 12 : 1 << 20;
+	std::vector<float> values(count, 1.0f);
+	std::function<void(unsigned int, unsigned int)> body = [&](unsigned int first, unsigned int end)
+	{
+		for (unsigned int i = first; i < end; i++)
+			values[i] = Spin(values[i], 16);
+	};
+
+	double serial = BestOf(runs, [&]() { body(0, count); });
+	printf("  serial loop        %8.3f ms (%u items)\n", serial, count);
+
+	unsigned int grains[] = { 1, 16, 256, 4096, 65536 };
+	for (unsigned int grain : grains)
+	{
+		if (quick && grain > count)
+			break;
+
+		jobs.ResetStats();
+		double parallel = BestOf(runs, [&]() { jobs.ParallelFor(count, grain, body); });
+		JobSystemStats stats = jobs.GetStats();
+
+		// Thread time spent beyond the serial loop's, spread over the ranges
+		// (just the one when the pool has no workers to split it over)
+		unsigned int ranges = stats.inlineParallelFors ? 1 : (count + grain - 1) / grain;
+		double overhead = (parallel * jobs.GetThreadCount() - serial) * 1000000.0 / ranges;
+		printf("  grain %6u        %8.3f ms  %.2fx  ~%8.1f ns overhead/range  (%u jobs, %u stolen)\n",
+			grain, parallel, serial / parallel, overhead, stats.jobsRun, stats.jobsStolen);
+	}
+
+	// Later items cost far more, so equal ranges only balance if they're stolen
+	unsigned int unevenCount = quick ? 256 : 4096;
+	std::vector<float> uneven(unevenCount, 1.0f);
+	double unevenSerial = BestOf(runs, [&]()
+	{
+		for (unsigned int i = 0; i < unevenCount; i++)
+			uneven[i] = Spin(uneven[i], i * 4);
+	});
+
+	jobs.ResetStats();
+	double unevenParallel = BestOf(runs, [&]()
+	{
+		jobs.ParallelFor(unevenCount, 16, [&](unsigned int first, unsigned int end)
+		{
+			for (unsigned int i = first; i < end; i++)
+				uneven[i] = Spin(uneven[i], i * 4);
+		});
+	});
+	JobSystemStats unevenStats = jobs.GetStats();
+	printf("  uneven loop        %8.3f ms serial  %8.3f ms parallel  %.2fx  (%u stolen)\n",
+		unevenSerial, unevenParallel, unevenSerial / unevenParallel, unevenStats.jobsStolen);
+
+	// Keep the results alive
+	float sum = 0.0f;
+	for (float value : values)
+		sum += value;
+	for (float value : uneven)
+		sum += value;
+	CHECK(sum > 0.0f);
+
+	delete &jobs;
+	return TEST_RESULT();
+}
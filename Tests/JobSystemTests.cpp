@@ -0,0 +1,263 @@
+#include "JobSystem.h"
+#include "TestHelpers.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// Stress tests for the JobSystem's scheduling.  Always run
+// with a few workers, whatever the machine has, so stealing,
+// sleeping and waking get exercised on single core runners too.
+// --------------------------------------------------------
+
+// Every index is visited exactly once, for awkward counts and grains
+static void ParallelForCoversEveryIndex()
+{
+	JobSystem& jobs = JobSystem::GetInstance();
+	bool once = true;
+
+	for (unsigned int iteration = 0; iteration < 300; iteration++)
+	{
+		unsigned int count = 1 + iteration * 137 % 5000;
+		unsigned int grain = 1 + iteration % 17;
+		std::vector<std::atomic<unsigned int>> visits(count);
+		for (std::atomic<unsigned int>& v : visits)
+			v = 0;
+
+		jobs.ParallelFor(count, grain, [&](unsigned int first, unsigned int end)
+		{
+			for (unsigned int i = first; i < end; i++)
+				visits[i]++;
+		});
+
+		for (std::atomic<unsigned int>& v : visits)
+			once = once && v.load() == 1;
+	}
+
+	CHECK(once);
+
+	// Nothing to do is fine too
+	bool called = false;
+	jobs.ParallelFor(0, 16, [&](unsigned int, unsigned int) { called = true; });
+	CHECK(!called);
+}
+
+// Jobs can go wide themselves, and wait without deadlocking
+static void NestedParallelFors()
+{
+	JobSystem& jobs = JobSystem::GetInstance();
+	std::atomic<unsigned int> total(0);
+
+	for (int repeat = 0; repeat < 20; repeat++)
+	{
+		jobs.ParallelFor(64, 1, [&](unsigned int first, unsigned int end)
+		{
+			for (unsigned int i = first; i < end; i++)
+			{
+				jobs.ParallelFor(100, 7, [&](unsigned int innerFirst, unsigned int innerEnd)
+				{
+					total += innerEnd - innerFirst;
+				});
+			}
+		});
+	}
+
+	CHECK_EQUAL(20 * 64 * 100, total.load());
+}
+
+// A chain of jobs, each depending on the one before, runs in order
+static void DependencyChainsRunInOrder()
+{
+	JobSystem& jobs = JobSystem::GetInstance();
+	bool ordered = true;
+
+	for (int repeat = 0; repeat < 50; repeat++)
+	{
+		std::vector<std::unique_ptr<JobCounter>> counters;
+		for (int i = 0; i < 100; i++)
+			counters.emplace_back(new JobCounter());
+
+		std::atomic<int> stage(0);
+		std::atomic<bool> outOfOrder(false);
+		for (int i = 0; i < 100; i++)
+		{
+			jobs.Run([&stage, &outOfOrder, i]()
+			{
+				if (stage.load() != i)
+					outOfOrder = true;
+				stage++;
+			}, counters[i].get(), i > 0 ? counters[i - 1].get() : 0);
+		}
+
+		jobs.Wait(counters[99].get());
+		ordered = ordered && !outOfOrder && stage.load() == 100;
+	}
+
+	CHECK(ordered);
+}
+
+// A job depending on a big group only starts once all of it is done
+static void FanInWaitsForTheWholeGroup()
+{
+	JobSystem& jobs = JobSystem::GetInstance();
+
+	for (int repeat = 0; repeat < 20; repeat++)
+	{
+		JobCounter group;
+		JobCounter after;
+		std::atomic<int> finished(0);
+		int seen = -1;
+
+		for (int i = 0; i < 1000; i++)
+			jobs.Run([&finished]() { finished++; }, &group);
+		jobs.Run([&finished, &seen]() { seen = finished.load(); }, &after, &group);
+
+		jobs.Wait(&after);
+		CHECK(group.IsDone());
+		CHECK_EQUAL(1000, seen);
+	}
+}
+
+// Jobs queueing more jobs on their own counter keep it from reaching zero
+static void JobsSpawningJobs()
+{
+	JobSystem& jobs = JobSystem::GetInstance();
+	JobCounter counter;
+	std::atomic<unsigned int> leaves(0);
+
+	std::function<void(int)> spawn = [&](int depth)
+	{
+		if (depth == 0)
+		{
+			leaves++;
+			return;
+		}
+
+		for (int i = 0; i < 4; i++)
+			jobs.Run([&spawn, depth]() { spawn(depth - 1); }, &counter);
+	};
+
+	jobs.Run([&spawn]() { spawn(6); }, &counter);
+	jobs.Wait(&counter);
+	CHECK_EQUAL(4096, leaves.load());
+}
+
+// Threads outside the pool share a queue, and can all queue and wait at once
+static void OutsideThreadsShareQueueZero()
+{
+	JobSystem& jobs = JobSystem::GetInstance();
+	std::atomic<unsigned int> total(0);
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 3; t++)
+	{
+		threads.emplace_back([&jobs, &total]()
+		{
+			for (int repeat = 0; repeat < 50; repeat++)
+			{
+				JobCounter counter;
+				for (int i = 0; i < 100; i++)
+					jobs.Run([&total]() { total++; }, &counter);
+				jobs.Wait(&counter);
+			}
+		});
+	}
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	CHECK_EQUAL(3 * 50 * 100, total.load());
+}
+
+// Background jobs only run on workers, never more than all but one of them at
+// once, and frame work keeps going while they do
+static void BackgroundJobsStayOnWorkers()
+{
+	JobSystem& jobs = JobSystem::GetInstance();
+	std::thread::id mainThread = std::this_thread::get_id();
+
+	JobCounter background;
+	std::atomic<unsigned int> running(0);
+	std::atomic<unsigned int> mostRunning(0);
+	std::atomic<bool> ranOnMainThread(false);
+	for (int i = 0; i < 12; i++)
+	{
+		jobs.RunBackground([&]()
+		{
+			if (std::this_thread::get_id() == mainThread)
+				ranOnMainThread = true;
+
+			unsigned int now = ++running;
+			unsigned int most = mostRunning.load();
+			while (now > most && !mostRunning.compare_exchange_weak(most, now));
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			running--;
+		}, &background);
+	}
+
+	// Frame work waited on meanwhile doesn't pick any of them up
+	std::atomic<unsigned int> total(0);
+	while (!background.IsDone())
+	{
+		jobs.ParallelFor(1000, 10, [&](unsigned int first, unsigned int end) { total += end - first; });
+		JobCounter frame;
+		jobs.Run([&total]() { total++; }, &frame);
+		jobs.Wait(&frame);
+	}
+	jobs.Wait(&background);
+
+	CHECK(!ranOnMainThread);
+	CHECK(mostRunning.load() >= 1);
+	CHECK(mostRunning.load() <= jobs.GetThreadCount() - 2);
+	CHECK(total.load() > 0);
+
+	// Anyone can run one on purpose, though
+	JobCounter helped;
+	std::atomic<bool> ran(false);
+	jobs.RunBackground([&ran]() { ran = true; }, &helped);
+	jobs.RunBackgroundJob();	// Unless a worker got there first
+	while (!helped.IsDone())
+		std::this_thread::yield();
+	jobs.Wait(&helped);
+	CHECK(ran.load());
+	CHECK(!jobs.RunBackgroundJob());
+}
+
+static void StatsCountJobs()
+{
+	JobSystem& jobs = JobSystem::GetInstance();
+	jobs.ResetStats();
+
+	JobCounter counter;
+	for (int i = 0; i < 10; i++)
+		jobs.Run([]() {}, &counter);
+	jobs.Wait(&counter);
+	jobs.ParallelFor(4, 16, [](unsigned int, unsigned int) {});	// Fits in one grain
+
+	JobSystemStats stats = jobs.GetStats();
+	CHECK_EQUAL(10, stats.jobsRun);
+	CHECK_EQUAL(1, stats.parallelFors);
+	CHECK_EQUAL(1, stats.inlineParallelFors);
+}
+
+int main()
+{
+	JobSystem::RequestedThreadCount = 4;
+	CHECK_EQUAL(4, JobSystem::GetInstance().GetThreadCount());
+
+	ParallelForCoversEveryIndex();
+	NestedParallelFors();
+	DependencyChainsRunInOrder();
+	FanInWaitsForTheWholeGroup();
+	JobsSpawningJobs();
+	OutsideThreadsShareQueueZero();
+	BackgroundJobsStayOnWorkers();
+	StatsCountJobs();
+
+	// Finishes anything left and joins the workers
+	delete &JobSystem::GetInstance();
+	return TEST_RESULT();
+}
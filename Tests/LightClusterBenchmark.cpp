@@ -0,0 +1,138 @@
+#include "LightClusterBuilder.h"
+#include "JobSystem.h"
+#include "TestHelpers.h"
+#include <algorithm>
+#include <set>
+#include <vector>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Cluster build time for 1k to 10k point lights scattered in
+// front of the camera, plus a check that the binning is
+// conservative: any light reaching a sampled point in the
+// frustum has to be in that point's cluster.
+// --------------------------------------------------------
+
+static const float NearClip = 0.1f;
+static const float FarClip = 100.0f;
+
+static unsigned int seed = 1;
+
+// Uniform in [low, high)
+static float Random(float low, float high)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return low + (high - low) * ((seed >> 8) / (float)(1u << 24));
+}
+
+static std::vector<Light> MakeLights(unsigned int count)
+{
+	std::vector<Light> lights;
+	Light sun = {};
+	sun.Type = LIGHT_TYPE_DIRECTIONAL;
+	sun.Direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
+	lights.push_back(sun);
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Light light = {};
+		light.Type = LIGHT_TYPE_POINT;
+		light.Position = XMFLOAT3(Random(-30.0f, 30.0f), Random(-6.0f, 6.0f), Random(0.0f, 60.0f));
+		light.Range = Random(0.5f, 4.0f);
+		light.Intensity = 1.0f;
+		light.Color = XMFLOAT3(1.0f, 1.0f, 1.0f);
+		lights.push_back(light);
+	}
+	return lights;
+}
+
+// Samples points through the frustum and counts lights that reach one
+// but are missing from its cluster
+static unsigned int CountMissingLights(const LightClusterBuilder& builder, const XMFLOAT4X4& view, const XMFLOAT4X4& projection, int samples, unsigned int& reached)
+{
+	XMMATRIX viewMatrix = XMLoadFloat4x4(&view);
+	const std::vector<Light>& lights = builder.GetLights();
+	const std::vector<unsigned int>& indices = builder.GetLightIndices();
+
+	std::vector<XMFLOAT3> viewPositions(lights.size());
+	for (size_t i = builder.GetDirectionalLightCount(); i < lights.size(); i++)
+		XMStoreFloat3(&viewPositions[i], XMVector3TransformCoord(XMLoadFloat3(&lights[i].Position), viewMatrix));
+
+	unsigned int missing = 0;
+	reached = 0;
+	for (int p = 0; p < samples; p++)
+	{
+		// A point at normalized screen (x, y) and a view depth spread like the slices
+		float x = Random(-1.0f, 1.0f);
+		float y = Random(-1.0f, 1.0f);
+		float depth = NearClip * powf(FarClip / NearClip, Random(0.0f, 1.0f));
+		XMFLOAT3 point(x * depth / projection._11, y * depth / projection._22, depth);
+
+		int clusterX = (std::min)(LIGHT_CLUSTERS_X - 1, (int)((x * 0.5f + 0.5f) * LIGHT_CLUSTERS_X));
+		int clusterY = (std::min)(LIGHT_CLUSTERS_Y - 1, (int)((0.5f - y * 0.5f) * LIGHT_CLUSTERS_Y));
+		int clusterZ = (int)floorf(logf(depth) * builder.GetSliceScale() + builder.GetSliceBias());
+		clusterZ = (std::max)(0, (std::min)(LIGHT_CLUSTERS_Z - 1, clusterZ));
+
+		const LightCluster& cluster = builder.GetClusters()[(clusterZ * LIGHT_CLUSTERS_Y + clusterY) * LIGHT_CLUSTERS_X + clusterX];
+		std::set<unsigned int> inCluster(indices.begin() + cluster.offset, indices.begin() + cluster.offset + cluster.count);
+
+		for (unsigned int i = builder.GetDirectionalLightCount(); i < lights.size(); i++)
+		{
+			float dx = viewPositions[i].x - point.x;
+			float dy = viewPositions[i].y - point.y;
+			float dz = viewPositions[i].z - point.z;
+			if (dx * dx + dy * dy + dz * dz < lights[i].Range * lights[i].Range)
+			{
+				reached++;
+				if (!inCluster.count(i))
+					missing++;
+			}
+		}
+	}
+	return missing;
+}
+
+int main(int argc, char* argv[])
+{
+	bool quick = IsQuickRun(argc, argv);
+	int runs = quick ? 1 : 20;
+	int samples = quick ? 500 : 20000;
+
+	XMFLOAT4X4 view;
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorSet(0.0f, 2.0f, -10.0f, 0.0f), XMVectorSet(0.2f, -0.1f, 1.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(1.0f, 16.0f / 9.0f, NearClip, FarClip));
+
+	printf("%u job threads, %d x %d x %d clusters\n", JobSystem::GetInstance().GetThreadCount(), LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y, LIGHT_CLUSTERS_Z);
+
+	std::vector<unsigned int> counts = { 1000, 2500, 5000, 10000 };
+	if (quick)
+		counts = { 1000, 10000 };
+
+	for (unsigned int count : counts)
+	{
+		std::vector<Light> lights = MakeLights(count);
+		LightClusterBuilder builder;
+
+		double milliseconds = BestOf(runs, [&]()
+		{
+			builder.Build(lights, view, projection, NearClip, FarClip);
+		});
+
+		LightClusterStats stats = builder.GetStats();
+		CHECK_EQUAL(1, stats.directionalLights);
+		CHECK_EQUAL(count, stats.clusteredLights + stats.culledLights);
+		CHECK_EQUAL(stats.indices, builder.GetLightIndices().size());
+
+		unsigned int reached = 0;
+		unsigned int missing = CountMissingLights(builder, view, projection, samples, reached);
+		CHECK_EQUAL(0, missing);
+		CHECK(reached > 0);
+
+		printf("%6u lights  build %8.3f ms  clustered %5u  culled %5u  indices %7u  max/cluster %4u\n",
+			count, milliseconds, stats.clusteredLights, stats.culledLights, stats.indices, stats.maxLightsPerCluster);
+	}
+
+	return TEST_RESULT();
+}
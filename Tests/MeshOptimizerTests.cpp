@@ -0,0 +1,179 @@
+#include "MeshOptimizer.h"
+#include "ObjParser.h"
+#include "TestHelpers.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// A triangle as its three corner vertices, rotated so the
+// smallest comes first (winding kept) and compared as bytes
+struct CornerTriangle
+{
+	Vertex corners[3];
+
+	bool operator<(const CornerTriangle& other) const { return memcmp(corners, other.corners, sizeof(corners)) < 0; }
+	bool operator==(const CornerTriangle& other) const { return memcmp(corners, other.corners, sizeof(corners)) == 0; }
+};
+
+static std::vector<CornerTriangle> GetTriangles(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+{
+	std::vector<CornerTriangle> triangles(indices.size() / 3);
+	for (size_t t = 0; t < triangles.size(); t++)
+	{
+		int first = 0;
+		for (int c = 1; c < 3; c++)
+		{
+			if (memcmp(&vertices[indices[t * 3 + c]], &vertices[indices[t * 3 + first]], sizeof(Vertex)) < 0)
+				first = c;
+		}
+
+		for (int c = 0; c < 3; c++)
+			triangles[t].corners[c] = vertices[indices[t * 3 + (first + c) % 3]];
+	}
+
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+// What Mesh::Import() does, checking that each step keeps every triangle
+// and doesn't make the vertex cache numbers worse
+static void CheckOptimize(const char* name, std::vector<Vertex> vertices, std::vector<unsigned int> indices)
+{
+	int vertexCount = (int)vertices.size();
+	int indexCount = (int)indices.size();
+	std::vector<CornerTriangle> original = GetTriangles(vertices, indices);
+
+	float acmrBefore = CalculateACMR(&indices[0], indexCount, vertexCount);
+	float atvrBefore = CalculateATVR(&indices[0], indexCount, vertexCount);
+
+	OptimizeVertexCache(&indices[0], indexCount, vertexCount);
+	float acmrCache = CalculateACMR(&indices[0], indexCount, vertexCount);
+	CHECK(GetTriangles(vertices, indices) == original);
+	CHECK(acmrCache <= acmrBefore);
+
+	// Overdraw ordering may give back up to its threshold (5%) of that
+	OptimizeOverdraw(&indices[0], indexCount, &vertices[0], vertexCount);
+	float acmrOverdraw = CalculateACMR(&indices[0], indexCount, vertexCount);
+	CHECK(GetTriangles(vertices, indices) == original);
+	CHECK(acmrOverdraw <= acmrCache * 1.05f + 0.001f);
+
+	// Vertex fetch only renumbers, so the cache numbers don't change
+	vertexCount = OptimizeVertexFetch(&vertices[0], vertexCount, &indices[0], indexCount);
+	vertices.resize(vertexCount);
+	CHECK(GetTriangles(vertices, indices) == original);
+	CHECK_NEAR(acmrOverdraw, CalculateACMR(&indices[0], indexCount, vertexCount), 1e-6);
+
+	// First use order: each index is at most one past the highest seen so far
+	unsigned int next = 0;
+	bool ordered = true;
+	for (unsigned int index : indices)
+	{
+		ordered = ordered && index <= next;
+		if (index == next)
+			next++;
+	}
+	CHECK(ordered);
+	CHECK_EQUAL(vertexCount, next);
+
+	float atvrAfter = CalculateATVR(&indices[0], indexCount, vertexCount);
+	CHECK(atvrAfter <= atvrBefore);
+	CHECK(atvrAfter >= 1.0f);
+
+	printf("%-20s %7d tris  ACMR %.3f -> %.3f  ATVR %.3f -> %.3f\n",
+		name, indexCount / 3, acmrBefore, acmrOverdraw, atvrBefore, atvrAfter);
+}
+
+// Known values from a single triangle and a strip
+static void MetricsOnSmallLists()
+{
+	const unsigned int triangle[3] = { 0, 1, 2 };
+	CHECK_NEAR(3.0f, CalculateACMR(triangle, 3, 3), 1e-6);
+	CHECK_NEAR(1.0f, CalculateATVR(triangle, 3, 3), 1e-6);
+
+	// A strip of 4 triangles shares 2 vertices with the last one: 6 misses
+	const unsigned int strip[12] = { 0, 1, 2, 2, 1, 3, 2, 3, 4, 4, 3, 5 };
+	CHECK_NEAR(6.0f / 4.0f, CalculateACMR(strip, 12, 6), 1e-6);
+	CHECK_NEAR(1.0f, CalculateATVR(strip, 12, 6), 1e-6);
+
+	// With a cache of 3, the same vertex twice after two others is a miss
+	const unsigned int thrashed[9] = { 0, 1, 2, 3, 4, 5, 0, 1, 2 };
+	CHECK_NEAR(3.0f, CalculateACMR(thrashed, 9, 6, 3), 1e-6);
+	CHECK_NEAR(1.5f, CalculateATVR(thrashed, 9, 6, 3), 1e-6);
+}
+
+// A grid with its triangles shuffled, the worst case for the cache
+static void ShuffledGrid()
+{
+	const int size = 64;
+	std::vector<Vertex> vertices((size + 1) * (size + 1));
+	for (int y = 0; y <= size; y++)
+	{
+		for (int x = 0; x <= size; x++)
+		{
+			Vertex& v = vertices[y * (size + 1) + x];
+			v = Vertex();
+			v.Position = DirectX::XMFLOAT3((float)x, (float)y, 0.0f);
+			v.normal = DirectX::XMFLOAT3(0.0f, 0.0f, -1.0f);
+			v.uv = DirectX::XMFLOAT2((float)x / size, (float)y / size);
+		}
+	}
+
+	std::vector<unsigned int> quads;
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			unsigned int i = y * (size + 1) + x;
+			unsigned int quad[6] = { i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2 };
+			quads.insert(quads.end(), quad, quad + 6);
+		}
+	}
+
+	// Deterministic shuffle of whole triangles
+	std::vector<unsigned int> indices(quads.size());
+	std::vector<int> order(quads.size() / 3);
+	for (size_t t = 0; t < order.size(); t++)
+		order[t] = (int)t;
+	unsigned int seed = 12345;
+	for (size_t t = order.size() - 1; t > 0; t--)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		std::swap(order[t], order[seed % (t + 1)]);
+	}
+	for (size_t t = 0; t < order.size(); t++)
+	{
+		for (int c = 0; c < 3; c++)
+			indices[t * 3 + c] = quads[order[t] * 3 + c];
+	}
+
+	float acmrShuffled = CalculateACMR(&indices[0], (int)indices.size(), (int)vertices.size());
+	CHECK(acmrShuffled > 1.5f);
+
+	CheckOptimize("shuffled 64x64 grid", vertices, indices);
+
+	// A regular grid can get close to 0.5, anything over 1 means the reorder is broken
+	std::vector<unsigned int> optimized = indices;
+	OptimizeVertexCache(&optimized[0], (int)optimized.size(), (int)vertices.size());
+	CHECK(CalculateACMR(&optimized[0], (int)optimized.size(), (int)vertices.size()) < 0.9f);
+}
+
+static void RepoModels()
+{
+	const char* models[] = { "cube", "cylinder", "helix", "sphere", "torus" };
+	for (const char* model : models)
+	{
+		std::string fileName = std::string("Assets/Models/") + model + ".obj";
+		ObjMeshData meshData;
+		CHECK(LoadObjFile(fileName.c_str(), meshData));
+		if (!meshData.indices.empty())
+			CheckOptimize(model, meshData.vertices, meshData.indices);
+	}
+}
+
+int main()
+{
+	MetricsOnSmallLists();
+	ShuffledGrid();
+	RepoModels();
+	return TEST_RESULT();
+}
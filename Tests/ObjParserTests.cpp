@@ -0,0 +1,195 @@
+#include "ObjParser.h"
+#include "TestHelpers.h"
+#include <string>
+#include <cmath>
+
+static bool Parse(const std::string& text, ObjMeshData& meshData, bool weldVertices = true)
+{
+	return ParseObj(text.c_str(), text.size(), meshData, weldVertices);
+}
+
+// Two triangles sharing an edge, as one quad face
+static void QuadIsTriangulatedAndWelded()
+{
+	const std::string obj =
+		"# a unit quad\n"
+		"v 0 0 0\n"
+		"v 1 0 0\n"
+		"v 1 1 0\n"
+		"v 0 1 0\n"
+		"vt 0 0\n"
+		"vt 1 0\n"
+		"vt 1 1\n"
+		"vt 0 1\n"
+		"vn 0 0 1\n"
+		"f 1/1/1 2/2/1 3/3/1 4/4/1\n";
+
+	ObjMeshData welded;
+	CHECK(Parse(obj, welded));
+	CHECK_EQUAL(6, welded.indices.size());
+	CHECK_EQUAL(4, welded.vertices.size());
+	CHECK_EQUAL(6, welded.stats.inputCorners);
+	CHECK_EQUAL(4, welded.stats.uniqueVertices);
+	CHECK_EQUAL(2 * sizeof(Vertex), welded.stats.bytesSaved);
+
+	ObjMeshData unwelded;
+	CHECK(Parse(obj, unwelded, false));
+	CHECK_EQUAL(6, unwelded.indices.size());
+	CHECK_EQUAL(6, unwelded.vertices.size());
+
+	// Fan around the first corner, winding flipped: (1, 3, 2) then (1, 4, 3)
+	const unsigned int expected[6] = { 0, 1, 2, 0, 3, 1 };
+	for (int i = 0; i < 6; i++)
+		CHECK_EQUAL(expected[i], welded.indices[i]);
+}
+
+// Right-handed file, left-handed vertices
+static void CornersAreConvertedToLeftHanded()
+{
+	const std::string obj =
+		"v 1 2 3\n"
+		"v 4 5 6\n"
+		"v 7 8 9\n"
+		"vt 0.25 0.75\n"
+		"vn 0 0 1\n"
+		"f 1/1/1 2/1/1 3/1/1\n";
+
+	ObjMeshData meshData;
+	CHECK(Parse(obj, meshData));
+	CHECK_EQUAL(3, meshData.vertices.size());
+
+	const Vertex& v = meshData.vertices[0];
+	CHECK_NEAR(1.0f, v.Position.x, 0.0);
+	CHECK_NEAR(2.0f, v.Position.y, 0.0);
+	CHECK_NEAR(-3.0f, v.Position.z, 0.0);
+	CHECK_NEAR(0.25f, v.uv.x, 0.0);
+	CHECK_NEAR(0.25f, v.uv.y, 1e-6);
+	CHECK_NEAR(-1.0f, v.normal.z, 0.0);
+}
+
+// "v", "v//vn", negative (relative) indices, odd numbers and whitespace
+static void CornerFormsAndNumbers()
+{
+	const std::string obj =
+		"v -1.5e1 +2.25 .5\r\n"
+		"v 1E-2 0.0 -0\r\n"
+		"v 3 4 5   # trailing comment\r\n"
+		"vn 0 1 0\r\n"
+		"o ignored\r\n"
+		"s off\r\n"
+		"f -3//1 -2//1 -1//1\r\n"
+		"f 1 2 3\r\n";
+
+	ObjMeshData meshData;
+	CHECK(Parse(obj, meshData));
+	CHECK_EQUAL(6, meshData.indices.size());
+
+	// "v//vn" and "v" corners differ in their normal, so nothing welds across faces
+	CHECK_EQUAL(6, meshData.vertices.size());
+
+	const Vertex& first = meshData.vertices[meshData.indices[0]];
+	CHECK_NEAR(-15.0f, first.Position.x, 1e-6);
+	CHECK_NEAR(2.25f, first.Position.y, 1e-6);
+	CHECK_NEAR(-0.5f, first.Position.z, 1e-6);
+	CHECK_NEAR(1.0f, first.normal.y, 0.0);
+
+	const Vertex& second = meshData.vertices[meshData.indices[2]];
+	CHECK_NEAR(0.01f, second.Position.x, 1e-6);
+
+	const Vertex& last = meshData.vertices[meshData.indices[5]];
+	CHECK_NEAR(0.0f, last.normal.y, 0.0);
+}
+
+// Out of range indices leave that part zeroed instead of reading past the arrays
+static void BadIndicesAreIgnored()
+{
+	const std::string obj =
+		"v 1 1 1\n"
+		"f 1/5/9 1 1\n"
+		"f 1\n";
+
+	ObjMeshData meshData;
+	CHECK(Parse(obj, meshData));
+	CHECK_EQUAL(3, meshData.indices.size());
+	CHECK_NEAR(0.0f, meshData.vertices[0].normal.x, 0.0);
+}
+
+// Indices too big for an int drop the face instead of wrapping to a real vertex
+static void OverflowingIndicesAreRejected()
+{
+	const std::string obj =
+		"v 1 1 1\n"
+		"v 2 2 2\n"
+		"f 4294967297 1 1\n"
+		"f 1/99999999999 2 1\n";
+
+	ObjMeshData meshData;
+	CHECK(Parse(obj, meshData));
+	CHECK_EQUAL(3, meshData.indices.size());
+	CHECK_NEAR(0.0f, meshData.vertices[meshData.indices[0]].uv.x, 0.0);
+}
+
+// Huge exponents come out as 0 (or infinity) instead of indexing past Pow10's table
+static void HugeExponentsAreClamped()
+{
+	const std::string obj =
+		"v 0.1e-2147483647 0 0\n"
+		"v 0.1e-99999999999 1e400 0\n"
+		"f 1 2 1\n";
+
+	ObjMeshData meshData;
+	CHECK(Parse(obj, meshData));
+	CHECK_EQUAL(3, meshData.indices.size());
+	CHECK_NEAR(0.0f, meshData.vertices[meshData.indices[0]].Position.x, 0.0);
+	CHECK(std::isinf(meshData.vertices[meshData.indices[2]].Position.y));
+}
+
+// Every model in the repo, welded and not
+static void RepoModelsParse()
+{
+	const char* models[] = { "cube", "cylinder", "helix", "quad", "quad_double_sided", "sphere", "torus" };
+	for (const char* model : models)
+	{
+		std::string fileName = std::string("Assets/Models/") + model + ".obj";
+
+		ObjMeshData welded;
+		ObjMeshData unwelded;
+		CHECK(LoadObjFile(fileName.c_str(), welded));
+		CHECK(LoadObjFile(fileName.c_str(), unwelded, false));
+
+		CHECK(!welded.indices.empty());
+		CHECK_EQUAL(0, welded.indices.size() % 3);
+		CHECK_EQUAL(unwelded.indices.size(), welded.indices.size());
+		CHECK(welded.vertices.size() < unwelded.vertices.size());
+
+		bool inRange = true;
+		for (unsigned int index : welded.indices)
+			inRange = inRange && index < welded.vertices.size();
+		CHECK(inRange);
+
+		// Welding only shares vertices, every triangle still has the same corners
+		bool same = true;
+		for (size_t i = 0; i < welded.indices.size(); i++)
+		{
+			const Vertex& a = welded.vertices[welded.indices[i]];
+			const Vertex& b = unwelded.vertices[unwelded.indices[i]];
+			same = same && memcmp(&a, &b, sizeof(Vertex)) == 0;
+		}
+		CHECK(same);
+	}
+
+	ObjMeshData missing;
+	CHECK(!LoadObjFile("Assets/Models/missing.obj", missing));
+}
+
+int main()
+{
+	QuadIsTriangulatedAndWelded();
+	CornersAreConvertedToLeftHanded();
+	CornerFormsAndNumbers();
+	BadIndicesAreIgnored();
+	OverflowingIndicesAreRejected();
+	HugeExponentsAreClamped();
+	RepoModelsParse();
+	return TEST_RESULT();
+}
@@ -0,0 +1,151 @@
+#include "RenderQueue.h"
+#include "TestHelpers.h"
+#include <algorithm>
+#include <vector>
+
+// Stand-ins for a scene's resources, only their addresses matter
+struct FakeDraw
+{
+	const void* shader;
+	const void* material;
+	const void* mesh;
+	float depth;
+};
+
+static std::vector<FakeDraw> MakeDraws(unsigned int count)
+{
+	static char shaders[8];
+	static char materials[500];
+	static char meshes[2000];
+
+	std::vector<FakeDraw> draws(count);
+	unsigned int seed = 1;
+	for (FakeDraw& draw : draws)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		draw.shader = &shaders[(seed >> 8) % 8];
+		draw.material = &materials[(seed >> 12) % 500];
+		draw.mesh = &meshes[(seed >> 4) % 2000];
+		draw.depth = (seed >> 8) / (float)(1u << 24);
+	}
+	return draws;
+}
+
+static void Fill(RenderQueue& queue, const std::vector<FakeDraw>& draws)
+{
+	queue.Clear();
+	for (unsigned int i = 0; i < draws.size(); i++)
+	{
+		const FakeDraw& draw = draws[i];
+		unsigned long long key = RenderQueue::MakeSortKey(RENDER_PASS_OPAQUE,
+			queue.GetResourceId(draw.shader),
+			queue.GetResourceId(draw.material),
+			queue.GetResourceId(draw.mesh),
+			draw.depth);
+		queue.Submit(key, { 0, i });
+	}
+	queue.Submit(RenderQueue::MakeSortKey(RENDER_PASS_SKY, 0, 0, 0, 0.0f), { 1, 0 });
+}
+
+static void KeyPacking()
+{
+	// Pass beats everything, then shader, material, mesh and depth
+	unsigned long long sky = RenderQueue::MakeSortKey(RENDER_PASS_SKY, 0, 0, 0, 0.0f);
+	unsigned long long opaque = RenderQueue::MakeSortKey(RENDER_PASS_OPAQUE, 1023, 16383, 16383, 1.0f);
+	CHECK(opaque < sky);
+	CHECK(RenderQueue::MakeSortKey(0, 1, 0, 0, 0.0f) > RenderQueue::MakeSortKey(0, 0, 16383, 16383, 1.0f));
+	CHECK(RenderQueue::MakeSortKey(0, 0, 1, 0, 0.0f) > RenderQueue::MakeSortKey(0, 0, 0, 16383, 1.0f));
+	CHECK(RenderQueue::MakeSortKey(0, 0, 0, 1, 0.0f) > RenderQueue::MakeSortKey(0, 0, 0, 0, 1.0f));
+	CHECK(RenderQueue::MakeSortKey(0, 0, 0, 0, 0.5f) > RenderQueue::MakeSortKey(0, 0, 0, 0, 0.25f));
+
+	// Depth is clamped, wide IDs are masked into their field
+	CHECK_EQUAL(RenderQueue::MakeSortKey(0, 0, 0, 0, 0.0f), RenderQueue::MakeSortKey(0, 0, 0, 0, -5.0f));
+	CHECK_EQUAL(RenderQueue::MakeSortKey(0, 0, 0, 0, 1.0f), RenderQueue::MakeSortKey(0, 0, 0, 0, 7.0f));
+	CHECK_EQUAL(RenderQueue::MakeSortKey(0, 0, 0, 3, 0.0f), RenderQueue::MakeSortKey(0, 0, 0, 16384 + 3, 0.0f));
+}
+
+static void ResourceIdsLastOneFrame()
+{
+	RenderQueue queue;
+	char resources[2];
+	const void* a = &resources[0];
+	const void* b = &resources[1];
+	CHECK_EQUAL(0, queue.GetResourceId(a));
+	CHECK_EQUAL(1, queue.GetResourceId(b));
+	CHECK_EQUAL(0, queue.GetResourceId(a));
+
+	// Next frame starts over in first-seen order
+	queue.Clear();
+	CHECK_EQUAL(0, queue.GetResourceId(b));
+	CHECK_EQUAL(1, queue.GetResourceId(a));
+}
+
+// Sorted keys ascend, and equal keys keep their submission order
+static void CheckSorted(const RenderQueue& queue)
+{
+	bool ordered = true;
+	for (unsigned int i = 1; i < queue.GetCount(); i++)
+	{
+		unsigned long long previous = queue.GetSortKey(i - 1);
+		unsigned long long key = queue.GetSortKey(i);
+		ordered = ordered && (previous < key || (previous == key && queue.GetPacket(i - 1).index < queue.GetPacket(i).index));
+	}
+	CHECK(ordered);
+	CHECK_EQUAL(1, queue.GetPacket(queue.GetCount() - 1).command);
+}
+
+int main(int argc, char* argv[])
+{
+	KeyPacking();
+	ResourceIdsLastOneFrame();
+
+	bool quick = IsQuickRun(argc, argv);
+	unsigned int drawCount = quick ? 10000 : 100000;
+	int runs = quick ? 1 : 10;
+	std::vector<FakeDraw> draws = MakeDraws(drawCount);
+
+	RenderQueue queue;
+	double fillMilliseconds = BestOf(runs, [&]() { Fill(queue, draws); });
+
+	// Each sort needs the unsorted submission again
+	double sortMilliseconds = 0.0;
+	for (int r = 0; r < runs; r++)
+	{
+		Fill(queue, draws);
+		BenchmarkTimer timer;
+		queue.Sort();
+		double milliseconds = timer.Milliseconds();
+		sortMilliseconds = r == 0 || milliseconds < sortMilliseconds ? milliseconds : sortMilliseconds;
+	}
+	CheckSorted(queue);
+
+	RenderQueueStats stats = queue.GetStats();
+	CHECK_EQUAL(drawCount + 1, stats.draws);
+	CHECK(stats.stateChangesSorted < stats.stateChangesSubmitted);
+
+	// The same keys through std::stable_sort, for comparison
+	std::vector<std::pair<unsigned long long, unsigned int>> keys(queue.GetCount());
+	double stdSortMilliseconds = 0.0;
+	for (int r = 0; r < runs; r++)
+	{
+		Fill(queue, draws);
+		for (unsigned int i = 0; i < queue.GetCount(); i++)
+			keys[i] = { queue.GetSortKey(i), i };
+
+		BenchmarkTimer timer;
+		std::stable_sort(keys.begin(), keys.end(), [](const std::pair<unsigned long long, unsigned int>& a, const std::pair<unsigned long long, unsigned int>& b)
+		{
+			return a.first < b.first;
+		});
+		double milliseconds = timer.Milliseconds();
+		stdSortMilliseconds = r == 0 || milliseconds < stdSortMilliseconds ? milliseconds : stdSortMilliseconds;
+	}
+
+	printf("%u draws\n", drawCount + 1);
+	printf("  key packing + submit  %8.3f ms\n", fillMilliseconds);
+	printf("  radix sort            %8.3f ms\n", sortMilliseconds);
+	printf("  std::stable_sort      %8.3f ms\n", stdSortMilliseconds);
+	printf("  state changes %u submitted, %u sorted\n", stats.stateChangesSubmitted, stats.stateChangesSorted);
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,246 @@
+#include "RenderStateCache.h"
+#include "TestHelpers.h"
+#include <map>
+#include <tuple>
+
+// --------------------------------------------------------
+// A stand-in for the device context: it only remembers what
+// is bound where and how many calls reached it.  Each Bind
+// goes through the cache the way the engine's draw code does,
+// so the mock only sees the binds the cache let through.
+// --------------------------------------------------------
+class MockContext
+{
+public:
+	MockContext() : calls(0) {}
+
+	void BindShader(RenderStage stage, const void* shader)
+	{
+		if (RenderStateCache::GetInstance().UpdateShader(stage, shader))
+			Set(std::make_tuple(0, (int)stage, 0u), shader);
+	}
+
+	void BindConstantBuffer(RenderStage stage, unsigned int slot, const void* buffer)
+	{
+		if (RenderStateCache::GetInstance().UpdateConstantBuffer(stage, slot, buffer))
+			Set(std::make_tuple(1, (int)stage, slot), buffer);
+	}
+
+	void BindShaderResource(RenderStage stage, unsigned int slot, const void* srv)
+	{
+		if (RenderStateCache::GetInstance().UpdateShaderResource(stage, slot, srv))
+			Set(std::make_tuple(2, (int)stage, slot), srv);
+	}
+
+	void BindSampler(RenderStage stage, unsigned int slot, const void* sampler)
+	{
+		if (RenderStateCache::GetInstance().UpdateSampler(stage, slot, sampler))
+			Set(std::make_tuple(3, (int)stage, slot), sampler);
+	}
+
+	void BindVertexBuffer(unsigned int slot, const void* buffer, unsigned int stride, unsigned int offset)
+	{
+		if (RenderStateCache::GetInstance().UpdateVertexBuffer(slot, buffer, stride, offset))
+		{
+			Set(std::make_tuple(4, 0, slot), buffer);
+			Set(std::make_tuple(4, 1, slot), (const void*)(size_t)stride, false);
+			Set(std::make_tuple(4, 2, slot), (const void*)(size_t)offset, false);
+		}
+	}
+
+	void BindDepthStencilState(const void* state, unsigned int stencilRef)
+	{
+		if (RenderStateCache::GetInstance().UpdateDepthStencilState(state, stencilRef))
+		{
+			Set(std::make_tuple(5, 0, 0u), state);
+			Set(std::make_tuple(5, 1, 0u), (const void*)(size_t)stencilRef, false);
+		}
+	}
+
+	// Something binding on the context behind the cache's back
+	void BindShaderDirectly(RenderStage stage, const void* shader)
+	{
+		Set(std::make_tuple(0, (int)stage, 0u), shader);
+	}
+
+	const void* Get(int kind, int index, unsigned int slot) const
+	{
+		std::map<Binding, const void*>::const_iterator it = bound.find(std::make_tuple(kind, index, slot));
+		return it == bound.end() ? 0 : it->second;
+	}
+
+	unsigned int GetCalls() const { return calls; }
+
+private:
+	typedef std::tuple<int, int, unsigned int> Binding;
+	std::map<Binding, const void*> bound;
+	unsigned int calls;
+
+	void Set(const Binding& binding, const void* value, bool countCall = true)
+	{
+		bound[binding] = value;
+		if (countCall)
+			calls++;
+	}
+};
+
+// Each test starts from an empty context, like after a device reset
+static RenderStateCache& FreshCache()
+{
+	RenderStateCache& cache = RenderStateCache::GetInstance();
+	cache.Invalidate();
+	cache.ResetStats();
+	return cache;
+}
+
+static char resources[16];
+
+static void FiltersRedundantBinds()
+{
+	RenderStateCache& cache = FreshCache();
+	MockContext context;
+
+	// The first bind always goes through, even null
+	context.BindShader(RenderStageVertex, 0);
+	CHECK_EQUAL(1, context.GetCalls());
+
+	context.BindShader(RenderStageVertex, &resources[0]);
+	context.BindShader(RenderStageVertex, &resources[0]);
+	context.BindShader(RenderStagePixel, &resources[0]);	// Stages are tracked apart
+	context.BindShader(RenderStagePixel, &resources[0]);
+	CHECK_EQUAL(3, context.GetCalls());
+	CHECK(context.Get(0, RenderStageVertex, 0) == &resources[0]);
+
+	context.BindConstantBuffer(RenderStageVertex, 0, &resources[1]);
+	context.BindConstantBuffer(RenderStageVertex, 1, &resources[1]);	// So are slots
+	context.BindConstantBuffer(RenderStageVertex, 0, &resources[1]);
+	context.BindShaderResource(RenderStagePixel, 3, &resources[2]);
+	context.BindShaderResource(RenderStagePixel, 3, &resources[2]);
+	context.BindSampler(RenderStagePixel, 0, &resources[3]);
+	context.BindSampler(RenderStagePixel, 0, &resources[3]);
+	CHECK_EQUAL(7, context.GetCalls());
+
+	CHECK_EQUAL(7, cache.GetForwardedCount());
+	CHECK_EQUAL(5, cache.GetFilteredCount());
+}
+
+static void ComparesEveryArgument()
+{
+	RenderStateCache& cache = FreshCache();
+	MockContext context;
+
+	context.BindVertexBuffer(0, &resources[0], 32, 0);
+	context.BindVertexBuffer(0, &resources[0], 32, 0);
+	context.BindVertexBuffer(0, &resources[0], 48, 0);	// New stride
+	context.BindVertexBuffer(0, &resources[0], 48, 96);	// New offset
+	CHECK_EQUAL(3, context.GetCalls());
+	CHECK_EQUAL(48, (size_t)context.Get(4, 1, 0));
+	CHECK_EQUAL(96, (size_t)context.Get(4, 2, 0));
+
+	context.BindDepthStencilState(&resources[1], 0);
+	context.BindDepthStencilState(&resources[1], 0);
+	context.BindDepthStencilState(&resources[1], 1);	// Same state, new stencil ref
+	CHECK_EQUAL(5, context.GetCalls());
+	CHECK_EQUAL(1, (size_t)context.Get(5, 1, 0));
+
+	CHECK(cache.UpdateIndexBuffer(&resources[2], 42, 0));
+	CHECK(!cache.UpdateIndexBuffer(&resources[2], 42, 0));
+	CHECK(cache.UpdateIndexBuffer(&resources[2], 57, 0));
+	CHECK(cache.UpdateIndexBuffer(&resources[2], 57, 6));
+	CHECK(cache.UpdateInputLayout(&resources[3]));
+	CHECK(!cache.UpdateInputLayout(&resources[3]));
+	CHECK(cache.UpdateRasterizerState(0));
+	CHECK(!cache.UpdateRasterizerState(0));
+}
+
+static void SlotsPastTheLimitAlwaysForward()
+{
+	RenderStateCache& cache = FreshCache();
+	MockContext context;
+
+	context.BindConstantBuffer(RenderStageVertex, RENDER_STATE_CONSTANT_BUFFER_SLOTS, &resources[0]);
+	context.BindConstantBuffer(RenderStageVertex, RENDER_STATE_CONSTANT_BUFFER_SLOTS, &resources[0]);
+	context.BindSampler(RenderStagePixel, RENDER_STATE_SAMPLER_SLOTS, &resources[1]);
+	context.BindSampler(RenderStagePixel, RENDER_STATE_SAMPLER_SLOTS, &resources[1]);
+	context.BindVertexBuffer(RENDER_STATE_VERTEX_BUFFER_SLOTS, &resources[2], 16, 0);
+	context.BindVertexBuffer(RENDER_STATE_VERTEX_BUFFER_SLOTS, &resources[2], 16, 0);
+	CHECK_EQUAL(6, context.GetCalls());
+
+	// Nothing was tracked, so nothing counts either way
+	CHECK_EQUAL(0, cache.GetFilteredCount());
+	CHECK_EQUAL(0, cache.GetForwardedCount());
+}
+
+static void InvalidateAfterDirectBinds()
+{
+	RenderStateCache& cache = FreshCache();
+	MockContext context;
+
+	context.BindShader(RenderStagePixel, &resources[0]);
+	context.BindShaderDirectly(RenderStagePixel, &resources[1]);
+
+	// Without an Invalidate() the cache still thinks resources[0] is bound
+	context.BindShader(RenderStagePixel, &resources[0]);
+	CHECK(context.Get(0, RenderStagePixel, 0) == &resources[1]);
+
+	cache.Invalidate();
+	context.BindShader(RenderStagePixel, &resources[0]);
+	CHECK(context.Get(0, RenderStagePixel, 0) == &resources[0]);
+
+	// And only the first bind after it goes through
+	unsigned int calls = context.GetCalls();
+	context.BindShader(RenderStagePixel, &resources[0]);
+	CHECK_EQUAL(calls, context.GetCalls());
+}
+
+// A long run of random binds: whatever the cache drops, the context
+// must always end up with what was last asked for
+static void ContextMatchesEveryRequest()
+{
+	RenderStateCache& cache = FreshCache();
+	MockContext context;
+
+	const void* expected[RenderStageCount][4] = {};
+	bool known[RenderStageCount][4] = {};
+	unsigned int requests = 0;
+	bool matches = true;
+
+	unsigned int seed = 7;
+	for (int i = 0; i < 20000; i++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		RenderStage stage = (RenderStage)((seed >> 8) % RenderStageCount);
+		unsigned int slot = (seed >> 12) % 4;
+		const void* value = (seed >> 16) % 5 == 0 ? 0 : &resources[(seed >> 20) % 4];
+
+		if ((seed >> 24) % 500 == 0)
+		{
+			cache.Invalidate();
+			continue;
+		}
+
+		context.BindShaderResource(stage, slot, value);
+		expected[stage][slot] = value;
+		known[stage][slot] = true;
+		requests++;
+
+		for (int s = 0; s < RenderStageCount; s++)
+			for (unsigned int t = 0; t < 4; t++)
+				matches = matches && (!known[s][t] || context.Get(2, s, t) == expected[s][t]);
+	}
+
+	CHECK(matches);
+	CHECK_EQUAL(requests, cache.GetFilteredCount() + cache.GetForwardedCount());
+	CHECK_EQUAL(cache.GetForwardedCount(), context.GetCalls());
+	CHECK(cache.GetFilteredCount() > 0);
+}
+
+int main()
+{
+	FiltersRedundantBinds();
+	ComparesEveryArgument();
+	SlotsPastTheLimitAlwaysForward();
+	InvalidateAfterDirectBinds();
+	ContextMatchesEveryRequest();
+	return TEST_RESULT();
+}
@@ -0,0 +1,168 @@
+#include "SimpleShader.h"
+#include "TestHelpers.h"
+#include <string>
+#include <vector>
+
+#pragma comment(lib, "d3d11.lib")
+
+using namespace DirectX;
+using namespace Microsoft::WRL;
+
+// --------------------------------------------------------
+// Per-draw CPU cost of setting object data on the game's
+// real shaders: by name (a string built and hashed for every
+// variable, as before handles) against SimpleVariableHandle.
+//
+// Runs on a WARP device so it needs no GPU; the shaders are
+// compiled from the repo's .hlsl into the temp folder.
+// --------------------------------------------------------
+
+// Compiles a shader and writes it where SimpleShader can load it from
+static bool CompileToFile(const wchar_t* source, const char* target, std::wstring& outputFile)
+{
+	ComPtr<ID3DBlob> blob;
+	ComPtr<ID3DBlob> errors;
+	HRESULT hr = D3DCompileFromFile(source, 0, D3D_COMPILE_STANDARD_FILE_INCLUDE, "main", target,
+		D3DCOMPILE_OPTIMIZATION_LEVEL3, 0, blob.GetAddressOf(), errors.GetAddressOf());
+	if (FAILED(hr))
+	{
+		printf("Couldn't compile %ls: %s\n", source, errors ? (const char*)errors->GetBufferPointer() : "file not found");
+		return false;
+	}
+
+	wchar_t tempPath[MAX_PATH];
+	GetTempPathW(MAX_PATH, tempPath);
+	outputFile = std::wstring(tempPath) + L"ShaderSetterBenchmark_" + source + L".cso";
+	return SUCCEEDED(D3DWriteBlobToFile(blob.Get(), outputFile.c_str(), TRUE));
+}
+
+// What one entity's draw sets, with a different world matrix each time
+struct DrawData
+{
+	XMFLOAT4X4 world;
+	XMFLOAT4X4 worldInvTranspose;
+	XMFLOAT4 tint;
+	unsigned int lights[8];
+};
+
+static std::vector<DrawData> MakeDraws(unsigned int count)
+{
+	std::vector<DrawData> draws(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMMATRIX world = XMMatrixTranslation((float)(i % 100), (float)(i / 100 % 100), (float)(i / 10000));
+		XMStoreFloat4x4(&draws[i].world, XMMatrixTranspose(world));
+		XMStoreFloat4x4(&draws[i].worldInvTranspose, XMMatrixInverse(0, world));
+		draws[i].tint = XMFLOAT4(1.0f, (i % 7) / 7.0f, 1.0f, 1.0f);
+		for (unsigned int l = 0; l < 8; l++)
+			draws[i].lights[l] = (i + l) % 64;
+	}
+	return draws;
+}
+
+int main(int argc, char* argv[])
+{
+	bool quick = IsQuickRun(argc, argv);
+	unsigned int drawCount = quick ? 1000 : 100000;
+
+	ComPtr<ID3D11Device> device;
+	ComPtr<ID3D11DeviceContext> context;
+	HRESULT hr = D3D11CreateDevice(0, D3D_DRIVER_TYPE_WARP, 0, 0, 0, 0, D3D11_SDK_VERSION,
+		device.GetAddressOf(), 0, context.GetAddressOf());
+	CHECK(SUCCEEDED(hr));
+	if (FAILED(hr))
+		return TEST_RESULT();
+
+	std::wstring vertexFile;
+	std::wstring pixelFile;
+	CHECK(CompileToFile(L"VertexShader.hlsl", "vs_5_0", vertexFile));
+	CHECK(CompileToFile(L"PixelShader.hlsl", "ps_5_0", pixelFile));
+	if (testFailures)
+		return TEST_RESULT();
+
+	SimpleVertexShader vs(device, context, vertexFile.c_str());
+	SimplePixelShader ps(device, context, pixelFile.c_str());
+	CHECK(vs.IsShaderValid());
+	CHECK(ps.IsShaderValid());
+
+	std::vector<DrawData> draws = MakeDraws(drawCount);
+	int runs = quick ? 1 : 5;
+
+	double byName = BestOf(runs, [&]()
+	{
+		for (const DrawData& draw : draws)
+		{
+			vs.SetMatrix4x4("worldMatrix", draw.world);
+			vs.SetMatrix4x4("worldInvTranspose", draw.worldInvTranspose);
+			vs.SetFloat4("objectTint", draw.tint);
+			ps.SetFloat4("colorTint", draw.tint);
+			ps.SetInt("useGammaCorrection", 1);
+			ps.SetInt("objectLightNum", 8);
+			ps.SetData("objectLights", draw.lights, sizeof(draw.lights));
+			vs.CopyAllBufferData();
+			ps.CopyAllBufferData();
+		}
+	});
+
+	SimpleVariableHandle worldHandle = vs.GetVariableHandle("worldMatrix");
+	SimpleVariableHandle worldInvTransposeHandle = vs.GetVariableHandle("worldInvTranspose");
+	SimpleVariableHandle objectTintHandle = vs.GetVariableHandle("objectTint");
+	SimpleVariableHandle colorTintHandle = ps.GetVariableHandle("colorTint");
+	SimpleVariableHandle gammaHandle = ps.GetVariableHandle("useGammaCorrection");
+	SimpleVariableHandle lightNumHandle = ps.GetVariableHandle("objectLightNum");
+	SimpleVariableHandle lightsHandle = ps.GetVariableHandle("objectLights");
+	CHECK(worldHandle.IsValid() && worldInvTransposeHandle.IsValid() && objectTintHandle.IsValid());
+	CHECK(colorTintHandle.IsValid() && gammaHandle.IsValid() && lightNumHandle.IsValid() && lightsHandle.IsValid());
+
+	double byHandle = BestOf(runs, [&]()
+	{
+		for (const DrawData& draw : draws)
+		{
+			vs.SetMatrix4x4(worldHandle, draw.world);
+			vs.SetMatrix4x4(worldInvTransposeHandle, draw.worldInvTranspose);
+			vs.SetFloat4(objectTintHandle, draw.tint);
+			ps.SetFloat4(colorTintHandle, draw.tint);
+			ps.SetInt(gammaHandle, 1);
+			ps.SetInt(lightNumHandle, 8);
+			ps.SetData(lightsHandle, draw.lights, sizeof(draw.lights));
+			vs.CopyAllBufferData();
+			ps.CopyAllBufferData();
+		}
+	});
+
+	// Same setters without the uploads, to show what the lookups alone cost
+	double setOnlyByName = BestOf(runs, [&]()
+	{
+		for (const DrawData& draw : draws)
+		{
+			vs.SetMatrix4x4("worldMatrix", draw.world);
+			vs.SetMatrix4x4("worldInvTranspose", draw.worldInvTranspose);
+			vs.SetFloat4("objectTint", draw.tint);
+			ps.SetFloat4("colorTint", draw.tint);
+			ps.SetInt("objectLightNum", 8);
+			ps.SetData("objectLights", draw.lights, sizeof(draw.lights));
+		}
+	});
+
+	double setOnlyByHandle = BestOf(runs, [&]()
+	{
+		for (const DrawData& draw : draws)
+		{
+			vs.SetMatrix4x4(worldHandle, draw.world);
+			vs.SetMatrix4x4(worldInvTransposeHandle, draw.worldInvTranspose);
+			vs.SetFloat4(objectTintHandle, draw.tint);
+			ps.SetFloat4(colorTintHandle, draw.tint);
+			ps.SetInt(lightNumHandle, 8);
+			ps.SetData(lightsHandle, draw.lights, sizeof(draw.lights));
+		}
+	});
+
+	double toNanoseconds = 1000000.0 / drawCount;
+	printf("%u draws, 7 variables each\n", drawCount);
+	printf("  set + upload   by name %8.1f ns/draw   by handle %8.1f ns/draw\n", byName * toNanoseconds, byHandle * toNanoseconds);
+	printf("  set only       by name %8.1f ns/draw   by handle %8.1f ns/draw\n", setOnlyByName * toNanoseconds, setOnlyByHandle * toNanoseconds);
+
+	DeleteFileW(vertexFile.c_str());
+	DeleteFileW(pixelFile.c_str());
+	return TEST_RESULT();
+}
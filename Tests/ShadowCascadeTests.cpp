@@ -0,0 +1,158 @@
+#include "ShadowCascades.h"
+#include "TestHelpers.h"
+
+using namespace DirectX;
+
+static const float NearClip = 0.01f;
+static const float FarClip = 1000.0f;
+static const XMFLOAT3 LightDirection(0.3f, -1.0f, 0.2f);
+
+// A camera turned and moved a bit more on every step
+static void MakeCamera(int step, bool perspective, XMFLOAT4X4& view, XMFLOAT4X4& projection)
+{
+	float yaw = step * 0.37f;
+	XMVECTOR position = XMVectorSet(step * 0.113f, 2.0f, -5.0f + step * 0.05f, 0.0f);
+	XMVECTOR forward = XMVectorSet(sinf(yaw), -0.2f, cosf(yaw), 0.0f);
+	XMStoreFloat4x4(&view, XMMatrixLookToLH(position, forward, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+
+	if (perspective)
+		XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(1.0f, 16.0f / 9.0f, NearClip, FarClip));
+	else
+		XMStoreFloat4x4(&projection, XMMatrixOrthographicLH(20.0f, 11.25f, NearClip, FarClip));
+}
+
+static void SplitsCoverTheRange()
+{
+	float splits[MAX_SHADOW_CASCADES + 1];
+
+	// Evenly spaced
+	ComputeShadowCascadeSplits(1.0f, 9.0f, 4, 0.0f, splits);
+	CHECK_NEAR(1.0f, splits[0], 0.0001);
+	CHECK_NEAR(3.0f, splits[1], 0.0001);
+	CHECK_NEAR(5.0f, splits[2], 0.0001);
+	CHECK_NEAR(7.0f, splits[3], 0.0001);
+	CHECK_NEAR(9.0f, splits[4], 0.0001);
+
+	// Logarithmic: every split the same ratio further than the last
+	ComputeShadowCascadeSplits(1.0f, 16.0f, 4, 1.0f, splits);
+	CHECK_NEAR(2.0f, splits[1], 0.0001);
+	CHECK_NEAR(4.0f, splits[2], 0.0001);
+	CHECK_NEAR(8.0f, splits[3], 0.0001);
+	CHECK_NEAR(16.0f, splits[4], 0.0001);
+
+	// In between, still ascending from near to far
+	ComputeShadowCascadeSplits(0.1f, 60.0f, 3, 0.75f, splits);
+	CHECK_NEAR(0.1f, splits[0], 0.0001);
+	CHECK_NEAR(60.0f, splits[3], 0.0001);
+	CHECK(splits[0] < splits[1] && splits[1] < splits[2] && splits[2] < splits[3]);
+}
+
+// Every corner of each cascade's slice of the camera frustum is
+// inside that cascade's light box, with its depth in [0, 1]
+static void CascadesContainTheirSlice(bool perspective)
+{
+	ShadowCascadeSettings settings;
+	bool contained = true;
+	bool adjacent = true;
+
+	for (int step = 0; step < 50; step++)
+	{
+		XMFLOAT4X4 view;
+		XMFLOAT4X4 projection;
+		MakeCamera(step, perspective, view, projection);
+
+		ShadowCascade cascades[MAX_SHADOW_CASCADES];
+		ComputeShadowCascades(view, projection, NearClip, FarClip, LightDirection, settings, cascades);
+
+		// Shadows stop at maxDistance, the cascades meet end to end
+		CHECK_NEAR(NearClip, cascades[0].splitNear, 0.0001);
+		CHECK_NEAR(settings.maxDistance, cascades[settings.cascadeCount - 1].splitFar, 0.001);
+		for (unsigned int i = 1; i < settings.cascadeCount; i++)
+			adjacent = adjacent && cascades[i].splitNear == cascades[i - 1].splitFar;
+
+		XMMATRIX inverseView = XMMatrixInverse(0, XMLoadFloat4x4(&view));
+		for (unsigned int i = 0; i < settings.cascadeCount; i++)
+		{
+			XMMATRIX lightViewProjection = XMLoadFloat4x4(&cascades[i].view) * XMLoadFloat4x4(&cascades[i].projection);
+			for (int corner = 0; corner < 8; corner++)
+			{
+				float depth = corner & 4 ? cascades[i].splitFar : cascades[i].splitNear;
+				float halfWidth = (perspective ? depth : 1.0f) / projection._11;
+				float halfHeight = (perspective ? depth : 1.0f) / projection._22;
+				XMVECTOR viewCorner = XMVectorSet(corner & 1 ? halfWidth : -halfWidth, corner & 2 ? halfHeight : -halfHeight, depth, 1.0f);
+
+				XMFLOAT3 lightClip;
+				XMStoreFloat3(&lightClip, XMVector3TransformCoord(XMVector3TransformCoord(viewCorner, inverseView), lightViewProjection));
+				contained = contained && fabsf(lightClip.x) <= 1.0001f && fabsf(lightClip.y) <= 1.0001f && lightClip.z >= 0.0f && lightClip.z <= 1.0f;
+			}
+		}
+	}
+
+	CHECK(contained);
+	CHECK(adjacent);
+}
+
+// Turning the camera doesn't resize the light boxes, and the world
+// stays on the same texel grid however the camera moves
+static void CascadesAreStable()
+{
+	ShadowCascadeSettings settings;
+	ShadowCascade first[MAX_SHADOW_CASCADES];
+	bool sameSize = true;
+	bool snapped = true;
+
+	for (int step = 0; step < 50; step++)
+	{
+		XMFLOAT4X4 view;
+		XMFLOAT4X4 projection;
+		MakeCamera(step, true, view, projection);
+
+		ShadowCascade cascades[MAX_SHADOW_CASCADES];
+		ComputeShadowCascades(view, projection, NearClip, FarClip, LightDirection, settings, step == 0 ? first : cascades);
+		const ShadowCascade* current = step == 0 ? first : cascades;
+
+		for (unsigned int i = 0; i < settings.cascadeCount; i++)
+		{
+			sameSize = sameSize && fabsf(current[i].sphereRadius - first[i].sphereRadius) <= first[i].sphereRadius * 0.0001f;
+
+			// The world origin lands on a whole texel in every cascade
+			XMMATRIX lightViewProjection = XMLoadFloat4x4(&current[i].view) * XMLoadFloat4x4(&current[i].projection);
+			XMFLOAT3 origin;
+			XMStoreFloat3(&origin, XMVector3TransformCoord(XMVectorZero(), lightViewProjection));
+			float texelX = origin.x * 0.5f * settings.resolution;
+			float texelY = origin.y * 0.5f * settings.resolution;
+			snapped = snapped && fabsf(texelX - roundf(texelX)) <= 0.02f && fabsf(texelY - roundf(texelY)) <= 0.02f;
+		}
+	}
+
+	CHECK(sameSize);
+	CHECK(snapped);
+}
+
+// A camera far plane closer than maxDistance ends the last cascade there
+static void NearFarPlaneEndsShadows()
+{
+	ShadowCascadeSettings settings;
+	settings.cascadeCount = 2;
+
+	XMFLOAT4X4 view;
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&view, XMMatrixIdentity());
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(1.0f, 1.0f, 0.5f, 20.0f));
+
+	ShadowCascade cascades[MAX_SHADOW_CASCADES];
+	ComputeShadowCascades(view, projection, 0.5f, 20.0f, LightDirection, settings, cascades);
+	CHECK_NEAR(0.5f, cascades[0].splitNear, 0.0001);
+	CHECK_NEAR(20.0f, cascades[1].splitFar, 0.0001);
+	CHECK(cascades[0].sphereRadius < cascades[1].sphereRadius);
+}
+
+int main()
+{
+	SplitsCoverTheRange();
+	CascadesContainTheirSlice(true);
+	CascadesContainTheirSlice(false);
+	CascadesAreStable();
+	NearFarPlaneEndsShadows();
+	return TEST_RESULT();
+}
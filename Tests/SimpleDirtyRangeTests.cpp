@@ -0,0 +1,104 @@
+#include "SimpleDirtyRange.h"
+#include "TestHelpers.h"
+
+static void StartsClean()
+{
+	SimpleDirtyRange range;
+	unsigned int start = 1;
+	unsigned int end = 1;
+	CHECK(!range.IsDirty());
+	CHECK(!range.GetAlignedRange(256, start, end));
+
+	// Empty writes don't dirty anything
+	range.Mark(64, 0);
+	CHECK(!range.IsDirty());
+}
+
+static void GrowsToCoverEveryWrite()
+{
+	SimpleDirtyRange range;
+	range.Mark(20, 8);
+	CHECK(range.IsDirty());
+	CHECK_EQUAL(20, range.Start);
+	CHECK_EQUAL(28, range.End);
+
+	// Before, inside and after the current range
+	range.Mark(4, 4);
+	CHECK_EQUAL(4, range.Start);
+	CHECK_EQUAL(28, range.End);
+	range.Mark(10, 2);
+	CHECK_EQUAL(4, range.Start);
+	CHECK_EQUAL(28, range.End);
+	range.Mark(100, 12);
+	CHECK_EQUAL(4, range.Start);
+	CHECK_EQUAL(112, range.End);
+
+	// A fresh range after Clear() starts over, it doesn't keep the old start
+	range.Clear();
+	CHECK(!range.IsDirty());
+	range.Mark(64, 16);
+	CHECK_EQUAL(64, range.Start);
+	CHECK_EQUAL(80, range.End);
+}
+
+static void AlignsToWholeConstants()
+{
+	SimpleDirtyRange range;
+	unsigned int start = 0;
+	unsigned int end = 0;
+
+	// A float in the middle of the second constant
+	range.Mark(20, 4);
+	CHECK(range.GetAlignedRange(256, start, end));
+	CHECK_EQUAL(16, start);
+	CHECK_EQUAL(32, end);
+
+	// A matrix spanning four constants exactly
+	range.Clear();
+	range.Mark(64, 64);
+	CHECK(range.GetAlignedRange(256, start, end));
+	CHECK_EQUAL(64, start);
+	CHECK_EQUAL(128, end);
+
+	// Straddling a boundary takes both constants
+	range.Clear();
+	range.Mark(12, 8);
+	CHECK(range.GetAlignedRange(256, start, end));
+	CHECK_EQUAL(0, start);
+	CHECK_EQUAL(32, end);
+
+	// Clamped to the buffer
+	range.Clear();
+	range.Mark(36, 4);
+	CHECK(range.GetAlignedRange(40, start, end));
+	CHECK_EQUAL(32, start);
+	CHECK_EQUAL(40, end);
+}
+
+static void MarkAllCoversTheBuffer()
+{
+	SimpleDirtyRange range;
+	range.Mark(32, 4);
+	range.MarkAll(192);
+	CHECK_EQUAL(0, range.Start);
+	CHECK_EQUAL(192, range.End);
+
+	unsigned int start = 1;
+	unsigned int end = 0;
+	CHECK(range.GetAlignedRange(192, start, end));
+	CHECK_EQUAL(0, start);
+	CHECK_EQUAL(192, end);
+
+	// An empty buffer is never dirty
+	range.MarkAll(0);
+	CHECK(!range.IsDirty());
+}
+
+int main()
+{
+	StartsClean();
+	GrowsToCoverEveryWrite();
+	AlignsToWholeConstants();
+	MarkAllCoversTheBuffer();
+	return TEST_RESULT();
+}
@@ -0,0 +1,101 @@
+#include "MeshTangents.h"
+#include "JobSystem.h"
+#include "ObjParser.h"
+#include "TestHelpers.h"
+#include <cmath>
+#include <string>
+#include <vector>
+
+// A wavy grid with (size * size * 2) triangles, uvs stretched so the tangents vary
+static void MakeGrid(int size, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	vertices.resize((size + 1) * (size + 1));
+	for (int y = 0; y <= size; y++)
+	{
+		for (int x = 0; x <= size; x++)
+		{
+			float u = (float)x / size;
+			float v = (float)y / size;
+			Vertex& vertex = vertices[y * (size + 1) + x];
+			vertex = Vertex();
+			vertex.Position = DirectX::XMFLOAT3(u * 10.0f, sinf(u * 20.0f) * cosf(v * 13.0f), v * 10.0f);
+			vertex.normal = DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
+			vertex.uv = DirectX::XMFLOAT2(u * u, v + u * 0.25f);
+		}
+	}
+
+	indices.clear();
+	indices.reserve(size * size * 6);
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			unsigned int i = y * (size + 1) + x;
+			unsigned int quad[6] = { i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+}
+
+static void Compare(const char* name, const std::vector<Vertex>& source, std::vector<unsigned int>& indices, int runs)
+{
+	std::vector<Vertex> serial = source;
+	std::vector<Vertex> parallel = source;
+	int vertexCount = (int)source.size();
+	int indexCount = (int)indices.size();
+
+	double serialMilliseconds = BestOf(runs, [&]()
+	{
+		CalculateTangentsSerial(&serial[0], vertexCount, &indices[0], indexCount);
+	});
+
+	double parallelMilliseconds = BestOf(runs, [&]()
+	{
+		CalculateTangents(&parallel[0], vertexCount, &indices[0], indexCount);
+	});
+
+	// The parallel path has to reproduce the serial sums exactly
+	CHECK(memcmp(&serial[0], &parallel[0], sizeof(Vertex) * vertexCount) == 0);
+
+	printf("%-24s %9d tris  serial %9.3f ms  parallel %9.3f ms  (%.2fx)\n",
+		name, indexCount / 3, serialMilliseconds, parallelMilliseconds,
+		parallelMilliseconds > 0.0 ? serialMilliseconds / parallelMilliseconds : 0.0);
+}
+
+int main(int argc, char* argv[])
+{
+	bool quick = IsQuickRun(argc, argv);
+	int runs = quick ? 1 : 5;
+
+	// The quick run always checks the parallel path, even on one core
+	if (quick)
+		JobSystem::RequestedThreadCount = 4;
+	printf("%u job threads\n", JobSystem::GetInstance().GetThreadCount());
+
+	const char* models[] = { "cube", "cylinder", "helix", "sphere", "torus" };
+	for (const char* model : models)
+	{
+		std::string fileName = std::string("Assets/Models/") + model + ".obj";
+		ObjMeshData meshData;
+		CHECK(LoadObjFile(fileName.c_str(), meshData));
+		if (!meshData.indices.empty())
+			Compare(model, meshData.vertices, meshData.indices, runs);
+	}
+
+	// Past the size where the parallel path kicks in, up to a million triangles
+	const int gridSizes[] = { 128, 256, 708 };
+	for (int size : gridSizes)
+	{
+		if (quick && size > 128)
+			break;
+
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		MakeGrid(size, vertices, indices);
+
+		std::string name = "grid " + std::to_string(size) + "x" + std::to_string(size);
+		Compare(name.c_str(), vertices, indices, runs);
+	}
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// --------------------------------------------------------
+// Just enough for the headless tests and benchmarks here.
+//
+// Every test is its own executable: checks print what failed
+// and keep going, and main() returns TEST_RESULT() so CTest
+// sees a non-zero exit code if anything did.
+// --------------------------------------------------------
+
+static int testFailures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) \
+		{ \
+			printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			testFailures++; \
+		} \
+	} while (0)
+
+#define CHECK_EQUAL(expected, actual) \
+	do { \
+		long long checkExpected = (long long)(expected); \
+		long long checkActual = (long long)(actual); \
+		if (checkExpected != checkActual) \
+		{ \
+			printf("%s(%d): CHECK_EQUAL(%s, %s) failed, %lld != %lld\n", __FILE__, __LINE__, #expected, #actual, checkExpected, checkActual); \
+			testFailures++; \
+		} \
+	} while (0)
+
+#define CHECK_NEAR(expected, actual, tolerance) \
+	do { \
+		double checkExpected = (double)(expected); \
+		double checkActual = (double)(actual); \
+		if (fabs(checkExpected - checkActual) > (tolerance)) \
+		{ \
+			printf("%s(%d): CHECK_NEAR(%s, %s) failed, %g != %g\n", __FILE__, __LINE__, #expected, #actual, checkExpected, checkActual); \
+			testFailures++; \
+		} \
+	} while (0)
+
+#define TEST_RESULT() (printf(testFailures ? "%d check(s) failed\n" : "All checks passed\n", testFailures), testFailures ? 1 : 0)
+
+// Benchmarks take --quick (what CTest runs) to just check they work
+inline bool IsQuickRun(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--quick") == 0)
+			return true;
+	}
+	return false;
+}
+
+// Wall time of a block, for the benchmarks
+class BenchmarkTimer
+{
+public:
+	BenchmarkTimer() : start(std::chrono::high_resolution_clock::now()) {}
+
+	double Milliseconds() const
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count();
+	}
+
+private:
+	std::chrono::high_resolution_clock::time_point start;
+};
+
+// Fastest of a few runs, so one descheduled run doesn't count
+template<typename Func>
+double BestOf(int runs, Func func)
+{
+	double best = 0.0;
+	for (int i = 0; i < runs; i++)
+	{
+		BenchmarkTimer timer;
+		func();
+		double milliseconds = timer.Milliseconds();
+		if (i == 0 || milliseconds < best)
+			best = milliseconds;
+	}
+	return best;
+}
@@ -0,0 +1,233 @@
+#include "TransformSystem.h"
+#include "JobSystem.h"
+#include "TestHelpers.h"
+#include <vector>
+
+using namespace DirectX;
+
+// Slots of a small tree, allocated fresh by each test:
+//
+//   G
+//   +- P
+//      +- A
+//      +- B
+//         +- B1
+//         +- B2
+struct Tree
+{
+	unsigned int G, P, A, B, B1, B2;
+};
+
+static Tree MakeTree()
+{
+	TransformSystem& system = TransformSystem::GetInstance();
+
+	Tree tree;
+	tree.G = system.Allocate(nullptr);
+	tree.P = system.Allocate(nullptr);
+	tree.A = system.Allocate(nullptr);
+	tree.B = system.Allocate(nullptr);
+	tree.B1 = system.Allocate(nullptr);
+	tree.B2 = system.Allocate(nullptr);
+
+	CHECK(system.SetParent(tree.P, tree.G));
+	CHECK(system.SetParent(tree.A, tree.P));
+	CHECK(system.SetParent(tree.B, tree.P));
+	CHECK(system.SetParent(tree.B1, tree.B));
+	CHECK(system.SetParent(tree.B2, tree.B));
+	return tree;
+}
+
+static void FreeTree(const Tree& tree)
+{
+	TransformSystem& system = TransformSystem::GetInstance();
+	const unsigned int slots[6] = { tree.B2, tree.B1, tree.B, tree.A, tree.P, tree.G };
+	for (unsigned int slot : slots)
+		system.Free(slot);
+}
+
+// The given slots (the ones under test, roots first) sit exactly in this
+// order, each root's range right after the previous one, with these sizes
+static void CheckOrder(const std::vector<unsigned int>& expectedOrder, const std::vector<unsigned int>& expectedSizes)
+{
+	TransformSystem& system = TransformSystem::GetInstance();
+
+	unsigned int base = system.GetOrderIndex(expectedOrder[0]);
+	bool contiguous = true;
+	for (size_t i = 0; i < expectedOrder.size(); i++)
+		contiguous = contiguous && system.GetOrderIndex(expectedOrder[i]) == base + i;
+	CHECK(contiguous);
+
+	for (size_t i = 0; i < expectedOrder.size(); i++)
+		CHECK_EQUAL(expectedSizes[i], system.GetSubtreeSize(expectedOrder[i]));
+
+	// Every slot's range holds exactly its descendants
+	for (unsigned int slot : expectedOrder)
+	{
+		unsigned int size = 1;
+		for (unsigned int child : system.GetChildren(slot))
+		{
+			CHECK_EQUAL(slot, system.GetParent(child));
+			CHECK(system.GetOrderIndex(child) > system.GetOrderIndex(slot));
+			CHECK(system.GetOrderIndex(child) + system.GetSubtreeSize(child) <= system.GetOrderIndex(slot) + system.GetSubtreeSize(slot));
+			size += system.GetSubtreeSize(child);
+		}
+		CHECK_EQUAL(size, system.GetSubtreeSize(slot));
+	}
+}
+
+static void CheckTranslation(unsigned int slot, float x, float y, float z)
+{
+	const XMFLOAT4X4& world = TransformSystem::GetInstance().GetWorldMatrix(slot);
+	CHECK_NEAR(x, world._41, 1e-5);
+	CHECK_NEAR(y, world._42, 1e-5);
+	CHECK_NEAR(z, world._43, 1e-5);
+}
+
+static void ReparentWithinTheTree()
+{
+	TransformSystem& system = TransformSystem::GetInstance();
+	Tree t = MakeTree();
+	CheckOrder({ t.G, t.P, t.A, t.B, t.B1, t.B2 }, { 6, 5, 1, 3, 1, 1 });
+
+	// To an ancestor whose range still holds the moved slot
+	CHECK(system.SetParent(t.A, t.G));
+	CHECK_EQUAL(t.G, system.GetParent(t.A));
+	CheckOrder({ t.G, t.P, t.B, t.B1, t.B2, t.A }, { 6, 4, 3, 1, 1, 1 });
+
+	// To a sibling, which comes after it
+	CHECK(system.SetParent(t.B1, t.B2));
+	CheckOrder({ t.G, t.P, t.B, t.B2, t.B1, t.A }, { 6, 4, 3, 2, 1, 1 });
+
+	// A whole subtree to the root
+	CHECK(system.SetParent(t.B, TRANSFORM_NO_PARENT));
+	CHECK_EQUAL(TRANSFORM_NO_PARENT, system.GetParent(t.B));
+	CheckOrder({ t.G, t.P, t.A, t.B, t.B2, t.B1 }, { 3, 1, 1, 3, 2, 1 });
+
+	// Back under a node that comes before it
+	CHECK(system.SetParent(t.B, t.P));
+	CheckOrder({ t.G, t.P, t.B, t.B2, t.B1, t.A }, { 6, 4, 3, 2, 1, 1 });
+
+	// To itself or a descendant: rejected, nothing moves
+	CHECK(!system.SetParent(t.B, t.B));
+	CHECK(!system.SetParent(t.B, t.B1));
+	CHECK(!system.SetParent(t.G, t.B2));
+	CHECK_EQUAL(t.P, system.GetParent(t.B));
+	CHECK_EQUAL(TRANSFORM_NO_PARENT, system.GetParent(t.G));
+	CheckOrder({ t.G, t.P, t.B, t.B2, t.B1, t.A }, { 6, 4, 3, 2, 1, 1 });
+
+	FreeTree(t);
+}
+
+// Reparenting keeps local offsets, so world positions follow the new parent
+static void WorldMatricesFollowTheParent()
+{
+	TransformSystem& system = TransformSystem::GetInstance();
+	Tree t = MakeTree();
+
+	system.SetPosition(t.G, 100.0f, 0.0f, 0.0f);
+	system.SetPosition(t.P, 0.0f, 10.0f, 0.0f);
+	system.SetPosition(t.A, 0.0f, 0.0f, 1.0f);
+	system.SetPosition(t.B, 2.0f, 0.0f, 0.0f);
+	system.SetPosition(t.B1, 0.0f, 3.0f, 0.0f);
+	system.UpdateDirtyMatrices();
+	CheckTranslation(t.A, 100.0f, 10.0f, 1.0f);
+	CheckTranslation(t.B1, 102.0f, 13.0f, 0.0f);
+
+	CHECK(system.SetParent(t.A, t.G));
+	system.UpdateDirtyMatrices();
+	CheckTranslation(t.A, 100.0f, 0.0f, 1.0f);
+
+	CHECK(system.SetParent(t.B, TRANSFORM_NO_PARENT));
+	system.UpdateDirtyMatrices();
+	CheckTranslation(t.B, 2.0f, 0.0f, 0.0f);
+	CheckTranslation(t.B1, 2.0f, 3.0f, 0.0f);
+
+	// Moving the old parent no longer touches the detached subtree
+	system.SetPosition(t.P, 0.0f, 20.0f, 0.0f);
+	system.UpdateDirtyMatrices();
+	CHECK(!system.IsDirty(t.B1));
+	CheckTranslation(t.B1, 2.0f, 3.0f, 0.0f);
+
+	// Without the batched update, a read still rebuilds what it needs
+	system.SetPosition(t.G, 0.0f, 0.0f, 0.0f);
+	CHECK(system.IsDirty(t.A));
+	CheckTranslation(t.A, 0.0f, 0.0f, 1.0f);
+
+	FreeTree(t);
+}
+
+// Freeing a slot makes its children roots, and the slot gets reused
+static void FreeDetachesChildren()
+{
+	TransformSystem& system = TransformSystem::GetInstance();
+	Tree t = MakeTree();
+
+	system.Free(t.B);
+	CHECK_EQUAL(TRANSFORM_NO_PARENT, system.GetParent(t.B1));
+	CHECK_EQUAL(TRANSFORM_NO_PARENT, system.GetParent(t.B2));
+	CHECK_EQUAL(3, system.GetSubtreeSize(t.G));
+	CHECK_EQUAL(t.B, system.Allocate(nullptr));
+
+	system.Free(t.B);
+	system.Free(t.B1);
+	system.Free(t.B2);
+	system.Free(t.A);
+	system.Free(t.P);
+	system.Free(t.G);
+}
+
+// Jobs setting neighbouring slots share dirty-bit words, none of their bits may get lost
+static void SettersFromJobs()
+{
+	TransformSystem& system = TransformSystem::GetInstance();
+	JobSystem& jobs = JobSystem::GetInstance();
+
+	// Every eighth slot a root, with the next seven as its children
+	std::vector<unsigned int> slots(1000);
+	for (unsigned int i = 0; i < slots.size(); i++)
+	{
+		slots[i] = system.Allocate(nullptr);
+		if (i % 8 != 0)
+			CHECK(system.SetParent(slots[i], slots[i - i % 8]));
+	}
+
+	for (int repeat = 0; repeat < 20; repeat++)
+	{
+		system.UpdateDirtyMatrices();
+
+		float offset = (float)repeat;
+		jobs.ParallelFor((unsigned int)slots.size(), 1, [&](unsigned int first, unsigned int end)
+		{
+			for (unsigned int i = first; i < end; i++)
+				system.SetPosition(slots[i], offset, (float)i, 0.0f);
+		});
+
+		bool allDirty = true;
+		for (unsigned int slot : slots)
+			allDirty = allDirty && system.IsDirty(slot);
+		CHECK(allDirty);
+
+		system.UpdateDirtyMatrices();
+		CHECK_EQUAL(slots.size(), system.GetLastUpdateCount());
+	}
+
+	// Children add their root's offset
+	CheckTranslation(slots[0], 19.0f, 0.0f, 0.0f);
+	CheckTranslation(slots[13], 38.0f, 21.0f, 0.0f);
+
+	for (size_t i = slots.size(); i > 0; i--)
+		system.Free(slots[i - 1]);
+}
+
+int main()
+{
+	// A few workers even on one core, so the setters really do race
+	JobSystem::RequestedThreadCount = 4;
+
+	ReparentWithinTheTree();
+	WorldMatricesFollowTheParent();
+	FreeDetachesChildren();
+	SettersFromJobs();
+	return TEST_RESULT();
+}
@@ -1,39 +1,49 @@
 #include "Transform.h"
 Transform::Transform()
 {
+	slot = TransformSystem::GetInstance().Allocate(this);
+
 	right = DirectX::XMFLOAT3(1.0f, 0.0f, 0.0f);
 	up = DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
 	forward = DirectX::XMFLOAT3(0.0f, 0.0f, 1.0f);
 
-	position = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
-	rotation = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
-	scale = DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f);
-
 	dirtyDirections = false;
-	dirtyMatrix = false;
+}
 
-	XMStoreFloat4x4(&worldMatrix, DirectX::XMMatrixIdentity());
-	XMStoreFloat4x4(&worldInverseTransposeMatrix, DirectX::XMMatrixIdentity());
+Transform::~Transform()
+{
+	TransformSystem::GetInstance().Free(slot);
 }
 
-void Transform::UpdateMatrices()
+unsigned int Transform::GetSlot()
 {
-	//To actually create a world matrix, create separate translation, rotation and scale matrices, multiply them together and store the result
-	// track whether or not any of the 3 major transformations have changed, meaning the matrix is dirty and needs an update.You would 
-	//then update the matrix right before it's actually returned by a GetWorldMatrix() method, and only if it's dirty.
+	return slot;
+}
 
-	DirectX::XMMATRIX translation = DirectX::XMMatrixTranslation(position.x, position.y, position.z);
-	DirectX::XMMATRIX sc = DirectX::XMMatrixScaling(scale.x, scale.y, scale.z);
-	DirectX::XMMATRIX rot = DirectX::XMMatrixRotationRollPitchYaw(rotation.x, rotation.y, rotation.z);
-	DirectX::XMMATRIX world = XMMatrixMultiply(XMMatrixMultiply(sc, rot), translation);
+bool Transform::SetParent(Transform* parent)
+{
+	return TransformSystem::GetInstance().SetParent(slot, parent ? parent->slot : TRANSFORM_NO_PARENT);
+}
 
-	XMStoreFloat4x4(&worldMatrix, world);
-	XMStoreFloat4x4(&worldInverseTransposeMatrix, XMMatrixInverse(0, XMMatrixTranspose(world)));
-	dirtyMatrix = false;
+Transform* Transform::GetParent()
+{
+	TransformSystem& system = TransformSystem::GetInstance();
+	unsigned int parentSlot = system.GetParent(slot);
+	return parentSlot == TRANSFORM_NO_PARENT ? nullptr : system.GetOwner(parentSlot);
+}
+
+std::vector<Transform*> Transform::GetChildren()
+{
+	TransformSystem& system = TransformSystem::GetInstance();
+	std::vector<Transform*> children;
+	for (unsigned int child : system.GetChildren(slot))
+		children.push_back(system.GetOwner(child));
+	return children;
 }
 
 void Transform::UpateDirections()
 {
+	DirectX::XMFLOAT3 rotation = GetPitchYawRoll();
 	DirectX::XMVECTOR quternionRotation = DirectX::XMQuaternionRotationRollPitchYaw(rotation.x, rotation.y, rotation.z);
 	XMStoreFloat3(&right, DirectX::XMVector3Rotate(DirectX::XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), quternionRotation));
 	XMStoreFloat3(&up, DirectX::XMVector3Rotate(DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), quternionRotation));
@@ -44,10 +54,10 @@ void Transform::UpateDirections()
 
 void Transform::SetPosition(float x, float y, float z)
 {
+	DirectX::XMFLOAT3 position = GetPosition();
 	if (position.x == x && position.y == y && position.z == z)
 		return;
-	position = DirectX::XMFLOAT3(x, y, z);
-	dirtyMatrix = true;
+	TransformSystem::GetInstance().SetPosition(slot, x, y, z);
 }
 
 void Transform::SetPosition(DirectX::XMFLOAT3 position)
@@ -57,10 +67,10 @@ void Transform::SetPosition(DirectX::XMFLOAT3 position)
 
 void Transform::SetRotation(float pitch, float yaw, float roll)
 {
+	DirectX::XMFLOAT3 rotation = GetPitchYawRoll();
 	if (rotation.x == pitch && rotation.y == yaw && rotation.z == roll)
 		return;
-	rotation = DirectX::XMFLOAT3(pitch, yaw, roll);
-	dirtyMatrix = true;
+	TransformSystem::GetInstance().SetPitchYawRoll(slot, pitch, yaw, roll);
 	dirtyDirections = true;
 
 }
@@ -72,10 +82,10 @@ void Transform::SetRotation(DirectX::XMFLOAT3 rotation)
 
 void Transform::SetScale(float x, float y, float z)
 {
+	DirectX::XMFLOAT3 scale = GetScale();
 	if (scale.x == x && scale.y == y && scale.z == z)
 		return;
-	scale = DirectX::XMFLOAT3(x, y, z);
-	dirtyMatrix = true;
+	TransformSystem::GetInstance().SetScale(slot, x, y, z);
 }
 
 void Transform::SetScale(DirectX::XMFLOAT3 scale)
@@ -106,31 +116,29 @@ DirectX::XMFLOAT3 Transform::GetForward()
 
 DirectX::XMFLOAT3 Transform::GetPosition()
 {
-	return position;
+	return TransformSystem::GetInstance().GetPosition(slot);
 }
 
 DirectX::XMFLOAT3 Transform::GetPitchYawRoll()
 {
-	return rotation;
+	return TransformSystem::GetInstance().GetPitchYawRoll(slot);
 }
 
 DirectX::XMFLOAT3 Transform::GetScale()
 {
-	return scale;
+	return TransformSystem::GetInstance().GetScale(slot);
 }
 
+// Normally already up to date, since Game::Update() rebuilds every
+// dirty matrix in one batch before anything is drawn
 DirectX::XMFLOAT4X4 Transform::GetWorldMatrix()
 {
-	if(dirtyMatrix)
-		UpdateMatrices();
-	return worldMatrix;
+	return TransformSystem::GetInstance().GetWorldMatrix(slot);
 }
 
 DirectX::XMFLOAT4X4 Transform::GetWorldInverseTransposeMatrix()
 {
-	if(dirtyMatrix)
-		UpdateMatrices();
-	return worldInverseTransposeMatrix;
+	return TransformSystem::GetInstance().GetWorldInverseTransposeMatrix(slot);
 }
 
 void Transform::MoveRelative(float x, float y, float z)
@@ -139,12 +147,14 @@ void Transform::MoveRelative(float x, float y, float z)
 		return;
 
 	//this code is very similar to the demo because I was reffering to it while trying to fix a bug
+	DirectX::XMFLOAT3 position = GetPosition();
+	DirectX::XMFLOAT3 rotation = GetPitchYawRoll();
 	DirectX::XMVECTOR relativeMovement = DirectX::XMVectorSet(x,y,z,0);
 	DirectX::XMVECTOR rot = DirectX::XMQuaternionRotationRollPitchYawFromVector(DirectX::XMLoadFloat3(&rotation));
 	DirectX::XMVECTOR direction = DirectX::XMVector3Rotate(relativeMovement, rot);
 	DirectX::XMVECTOR newPosition = DirectX::XMVectorAdd(XMLoadFloat3(&position), direction);
 	XMStoreFloat3(&position, newPosition);
-	dirtyMatrix = true;
+	TransformSystem::GetInstance().SetPosition(slot, position.x, position.y, position.z);
 }
 
 void Transform::MoveRelative(DirectX::XMFLOAT3 offset)
@@ -156,8 +166,8 @@ void Transform::MoveAbsolute(float x, float y, float z)
 {
 	if (x == 0.0f && y == 0.0f && z == 0.0f)
 		return;
-	position = DirectX::XMFLOAT3(position.x + x, position.y + y, position.z + z);
-	dirtyMatrix = true;
+	DirectX::XMFLOAT3 position = GetPosition();
+	TransformSystem::GetInstance().SetPosition(slot, position.x + x, position.y + y, position.z + z);
 }
 
 void Transform::MoveAbsolute(DirectX::XMFLOAT3 offset)
@@ -169,9 +179,9 @@ void Transform::Rotate(float pitch, float yaw, float roll)
 {
 	if (pitch == 0.0f && yaw == 0.0f && roll == 0.0f)
 		return;
-	rotation = DirectX::XMFLOAT3(rotation.x + pitch, rotation.y + yaw, rotation.z + roll);
+	DirectX::XMFLOAT3 rotation = GetPitchYawRoll();
+	TransformSystem::GetInstance().SetPitchYawRoll(slot, rotation.x + pitch, rotation.y + yaw, rotation.z + roll);
 	dirtyDirections = true;
-	dirtyMatrix = true;
 }
 
 void Transform::Rotate(DirectX::XMFLOAT3 rotation)
@@ -184,8 +194,8 @@ void Transform::Scale(float x, float y, float z)
 	if (x == 1.0f && y == 1.0f && z == 1.0f)
 		return;
 
-	scale = DirectX::XMFLOAT3(scale.x * x, scale.y * y, scale.z * z);
-	dirtyMatrix = true;
+	DirectX::XMFLOAT3 scale = GetScale();
+	TransformSystem::GetInstance().SetScale(slot, scale.x * x, scale.y * y, scale.z * z);
 }
 
 void Transform::Scale(DirectX::XMFLOAT3 scale)
@@ -1,20 +1,35 @@
 #pragma once
 #include <DirectXMath.h>
+#include "TransformSystem.h"
+#include <vector>
+
+// Position, rotation, scale and the matrices live in the TransformSystem,
+// this is just a handle to one of its slots
 class Transform
 {
 private:
-	DirectX::XMFLOAT3 position, scale, rotation;
+	unsigned int slot;
 	DirectX::XMFLOAT3 up, right, forward;
 
-	DirectX::XMFLOAT4X4 worldMatrix, worldInverseTransposeMatrix;
-
-	bool dirtyMatrix;
 	bool dirtyDirections;
-	void UpdateMatrices();
 	void UpateDirections(); //helper method to get the transform's realtive up, right, and forward
 
 public:
 	Transform();
+	~Transform();
+
+	// Each transform owns its slot, so copying would free it twice
+	Transform(const Transform&) = delete;
+	Transform& operator=(const Transform&) = delete;
+
+	unsigned int GetSlot();
+
+	// Position, rotation and scale become relative to the parent
+	// - Pass nullptr to detach
+	// - Returns false if that would create a loop
+	bool SetParent(Transform* parent);
+	Transform* GetParent();
+	std::vector<Transform*> GetChildren();
 	void SetPosition(float x, float y, float z);
 	void SetPosition(DirectX::XMFLOAT3 position);
 	void SetRotation(float pitch, float yaw, float roll);
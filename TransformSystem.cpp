@@ -0,0 +1,509 @@
+#include "TransformSystem.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <atomic>
+
+using namespace DirectX;
+
+// Singleton requirement
+TransformSystem* TransformSystem::instance;
+
+// Setters for different slots can run on different threads, and
+// neighbouring slots share a word, so bits are set and cleared atomically.
+// Relaxed is enough: whoever reads them next has waited on those jobs.
+static inline bool TestBit(const std::vector<std::atomic<unsigned long long>>& bits, unsigned int index)
+{
+	return (bits[index / 64].load(std::memory_order_relaxed) >> (index % 64)) & 1ull;
+}
+
+static inline void SetBit(std::vector<std::atomic<unsigned long long>>& bits, unsigned int index)
+{
+	bits[index / 64].fetch_or(1ull << (index % 64), std::memory_order_relaxed);
+}
+
+static inline void ClearBit(std::vector<std::atomic<unsigned long long>>& bits, unsigned int index)
+{
+	bits[index / 64].fetch_and(~(1ull << (index % 64)), std::memory_order_relaxed);
+}
+
+// Atomics can't be moved, so vector::resize() won't take them
+static void GrowBits(std::vector<std::atomic<unsigned long long>>& bits, size_t wordCount)
+{
+	if (wordCount <= bits.size())
+		return;
+
+	std::vector<std::atomic<unsigned long long>> grown(wordCount);
+	for (size_t i = 0; i < wordCount; i++)
+		grown[i].store(i < bits.size() ? bits[i].load() : 0);
+	bits.swap(grown);
+}
+
+TransformSystem::TransformSystem() :
+	slotCount(0),
+	lastUpdateCount(0),
+	lastHierarchyCount(0)
+{
+}
+
+TransformSystem::~TransformSystem()
+{
+}
+
+unsigned int TransformSystem::Allocate(Transform* owner)
+{
+	unsigned int slot;
+	if (!freeSlots.empty())
+	{
+		// Freed slots were already detached, so they're
+		// still sitting in the depth first order as roots
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		slot = slotCount++;
+
+		// Arrays always grow by four so a batch can load any
+		// aligned group of four floats without reading past the end
+		if (slot >= positionX.size())
+		{
+			size_t size = positionX.size() + 4;
+			positionX.resize(size); positionY.resize(size); positionZ.resize(size);
+			pitch.resize(size); yaw.resize(size); roll.resize(size);
+			scaleX.resize(size); scaleY.resize(size); scaleZ.resize(size);
+			worldMatrices.resize(size);
+			worldInverseTransposeMatrices.resize(size);
+			localMatrices.resize(size);
+			localInverseTransposeMatrices.resize(size);
+			parents.resize(size);
+			owners.resize(size);
+			orderIndex.resize(size);
+			subtreeSize.resize(size);
+			GrowBits(localDirtyBits, (size + 63) / 64);
+			GrowBits(worldDirtyBits, (size + 63) / 64);
+		}
+
+		// New slots start as roots at the end of the order
+		orderIndex[slot] = (unsigned int)depthFirstOrder.size();
+		depthFirstOrder.push_back(slot);
+	}
+
+	positionX[slot] = 0.0f; positionY[slot] = 0.0f; positionZ[slot] = 0.0f;
+	pitch[slot] = 0.0f; yaw[slot] = 0.0f; roll[slot] = 0.0f;
+	scaleX[slot] = 1.0f; scaleY[slot] = 1.0f; scaleZ[slot] = 1.0f;
+
+	XMStoreFloat4x4(&worldMatrices[slot], XMMatrixIdentity());
+	XMStoreFloat4x4(&worldInverseTransposeMatrices[slot], XMMatrixIdentity());
+	XMStoreFloat4x4(&localMatrices[slot], XMMatrixIdentity());
+	XMStoreFloat4x4(&localInverseTransposeMatrices[slot], XMMatrixIdentity());
+
+	parents[slot] = TRANSFORM_NO_PARENT;
+	owners[slot] = owner;
+	subtreeSize[slot] = 1;
+	ClearBit(localDirtyBits, slot);
+	ClearBit(worldDirtyBits, slot);
+
+	return slot;
+}
+
+void TransformSystem::Free(unsigned int slot)
+{
+	// Children become roots, and the slot itself leaves its parent
+	std::vector<unsigned int> children = GetChildren(slot);
+	for (unsigned int child : children)
+		SetParent(child, TRANSFORM_NO_PARENT);
+	SetParent(slot, TRANSFORM_NO_PARENT);
+
+	ClearBit(localDirtyBits, slot);
+	ClearBit(worldDirtyBits, slot);
+	owners[slot] = nullptr;
+	freeSlots.push_back(slot);
+}
+
+XMFLOAT3 TransformSystem::GetPosition(unsigned int slot)
+{
+	return XMFLOAT3(positionX[slot], positionY[slot], positionZ[slot]);
+}
+
+XMFLOAT3 TransformSystem::GetPitchYawRoll(unsigned int slot)
+{
+	return XMFLOAT3(pitch[slot], yaw[slot], roll[slot]);
+}
+
+XMFLOAT3 TransformSystem::GetScale(unsigned int slot)
+{
+	return XMFLOAT3(scaleX[slot], scaleY[slot], scaleZ[slot]);
+}
+
+void TransformSystem::SetPosition(unsigned int slot, float x, float y, float z)
+{
+	positionX[slot] = x;
+	positionY[slot] = y;
+	positionZ[slot] = z;
+	MarkDirty(slot);
+}
+
+void TransformSystem::SetPitchYawRoll(unsigned int slot, float pitch, float yaw, float roll)
+{
+	this->pitch[slot] = pitch;
+	this->yaw[slot] = yaw;
+	this->roll[slot] = roll;
+	MarkDirty(slot);
+}
+
+void TransformSystem::SetScale(unsigned int slot, float x, float y, float z)
+{
+	scaleX[slot] = x;
+	scaleY[slot] = y;
+	scaleZ[slot] = z;
+	MarkDirty(slot);
+}
+
+bool TransformSystem::SetParent(unsigned int slot, unsigned int parentSlot)
+{
+	if (parents[slot] == parentSlot)
+		return true;
+
+	unsigned int begin = orderIndex[slot];
+	unsigned int count = subtreeSize[slot];
+
+	// Can't parent something to itself or anything below it
+	if (parentSlot != TRANSFORM_NO_PARENT &&
+		orderIndex[parentSlot] >= begin && orderIndex[parentSlot] < begin + count)
+		return false;
+
+	// The subtree goes right after the new parent's last descendant,
+	// or to the very end when it becomes a root.  Found before the
+	// old ancestors shrink, as the new parent may be one of them.
+	unsigned int target = parentSlot == TRANSFORM_NO_PARENT ?
+		(unsigned int)depthFirstOrder.size() :
+		orderIndex[parentSlot] + subtreeSize[parentSlot];
+
+	for (unsigned int p = parents[slot]; p != TRANSFORM_NO_PARENT; p = parents[p])
+		subtreeSize[p] -= count;
+
+	std::vector<unsigned int>::iterator order = depthFirstOrder.begin();
+	unsigned int first, last;
+	if (target > begin)
+	{
+		std::rotate(order + begin, order + begin + count, order + target);
+		first = begin;
+		last = target;
+	}
+	else
+	{
+		std::rotate(order + target, order + begin, order + begin + count);
+		first = target;
+		last = begin + count;
+	}
+
+	for (unsigned int i = first; i < last; i++)
+		orderIndex[depthFirstOrder[i]] = i;
+
+	parents[slot] = parentSlot;
+	for (unsigned int p = parentSlot; p != TRANSFORM_NO_PARENT; p = parents[p])
+		subtreeSize[p] += count;
+
+	// Local matrices of parented transforms are kept separately
+	// from world matrices, so this one has to be rebuilt either way
+	MarkDirty(slot);
+	return true;
+}
+
+unsigned int TransformSystem::GetParent(unsigned int slot)
+{
+	return parents[slot];
+}
+
+Transform* TransformSystem::GetOwner(unsigned int slot)
+{
+	return owners[slot];
+}
+
+std::vector<unsigned int> TransformSystem::GetChildren(unsigned int slot)
+{
+	// Direct children sit inside the subtree range, each one
+	// followed by its own descendants which get skipped
+	std::vector<unsigned int> children;
+	unsigned int end = orderIndex[slot] + subtreeSize[slot];
+	for (unsigned int i = orderIndex[slot] + 1; i < end; i += subtreeSize[depthFirstOrder[i]])
+		children.push_back(depthFirstOrder[i]);
+	return children;
+}
+
+unsigned int TransformSystem::GetOrderIndex(unsigned int slot)
+{
+	return orderIndex[slot];
+}
+
+unsigned int TransformSystem::GetSubtreeSize(unsigned int slot)
+{
+	return subtreeSize[slot];
+}
+
+const XMFLOAT4X4& TransformSystem::GetWorldMatrix(unsigned int slot)
+{
+	UpdateWorldMatrix(slot);
+	return worldMatrices[slot];
+}
+
+const XMFLOAT4X4& TransformSystem::GetWorldInverseTransposeMatrix(unsigned int slot)
+{
+	UpdateWorldMatrix(slot);
+	return worldInverseTransposeMatrices[slot];
+}
+
+bool TransformSystem::IsDirty(unsigned int slot)
+{
+	return TestBit(worldDirtyBits, slot);
+}
+
+void TransformSystem::MarkDirty(unsigned int slot)
+{
+	SetBit(localDirtyBits, slot);
+
+	// Only this transform's own subtree needs new world matrices
+	unsigned int begin = orderIndex[slot];
+	unsigned int end = begin + subtreeSize[slot];
+	for (unsigned int i = begin; i < end; i++)
+		SetBit(worldDirtyBits, depthFirstOrder[i]);
+}
+
+void TransformSystem::UpdateWorldMatrix(unsigned int slot)
+{
+	if (!TestBit(worldDirtyBits, slot))
+		return;
+
+	if (TestBit(localDirtyBits, slot) || parents[slot] == TRANSFORM_NO_PARENT)
+	{
+		unsigned int slots[4] = { slot, slot, slot, slot };
+		CalculateMatrices(slots);
+		ClearBit(localDirtyBits, slot);
+	}
+
+	if (parents[slot] != TRANSFORM_NO_PARENT)
+	{
+		UpdateWorldMatrix(parents[slot]);
+		ComposeWithParent(slot);
+	}
+
+	ClearBit(worldDirtyBits, slot);
+}
+
+// world = local * parentWorld, and since (AB)^-T = A^-T B^-T
+// the inverse transposes compose the same way
+void TransformSystem::ComposeWithParent(unsigned int slot)
+{
+	unsigned int parent = parents[slot];
+
+	XMMATRIX world = XMMatrixMultiply(
+		XMLoadFloat4x4(&localMatrices[slot]),
+		XMLoadFloat4x4(&worldMatrices[parent]));
+	XMMATRIX inverseTranspose = XMMatrixMultiply(
+		XMLoadFloat4x4(&localInverseTransposeMatrices[slot]),
+		XMLoadFloat4x4(&worldInverseTransposeMatrices[parent]));
+
+	XMStoreFloat4x4(&worldMatrices[slot], world);
+	XMStoreFloat4x4(&worldInverseTransposeMatrices[slot], inverseTranspose);
+}
+
+void TransformSystem::UpdateDirtyMatrices()
+{
+	PROFILE_SCOPE("Update Transforms");
+
+	// 1) Local matrices, four at a time, spread over the JobSystem in runs
+	//    of whole dirty-bit words (a slot only touches its own word's bits)
+	std::atomic<unsigned int> updateCount(0);
+	JobSystem::GetInstance().ParallelFor((unsigned int)localDirtyBits.size(), TRANSFORM_WORDS_PER_JOB,
+		[this, &updateCount](unsigned int firstWord, unsigned int endWord)
+	{
+		PROFILE_SCOPE("Local Matrices");
+		updateCount += UpdateLocalMatrices(firstWord, endWord);
+	});
+	lastUpdateCount = updateCount.load();
+
+	// 2) Whatever is still world-dirty has a parent.  Sorting those by
+	//    depth first position guarantees parents are composed first.
+	hierarchyScratch.clear();
+	for (size_t word = 0; word < worldDirtyBits.size(); word++)
+	{
+		unsigned long long bits = worldDirtyBits[word].exchange(0);
+		for (unsigned int bit = 0; bits; bit++, bits >>= 1)
+		{
+			if (bits & 1ull)
+				hierarchyScratch.push_back(orderIndex[word * 64 + bit]);
+		}
+	}
+
+	std::sort(hierarchyScratch.begin(), hierarchyScratch.end());
+	for (unsigned int index : hierarchyScratch)
+		ComposeWithParent(depthFirstOrder[index]);
+
+	lastHierarchyCount = (unsigned int)hierarchyScratch.size();
+}
+
+unsigned int TransformSystem::UpdateLocalMatrices(unsigned int firstWord, unsigned int endWord)
+{
+	unsigned int batch[4];
+	int batchCount = 0;
+	unsigned int count = 0;
+
+	for (unsigned int word = firstWord; word < endWord; word++)
+	{
+		unsigned long long bits = localDirtyBits[word].exchange(0);
+		for (unsigned int bit = 0; bits; bit++, bits >>= 1)
+		{
+			if (!(bits & 1ull))
+				continue;
+
+			batch[batchCount++] = word * 64 + bit;
+			if (batchCount == 4)
+			{
+				CalculateMatrices(batch);
+				batchCount = 0;
+			}
+			count++;
+		}
+	}
+
+	// Pad the last partial batch by repeating its first slot
+	if (batchCount > 0)
+	{
+		for (int i = batchCount; i < 4; i++)
+			batch[i] = batch[0];
+		CalculateMatrices(batch);
+	}
+
+	return count;
+}
+
+unsigned int TransformSystem::GetTransformCount()
+{
+	return slotCount - (unsigned int)freeSlots.size();
+}
+
+unsigned int TransformSystem::GetLastUpdateCount()
+{
+	return lastUpdateCount;
+}
+
+unsigned int TransformSystem::GetLastHierarchyCount()
+{
+	return lastHierarchyCount;
+}
+
+// --------------------------------------------------------
+// Each XMVECTOR lane holds a different transform.
+//
+// The rotation is the same one XMMatrixRotationRollPitchYaw
+// builds (roll, then pitch, then yaw), written out per element
+// so one XMVectorSinCos call covers four transforms.
+//
+// Local = Scale * Rotation * Translation, so
+//   row i = scale_i * R_i, row 3 = (position, 1)
+// and since R is orthonormal its inverse transpose is just
+//   row i = (R_i / scale_i, -dot(position, R_i) / scale_i)
+//   row 3 = (0, 0, 0, 1)
+// which avoids a general 4x4 inverse per transform.
+// --------------------------------------------------------
+void TransformSystem::CalculateMatrices(const unsigned int slots[4])
+{
+	XMVECTOR px, py, pz, rp, ry, rr, sx, sy, sz;
+
+	if (slots[0] % 4 == 0 && slots[1] == slots[0] + 1 && slots[2] == slots[0] + 2 && slots[3] == slots[0] + 3)
+	{
+		// Four neighbouring slots can be loaded straight from the arrays
+		unsigned int s = slots[0];
+		px = XMLoadFloat4((const XMFLOAT4*)&positionX[s]);
+		py = XMLoadFloat4((const XMFLOAT4*)&positionY[s]);
+		pz = XMLoadFloat4((const XMFLOAT4*)&positionZ[s]);
+		rp = XMLoadFloat4((const XMFLOAT4*)&pitch[s]);
+		ry = XMLoadFloat4((const XMFLOAT4*)&yaw[s]);
+		rr = XMLoadFloat4((const XMFLOAT4*)&roll[s]);
+		sx = XMLoadFloat4((const XMFLOAT4*)&scaleX[s]);
+		sy = XMLoadFloat4((const XMFLOAT4*)&scaleY[s]);
+		sz = XMLoadFloat4((const XMFLOAT4*)&scaleZ[s]);
+	}
+	else
+	{
+		const unsigned int a = slots[0], b = slots[1], c = slots[2], d = slots[3];
+		px = XMVectorSet(positionX[a], positionX[b], positionX[c], positionX[d]);
+		py = XMVectorSet(positionY[a], positionY[b], positionY[c], positionY[d]);
+		pz = XMVectorSet(positionZ[a], positionZ[b], positionZ[c], positionZ[d]);
+		rp = XMVectorSet(pitch[a], pitch[b], pitch[c], pitch[d]);
+		ry = XMVectorSet(yaw[a], yaw[b], yaw[c], yaw[d]);
+		rr = XMVectorSet(roll[a], roll[b], roll[c], roll[d]);
+		sx = XMVectorSet(scaleX[a], scaleX[b], scaleX[c], scaleX[d]);
+		sy = XMVectorSet(scaleY[a], scaleY[b], scaleY[c], scaleY[d]);
+		sz = XMVectorSet(scaleZ[a], scaleZ[b], scaleZ[c], scaleZ[d]);
+	}
+
+	XMVECTOR sp, cp, sya, cya, sr, cr;
+	XMVectorSinCos(&sp, &cp, rp);
+	XMVectorSinCos(&sya, &cya, ry);
+	XMVectorSinCos(&sr, &cr, rr);
+
+	XMVECTOR spsy = XMVectorMultiply(sp, sya);
+	XMVECTOR spcy = XMVectorMultiply(sp, cya);
+
+	// Rotation rows
+	XMVECTOR r00 = XMVectorMultiplyAdd(sr, spsy, XMVectorMultiply(cr, cya));
+	XMVECTOR r01 = XMVectorMultiply(sr, cp);
+	XMVECTOR r02 = XMVectorSubtract(XMVectorMultiply(sr, spcy), XMVectorMultiply(cr, sya));
+
+	XMVECTOR r10 = XMVectorSubtract(XMVectorMultiply(cr, spsy), XMVectorMultiply(sr, cya));
+	XMVECTOR r11 = XMVectorMultiply(cr, cp);
+	XMVECTOR r12 = XMVectorMultiplyAdd(cr, spcy, XMVectorMultiply(sr, sya));
+
+	XMVECTOR r20 = XMVectorMultiply(cp, sya);
+	XMVECTOR r21 = XMVectorNegate(sp);
+	XMVECTOR r22 = XMVectorMultiply(cp, cya);
+
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR one = XMVectorSplatOne();
+
+	// World matrix rows, transposed so each row vector belongs to one transform
+	XMMATRIX world0 = XMMatrixTranspose(XMMATRIX(XMVectorMultiply(r00, sx), XMVectorMultiply(r01, sx), XMVectorMultiply(r02, sx), zero));
+	XMMATRIX world1 = XMMatrixTranspose(XMMATRIX(XMVectorMultiply(r10, sy), XMVectorMultiply(r11, sy), XMVectorMultiply(r12, sy), zero));
+	XMMATRIX world2 = XMMatrixTranspose(XMMATRIX(XMVectorMultiply(r20, sz), XMVectorMultiply(r21, sz), XMVectorMultiply(r22, sz), zero));
+	XMMATRIX world3 = XMMatrixTranspose(XMMATRIX(px, py, pz, one));
+
+	// Inverse transpose rows
+	XMVECTOR isx = XMVectorReciprocal(sx);
+	XMVECTOR isy = XMVectorReciprocal(sy);
+	XMVECTOR isz = XMVectorReciprocal(sz);
+
+	XMVECTOR q00 = XMVectorMultiply(r00, isx), q01 = XMVectorMultiply(r01, isx), q02 = XMVectorMultiply(r02, isx);
+	XMVECTOR q10 = XMVectorMultiply(r10, isy), q11 = XMVectorMultiply(r11, isy), q12 = XMVectorMultiply(r12, isy);
+	XMVECTOR q20 = XMVectorMultiply(r20, isz), q21 = XMVectorMultiply(r21, isz), q22 = XMVectorMultiply(r22, isz);
+
+	XMVECTOR d0 = XMVectorNegate(XMVectorMultiplyAdd(pz, q02, XMVectorMultiplyAdd(py, q01, XMVectorMultiply(px, q00))));
+	XMVECTOR d1 = XMVectorNegate(XMVectorMultiplyAdd(pz, q12, XMVectorMultiplyAdd(py, q11, XMVectorMultiply(px, q10))));
+	XMVECTOR d2 = XMVectorNegate(XMVectorMultiplyAdd(pz, q22, XMVectorMultiplyAdd(py, q21, XMVectorMultiply(px, q20))));
+
+	XMMATRIX inverse0 = XMMatrixTranspose(XMMATRIX(q00, q01, q02, d0));
+	XMMATRIX inverse1 = XMMatrixTranspose(XMMATRIX(q10, q11, q12, d1));
+	XMMATRIX inverse2 = XMMatrixTranspose(XMMATRIX(q20, q21, q22, d2));
+	XMVECTOR inverse3 = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+
+	for (int i = 0; i < 4; i++)
+	{
+		unsigned int slot = slots[i];
+		XMMATRIX world = XMMATRIX(world0.r[i], world1.r[i], world2.r[i], world3.r[i]);
+		XMMATRIX inverseTranspose = XMMATRIX(inverse0.r[i], inverse1.r[i], inverse2.r[i], inverse3);
+
+		// Without a parent the local matrix already is the world matrix
+		if (parents[slot] == TRANSFORM_NO_PARENT)
+		{
+			XMStoreFloat4x4(&worldMatrices[slot], world);
+			XMStoreFloat4x4(&worldInverseTransposeMatrices[slot], inverseTranspose);
+			ClearBit(worldDirtyBits, slot);
+		}
+		else
+		{
+			XMStoreFloat4x4(&localMatrices[slot], world);
+			XMStoreFloat4x4(&localInverseTransposeMatrices[slot], inverseTranspose);
+		}
+	}
+}
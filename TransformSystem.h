@@ -0,0 +1,136 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <atomic>
+#include <vector>
+
+class Transform;
+
+// Slot value meaning "no parent"
+#define TRANSFORM_NO_PARENT 0xFFFFFFFF
+
+// Dirty-bit words (64 slots each) per job when rebuilding local matrices
+#define TRANSFORM_WORDS_PER_JOB 16
+
+// --------------------------------------------------------
+// Owns the data for every Transform in structure-of-arrays
+// form.  A Transform is just a slot index into these arrays.
+//
+// Changing a transform only sets its bit in the dirty bitset.
+// UpdateDirtyMatrices() then rebuilds all dirty local matrices
+// four at a time with SIMD, split across the JobSystem.
+//
+// Transforms can have a parent.  Every slot also lives in a
+// depth-first order array, so a transform's whole subtree is
+// one contiguous range right after it.  Changing a transform
+// marks only that range as needing a new world matrix, and
+// since parents always come before their children in that
+// order, the world matrices can be composed in one pass.
+// --------------------------------------------------------
+class TransformSystem
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static TransformSystem& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new TransformSystem();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	TransformSystem(TransformSystem const&) = delete;
+	void operator=(TransformSystem const&) = delete;
+
+private:
+	static TransformSystem* instance;
+	TransformSystem();
+#pragma endregion
+
+public:
+	~TransformSystem();
+
+	// Slots are reused after being freed
+	unsigned int Allocate(Transform* owner);
+	void Free(unsigned int slot);
+
+	DirectX::XMFLOAT3 GetPosition(unsigned int slot);
+	DirectX::XMFLOAT3 GetPitchYawRoll(unsigned int slot);
+	DirectX::XMFLOAT3 GetScale(unsigned int slot);
+
+	// Setters only mark the slot (and its children) dirty, nothing is recalculated here.
+	// Jobs can call them at the same time, as long as each job sticks to its own slots.
+	void SetPosition(unsigned int slot, float x, float y, float z);
+	void SetPitchYawRoll(unsigned int slot, float pitch, float yaw, float roll);
+	void SetScale(unsigned int slot, float x, float y, float z);
+
+	// Position/rotation/scale stay relative to the parent, so a child
+	// jumps to the same offset from its new parent.  Returns false if
+	// the new parent is the slot itself or one of its descendants.
+	bool SetParent(unsigned int slot, unsigned int parentSlot);
+	unsigned int GetParent(unsigned int slot);
+	Transform* GetOwner(unsigned int slot);
+	std::vector<unsigned int> GetChildren(unsigned int slot);
+
+	// Where the slot sits in the depth first order, and how many
+	// slots from there its subtree covers (itself included)
+	unsigned int GetOrderIndex(unsigned int slot);
+	unsigned int GetSubtreeSize(unsigned int slot);
+
+	// Rebuilds just this slot (and any dirty parents) if needed, for
+	// when a matrix is requested before the batched update has run
+	const DirectX::XMFLOAT4X4& GetWorldMatrix(unsigned int slot);
+	const DirectX::XMFLOAT4X4& GetWorldInverseTransposeMatrix(unsigned int slot);
+
+	bool IsDirty(unsigned int slot);
+
+	// Recalculates every dirty local matrix in SIMD batches of four,
+	// then composes world matrices for dirty transforms with parents
+	void UpdateDirtyMatrices();
+
+	unsigned int GetTransformCount();		// Slots currently in use
+	unsigned int GetLastUpdateCount();		// Local matrices rebuilt by the last UpdateDirtyMatrices()
+	unsigned int GetLastHierarchyCount();	// World matrices composed from a parent by the last UpdateDirtyMatrices()
+
+private:
+	// Local transform components, one array per float
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> pitch, yaw, roll;
+	std::vector<float> scaleX, scaleY, scaleZ;
+
+	// Results, stored per transform since they're read per entity
+	// - Transforms without a parent write straight into the world arrays
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+	std::vector<DirectX::XMFLOAT4X4> worldInverseTransposeMatrices;
+	std::vector<DirectX::XMFLOAT4X4> localMatrices;
+	std::vector<DirectX::XMFLOAT4X4> localInverseTransposeMatrices;
+
+	// Hierarchy
+	std::vector<unsigned int> parents;
+	std::vector<Transform*> owners;
+	std::vector<unsigned int> depthFirstOrder;	// Slots, every subtree contiguous
+	std::vector<unsigned int> orderIndex;		// Slot -> position in depthFirstOrder
+	std::vector<unsigned int> subtreeSize;		// Slot -> itself + all descendants
+
+	std::vector<std::atomic<unsigned long long>> localDirtyBits;	// Local matrix needs rebuilding
+	std::vector<std::atomic<unsigned long long>> worldDirtyBits;	// World matrix needs rebuilding
+	std::vector<unsigned int> freeSlots;
+	std::vector<unsigned int> hierarchyScratch;
+	unsigned int slotCount;
+	unsigned int lastUpdateCount;
+	unsigned int lastHierarchyCount;
+
+	void MarkDirty(unsigned int slot);
+	void UpdateWorldMatrix(unsigned int slot);
+	void ComposeWithParent(unsigned int slot);
+
+	// Rebuilds the dirty slots of a range of dirty-bit words, returns how many
+	unsigned int UpdateLocalMatrices(unsigned int firstWord, unsigned int endWord);
+
+	// Builds the local matrices of four slots at once (slots may repeat)
+	void CalculateMatrices(const unsigned int slots[4]);
+};
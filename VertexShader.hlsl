@@ -1,8 +1,14 @@
 #include "ShaderIncludes.hlsli"
 
-cbuffer ExternalData : register(b0)
+cbuffer PerFrame : register(b0)
 {
-    matrix worldMatrix, projectionMatrix, viewMatrix, worldInvTranspose, shadowView, shadowProjection;
+    matrix projectionMatrix, viewMatrix;
+}
+
+cbuffer PerObject : register(b1)
+{
+    matrix worldMatrix, worldInvTranspose;
+    float4 objectTint;
 }
 
 // --------------------------------------------------------
@@ -31,8 +37,7 @@ VertexToPixel main( VertexShaderInput input )
     output.normal = mul((float3x3) worldInvTranspose, input.normal);
     output.worldPosition = mul(worldMatrix, float4(input.localPosition, 1.0f)).xyz;
     output.tangent = mul((float3x3) worldMatrix, input.tangent);
-    matrix shadowWVP = mul(shadowProjection, mul(shadowView, worldMatrix));
-    output.shadowMapPos = mul(shadowWVP, float4(input.localPosition, 1.0f));
+    output.tint = objectTint;
 	// Whatever we return will make its way through the pipeline to the
 	// next programmable stage we're using (the pixel shader for now)
 	return output;